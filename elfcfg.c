@@ -18,6 +18,7 @@
  *                                                                         *
  ***************************************************************************/
 
+#define _GNU_SOURCE     /* strcasestr() */
 #include <unistd.h>
 #include <malloc.h>
 #include <stdio.h>
@@ -25,6 +26,7 @@
 #include <ctype.h>
 #include <time.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 
 #include <sys/types.h>
@@ -37,127 +39,149 @@
  */
 void  strupr (char *str);
 
+static char  *trim (char *str);
+
 
 /* --------------------------------
  * ------------  code  ------------
  */
 
-/* open the named (config) file,
- * and return a FILE pointer;
- * returns NULL upon failure;
+/* read the named config file in one pass, into the table <pct>;
+ * each "KEY = value" line makes one entry, keys are stored in upper
+ * case, values as given (trimmed); repeated keys are kept in order;
+ * returns the number of entries, or -1 if the file cannot be opened
  */
-FILE  *openCfgfile (char *name)
+int  cfgLoad (cfgTable *pct, const char *name)
 {
-    return (fopen (name, "r"));
+    FILE    *pf;
+    char     lbuf[CFG_STR_MAX + CFG_KEY_MAX];
+    char    *pk, *pv, *p;
+
+    pct->count = 0;
+    if (!(pf = fopen (name, "r")))
+        return -1;
+
+    while (fgets (lbuf, sizeof (lbuf), pf))
+    {
+        if ((p = strchr (lbuf, '\n')))              /* terminate at \n */
+            *p = '\0';
+        pk = trim (lbuf);
+        if ((*pk == '#') || (*pk == '\0'))         /* comment line ?  */
+            continue;
+        if (!(pv = strchr (pk, '=')))               /* must have a '=' */
+            continue;
+        *pv++ = '\0';
+        pk = trim (pk);
+        pv = trim (pv);
+        if ((*pk == '\0') || (strlen (pk) >= CFG_KEY_MAX))
+            continue;
+
+        if (pct->count >= CFG_ITEMS_MAX)
+        {
+            fprintf (stderr, "config: more than %d items, <%s> ignored\n", CFG_ITEMS_MAX, pk);
+            continue;
+        }
+        strupr (pk);
+        strcpy (pct->item[pct->count].key, pk);
+        strncpy (pct->item[pct->count].value, pv, CFG_STR_MAX);
+        pct->item[pct->count].value[CFG_STR_MAX-1] = '\0';
+        pct->count++;
+    }
+
+    fclose (pf);
+    return pct->count;
 }
 
 
 
-/* look for the given key in a file,
- * and return a pointer to the value specified after "=';
- * if none was found, NULL is returned
+/* return the value of the <n>-th occurrence (0 = first) of a key,
+ * or NULL if there is no such entry; keys are not case sensitive
  */
-int  getstrcfgitem (FILE *pf, char *pItem, char *ptarget)
+const char  *cfgGetStrN (cfgTable *pct, const char *key, int n)
 {
-    char   lbuf[256];
-    char  *p, *pr;
-    int    done, rv;
-
-    if (!pf)
-        return 0;
+    int  i;
 
-    rewind (pf);
-    done = 0;
-    rv   = 0;
-    pr   = NULL;
-    do
+    for (i=0; i<pct->count; i++)
     {
-        lbuf[0] = '\0';
-        if ((fgets (lbuf, 255, pf)) == NULL)
-            done = 1;
-        else
-        {
-            strupr (lbuf);
-            if (lbuf[0] == '#')                      /* comment line ?  */
-                continue;
-            if ((p = strchr (lbuf, '\n')))           /* terminate at \n */
-                *p = '\0';
-            if ((p = strstr (lbuf, pItem)) == NULL)  /* find the key    */
-                continue;
-            p += strlen (pItem);                     /* skip behind key */
-            if (!(pr = strchr(p, '=')))              /* must have a '=' */
-                continue;
-            p = pr;                                  /* skip past it !  */
-            p++;
-            while ((*p == ' ') || (*p == '\t'))      /* skip all spaces */
-                p++;
-            if ((*p != '\0') && (*p != '\n'))
-            {
-                strcpy (ptarget, p);
-                done = 1;
-                rv   = 1;
-            }
-        }
+        if (strcasecmp (pct->item[i].key, key) != 0)
+            continue;
+        if (n-- == 0)
+            return (pct->item[i].value);
     }
-    while (!done);
-    return (rv);
+    return NULL;
+}
+
+
+
+/* return the value of a key, or NULL if the key is not given,
+ * or has an empty value
+ */
+const char  *cfgGetStr (cfgTable *pct, const char *key)
+{
+    const char  *pv;
+
+    pv = cfgGetStrN (pct, key, 0);
+    if (pv && (*pv == '\0'))
+        return NULL;
+    return pv;
 }
 
 
 
 /* read an integer configuration item;
- * if the item found, it is stored in the target pointer location,
- * and '1' is returned;
- * if the item was not found, the target pointer is not modified,
- * and 0 is returned;
+ * if the item is found and is a valid number, it is stored in the
+ * target location, and '1' is returned;
+ * otherwise the target is not modified, and 0 is returned
  */
-int  getintcfgitem (FILE *pf, char *pItem, int *pvalue)
+int  cfgGetInt (cfgTable *pct, const char *key, int *pvalue)
 {
-    char   lbuf[256];
-    char  *p, *pe;
-    int    done, rv, i;
+    const char  *pv;
+    char        *pe;
+    long         l;
 
-    if (!pf)
+    if (!(pv = cfgGetStr (pct, key)))
         return 0;
 
-    rewind (pf);
-    done = 0;
-    rv   = 0;
-    do
-    {
-        lbuf[0] = '\0';
-        if ((fgets (lbuf, 255, pf)) == NULL)
-            done = 1;
-        else
-        {
-            strupr (lbuf);
-            if (lbuf[0] == '#')                      /* comment line ?  */
-                continue;
-            if ((p = strchr (lbuf, '\n')))           /* terminate at \n */
-                *p = '\0';
-            if ((p = strstr (lbuf, pItem)) == NULL)  /* find the key    */
-                continue;
-            p += strlen (pItem);                     /* skip behind key */
-            if (!(pe = strchr(p, '=')))              /* must have a '=' */
-                continue;
-            p = pe;                                  /* skip past it !  */
-            p++;
-            while ((*p == ' ') || (*p == '\t'))      /* skip spaces     */
-                p++;
-            if ((*p != '\0') && (*p != '\n'))
-            {
-                i = (int) strtol (p, &pe, 10);       /* check for some valid number */
-                if ((i != 0) && (pe != p))
-                {
-                    *pvalue = i;
-                    rv      = 1;
-                }
-                done = 1;
-            }
-        }
-    }
-    while (!done);
-    return (rv);
+    l = strtol (pv, &pe, 0);
+    if ((pe == pv) || (*trim (pe) != '\0'))
+        return 0;
+    *pvalue = (int) l;
+    return 1;
+}
+
+
+
+/* read a floating point configuration item;
+ * same rules as for integer items
+ */
+int  cfgGetDbl (cfgTable *pct, const char *key, double *pvalue)
+{
+    const char  *pv;
+    char        *pe;
+    double       d;
+
+    if (!(pv = cfgGetStr (pct, key)))
+        return 0;
+
+    d = strtod (pv, &pe);
+    if ((pe == pv) || (*trim (pe) != '\0'))
+        return 0;
+    *pvalue = d;
+    return 1;
+}
+
+
+
+/* check if a string item contains <word>, not case sensitive;
+ * returns 1 if so, 0 if not, or if the item is not given
+ */
+int  cfgIsStr (cfgTable *pct, const char *key, const char *word)
+{
+    const char  *pv;
+
+    if (!(pv = cfgGetStr (pct, key)))
+        return 0;
+    return (strcasestr (pv, word) != NULL);
 }
 
 
@@ -179,3 +203,19 @@ void  strupr (char *str)
     }
 }
 
+
+
+/* strip leading and trailing white space, in place;
+ * returns a pointer to the first non-space character
+ */
+static char  *trim (char *str)
+{
+    char  *pe;
+
+    while (isspace ((unsigned char) *str))
+        str++;
+    pe = str + strlen (str);
+    while ((pe > str) && isspace ((unsigned char) pe[-1]))
+        *--pe = '\0';
+    return str;
+}
@@ -19,6 +19,7 @@
  *                                                                         *
  ***************************************************************************/
 
+#define _GNU_SOURCE     /* strcasestr() */
 #include <unistd.h>
 #include <malloc.h>
 #include <stdio.h>
@@ -31,6 +32,8 @@
 #include <sys/mman.h>
 #include <time.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
@@ -38,6 +41,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
 
 #define _GMT_DATA_      /* declare const tables here */
 #include "gmt.h"
@@ -45,60 +50,232 @@
 // ----- data definitions -----
 #define I2C_NAME_BASE       "/dev/i2c-"
 
-/* struct to pass certain parameters to a thread
+/* struct to pass certain parameters to a thread;
+ * one per sensor
  */
 typedef struct
 {
-    int            ifh;          /* i2c file handle               */
+    gmtDevice      dev;          /* sensor, and its driver        */
     int            ofh;          /* streaming pipe file handle    */
-    unsigned long  vcount;       /* number values / i2c reads     */
-    unsigned long  ecount;       /* number of i2c read errors     */
+    metSensor     *met;          /* samples, errors, timing       */
     magnBuffer     vBuf;         /* sensor value buffer           */
-    uchar          addr;         /* i2c slave device address      */
     int            axes;         /* axis sampling configuration   */
     int            mode;         /* data file value mode          */
+    int            storage;      /* storage backends, GMT_STORE_* */
     double         fullScale;    /* configured fullscale value    */
     double         scaleVal;     /* physical scale value          */
     double         dx;           /* scaled double values per axis */
     double         dy;
     double         dz;
+    time_t         tstamp;       /* time of the (averaged) sample */
+    double         odRate;       /* sensor OD rate, in Hz         */
+    unsigned long  nsmpl;        /* raw samples in the average    */
+    double         dmin[GMT_AXES]; /* extremes of the raw samples */
+    double         dmax[GMT_AXES];
+    int            dtype;        /* ELFD_DTYPE_FLOAT / _INT       */
+    double         unit;         /* _INT: Ga per integer unit     */
+    int            ival[GMT_AXES]; /* _INT: average, in units     */
+    int            imin[GMT_AXES]; /* _INT: extremes, in units    */
+    int            imax[GMT_AXES];
+    gmtDecim      *decim;        /* decimation stage, or NULL     */
+    double         dsd[GMT_AXES]; /* decim: standard deviation    */
+    gmtCapture    *cap;          /* raw capture, or NULL          */
+    int            index;        /* position in the sensor list   */
+    char           tag[GMT_NAME_SIZE]; /* day file name tag       */
+    gmtRing       *ring;         /* sampler -> consumer           */
+    rawAccum       arec;         /* current record, continuous    */
+    time_t         curslot;      /* its slot, time / recPeriod    */
+    gmtSaver       save;         /* its files, storage thread     */
+    int            drdy;         /* data-ready source, GMT_DRDY_* */
+    int            gfd;          /* DRDY gpio line, or -1         */
 }
 sampler_cfg;
 
+/* one i2c bus, with the sensors on it;
+ * served by one sampler thread in continuous mode
+ */
+typedef struct
+{
+    int            bus;          /* bus number                    */
+    int            ifh;          /* i2c file handle               */
+    int            nsens;        /* sensors on the bus            */
+    sampler_cfg   *sens[GMT_MAX_SENSORS];
+    gmtSched       sched;        /* sample tick                   */
+    pthread_t      thread;
+}
+busWorker;
+
 // -------- Prototypes --------
 
 static void   initDefaultCfg   (elfSenseConfig *pcfg);
-static int    getConfig        (elfSenseConfig *pecfg, deviceConfig *dcfg);
-static void   setSensorConfig  (elfSenseConfig *pecfg, deviceConfig *dcfg);
-static int    setupSensor      (deviceConfig *dcfg, int ifh);
-static int    i2c_write        (uchar slave_addr, uchar reg, uchar data, int ifh);
-static int    i2c_readMagn     (magnBuffer *mBuf, uchar slave_addr, int ifh);
+static int    getConfig        (elfSenseConfig *pecfg);
+static int    parseSensor      (const char *pv, sensorConfig *ps);
+static int    openSensor       (elfSenseConfig *pecfg, int k);
+static void   closeAll         (void);
+static int    waitSample       (sampler_cfg *gmdata);
 static int    gmSample         (sampler_cfg *gmdata);
-static int    writeData        (sampler_cfg *gmdata);
-
-static void   exithandler      (int signumber);
+static void   countSample      (sampler_cfg *gmdata, int n);
+static int    storeSample      (void *arg, storeRecord *pr);
+static void   putSample        (sampler_cfg *gmdata);
+static void   putRecord        (sampler_cfg *gmdata);
+static void   putDecim         (sampler_cfg *gmdata);
+static void   putStorm         (sampler_cfg *gmdata, const double *pv);
+static int    stormStart       (elfSenseConfig *pecfg);
+static void   putSpec          (gspRecord *pr);
+static void   putCapture       (sampler_cfg *gmdata, rawBlock *pb);
+static void   intToPhys        (sampler_cfg *gmdata);
+static int    runContinuous    (elfSenseConfig *pecfg);
+static void  *samplerThread    (void *arg);
+static int    drainRings       (void);
+static void   drainEnd         (void);
+static int    consumeTick      (void *arg, int fd, unsigned int events);
+static int    sampleTick       (void *arg, int fd, unsigned int events);
+static int    onSignal         (void *arg, int fd, unsigned int events);
+
+static void   reloadConfig     (void);
+static void   applyConfig      (elfSenseConfig *pcur);
 
 #if 0
 static void   updateRLog       (void);
 static void   printHelp        (char **);
 #endif
 
-extern FILE  *openCfgfile      (char *name);
-extern int    getstrcfgitem    (FILE *pf, char *pItem, char *ptarget);
-extern int    getintcfgitem    (FILE *pf, char *pItem, int *pvalue);
-
-#ifdef __SIMULATION__
-  #define localtime   sim_localtime
-  static struct tm   *sim_localtime (const time_t *timep);
-#endif
+extern int          cfgLoad      (cfgTable *pct, const char *name);
+extern const char  *cfgGetStr    (cfgTable *pct, const char *key);
+extern const char  *cfgGetStrN   (cfgTable *pct, const char *key, int n);
+extern int          cfgGetInt    (cfgTable *pct, const char *key, int *pvalue);
+extern int          cfgGetDbl    (cfgTable *pct, const char *key, double *pvalue);
+extern int          cfgIsStr     (cfgTable *pct, const char *key, const char *word);
+
+extern void          writerSetPolicy (gmtWriter *pw, int batch, int syncMode, int syncValue);
+extern int           saveInit     (gmtSaver *ps, const char *path, const char *tag, int period,
+                                   double fullScale, int dtype, double unit, int batch,
+                                   int syncMode, int syncValue);
+extern void          saveSetPath  (gmtSaver *ps, const char *path);
+extern int           saveRecord   (gmtSaver *ps, const storeRecord *pr);
+extern void          saveClose    (gmtSaver *ps);
+extern void          accAdd       (rawAccum *pa, const magnBuffer *pm);
+extern void          accAddN      (rawAccum *pa, const magnBuffer *pm, int n);
+extern void          accResult    (rawAccum *pa, double scale, double *pmean, double *pmin,
+                                   double *pmax);
+extern void          accResultInt (rawAccum *pa, int *pmean, int *pmin, int *pmax);
+extern void          accMean      (const gmtDriver *pd, const magnBuffer *pm, int n, double scale,
+                                   double *pmean, double *pmin, double *pmax);
+
+extern gmtHistory   *histCreate   (int days, int period);
+extern void          histDestroy  (gmtHistory *ph);
+extern int           histAppend   (gmtHistory *ph, time_t t, const double *pv);
+
+extern gmtPublisher *udpCreate    (const char *targets, int station);
+extern void          udpDestroy   (gmtPublisher *pp);
+extern void          udpQueue     (gmtPublisher *pp, int type, const struct timespec *ts, int period,
+                                    unsigned long count, const double *pmean, const double *pmin,
+                                    const double *pmax);
+extern void          udpQueueInt  (gmtPublisher *pp, int type, const struct timespec *ts, int period,
+                                   unsigned long count, const int *pmean, const int *pmin,
+                                   const int *pmax, double scale);
+extern int           udpFlush     (gmtPublisher *pp);
+extern void          udpQueueAlert (gmtPublisher *pp, const stormEvent *pe, int period);
+extern gmtStorm     *stormCreate  (int period, int baseline);
+extern void          stormDestroy (gmtStorm *ps);
+extern void          stormSetLimits (gmtStorm *ps, double dbdt, double dev, int hyst);
+extern int           stormAdd     (gmtStorm *ps, time_t t, const double *pv, stormEvent *pe);
+extern unsigned long histQuery    (gmtHistory *ph, time_t from, time_t to, histStats *ps);
+extern gmtSpec      *specCreate   (int size, double rate, double scale, int interval, double fmax,
+                                   const char *path, const char *tag);
+extern void          specDestroy  (gmtSpec *ps);
+extern gspRecord    *specPut      (gmtSpec *ps, const struct timespec *pt, const magnBuffer *pm);
+extern gspRecord    *specFlush    (gmtSpec *ps);
+extern size_t        specSize     (const gmtSpec *ps);
+extern int           specWrite    (gmtSpec *ps, const gspRecord *pr);
+extern gmtCapture   *capCreate    (const char *path, const char *tag, int sensor, int device, int bus,
+                                   int addr, double rate, double fullScale, double scale, int mb,
+                                   int rotate);
+extern void          capDestroy   (gmtCapture *pc);
+extern rawBlock     *capPut       (gmtCapture *pc, const gmtRecord *pr, unsigned long overruns);
+extern rawBlock     *capFlush     (gmtCapture *pc);
+extern void          capLost      (gmtCapture *pc, unsigned int n);
+extern int           capWrite     (gmtCapture *pc, const rawBlock *pb);
+
+extern gmtQueryServer *qryCreate  (int port, gmtHistory *hist, const char *path);
+extern const gmtDriver *drvGet    (int device);
+extern const gmtDriver *drvFind   (const char *name);
+extern int           devOpen      (gmtDevice *pd, const gmtDriver *drv, int ifh, int addr, int rate);
+extern int           devRead      (gmtDevice *pd, magnBuffer *pm);
+extern int           devReady     (gmtDevice *pd);
+extern int           gpioOpen     (const char *chip, int line);
+extern int           gpioWait     (int fd, int ms);
+extern void          gpioClose    (int fd);
+extern void          schedInit    (gmtSched *ps, clockid_t clock, long long period,
+                                   const struct timespec *pbase);
+extern int           schedWait    (gmtSched *ps, struct timespec *pslot);
+extern int           schedTimer   (gmtSched *ps);
+extern int           schedExpired (gmtSched *ps, struct timespec *pslot);
+extern void          schedClose   (gmtSched *ps);
+extern void          schedReport  (gmtSched *ps, const char *name);
+extern gmtLoop      *loopCreate   (void);
+extern void          loopDestroy  (gmtLoop *pl);
+extern int           loopAdd      (gmtLoop *pl, int fd, unsigned int events, loopHandler fn, void *arg);
+extern void          loopDel      (gmtLoop *pl, int fd);
+extern int           loopSignals  (gmtLoop *pl, const sigset_t *pset, loopHandler fn, void *arg);
+extern int           loopRun      (gmtLoop *pl);
+extern gmtDecim     *decimCreate  (int mode, int order, int factor);
+extern void          decimDestroy (gmtDecim *pd);
+extern int           decimPut     (gmtDecim *pd, const magnBuffer *pm);
+extern unsigned long decimResult  (gmtDecim *pd, decimStats *ps);
+extern void          qryDestroy   (gmtQueryServer *pq);
+extern void          qrySetPath   (gmtQueryServer *pq, const char *path);
+
+extern gmtRing       *ringCreate   (unsigned long count, size_t esize);
+extern void           ringDestroy  (gmtRing *pr);
+extern int            ringPush     (gmtRing *pr, const void *pe);
+extern int            ringPop      (gmtRing *pr, void *pe);
+extern int            ringPeek     (gmtRing *pr, void *pe);
+extern unsigned long  ringOverruns (gmtRing *pr);
+extern unsigned long  ringCount    (gmtRing *pr);
+
+extern gmtMetricServer *metCreate  (gmtMetrics *pm, const char *file, int port, int interval);
+extern void           metDestroy   (gmtMetricServer *ps);
+extern void           metAdd       (_Atomic unsigned long long *pc, unsigned long long n);
+extern void           metSet       (_Atomic long long *pg, long long v);
+extern void           metObserve   (metHist *ph, long long ns);
+extern long long      metClock     (void);
+
+extern gmtStore      *storeCreate  (unsigned long limit, int payload, int policy, storeSink fn,
+                                    void *arg, gmtMetrics *pm);
+extern void           storeDestroy (gmtStore *ps);
+extern int            storePut     (gmtStore *ps, const storeRecord *pr);
+extern int            storeWait    (gmtStore *ps, int ms);
+extern void           storeSkip    (gmtStore *ps);
+extern void           storeSetLimit (gmtStore *ps, unsigned long limit, int payload, int policy);
 
 // -------- global variables --------
 
 static runtime_log     rLog = {0, 0, 0};
-static char            devName[64] = {'\0'};
-static int             iDev        = 0;               /* i2c device handle */
-static unsigned short  dData[MINS_PER_DAY][GMT_AXES];
+static gmtHistory     *dHist       = NULL;            /* recent samples     */
+static gmtPublisher   *dPub        = NULL;            /* UDP live data      */
+static gmtPublisher   *dAlert      = NULL;            /* alerts, or dPub    */
+static gmtStorm       *dStorm      = NULL;            /* storm detector     */
+static gmtSpec        *dSpec       = NULL;            /* spectra, or NULL   */
+static gmtQueryServer *dQuery      = NULL;            /* TCP range queries  */
+static gmtMetrics      dMetrics;                      /* runtime metrics    */
+static gmtMetricServer *dMetSrv    = NULL;            /* their export       */
+static gmtStore       *dStore      = NULL;            /* storage thread     */
 static char            datapath[FILENAME_MAXSIZE] = { GMT_DATA_PATH };
+static volatile sig_atomic_t  gmtExit   = 0;          /* set on SIGTERM     */
+static gmtLoop        *dLoop       = NULL;            /* main thread events */
+static rawAccum        secAcc;                        /* live second, first */
+static time_t          secTime     = -1;              /* sensor; its second */
+static elfSenseConfig  *activeCfg  = NULL;            /* settings in use    */
+static elfSenseConfig   newCfg;                       /* reloaded settings  */
+static atomic_int       cfgPending = 0;               /* newCfg not applied */
+static pthread_mutex_t  cfgLock    = PTHREAD_MUTEX_INITIALIZER;
+static busWorker       dBus[GMT_MAX_SENSORS];         /* open i2c buses     */
+static int             nBuses      = 0;
+static int             nSensors    = 0;
+static struct timespec tickStart;                     /* common sample tick */
+static long            tickPeriod;                    /* in ns              */
+static int             recPeriod   = GMT_SAMPLE_PERIOD;  /* record period, s */
 
 #ifdef __SIMULATION__
   /* in simulation mode, run max 5 minutes */
@@ -106,21 +283,22 @@ static char            datapath[FILENAME_MAXSIZE] = { GMT_DATA_PATH };
 static int        txcount         = 0;
 #endif
 
-/* work data for the sampler
+/* work data for the sampler, per sensor
  */
-static sampler_cfg  cbData      = {0};
-
-/*  The concept is simple - take a sensor sample once a minute, and
- *  eventually store it in a file. Timing is thus not of very critical
- *  importance, and simple date/time function and sleep calls are fine to
- *  achieve a sufficient accuracy.
- *  To keep long-time deviations low, the current time is evaluated after
- *  each measurement, and the remainder to the next full minute is used
- *  as parameter for the sleep() call.
- *  Currently, the sampled data are saved to a file and additionally kept
- *  in memory for one day- just because we can.
- *  At a later point, direct TCP access and query for data values might
- *  be implemented.
+static sampler_cfg  cbData[GMT_MAX_SENSORS];
+
+/*  The concept is simple - take a sensor sample once per sample period
+ *  (a minute by default), and eventually store it in a file.
+ *  To correlate events across stations, the samples are taken at the
+ *  wall clock period boundaries; the scheduler timer expires at the
+ *  absolute time of the next boundary, so neither wake-up latency nor
+ *  sampling time accumulate, and each record carries the time of its
+ *  boundary. The main thread waits in one event loop for that timer,
+ *  the consumer timer of continuous mode, and the signals, and sleeps
+ *  in between.
+ *  The records are saved to the day files, and additionally kept in
+ *  memory for HISTORY_DAYS days, which the TCP query server answers
+ *  range requests from.
  */
 // *****************************Code************************************
 
@@ -129,10 +307,8 @@ static sampler_cfg  cbData      = {0};
 int  main (int argc, char **argv)
 {
     elfSenseConfig  escfg;
-    deviceConfig    dcfg;
-    time_t          t;
-    struct tm      *ptime;
-    int             i;
+    gmtSched        sched;
+    int             i, k;
 
     /* open and read the configuration:
      * sensor device  [default = LSM303]
@@ -142,97 +318,264 @@ int  main (int argc, char **argv)
     initDefaultCfg (&escfg);
 
     /* load configuration */
-    getConfig (&escfg, &dcfg);
+    getConfig (&escfg);
+    strcpy (datapath, escfg.dataPath);
+    recPeriod = escfg.samplePeriod;
+    activeCfg = &escfg;
+
+    /* several sensors are only read by the per-bus sampler threads */
+    nSensors = escfg.nSensors;
+    if ((nSensors > 1) && (escfg.acqMode == GMT_ACQ_SINGLE))
+    {
+        printf ("%d sensors, acquisition is continuous\n", nSensors);
+        escfg.acqMode = GMT_ACQ_CONTINUOUS;
+    }
+
+#ifdef __SIMULATION__
+    fprintf (stdout, "run in simulation mode, with random data !\n");
+#endif
+
+    /* open each bus once, and configure and start its sensors */
+    for (k=0; k<GMT_MAX_SENSORS; k++)
+    {
+        cbData[k].save.writer.fd = cbData[k].save.esd.fd = cbData[k].gfd = -1;
+        cbData[k].save.hdrFmt    = -1;
+    }
+    for (k=0; k<nSensors; k++)
+    {
+        cbData[k].met = &dMetrics.sensor[k];
+        if ((i = openSensor (&escfg, k)) != 0)
+        {
+            closeAll ();
+            return i;
+        }
+        cbData[k].axes    = escfg.sampleAxes;
+        cbData[k].mode    = escfg.outputMode;
+        cbData[k].storage = escfg.storage;
+        cbData[k].dtype   = escfg.dataType;
+        cbData[k].unit    = cbData[k].scaleVal / (1 << GMT_INT_FRAC_BITS);
+        cbData[k].dev.met = cbData[k].met;
+    }
+    dMetrics.sensors = nSensors;
+    dMetrics.start   = time (NULL);
+    escfg.fullScale = cbData[0].fullScale;
 
-#ifndef __SIMULATION__
 
-    /* make device name, and open */
-    sprintf (devName, "%s%d",I2C_NAME_BASE, escfg.i2cBus);
-    if ((iDev = open (devName, O_RDWR)) < 0)
+    /* the signals are events of the main loop; they are blocked here,
+     * before any thread is started, so no thread takes them */
     {
-        perror (devName);
-        return 10;
+        sigset_t  sset;
+
+        sigemptyset (&sset);
+        sigaddset (&sset, SIGTERM);
+        sigaddset (&sset, SIGINT);
+        sigaddset (&sset, SIGHUP);
+        pthread_sigmask (SIG_BLOCK, &sset, NULL);
+        if (!(dLoop = loopCreate ()) || (loopSignals (dLoop, &sset, onSignal, NULL) != 0))
+        {
+            perror ("event loop");
+            closeAll ();
+            return 21;
+        }
     }
 
-    /* some general i2c settings... */
-    ioctl (iDev, I2C_TENBIT, 0);    // 10-bit addressing off
-    ioctl (iDev, I2C_RETRIES, 5);
 
-    /* need to dynamically assign the sensor device here later */
-    setSensorConfig (&escfg, &dcfg);
+    /* live data publisher, if targets are configured */
+    if (escfg.targets[0] && !(dPub = udpCreate (escfg.targets, escfg.stationId)))
+        printf ("no valid publish target in <%s> !\n", escfg.targets);
+    if (escfg.alerts[0] && !(dAlert = udpCreate (escfg.alerts, escfg.stationId)))
+        printf ("no valid alert target in <%s> !\n", escfg.alerts);
+    if (stormStart (&escfg) != 0)
+    {
+        printf ("no memory for the storm detector !\n");
+        closeAll ();
+        return 27;
+    }
 
-    /* configure and start the sensor */
-    i = setupSensor (&dcfg, iDev);
-    if (i != 0)
+    /* keep the recent days in memory, one slot per record */
+    if (!(dHist = histCreate (escfg.historyDays, recPeriod)))
     {
-        printf ("setupSensor() ret = %d, error !\n", i);
-        fflush (stdout);
-        return 20;
+        printf ("no memory for %d days of history !\n", escfg.historyDays);
+        closeAll ();
+        return 24;
     }
 
-#else
-    escfg.fullScale = FS_VALUE_LSM303;
-    fprintf (stdout, "run in simulation mode, with random data !\n");
-#endif    /* __simulation__ */
+    /* query server; its thread must not take the main thread's signals */
+    if (escfg.queryPort > 0)
+    {
+        sigset_t  sset, oset;
 
+        sigfillset (&sset);
+        pthread_sigmask (SIG_BLOCK, &sset, &oset);
+        if (!(dQuery = qryCreate (escfg.queryPort, dHist, datapath)))
+            printf ("query server not started !\n");
+        pthread_sigmask (SIG_SETMASK, &oset, NULL);
+    }
 
-    /* set exit handler */
-    signal (SIGTERM, exithandler);
+    /* metrics export, to a file and / or on the loopback interface */
+    if (escfg.metricsFile[0] || (escfg.metricsPort > 0))
+    {
+        sigset_t  sset, oset;
+
+        sigfillset (&sset);
+        pthread_sigmask (SIG_BLOCK, &sset, &oset);
+        if (!(dMetSrv = metCreate (&dMetrics, escfg.metricsFile, escfg.metricsPort,
+                                   escfg.metricsInterval)))
+            printf ("metrics export not started !\n");
+        pthread_sigmask (SIG_SETMASK, &oset, NULL);
+    }
 
+    /* the files of each sensor, all used by the storage thread */
+    for (k=0; k<nSensors; k++)
+    {
+        if (saveInit (&cbData[k].save, datapath, cbData[k].tag, recPeriod, cbData[k].fullScale,
+                      cbData[k].dtype, cbData[k].unit, escfg.writeBatch, escfg.syncMode,
+                      escfg.syncValue) != 0)
+        {
+            printf ("no memory for the writer !\n");
+            closeAll ();
+            return 25;
+        }
+        cbData[k].save.writer.written = &dMetrics.bytes;
+    }
 
-    /* initialize/copy some "work" data */
-    cbData.ifh       = iDev;
-    cbData.addr      = dcfg.dev_addr;
-    cbData.axes      = escfg.sampleAxes;
-    cbData.mode      = escfg.outputMode;
-    cbData.fullScale = (escfg.device == GMT_DEVICE_LSM303) ? FS_VALUE_LSM303 : FS_VALUE_HMC5883;
-    cbData.scaleVal  = cbData.fullScale / SHORT_MAX_DBL;
+    /* the storage thread, from here on the only user of the writers */
+    {
+        sigset_t  sset, oset;
 
-    /* clear out, just to be safe */
-    memset (dData, 0, sizeof (dData));
+        sigfillset (&sset);
+        pthread_sigmask (SIG_BLOCK, &sset, &oset);
+        dStore = storeCreate (escfg.backlog, escfg.payload, escfg.overflow, storeSample, NULL, &dMetrics);
+        pthread_sigmask (SIG_SETMASK, &oset, NULL);
+        if (!dStore)
+        {
+            printf ("storage thread not started !\n");
+            closeAll ();
+            return 26;
+        }
+    }
 
-    /* prepare to enter the main loop;
-     * first, get near the next minute mark */
+    if ((escfg.acqMode != GMT_ACQ_CONTINUOUS) && (escfg.decimMode != GMT_DECIM_NONE))
+        printf ("decimation is only used in continuous mode\n");
+    if ((escfg.acqMode != GMT_ACQ_CONTINUOUS) && (escfg.specSize > 0))
+        printf ("spectra are only computed in continuous mode\n");
+    if ((escfg.acqMode != GMT_ACQ_CONTINUOUS) && escfg.capPath[0])
+        printf ("raw capture is only done in continuous mode\n");
 
+    /* continuous mode; the main loop runs the consumer */
+    if (escfg.acqMode == GMT_ACQ_CONTINUOUS)
+    {
+        i = runContinuous (&escfg);
+        closeAll ();
+        return i;
+    }
+
+    /* the first sample is taken at the next period boundary */
 #ifdef __SIMULATION__
-    ptime = sim_localtime (&t);
-    usleep (300000);
+    schedInit (&sched, CLOCK_MONOTONIC, 120000000LL, NULL);
 #else
- /* use the current time */
-    t     = time (NULL);
-    ptime = localtime (&t);
-
-    if ((ptime->tm_sec > 5) && (ptime->tm_sec < 55))
-        sleep (60 - ptime->tm_sec);
+    schedInit (&sched, CLOCK_REALTIME, recPeriod * 1000000000LL, NULL);
 #endif
-
-    /* main loop; sample and save once a minute */
-    do
+    sched.jitter = &dMetrics.jitter;
+    if ((schedTimer (&sched) < 0) || (loopAdd (dLoop, sched.tfd, EPOLLIN, sampleTick, &sched) != 0))
     {
-        gmSample  (&cbData);
-fputc ('+', stdout); fflush (stdout);
-        writeData (&cbData);
+        perror ("sample timer");
+        closeAll ();
+        return 28;
+    }
 
-        i = 60 * ptime->tm_hour + ptime->tm_min;
-        dData[i][DI_X] = cbData.dx;
-        dData[i][DI_Y] = cbData.dy;
-        dData[i][DI_Z] = cbData.dz;
+    /* main loop; sample and save once per period, idle in between */
+    loopRun (dLoop);
 
+    loopDel (dLoop, sched.tfd);
+    schedClose (&sched);
+    schedReport (&sched, "scheduler");
+    closeAll ();
+    return 0;
+}
+
+
+
+/* sample tick of single mode; sample and save, at the period
+ * boundary, and take over a reloaded configuration; the sample is
+ * skipped, and counted as dropped, while a blocking storage queue
+ * is full
+ * returns 0, the loop goes on
+ */
+static int  sampleTick (void *arg, int fd, unsigned int events)
+{
+    struct timespec  tslot;
+
+    if (schedExpired ((gmtSched *) arg, &tslot) != 0)
+        return 0;
+    if (storeWait (dStore, GMT_STORE_WAIT) == 0)
+    {
 #ifdef __SIMULATION__
-        usleep (120000);
-#else
-        t     = time (NULL);
-        ptime = localtime (&t);
-        sleep (60 - ptime->tm_sec);
+        clock_gettime (CLOCK_REALTIME, &tslot);
 #endif
+        gmSample  (&cbData[0]);
+        cbData[0].tstamp = tslot.tv_sec;
+fputc ('+', stdout); fflush (stdout);
+        putSample (&cbData[0]);
     }
-    while (1);
-
+    else
+        storeSkip (dStore);
+    applyConfig (activeCfg);
     return 0;
 }
 
 
 
+/* stop the query server, finish all files, and close the buses
+ */
+static void  closeAll (void)
+{
+    int  k;
+
+    qryDestroy (dQuery);
+    dQuery = NULL;
+    loopDestroy (dLoop);
+    dLoop = NULL;
+
+    /* all queued records are written first */
+    if (dStore)
+    {
+        storeDestroy (dStore);
+        printf ("storage: at most %lld records queued, %llu dropped\n", dMetrics.backlogPeak,
+                dMetrics.dropped);
+    }
+    dStore = NULL;
+    specDestroy (dSpec);
+    dSpec = NULL;
+    for (k=0; k<nSensors; k++)
+    {
+        capDestroy (cbData[k].cap);
+        cbData[k].cap = NULL;
+    }
+    metDestroy (dMetSrv);
+    dMetSrv = NULL;
+    for (k=0; k<nSensors; k++)
+    {
+        saveClose (&cbData[k].save);
+        gpioClose (cbData[k].gfd);
+        cbData[k].gfd = -1;
+    }
+    histDestroy (dHist);
+    dHist = NULL;
+    udpDestroy (dPub);
+    dPub = NULL;
+    udpDestroy (dAlert);
+    dAlert = NULL;
+    stormDestroy (dStorm);
+    dStorm = NULL;
+    for (k=0; k<nBuses; k++)
+        if (dBus[k].ifh >= 0)
+            close (dBus[k].ifh);
+    nBuses = 0;
+}
+
+
+
 #if 0
 static void  printHelp (char **argv)
 {
@@ -246,197 +589,596 @@ static void  initDefaultCfg (elfSenseConfig *pcfg)
     pcfg->device     = GMT_DEFAULT_DEVICE;
     pcfg->i2cBus     = GMT_DEFAULT_BUS;
     pcfg->sampleRate = GMT_DEFAULT_OD_RATE;
+    pcfg->samplePeriod = GMT_SAMPLE_PERIOD;
+    pcfg->dataType   = ELFD_DTYPE_FLOAT;
+    pcfg->decimMode  = GMT_DECIM_NONE;
+    pcfg->cicOrder   = GMT_CIC_ORDER;
+    pcfg->cicFactor  = GMT_CIC_FACTOR;
     pcfg->sampleAxes = GMT_AXIS_USE_X | GMT_AXIS_USE_Y | GMT_AXIS_USE_Z;  /* all axes */
+    pcfg->outputMode = GMT_AXIS_ALL;
+    pcfg->acqMode    = GMT_ACQ_SINGLE;
+    pcfg->storage    = GMT_STORE_TEXT;
+    pcfg->writeBatch = GMT_WRITE_BATCH;
+    pcfg->syncMode   = GMT_SYNC_NONE;
+    pcfg->syncValue  = 1;
+    pcfg->historyDays = GMT_HISTORY_DAYS;
+    pcfg->stationId  = 0;
+    pcfg->targets[0] = '\0';
+    pcfg->queryPort  = 0;
+    pcfg->metricsFile[0]  = '\0';
+    pcfg->metricsPort     = 0;
+    pcfg->metricsInterval = MET_INTERVAL;
+    pcfg->backlog    = GMT_STORE_BACKLOG;
+    pcfg->payload    = GMT_STORE_PAYLOAD;
+    pcfg->stormDbdt  = 0.0;
+    pcfg->stormDev   = 0.0;
+    pcfg->stormBaseline = STORM_BASELINE;
+    pcfg->stormHyst  = STORM_HYSTERESIS;
+    pcfg->alerts[0]  = '\0';
+    pcfg->specSize   = 0;
+    pcfg->specInterval = GSP_INTERVAL;
+    pcfg->specFmax   = 0.0;
+    strcpy (pcfg->specPath, FILENAME_BASE);
+    pcfg->capPath[0] = '\0';
+    pcfg->capSize    = RAW_FILE_SIZE;
+    pcfg->capRotate  = RAW_ROTATE;
+    pcfg->overflow   = GMT_OVF_DROP_OLDEST;
+    strcpy (pcfg->dataPath, GMT_DATA_PATH);
+    pcfg->drdyMode   = GMT_DRDY_NONE;
+    pcfg->drdyChip[0] = '\0';
+    pcfg->drdyLine   = -1;
+    memset (pcfg->sensor, 0, sizeof (pcfg->sensor));
+    pcfg->nSensors   = 1;
+    pcfg->sensor[0].device = pcfg->device;
+    pcfg->sensor[0].bus    = pcfg->i2cBus;
 }
 
 
 
-/* a stub at the moment; to implement later !
- *  - bus (default: 0)
- *  - device (default: ST LSM303DLHC)
- *  - OD rate (default: device max.)
- *  - axes used (default: Z only)
- *  - auto-termination time (default: 0 / none)
+/* read the configuration file into <pecfg>;
+ * the file is read once into a key / value table, the items
+ * are taken from there; value words are not case sensitive,
+ * path names are kept as given;
+ * returns 0 if the file was read, or 1 if not
  */
-static int  getConfig (elfSenseConfig *pecfg, deviceConfig *dcfg)
+static int  getConfig (elfSenseConfig *pecfg)
 {
-    FILE *pcf;
-    char  pd[128], px[128];
-    int   bus, rate, i, k;
+    static cfgTable  cfg;        /* main thread only */
+    const gmtDriver *pdrv;
+    const char      *pv;
+    double           d;
+    int              rate, k;
 
-    if (!(pcf = openCfgfile (GMT_CFG)))
+    if (cfgLoad (&cfg, GMT_CFG) < 0)
     {
         printf ("\n no config file (%d) !", errno);
-        return 0;
+        return 1;
     }
 
     /* string items */
-    if ((i = getstrcfgitem  (pcf, GMT_CFG_DEVICE, pd)))
+    if ((pdrv = drvFind (cfgGetStr (&cfg, GMT_CFG_DEVICE))))
+        pecfg->device = pdrv->device;
+
+    if ((pv = cfgGetStr (&cfg, GMT_CFG_DATAPATH)))
     {
-        if (strstr (pd, GMT_CFG_DEV_LSM303))
-        {
-            pecfg->device = GMT_DEVICE_LSM303;
-            setSensorConfig (pecfg, dcfg);
-        }
-        else if (strstr (pd, GMT_CFG_DEV_HMC5883))
-        {
-            pecfg->device = GMT_DEVICE_HMC5883;
-            setSensorConfig (pecfg, dcfg);
-        }
+        strncpy (pecfg->dataPath, pv, GMT_PATH_SIZE);
+        pecfg->dataPath[GMT_PATH_SIZE-1] = '\0';
+        printf ("\noutput file path  = <%s>", pecfg->dataPath);
     }
 
-    if ((k = getstrcfgitem  (pcf, GMT_CFG_DATAPATH, px)))
+    /* data output mode; axes separately, or vector sum */
+    if (cfgGetStr (&cfg, GMT_CFG_MODE))
     {
-        if (strlen (px) > 0)
+        pecfg->outputMode = GMT_AXIS_ALL;
+        if (cfgIsStr (&cfg, GMT_CFG_MODE, GMT_MD_SUM))
+            pecfg->outputMode = GMT_AXIS_SUM;
+    }
+
+    /* storage backend; text day files, binary day files, or both */
+    if (cfgIsStr (&cfg, GMT_CFG_STORAGE, GMT_ST_BOTH))
+        pecfg->storage = GMT_STORE_TEXT | GMT_STORE_BINARY;
+    else if (cfgIsStr (&cfg, GMT_CFG_STORAGE, GMT_ST_BINARY))
+        pecfg->storage = GMT_STORE_BINARY;
+    else if (cfgIsStr (&cfg, GMT_CFG_STORAGE, GMT_ST_TEXT))
+        pecfg->storage = GMT_STORE_TEXT;
+
+    /* live data publish targets, "host[:portbase], ..." */
+    if ((pv = cfgGetStr (&cfg, GMT_CFG_TARGETS)))
+    {
+        strncpy (pecfg->targets, pv, GMT_TARGET_SIZE);
+        pecfg->targets[GMT_TARGET_SIZE-1] = '\0';
+    }
+
+    if ((pv = cfgGetStr (&cfg, GMT_CFG_ALERTS)))
+    {
+        strncpy (pecfg->alerts, pv, GMT_TARGET_SIZE);
+        pecfg->alerts[GMT_TARGET_SIZE-1] = '\0';
+    }
+
+    /* storm thresholds, in nT / min and nT; 0 is off */
+    if (cfgGetDbl (&cfg, GMT_CFG_STORMDBDT, &d) && (d >= 0.0))
+        pecfg->stormDbdt = d;
+    if (cfgGetDbl (&cfg, GMT_CFG_STORMDEV, &d) && (d >= 0.0))
+        pecfg->stormDev = d;
+
+    /* spectra; highest frequency in Hz, and their directory */
+    if (cfgGetDbl (&cfg, GMT_CFG_SPECFMAX, &d) && (d >= 0.0))
+        pecfg->specFmax = d;
+    if ((pv = cfgGetStr (&cfg, GMT_CFG_SPECPATH)))
+    {
+        strncpy (pecfg->specPath, pv, GMT_PATH_SIZE);
+        pecfg->specPath[GMT_PATH_SIZE-1] = '\0';
+    }
+
+    /* raw capture directory; none if not given */
+    if ((pv = cfgGetStr (&cfg, GMT_CFG_CAPPATH)))
+    {
+        strncpy (pecfg->capPath, pv, GMT_PATH_SIZE);
+        pecfg->capPath[GMT_PATH_SIZE-1] = '\0';
+    }
+
+    /* metrics file, rewritten every METRICS_INTERVAL seconds */
+    if ((pv = cfgGetStr (&cfg, GMT_CFG_METFILE)))
+    {
+        strncpy (pecfg->metricsFile, pv, GMT_PATH_SIZE);
+        pecfg->metricsFile[GMT_PATH_SIZE-1] = '\0';
+    }
+
+    /* durability; when to force written data to the medium */
+    if (cfgIsStr (&cfg, GMT_CFG_SYNCMODE, GMT_SY_RECORDS))
+        pecfg->syncMode = GMT_SYNC_RECORDS;
+    else if (cfgIsStr (&cfg, GMT_CFG_SYNCMODE, GMT_SY_SECONDS))
+        pecfg->syncMode = GMT_SYNC_SECONDS;
+    else if (cfgIsStr (&cfg, GMT_CFG_SYNCMODE, GMT_SY_NONE))
+        pecfg->syncMode = GMT_SYNC_NONE;
+
+    /* storage backlog full; which record to lose, or to wait */
+    if (cfgIsStr (&cfg, GMT_CFG_OVERFLOW, GMT_OV_DROP_OLDEST))
+        pecfg->overflow = GMT_OVF_DROP_OLDEST;
+    else if (cfgIsStr (&cfg, GMT_CFG_OVERFLOW, GMT_OV_DROP_NEWEST))
+        pecfg->overflow = GMT_OVF_DROP_NEWEST;
+    else if (cfgIsStr (&cfg, GMT_CFG_OVERFLOW, GMT_OV_BLOCK))
+        pecfg->overflow = GMT_OVF_BLOCK;
+
+    /* acquisition mode; once a minute, or continuously at the OD rate */
+    if (cfgIsStr (&cfg, GMT_CFG_ACQMODE, GMT_ACQ_MD_CONTINUOUS))
+        pecfg->acqMode = GMT_ACQ_CONTINUOUS;
+    else if (cfgIsStr (&cfg, GMT_CFG_ACQMODE, GMT_ACQ_MD_SINGLE))
+        pecfg->acqMode = GMT_ACQ_SINGLE;
+
+    /* record data type; floats, or raw integer units */
+    if (cfgIsStr (&cfg, GMT_CFG_DTYPE, GMT_DT_INT))
+        pecfg->dataType = ELFD_DTYPE_INT;
+    else if (cfgIsStr (&cfg, GMT_CFG_DTYPE, GMT_DT_FLOAT))
+        pecfg->dataType = ELFD_DTYPE_FLOAT;
+
+    /* decimation stage of the continuous mode */
+    if (cfgIsStr (&cfg, GMT_CFG_DECIM, GMT_DC_BOXCAR))
+        pecfg->decimMode = GMT_DECIM_BOXCAR;
+    else if (cfgIsStr (&cfg, GMT_CFG_DECIM, GMT_DC_CIC))
+        pecfg->decimMode = GMT_DECIM_CIC;
+    else if (cfgIsStr (&cfg, GMT_CFG_DECIM, GMT_DC_NONE))
+        pecfg->decimMode = GMT_DECIM_NONE;
+    if (cfgGetInt (&cfg, GMT_CFG_CICORDER, &k) && (k > 0))
+        pecfg->cicOrder = k;
+    if (cfgGetInt (&cfg, GMT_CFG_CICFACTOR, &k) && (k > 1))
+        pecfg->cicFactor = k;
+
+    /* data-ready source; a gpio line is given as "<chip> <line>" */
+    if (cfgIsStr (&cfg, GMT_CFG_DRDY, GMT_DR_STATUS))
+        pecfg->drdyMode = GMT_DRDY_STATUS;
+    else if (cfgIsStr (&cfg, GMT_CFG_DRDY, GMT_DR_GPIO))
+        pecfg->drdyMode = GMT_DRDY_GPIO;
+    else if (cfgIsStr (&cfg, GMT_CFG_DRDY, GMT_DR_NONE))
+        pecfg->drdyMode = GMT_DRDY_NONE;
+    if ((pv = cfgGetStr (&cfg, GMT_CFG_DRDYGPIO)) &&
+        (sscanf (pv, "%63s %d", pecfg->drdyChip, &pecfg->drdyLine) != 2))
+        pecfg->drdyChip[0] = '\0';
+
+    /* sensor OD rate, in Hz; the highest supported table rate
+     * not above the given value is used */
+    {
+        double  hz;
+
+        if (cfgGetDbl (&cfg, GMT_CFG_RATE, &hz))
         {
-            strncpy (datapath, px, FILENAME_MAXSIZE);
-            datapath[FILENAME_MAXSIZE-1] = '\0';
-            printf ("\noutput file path  = <%s>", datapath);
+            for (rate=0; rate<7; rate++)
+                if (OD_rate_rtable[rate+1] > hz)
+                    break;
+            pecfg->sampleRate = rate;
         }
     }
 
-    /* data output mode; axes separately, or vector sum;
-     * vector sum option not yet implemented */
-    if ((k = getstrcfgitem  (pcf, GMT_CFG_MODE, px)))
+    /* record period, in s; must fit into the minute, or the hour */
+    if (cfgGetInt (&cfg, GMT_CFG_PERIOD, &k))
     {
-        pecfg->outputMode = GMT_AXIS_ALL;
-        if (strstr (px, GMT_MD_SUM))
-            pecfg->outputMode = GMT_AXIS_SUM;
+        if ((k > 0) && (((k < 60) && (60 % k == 0)) ||
+                        ((k % 60 == 0) && (3600 % k == 0))))
+            pecfg->samplePeriod = k;
+        else
+            printf ("\nsample period %ds not supported, using %ds", k, pecfg->samplePeriod);
     }
 
     /* integer items */
-    bus = rate = -1;
-    if ((i = getintcfgitem  (pcf, GMT_CFG_BUS, &bus)))
-        pecfg->i2cBus = bus;
+    if (cfgGetInt (&cfg, GMT_CFG_BUS, &k) && (k >= 0))
+        pecfg->i2cBus = k;
+    if (cfgGetInt (&cfg, GMT_CFG_BATCH, &k) && (k > 0))
+        pecfg->writeBatch = k;
+    if (cfgGetInt (&cfg, GMT_CFG_SYNCVALUE, &k) && (k > 0))
+        pecfg->syncValue = k;
+    if (cfgGetInt (&cfg, GMT_CFG_BACKLOG, &k) && (k > 0))
+        pecfg->backlog = k;
+    if (cfgGetInt (&cfg, GMT_CFG_PAYLOAD, &k) && (k > 0))
+        pecfg->payload = k;
+    if (cfgGetInt (&cfg, GMT_CFG_HISTORY, &k) && (k > 0))
+        pecfg->historyDays = k;
+    if (cfgGetInt (&cfg, GMT_CFG_STATION, &k) && (k > 0))
+        pecfg->stationId = k;
+    if (cfgGetInt (&cfg, GMT_CFG_QRYPORT, &k) && (k > 0))
+        pecfg->queryPort = k;
+    if (cfgGetInt (&cfg, GMT_CFG_METPORT, &k) && (k > 0))
+        pecfg->metricsPort = k;
+    if (cfgGetInt (&cfg, GMT_CFG_METINTERVAL, &k) && (k > 0))
+        pecfg->metricsInterval = k;
+    if (cfgGetInt (&cfg, GMT_CFG_STORMBASE, &k) && (k > 0))
+        pecfg->stormBaseline = k;
+    if (cfgGetInt (&cfg, GMT_CFG_STORMHYST, &k) && (k > 0) && (k <= 100))
+        pecfg->stormHyst = k;
+    if (cfgGetInt (&cfg, GMT_CFG_SPECSIZE, &k) && (k >= 0))
+        pecfg->specSize = k;
+    if (cfgGetInt (&cfg, GMT_CFG_SPECINTERVAL, &k) && (k > 0))
+        pecfg->specInterval = k;
+    if (cfgGetInt (&cfg, GMT_CFG_CAPSIZE, &k) && (k > 0))
+        pecfg->capSize = k;
+    if (cfgGetInt (&cfg, GMT_CFG_CAPROTATE, &k) && (k >= 0))
+        pecfg->capRotate = k;
+
+    /* sensor list, one SENSOR line each; without a list,
+     * DEVICE and I2C_BUS give the only sensor */
+    pecfg->sensor[0].device = pecfg->device;
+    pecfg->sensor[0].bus    = pecfg->i2cBus;
+    pecfg->sensor[0].addr   = 0;
+    pecfg->sensor[0].name[0] = '\0';
+    if (cfgGetStrN (&cfg, GMT_CFG_SENSOR, 0))
+        pecfg->nSensors = 0;
+    for (k=0; (pv = cfgGetStrN (&cfg, GMT_CFG_SENSOR, k)); k++)
+    {
+        if (pecfg->nSensors >= GMT_MAX_SENSORS)
+        {
+            printf ("\nmore than %d sensors, <%s> ignored", GMT_MAX_SENSORS, pv);
+            continue;
+        }
+        if (parseSensor (pv, &pecfg->sensor[pecfg->nSensors]) != 0)
+        {
+            printf ("\ninvalid sensor <%s> ignored", pv);
+            continue;
+        }
+        pecfg->nSensors++;
+    }
+    if (pecfg->nSensors == 0)
+        pecfg->nSensors = 1;
+
+    /* all sensors share the sample tick; the slowest
+     * device (e.g. HMC5883, no 220Hz) limits all others */
+    for (k=0; k<pecfg->nSensors; k++)
+        if (pecfg->sampleRate > drvGet (pecfg->sensor[k].device)->maxRate)
+            pecfg->sampleRate = drvGet (pecfg->sensor[k].device)->maxRate;
 
     return 0;
 }
 
 
 
-/* sensor-specific device configuration setup;
- * the sample rate value is a table index
+/* parse one sensor list entry, "<device> <bus> [<address>] [<name>]";
+ * the address is given as number (e.g. 0x1e), the name (used to tag
+ * the day files) must not start with a digit;
+ * returns 0 if valid, or 1 if not
  */
-static void  setSensorConfig (elfSenseConfig *pecfg, deviceConfig *dcfg)
+static int  parseSensor (const char *pv, sensorConfig *ps)
 {
-    if (pecfg->device == GMT_DEVICE_LSM303)
-    {
-        dcfg->dev_addr   = DEVICE_ADDRESS_LSM303;
-        dcfg->adr_cra    = (unsigned char) (pecfg->sampleRate << 2);  /* bits 4..2 */
-        dcfg->adr_crb    = 0x01;
-        dcfg->adr_mr     = 0x02;
-        dcfg->regm_cra   = 0x1C;
-        dcfg->regm_crb   = 0x20;
-        dcfg->regm_mr    = 0x00;
-        pecfg->fullScale = FS_VALUE_LSM303;
-    }
-    else
+    const gmtDriver  *pdrv;
+    char              buf[CFG_STR_MAX];
+    char             *ptok, *psave, *pe;
+
+    memset (ps, 0, sizeof (sensorConfig));
+    strncpy (buf, pv, CFG_STR_MAX);
+    buf[CFG_STR_MAX-1] = '\0';
+
+    if (!(ptok = strtok_r (buf, " \t,", &psave)))
+        return 1;
+    if (!(pdrv = drvFind (ptok)))
+        return 1;
+    ps->device = pdrv->device;
+
+    if (!(ptok = strtok_r (NULL, " \t,", &psave)))
+        return 1;
+    ps->bus = (int) strtol (ptok, &pe, 10);
+    if ((*pe != '\0') || (ps->bus < 0))
+        return 1;
+
+    while ((ptok = strtok_r (NULL, " \t,", &psave)))
     {
-        dcfg->dev_addr   = DEVICE_ADDRESS_HMC5883;
-        dcfg->adr_cra    = (unsigned char) (pecfg->sampleRate << 2);
-        dcfg->adr_crb    = 0x01;
-        dcfg->adr_mr     = 0x02;
-        dcfg->regm_cra   = 0x10;
-        dcfg->regm_crb   = 0x00;
-        dcfg->regm_mr    = 0x00;
-        pecfg->fullScale = FS_VALUE_HMC5883;
+        if (isdigit ((unsigned char) *ptok))
+        {
+            ps->addr = (int) strtol (ptok, &pe, 0);
+            if ((*pe != '\0') || (ps->addr <= 0) || (ps->addr > 0x7f))
+                return 1;
+        }
+        else
+        {
+            strncpy (ps->name, ptok, GMT_NAME_SIZE);
+            ps->name[GMT_NAME_SIZE-1] = '\0';
+        }
     }
+    return 0;
 }
 
 
 
-/* configure and start the sensor,
- * setting up the i2c config registers CRA, RCB and MR
- * return 0 if everything went fine,
- * or an error number > 0
+/* SIGHUP; read the configuration again, into the pending copy;
+ * called by the main loop, when the signal arrived
  */
-static int  setupSensor (deviceConfig *dcfg, int ifh)
+static void  reloadConfig (void)
 {
-    if (i2c_write (dcfg->dev_addr, dcfg->adr_cra, dcfg->regm_cra, ifh) < 0)
-        return 1;
+    elfSenseConfig  ncfg;
+
+    initDefaultCfg (&ncfg);
+    if (getConfig (&ncfg) != 0)
+        return;
+    printf ("\nconfiguration reloaded\n");
+    fflush (stdout);
+
+    pthread_mutex_lock (&cfgLock);
+    newCfg = ncfg;
+    atomic_store (&cfgPending, 1);
+    pthread_mutex_unlock (&cfgLock);
+}
 
-    if (i2c_write (dcfg->dev_addr, dcfg->adr_crb, dcfg->regm_crb, ifh) < 0)
-        return 2;
 
-    if (i2c_write (dcfg->dev_addr, dcfg->adr_mr, dcfg->regm_mr, ifh) < 0)
-        return 3;
 
-    return 0;
+/* apply a reloaded configuration, if there is one;
+ * called between two samples by the main loop, which does the output
+ * (the consumer, or the sample tick), so no other thread uses the writer
+ * and publisher meanwhile; only items that need no sensor access
+ * are taken over, the sensor keeps sampling
+ */
+static void  applyConfig (elfSenseConfig *pcur)
+{
+    elfSenseConfig  ncfg;
+    storeRecord     sr;
+    int             k;
+
+    if (!atomic_load (&cfgPending))
+        return;
+    pthread_mutex_lock (&cfgLock);
+    ncfg = newCfg;
+    atomic_store (&cfgPending, 0);
+    pthread_mutex_unlock (&cfgLock);
+
+    /* output format and storage; the records take them to storage,
+     * where a new header marks the change */
+    if ((ncfg.outputMode != pcur->outputMode) || (ncfg.storage != pcur->storage))
+    {
+        pcur->outputMode = ncfg.outputMode;
+        pcur->storage    = ncfg.storage;
+        for (k=0; k<nSensors; k++)
+        {
+            cbData[k].mode    = ncfg.outputMode;
+            cbData[k].storage = ncfg.storage;
+        }
+    }
+
+    /* data directory and write policy; queued, the records before
+     * the change still go by the old ones */
+    memset (&sr, 0, sizeof (sr));
+    sr.kind = STORE_CONFIG;
+    if (strcmp (ncfg.dataPath, pcur->dataPath) != 0)
+    {
+        strcpy (pcur->dataPath, ncfg.dataPath);
+        strcpy (datapath, ncfg.dataPath);
+        qrySetPath (dQuery, datapath);
+        sr.path = datapath;
+    }
+    pcur->writeBatch = sr.batch    = ncfg.writeBatch;
+    pcur->syncMode   = sr.syncMode = ncfg.syncMode;
+    pcur->syncValue  = sr.syncValue = ncfg.syncValue;
+    storePut (dStore, &sr);
+
+    pcur->backlog  = ncfg.backlog;
+    pcur->payload  = ncfg.payload;
+    pcur->overflow = ncfg.overflow;
+    storeSetLimit (dStore, pcur->backlog, pcur->payload, pcur->overflow);
+
+    /* live data targets; the sequence numbers restart */
+    if ((strcmp (ncfg.targets, pcur->targets) != 0) || (ncfg.stationId != pcur->stationId))
+    {
+        strcpy (pcur->targets, ncfg.targets);
+        pcur->stationId = ncfg.stationId;
+        udpDestroy (dPub);
+        dPub = NULL;
+        if (pcur->targets[0] && !(dPub = udpCreate (pcur->targets, pcur->stationId)))
+            printf ("no valid publish target in <%s> !\n", pcur->targets);
+        udpDestroy (dAlert);
+        dAlert = NULL;
+    }
+    if (strcmp (ncfg.alerts, pcur->alerts) != 0)
+    {
+        strcpy (pcur->alerts, ncfg.alerts);
+        udpDestroy (dAlert);
+        dAlert = NULL;
+    }
+    if (pcur->alerts[0] && !dAlert && !(dAlert = udpCreate (pcur->alerts, pcur->stationId)))
+        printf ("no valid alert target in <%s> !\n", pcur->alerts);
+
+    /* storm thresholds; the baseline length needs a restart */
+    pcur->stormDbdt = ncfg.stormDbdt;
+    pcur->stormDev  = ncfg.stormDev;
+    pcur->stormHyst = ncfg.stormHyst;
+    if (stormStart (pcur) != 0)
+        printf ("no memory for the storm detector !\n");
+
+    if ((ncfg.device != pcur->device) || (ncfg.i2cBus != pcur->i2cBus) ||
+        (ncfg.sampleRate != pcur->sampleRate) || (ncfg.acqMode != pcur->acqMode) ||
+        (ncfg.samplePeriod != pcur->samplePeriod) || (ncfg.dataType != pcur->dataType) ||
+        (ncfg.decimMode != pcur->decimMode) || (ncfg.cicOrder != pcur->cicOrder) ||
+        (ncfg.cicFactor != pcur->cicFactor) ||
+        (ncfg.historyDays != pcur->historyDays) || (ncfg.queryPort != pcur->queryPort) ||
+        (ncfg.nSensors != pcur->nSensors) || (ncfg.drdyMode != pcur->drdyMode) ||
+        strcmp (ncfg.metricsFile, pcur->metricsFile) || (ncfg.metricsPort != pcur->metricsPort) ||
+        (ncfg.metricsInterval != pcur->metricsInterval) || (ncfg.stormBaseline != pcur->stormBaseline) ||
+        (ncfg.specSize != pcur->specSize) || (ncfg.specInterval != pcur->specInterval) ||
+        (ncfg.specFmax != pcur->specFmax) || strcmp (ncfg.specPath, pcur->specPath) ||
+        strcmp (ncfg.capPath, pcur->capPath) || (ncfg.capSize != pcur->capSize) ||
+        (ncfg.capRotate != pcur->capRotate) ||
+        memcmp (ncfg.sensor, pcur->sensor, ncfg.nSensors * sizeof (sensorConfig)))
+        printf ("sensor, acquisition, period, data type, history, query, metrics, storm baseline, "
+                "spectra and capture settings need a restart !\n");
+    fflush (stdout);
 }
 
 
 
-// Write to an I2C slave device's register
-static int  i2c_write (uchar slave_addr, uchar reg, uchar data, int ifh)
+/* set up sensor <k> of the list; the bus is opened once, for
+ * the first sensor on it, and the device is probed, configured and
+ * started by its driver; simulation builds use simulated sensors;
+ * the first sensor writes the plain day files, the others tag
+ * their files with the sensor name, or bus and address;
+ * returns 0 if ok, or an error number
+ */
+static int  openSensor (elfSenseConfig *pecfg, int k)
 {
-    uchar                       outbuf[2];
-    struct i2c_msg              msgs[1];
-    struct i2c_rdwr_ioctl_data  msgset[1];
+    sensorConfig     *ps = &pecfg->sensor[k];
+    sampler_cfg      *pd = &cbData[k];
+    const gmtDriver  *pdrv;
+    busWorker        *pb;
+    char              devName[64];
+    int               i;
 
-    outbuf[0] = reg;
-    outbuf[1] = data;
+#ifdef __SIMULATION__
+    pdrv = drvGet (GMT_DEVICE_SIM);
+#else
+    pdrv = drvGet (ps->device);
+#endif
 
-    msgs[0].addr  = slave_addr;
-    msgs[0].flags = 0;
-    msgs[0].len   = 2;
-    msgs[0].buf   = outbuf;
+    for (i=0; i<nBuses; i++)
+        if (dBus[i].bus == ps->bus)
+            break;
+    pb = &dBus[i];
+    if (i == nBuses)
+    {
+        pb->bus   = ps->bus;
+        pb->ifh   = -1;
+        pb->nsens = 0;
+        nBuses++;
+    }
 
-    msgset[0].msgs  = msgs;
-    msgset[0].nmsgs = 1;
+    if (pdrv->onBus && (pb->ifh < 0))
+    {
+        /* make device name, and open */
+        sprintf (devName, "%s%d", I2C_NAME_BASE, ps->bus);
+        if ((pb->ifh = open (devName, O_RDWR)) < 0)
+        {
+            perror (devName);
+            return 10;
+        }
+
+        /* some general i2c settings... */
+        ioctl (pb->ifh, I2C_TENBIT, 0);    // 10-bit addressing off
+        ioctl (pb->ifh, I2C_RETRIES, 5);
+    }
+
+    for (i=0; i<pb->nsens; i++)
+    {
+        if (pdrv->onBus && (pb->sens[i]->dev.addr == (ps->addr ? ps->addr : pdrv->addr)))
+        {
+            printf ("sensor %d: address 0x%02x on bus %d is already used !\n", k,
+                    pb->sens[i]->dev.addr, ps->bus);
+            return 11;
+        }
+    }
+
+    /* configure and start the sensor */
+    if ((i = devOpen (&pd->dev, pdrv, pb->ifh, ps->addr, pecfg->sampleRate)) != 0)
+    {
+        printf ("sensor %d: %s on bus %d, error %d !\n", k, pdrv->name, ps->bus, i);
+        fflush (stdout);
+        return 20;
+    }
+
+    pd->index     = k;
+    pd->fullScale = pdrv->fullScale;
+    pd->scaleVal  = pd->dev.scale;
+    pd->odRate    = pd->dev.odRate;
 
-    if (ioctl (ifh, I2C_RDWR, &msgset) < 0)
+    /* data-ready; the gpio line is wired to the first sensor,
+     * all others poll their status register */
+    pd->drdy = pecfg->drdyMode;
+    if ((pd->drdy == GMT_DRDY_GPIO) && ((k > 0) || !pdrv->onBus || !pecfg->drdyChip[0] ||
+        ((pd->gfd = gpioOpen (pecfg->drdyChip, pecfg->drdyLine)) < 0)))
     {
-        perror("i2c_write");
-        return -1;
+        if (k == 0)
+            printf ("no DRDY gpio line, polling the status register !\n");
+        pd->drdy = GMT_DRDY_STATUS;
     }
 
+    pd->tag[0] = '\0';
+    if ((k > 0) && ps->name[0])
+        strcpy (pd->tag, ps->name);
+    else if (k > 0)
+        snprintf (pd->tag, GMT_NAME_SIZE, "b%d_%02x", ps->bus, pd->dev.addr);
+    pb->sens[pb->nsens++] = pd;
     return 0;
 }
 
 
 
-/* read the magnetometer data
- * returns 0 if read was ok,
- * or != 0 (1) on error
+/* wait until the sensor has a new conversion, from its data-ready
+ * source; without one, just one conversion period is waited;
+ * status polling and the gpio line give up after two periods;
+ * returns 0 if a new value is ready, or 1 on timeout / error
  */
-static int  i2c_readMagn (magnBuffer *mBuf, uchar slave_addr, int ifh)
+static int  waitSample (sampler_cfg *gmdata)
 {
-    short                       hh, hl;
-    uchar                       regadr;
-    uchar                       inbuf[6] = {0};  // clear
-    struct i2c_msg              msgs[2];
-    struct i2c_rdwr_ioctl_data  msgset[1];
+    struct timespec  ts, now, end;
+    long             period;
+    int              r;
 
-    regadr = 0x03;  // register address of OUT_X_H_M
-    msgs[0].addr  = slave_addr;
-    msgs[0].flags = 0;
-    msgs[0].len   = 1;
-    msgs[0].buf   = &regadr;
+    period = (long) (1.0e9 / gmdata->odRate);
 
-    msgs[1].addr  = slave_addr;
-    msgs[1].flags = I2C_M_RD | I2C_M_NOSTART;
-    msgs[1].len   = 6;
-    msgs[1].buf   = inbuf;
+    if (gmdata->drdy == GMT_DRDY_GPIO)
+        return ((gpioWait (gmdata->gfd, (int) (2 * period / 1000000L) + 10) > 0) ? 0 : 1);
 
-    msgset[0].msgs  = msgs;
-    msgset[0].nmsgs = 2;
+    if (gmdata->drdy == GMT_DRDY_NONE)
+    {
+        ts.tv_sec  = period / 1000000000L;
+        ts.tv_nsec = period % 1000000000L;
+        nanosleep (&ts, NULL);
+        return 0;
+    }
 
-    if (ioctl (ifh, I2C_RDWR, &msgset) < 0)
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    end.tv_nsec += 2 * period;
+    while (end.tv_nsec >= 1000000000L)
     {
-        perror ("i2c_readMagn");
-        return 1;
+        end.tv_nsec -= 1000000000L;
+        end.tv_sec++;
     }
+    ts.tv_sec  = 0;
+    ts.tv_nsec = period / GMT_DRDY_POLL_DIV;
 
-    hh = inbuf[0];
-    hl = inbuf[1];
-    mBuf->mgnX = (short) ((hh << 8) + hl);
-    hh = inbuf[2];
-    hl = inbuf[3];
-    mBuf->mgnY = (short) ((hh << 8) + hl);
-    hh = inbuf[4];
-    hl = inbuf[5];
-    mBuf->mgnZ = (short) ((hh << 8) + hl);
-    return 0;
+    while (!gmtExit)
+    {
+        if ((r = devReady (&gmdata->dev)) > 0)
+            return 0;
+        if (r < 0)
+            break;
+
+        clock_gettime (CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec > end.tv_sec) || ((now.tv_sec == end.tv_sec) && (now.tv_nsec >= end.tv_nsec)))
+            break;
+        nanosleep (&ts, NULL);
+    }
+    return 1;
 }
 
 
@@ -448,72 +1190,70 @@ static int  i2c_readMagn (magnBuffer *mBuf, uchar slave_addr, int ifh)
  */
 static int  gmSample  (sampler_cfg *gmdata)
 {
-    double      x, y, z, div;
-    int         i, r, valid[GMT_AVG_COUNT];
-    databuffer  buffer;
-    magnBuffer  vBuf;
-
-    memset (valid, 0, GMT_AVG_COUNT * sizeof (int));
+    double      mean[GMT_AXES];
+    int         i, r;
+    magnBuffer  raw[GMT_AVG_COUNT];
 
-#ifndef __SIMULATION__
-    for (i=0; i<GMT_AVG_COUNT; i++)
+    for (i=r=0; i<GMT_AVG_COUNT; i++)
     {
-        if (i2c_readMagn (&vBuf, gmdata->addr, gmdata->ifh) == 0)
+        /* each value from a new conversion; without a data-ready
+         * source, the first one is read right away */
+        if (((i > 0) || (gmdata->drdy != GMT_DRDY_NONE)) && (waitSample (gmdata) != 0))
         {
-            buffer.x[i] = vBuf.mgnX * gmdata->scaleVal;
-            buffer.y[i] = vBuf.mgnY * gmdata->scaleVal;
-            buffer.z[i] = vBuf.mgnZ * gmdata->scaleVal;
-            valid[i]    = 1;
+            metAdd (&gmdata->met->i2cErrors, 1);
+            continue;
         }
-        if (i<(GMT_AVG_COUNT-1))  // wait a bit between samples
-            usleep (250000);
-    }
-
-#else  /* simulation; no need for averaging */
-
-    for (i=0; i<GMT_AVG_COUNT; i++)
-    {
-        gmdata->dx = (2.0 * drand48() - 1.0) * gmdata->scaleVal;
-        gmdata->dy = (2.0 * drand48() - 1.0) * gmdata->scaleVal;
-        gmdata->dz = (2.0 * drand48() - 1.0) * gmdata->scaleVal;
-    }
-    return 3;
-
-#endif
-
-    /* average valid data */
-    x = y = z = div = 0.0;
-    r = 0;
-    for (i=0; i<GMT_AVG_COUNT; i++)
-    {
-        if (valid[i])
-        {
+        if (devRead (&gmdata->dev, &raw[r]) == 0)
             r++;
-            div += 1.0;
-            x += buffer.x[i];
-            y += buffer.y[i];
-            z += buffer.z[i];
-        }
     }
 
-    if (div > 0.0)
+    /* integer records; exact sums of the raw counts, not scaled */
+    if (gmdata->dtype == ELFD_DTYPE_INT)
     {
-        x /= div;
-        y /= div;
-        z /= div;
+        rawAccum  acc;
+
+        acc.n = 0;
+        accAddN (&acc, raw, r);
+        if (r > 0)
+            accResultInt (&acc, gmdata->ival, gmdata->imin, gmdata->imax);
+        intToPhys (gmdata);
+        gmdata->nsmpl  = r;
+        gmdata->tstamp = time (NULL);
+        countSample (gmdata, r);
+        return (r);
     }
 
+    /* scale all valid values at once, and average them */
+    accMean (gmdata->dev.drv, raw, r, gmdata->scaleVal, mean, gmdata->dmin, gmdata->dmax);
+
     /* copy data */
-    gmdata->dx = x;
-    gmdata->dy = y;
-    gmdata->dz = z;
-    gmdata->vcount++;
+    gmdata->dx     = mean[DI_X];
+    gmdata->dy     = mean[DI_Y];
+    gmdata->dz     = mean[DI_Z];
+    gmdata->nsmpl  = r;
+    gmdata->tstamp = time (NULL);
+    countSample (gmdata, r);
 
     return (r);
 }
 
 
 
+/* count <n> values read from a sensor, and stamp the last one
+ */
+static void  countSample (sampler_cfg *gmdata, int n)
+{
+    struct timespec  ts;
+
+    if (n <= 0)
+        return;
+    clock_gettime (CLOCK_REALTIME, &ts);
+    metAdd (&gmdata->met->samples, n);
+    metSet (&gmdata->met->lastSample, ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
+
+
+
 /* update the runtime counter;
  * called every minute, and counts up on this base
  */
@@ -534,140 +1274,656 @@ static void  updateRLog (void)
 
 
 
-/* handler for the exit / break signals
+/* continuous acquisition;
+ * starts one sampler thread per bus, and runs the main loop, with the
+ * consumer on a timer, until a termination signal arrives; the threads
+ * are started with all signals blocked;
+ * returns 0 on a regular exit, or an error number
  */
-static void  exithandler (int signumber)
+static int  runContinuous (elfSenseConfig *pecfg)
 {
-    if (iDev)
-        close (iDev);
-    iDev = 0;
+    gmtSched         ctick;
+    struct timespec  cbase;
+    sigset_t         sset, oset;
+    double           rate;
+    int              i, k, rv;
+
+    rate = OD_rate_rtable[pecfg->sampleRate];
+    for (k=0; k<nSensors; k++)
+    {
+        if (!(cbData[k].ring = ringCreate (GMT_RING_SIZE, sizeof (gmtRecord))))
+        {
+            printf ("no memory for the sample ring !\n");
+            return 30;
+        }
+        cbData[k].odRate  = rate;
+        cbData[k].curslot = -1;
+
+        if ((pecfg->decimMode != GMT_DECIM_NONE) &&
+            !(cbData[k].decim = decimCreate (pecfg->decimMode, pecfg->cicOrder, pecfg->cicFactor)))
+        {
+            printf ("decimation CIC N=%d R=%d not supported !\n", pecfg->cicOrder, pecfg->cicFactor);
+            return 33;
+        }
+    }
+
+    /* spectra of the first sensor, at the nominal rate */
+    if ((pecfg->specSize > 0) &&
+        !(dSpec = specCreate (pecfg->specSize, rate, cbData[0].scaleVal, pecfg->specInterval,
+                              pecfg->specFmax, pecfg->specPath, cbData[0].tag)))
+    {
+        printf ("spectra of %d samples not supported !\n", pecfg->specSize);
+        return 34;
+    }
+
+    /* raw capture, every sensor to its own files */
+    for (k=0; (k<nSensors) && pecfg->capPath[0]; k++)
+    {
+        if (!(cbData[k].cap = capCreate (pecfg->capPath, cbData[k].tag, k, cbData[k].dev.drv->device,
+                                         pecfg->sensor[k].bus, cbData[k].dev.addr, rate,
+                                         cbData[k].fullScale, cbData[k].scaleVal, pecfg->capSize,
+                                         pecfg->capRotate)))
+        {
+            printf ("no memory for the raw capture !\n");
+            return 35;
+        }
+    }
+
+    /* all buses sample on the same monotonic clock ticks */
+    tickPeriod = (long) (1.0e9 / rate);
+    clock_gettime (CLOCK_MONOTONIC, &tickStart);
+
+    sigfillset (&sset);
+    pthread_sigmask (SIG_BLOCK, &sset, &oset);
+
+    rv = 0;
+    for (i=0; i<nBuses; i++)
+    {
+        if (pthread_create (&dBus[i].thread, NULL, samplerThread, &dBus[i]) != 0)
+        {
+            perror ("sampler thread");
+            gmtExit = 1;
+            rv = 31;
+            break;
+        }
+    }
+    pthread_sigmask (SIG_SETMASK, &oset, NULL);
+
+    /* the consumer drains the rings just after each second, once the
+     * samples of the second are in; nothing is polled */
+    cbase.tv_sec  = 0;
+    cbase.tv_nsec = 2 * tickPeriod + GMT_CONSUMER_DELAY_MS * 1000000L;
+    if (cbase.tv_nsec > 500000000L)
+        cbase.tv_nsec = 500000000L;
+    schedInit (&ctick, CLOCK_REALTIME, 1000000000LL, &cbase);
+    if ((rv == 0) &&
+        ((schedTimer (&ctick) < 0) || (loopAdd (dLoop, ctick.tfd, EPOLLIN, consumeTick, &ctick) != 0)))
+    {
+        perror ("consumer timer");
+        gmtExit = 1;
+        rv = 32;
+    }
+    if (rv != 0)
+    {
+        while (--i >= 0)
+            pthread_join (dBus[i].thread, NULL);
+        schedClose (&ctick);
+        return rv;
+    }
+
+    printf ("continuous sampling at %.2lfHz, %d sensor(s) on %d bus(es)\n", rate, nSensors, nBuses);
+    if (pecfg->decimMode == GMT_DECIM_CIC)
+        printf ("decimation: CIC N=%d R=%d, boxcar per %ds\n", pecfg->cicOrder, pecfg->cicFactor, recPeriod);
+    else if (pecfg->decimMode == GMT_DECIM_BOXCAR)
+        printf ("decimation: boxcar per %ds\n", recPeriod);
+    if (dSpec)
+        printf ("spectra: %d samples, %.4lfHz bins, averaged per %ds, to <%s>\n", pecfg->specSize,
+                rate / pecfg->specSize, pecfg->specInterval, pecfg->specPath);
+    if (pecfg->capPath[0])
+        printf ("raw capture: to <%s>, %dMB files, a new one every %ds\n", pecfg->capPath,
+                pecfg->capSize, pecfg->capRotate);
+    fflush (stdout);
+
+    /* until SIGTERM; a SIGHUP reloads the configuration, the
+     * consumer applies it */
+    loopRun (dLoop);
+    gmtExit = 1;
+
+    /* samplers stopped; the rest of the rings, and the incomplete
+     * last records */
+    for (i=0; i<nBuses; i++)
+        pthread_join (dBus[i].thread, NULL);
+    loopDel (dLoop, ctick.tfd);
+    schedClose (&ctick);
+    while (drainRings () != 0)
+        storeWait (dStore, GMT_STORE_WAIT);
+    drainEnd ();
+
+    for (i=0; i<nBuses; i++)
+    {
+        char  name[32];
+
+        snprintf (name, sizeof (name), "bus %d tick", dBus[i].bus);
+        schedReport (&dBus[i].sched, name);
+    }
+    schedReport (&ctick, "consumer tick");
 
+    for (k=0; k<nSensors; k++)
+    {
+        printf ("\nsensor %d: %llu samples, %llu read errors, %lu ring overruns", k,
+                cbData[k].met->samples, cbData[k].met->i2cErrors, ringOverruns (cbData[k].ring));
+        ringDestroy (cbData[k].ring);
+        cbData[k].ring = NULL;
+        decimDestroy (cbData[k].decim);
+        cbData[k].decim = NULL;
+    }
+    printf ("\n");
+    return 0;
 }
 
 
-/* save current data to file;
- * return 0 if writing was ok
- * an error number otherwise
+
+/* sampler thread, one per bus;
+ * reads all sensors of the bus on absolute monotonic clock ticks,
+ * common to all buses, and pushes the raw values into the sensor
+ * rings; with a data-ready source, the sensors set the pace instead,
+ * and each conversion is read once; never waits for the consumer,
+ * if a ring is full the sample is dropped (and counted by the ring)
  */
-static int  writeData (sampler_cfg *gmdata)
+static void  *samplerThread (void *arg)
 {
-    FILE        *hFile;
-    char         fbuf[256];
-    long         pos;
-    time_t       t;
-    struct tm   *ptime;
-    struct stat  st = { 0 };
-    static int   mday    = 0;  /* last recent day, 'invalid' start value */
+    busWorker       *pb = (busWorker *) arg;
+    sampler_cfg     *gmdata;
+    gmtRecord        rec;
+    int              i;
 
-    /* use the current time */
-    t     = time (NULL);
-    ptime = localtime (&t);
+    while (!gmtExit && (pb->sens[0]->drdy != GMT_DRDY_NONE))
+    {
+        for (i=0; i<pb->nsens; i++)
+        {
+            gmdata = pb->sens[i];
+            if ((waitSample (gmdata) != 0) || (devRead (&gmdata->dev, &rec.mb) != 0))
+            {
+                if (!gmtExit)
+                    metAdd (&gmdata->met->i2cErrors, 1);
+                continue;
+            }
+            clock_gettime (CLOCK_REALTIME, &rec.ts);
+            rec.mono = metClock ();
+            countSample (gmdata, 1);
+            ringPush (gmdata->ring, &rec);
+        }
+    }
 
-    /* create data files in a sub-directory; might need to create the directory first...
-     * have to set "executable" rights, or else creating files fails */
-    if (stat (GMT_DATA_PATH, &st) == -1)
+    schedInit (&pb->sched, CLOCK_MONOTONIC, tickPeriod, &tickStart);
+    pb->sched.jitter = &dMetrics.jitter;
+    while (!gmtExit)
     {
-        if (mkdir (GMT_DATA_PATH, S_IRUSR | S_IWUSR | S_IXUSR | S_IRGRP | S_IWGRP | S_IXGRP) != 0)
-            perror ("creating data directory");
+        if (schedWait (&pb->sched, NULL) != 0)
+            continue;
+        clock_gettime (CLOCK_REALTIME, &rec.ts);
+        rec.mono = metClock ();
+
+        for (i=0; i<pb->nsens; i++)
+        {
+            gmdata = pb->sens[i];
+            if (devRead (&gmdata->dev, &rec.mb) != 0)
+            {
+                metAdd (&gmdata->met->i2cErrors, 1);
+                continue;
+            }
+            countSample (gmdata, 1);
+            ringPush (gmdata->ring, &rec);
+        }
     }
+    return NULL;
+}
+
+
 
-    /* for the moment, just create a file in the local sub-folder;
-     * using the current date as name automatically creates a new file each day;
-     * and for one write access per minute, open/close it each time is fine */
-    sprintf (fbuf, "%s/%4d_%02d_%02d.dat", GMT_DATA_PATH, ptime->tm_year + 2000, ptime->tm_mon+1, ptime->tm_mday);
-    if (!(hFile = fopen (fbuf, "a+")))
+/* consumer tick, once a second; takes over a reloaded configuration,
+ * and drains the rings; not while a blocking storage queue is full,
+ * the rings fill then, and the signals are still served
+ * returns 0, the loop goes on
+ */
+static int  consumeTick (void *arg, int fd, unsigned int events)
+{
+    if (schedExpired ((gmtSched *) arg, NULL) != 0)
+        return 0;
+    applyConfig (activeCfg);
+    if (storeWait (dStore, GMT_STORE_WAIT) != 0)
+        return 0;
+    drainRings ();
+    return 0;
+}
+
+
+
+/* the consumer; drains the rings of all sensors, averages the raw
+ * values of each (wall clock) sample period, and hands the results to
+ * storage; the samplers never wait for it, a slow medium only fills
+ * the storage queue; live second data are sent for the first sensor;
+ * with the BLOCK policy, a full queue stops it, the rest of the samples
+ * stay in the rings until the next call
+ * returns 0 if the rings are drained, or 1 if the queue was full
+ */
+static int  drainRings (void)
+{
+    sampler_cfg      *gmdata;
+    gmtRecord         rec;
+    gspRecord        *psr;
+    rawBlock         *prb;
+    struct timespec   tsec;
+    double            mean[GMT_AXES], mn[GMT_AXES], mx[GMT_AXES];
+    int               imean[GMT_AXES], imn[GMT_AXES], imx[GMT_AXES];
+    int               k, complete;
+
+    tsec.tv_nsec = 0;
+    for (k=0; k<nSensors; k++)
     {
-        perror ("accessing data file");
-        return 1;
+        gmdata = &cbData[k];
+        metSet (&gmdata->met->queue, ringCount (gmdata->ring));
+        metSet (&gmdata->met->overruns, ringOverruns (gmdata->ring));
+        while (ringPeek (gmdata->ring, &rec))
+        {
+            /* period complete; with the sample left in the ring, if
+             * storage has no space for the record */
+            complete = (rec.ts.tv_sec / recPeriod != gmdata->curslot) && (gmdata->arec.n > 0);
+            if (complete && (storeWait (dStore, 0) != 0))
+                return 1;
+            ringPop (gmdata->ring, &rec);
+
+            /* second complete; live data only */
+            if ((k == 0) && (rec.ts.tv_sec != secTime) && (secAcc.n > 0))
+            {
+                tsec.tv_sec = secTime;
+                if (gmdata->dtype == ELFD_DTYPE_INT)
+                {
+                    accResultInt (&secAcc, imean, imn, imx);
+                    udpQueueInt (dPub, GMT_PCK_SECOND, &tsec, 1, secAcc.n, imean, imn, imx, gmdata->unit);
+                }
+                else
+                {
+                    accResult (&secAcc, gmdata->scaleVal, mean, mn, mx);
+                    udpQueue (dPub, GMT_PCK_SECOND, &tsec, 1, secAcc.n, mean, mn, mx);
+                }
+                udpFlush (dPub);
+                secAcc.n = 0;
+            }
+
+            /* store and publish */
+            if (complete)
+                putRecord (gmdata);
+
+            if (k == 0)
+            {
+                secTime = rec.ts.tv_sec;
+                accAdd (&secAcc, &rec.mb);
+            }
+            /* the accumulator also marks a period with data */
+            gmdata->curslot = rec.ts.tv_sec / recPeriod;
+            accAdd (&gmdata->arec, &rec.mb);
+            if (gmdata->decim)
+                decimPut (gmdata->decim, &rec.mb);
+            if ((k == 0) && dSpec && (psr = specPut (dSpec, &rec.ts, &rec.mb)))
+                putSpec (psr);
+            if (gmdata->cap && (prb = capPut (gmdata->cap, &rec, ringOverruns (gmdata->ring))))
+                putCapture (gmdata, prb);
+        }
     }
+    return 0;
+}
 
-    fseek (hFile, 0, SEEK_END);
-    pos = ftell (hFile);
 
-    /* write header to (each) output file once */
-    if (pos == 0)
+
+/* the samplers have stopped, and the rings are drained; save the
+ * incomplete last records, capture blocks and spectra; a full
+ * storage queue (BLOCK) is waited for
+ */
+static void  drainEnd (void)
+{
+    gspRecord  *psr;
+    rawBlock   *prb;
+    int         k;
+
+    for (k=0; k<nSensors; k++)
     {
-        sprintf (fbuf, "# -- geomagnetism data, per minute --\n");
-        fputs (fbuf, hFile);
-        sprintf (fbuf, "# start time : %02d.%02d.%4d, %02d:%02d\n", ptime->tm_mon+1, ptime->tm_mday,
-             ptime->tm_year + 1900, ptime->tm_hour, ptime->tm_min);
-        fputs (fbuf, hFile);
-        if (cbData.mode == GMT_AXIS_ALL)
-            sprintf (fbuf, "# format :\n# HH:MM, X_data, Y_data, Z_data\n");
-        else
-            sprintf (fbuf, "# format :\n# HH:MM, XYZ_Vector_data\n");
-        fputs (fbuf, hFile);
-        sprintf (fbuf, "# fullscale value = %.5lf Ga\n", gmdata->fullScale);
-        fputs (fbuf, hFile);
-        fflush (hFile);
+        while ((cbData[k].arec.n > 0) && (storeWait (dStore, GMT_STORE_WAIT) != 0))
+            ;
+        if (cbData[k].arec.n > 0)
+            putRecord (&cbData[k]);
+        if (cbData[k].cap && (prb = capFlush (cbData[k].cap)))
+            putCapture (&cbData[k], prb);
+    }
+    if (dSpec && (psr = specFlush (dSpec)))
+        putSpec (psr);
+}
+
+
+
+/* the sample period of a sensor is complete; average, and store it
+ */
+static void  putRecord (sampler_cfg *gmdata)
+{
+    double  mean[GMT_AXES];
+
+    if (gmdata->decim)
+    {
+        putDecim (gmdata);
+        return;
     }
-    mday = ptime->tm_mday;
 
-    /* write data */
-    if (cbData.mode == GMT_AXIS_ALL)
-        sprintf (fbuf, "%02d:%02d, %.6lf, %.06lf, %06lf\n", ptime->tm_hour, ptime->tm_min, gmdata->dx, gmdata->dy, gmdata->dz);
+    gmdata->nsmpl  = gmdata->arec.n;
+    if (gmdata->dtype == ELFD_DTYPE_INT)
+    {
+        accResultInt (&gmdata->arec, gmdata->ival, gmdata->imin, gmdata->imax);
+        intToPhys (gmdata);
+    }
     else
     {
-        double  dh, vs;
-        dh = gmdata->dx * gmdata->dx + gmdata->dy * gmdata->dy + gmdata->dz * gmdata->dz;
-        vs = sqrt (dh);
-        sprintf (fbuf, "%02d:%02d, %.6lf\n", ptime->tm_hour, ptime->tm_min, vs);
+        accResult (&gmdata->arec, gmdata->scaleVal, mean, gmdata->dmin, gmdata->dmax);
+        gmdata->dx = mean[DI_X];
+        gmdata->dy = mean[DI_Y];
+        gmdata->dz = mean[DI_Z];
     }
-    fputs (fbuf, hFile);
+    gmdata->tstamp = gmdata->curslot * recPeriod;
+    putSample (gmdata);
+    gmdata->arec.n = 0;
+}
 
-    fflush (hFile);
-    fclose (hFile);
-    return 0;
+
+
+/* the sample period of a sensor with a decimation stage is complete;
+ * take its statistics, and store them; a period without a filter
+ * output (e.g. while the filter starts) is left out
+ */
+static void  putDecim (sampler_cfg *gmdata)
+{
+    decimStats  ds;
+    int         i;
+
+    gmdata->arec.n = 0;
+    if (decimResult (gmdata->decim, &ds) == 0)
+        return;
+
+    gmdata->nsmpl = ds.count;
+    for (i=0; i<GMT_AXES; i++)
+    {
+        gmdata->ival[i] = ds.umean[i];
+        gmdata->imin[i] = ds.umin[i];
+        gmdata->imax[i] = ds.umax[i];
+        gmdata->dsd[i]  = ds.stddev[i] * gmdata->scaleVal;
+    }
+    if (gmdata->dtype == ELFD_DTYPE_INT)
+        intToPhys (gmdata);
+    else
+    {
+        gmdata->dx = ds.mean[DI_X] * gmdata->scaleVal;
+        gmdata->dy = ds.mean[DI_Y] * gmdata->scaleVal;
+        gmdata->dz = ds.mean[DI_Z] * gmdata->scaleVal;
+        for (i=0; i<GMT_AXES; i++)
+        {
+            gmdata->dmin[i] = ds.min[i] * gmdata->scaleVal;
+            gmdata->dmax[i] = ds.max[i] * gmdata->scaleVal;
+        }
+    }
+    gmdata->tstamp = gmdata->curslot * recPeriod;
+    putSample (gmdata);
 }
 
 
 
-/* a debug function to "speed up" simulated runs
- * does <not> try to emulate fully compatible behavior !
+/* physical values of an integer record; for the in-memory
+ * history, and the vector sum
  */
-static struct tm  *sim_localtime (const time_t *timep)
+static void  intToPhys (sampler_cfg *gmdata)
 {
-    static struct tm  lstime;
-    static int        ccount = 0;
+    int  i;
 
-    /*  on first call, get the actual time, and keep a copy */
-    if (ccount == 0)
+    gmdata->dx = gmdata->ival[DI_X] * gmdata->unit;
+    gmdata->dy = gmdata->ival[DI_Y] * gmdata->unit;
+    gmdata->dz = gmdata->ival[DI_Z] * gmdata->unit;
+    for (i=0; i<GMT_AXES; i++)
     {
-        lstime.tm_sec  = 0;
-        lstime.tm_min  = 1;
-        lstime.tm_hour = 13;
-        lstime.tm_mday = 4;
-        lstime.tm_mon  = 4;
-        lstime.tm_year = 25;
-        ccount++;
-        return (&lstime);
+        gmdata->dmin[i] = gmdata->imin[i] * gmdata->unit;
+        gmdata->dmax[i] = gmdata->imax[i] * gmdata->unit;
     }
+}
 
-    /* on subsequent calls, just modify the local copy
-     * and advance the minute */
-    else
+
+
+/* signals of the main loop; SIGHUP reloads the configuration,
+ * SIGTERM and SIGINT stop sampling, the files are finished then
+ * returns non-zero to end the loop
+ */
+static int  onSignal (void *arg, int fd, unsigned int events)
+{
+    struct signalfd_siginfo  si;
+
+    while (read (fd, &si, sizeof (si)) == sizeof (si))
+    {
+        if (si.ssi_signo == SIGHUP)
+            reloadConfig ();
+        else
+            gmtExit = 1;
+    }
+    return gmtExit;
+}
+
+
+
+/* hand one (averaged) sample to all consumers;
+ * the storage backends, the in-memory history, and the publisher;
+ * history and live data are kept for the first sensor only
+ */
+static void  putSample (sampler_cfg *gmdata)
+{
+    storeRecord  sr;
+    double       v[GMT_AXES];
+    int          i;
+
+    /* a copy to the storage thread; never waits for the medium */
+    memset (&sr, 0, sizeof (sr));
+    sr.kind     = STORE_SAMPLE;
+    sr.sensor   = gmdata->index;
+    sr.tstamp   = gmdata->tstamp;
+    sr.mode     = gmdata->mode;
+    sr.storage  = gmdata->storage;
+    sr.envelope = (gmdata->decim != NULL);
+    sr.nsmpl    = gmdata->nsmpl;
+    sr.v[DI_X]  = gmdata->dx;
+    sr.v[DI_Y]  = gmdata->dy;
+    sr.v[DI_Z]  = gmdata->dz;
+    for (i=0; i<GMT_AXES; i++)
+    {
+        sr.vmin[i] = gmdata->dmin[i];
+        sr.vmax[i] = gmdata->dmax[i];
+        sr.sd[i]   = gmdata->dsd[i];
+        sr.ival[i] = gmdata->ival[i];
+        sr.imin[i] = gmdata->imin[i];
+        sr.imax[i] = gmdata->imax[i];
+    }
+    storePut (dStore, &sr);
+    if (gmdata->index != 0)
+        return;
+
+    v[DI_X] = gmdata->dx;
+    v[DI_Y] = gmdata->dy;
+    v[DI_Z] = gmdata->dz;
+    histAppend (dHist, gmdata->tstamp, v);
+    if (dStorm)
+        putStorm (gmdata, v);
+
+    /* live data; the record, and the minute and the hour if this record
+     * completes them; shorter records go to the seconds stream, unless
+     * the continuous consumer sends its own seconds there */
+    if (dPub)
     {
-        lstime.tm_sec = 0;
-        lstime.tm_min++;
-        if (lstime.tm_min >= 60)
+        struct timespec  ts;
+        histStats        hs;
+        int              type;
+
+        ts.tv_sec  = gmdata->tstamp - (gmdata->tstamp % recPeriod);
+        ts.tv_nsec = 0;
+        type = GMT_PCK_MINUTE;
+        if (recPeriod < 60)
+            type = (activeCfg->acqMode != GMT_ACQ_CONTINUOUS) ? GMT_PCK_SECOND : 0;
+        if (type && (gmdata->dtype == ELFD_DTYPE_INT))
+            udpQueueInt (dPub, type, &ts, recPeriod, gmdata->nsmpl, gmdata->ival, gmdata->imin,
+                         gmdata->imax, gmdata->unit);
+        else if (type)
+            udpQueue (dPub, type, &ts, recPeriod, gmdata->nsmpl, v, gmdata->dmin, gmdata->dmax);
+
+        if ((recPeriod < 60) && ((ts.tv_sec + recPeriod) % 60 == 0))
         {
-            lstime.tm_min = 0;
-            lstime.tm_hour++;
+            struct timespec  tm;
+
+            tm.tv_sec  = ts.tv_sec + recPeriod - 60;
+            tm.tv_nsec = 0;
+            if (histQuery (dHist, tm.tv_sec, tm.tv_sec + 60, &hs) > 0)
+                udpQueue (dPub, GMT_PCK_MINUTE, &tm, 60, hs.count, hs.mean, hs.min, hs.max);
         }
-        if (lstime.tm_hour >= 23)
+
+        if ((ts.tv_sec + recPeriod) % 3600 == 0)
         {
-            lstime.tm_hour = 0;
-            lstime.tm_mday++;
+            ts.tv_sec -= 3600 - recPeriod;
+            if (histQuery (dHist, ts.tv_sec, ts.tv_sec + 3600, &hs) > 0)
+                udpQueue (dPub, GMT_PCK_HOUR, &ts, 3600, hs.count, hs.mean, hs.min, hs.max);
         }
-        if (lstime.tm_mday >= 31)
+        udpFlush (dPub);
+    }
+}
+
+
+
+/* run the storm detector on a record of the first sensor; a change
+ * of the alarms is logged, and sent right away, to the alert targets
+ * or else to the live data targets
+ */
+static void  putStorm (sampler_cfg *gmdata, const double *pv)
+{
+    gmtPublisher  *pp;
+    stormEvent     se;
+    struct tm      tm;
+    char           ts[32];
+
+    if (!stormAdd (dStorm, gmdata->tstamp, pv, &se))
+        return;
+    metSet (&dMetrics.stormActive, se.active);
+    metAdd (&dMetrics.alerts, 1);
+    if ((pp = dAlert ? dAlert : dPub))
+    {
+        udpQueueAlert (pp, &se, recPeriod);
+        udpFlush (pp);
+    }
+
+    strftime (ts, sizeof (ts), "%Y-%m-%d %H:%M:%S", localtime_r (&se.time, &tm));
+    printf ("%s storm alarm %s, 0x%03x: dB/dt %.1lf %.1lf %.1lf %.1lf nT/min, "
+            "deviation %.1lf %.1lf %.1lf %.1lf nT\n", ts, (se.changed & se.active) ? "raised" : "cleared",
+            se.active, se.dbdt[DI_X], se.dbdt[DI_Y], se.dbdt[DI_Z], se.dbdt[STORM_F],
+            se.dev[DI_X], se.dev[DI_Y], se.dev[DI_Z], se.dev[STORM_F]);
+    fflush (stdout);
+}
+
+
+
+/* start the storm detector, when a threshold is set, and set them;
+ * returns 0 on success, or -1 on memory shortage
+ */
+static int  stormStart (elfSenseConfig *pecfg)
+{
+    if (!dStorm && ((pecfg->stormDbdt > 0.0) || (pecfg->stormDev > 0.0)))
+    {
+        if (!(dStorm = stormCreate (recPeriod, pecfg->stormBaseline)))
+            return -1;
+        printf ("storm detector: dB/dt %.1lf nT/min, deviation %.1lf nT from %d min, %d%% hysteresis\n",
+                pecfg->stormDbdt, pecfg->stormDev, pecfg->stormBaseline, pecfg->stormHyst);
+    }
+    if (dStorm)
+        stormSetLimits (dStorm, pecfg->stormDbdt, pecfg->stormDev, pecfg->stormHyst);
+    return 0;
+}
+
+
+
+/* hand an averaged spectrum to the storage thread, which releases it
+ */
+static void  putSpec (gspRecord *pr)
+{
+    storeRecord  sr;
+
+    memset (&sr, 0, sizeof (sr));
+    sr.kind   = STORE_SPECTRUM;
+    sr.tstamp = (time_t) pr->time;
+    sr.data   = pr;
+    sr.size   = specSize (dSpec);
+    storePut (dStore, &sr);
+}
+
+
+
+/* hand a block of raw samples to the storage thread, which
+ * releases it; if it is dropped, its samples are lost with the next
+ */
+static void  putCapture (sampler_cfg *gmdata, rawBlock *pb)
+{
+    storeRecord   sr;
+    unsigned int  n = pb->count;
+
+    memset (&sr, 0, sizeof (sr));
+    sr.kind   = STORE_CAPTURE;
+    sr.sensor = gmdata->index;
+    sr.tstamp = (time_t) (pb->real / 1000000000LL);
+    sr.data   = pb;
+    sr.size   = RAW_BLOCK_SIZE;
+    if (storePut (dStore, &sr) != 0)
+        capLost (gmdata->cap, n);
+}
+
+
+
+/* storage sink; the storage thread hands each queued record to
+ * its sensor's files, the spectra or the capture file, or applies
+ * a data path and write policy change
+ * returns 0 if writing was ok, an error number otherwise
+ */
+static int  storeSample (void *arg, storeRecord *pr)
+{
+    long long  t0;
+    int        k, rv;
+
+    (void) arg;
+    if (pr->kind == STORE_CONFIG)
+    {
+        /* files are reopened with the next record */
+        if (pr->path)
         {
-            lstime.tm_mday = 1;
-            lstime.tm_mon++;
+            for (k=0; k<nSensors; k++)
+                saveSetPath (&cbData[k].save, pr->path);
         }
-        if (lstime.tm_mon >= 12)
-            lstime.tm_year++;
+        for (k=0; k<nSensors; k++)
+            writerSetPolicy (&cbData[k].save.writer, pr->batch, pr->syncMode, pr->syncValue);
+        return 0;
     }
-    return (&lstime);
+    if (pr->kind == STORE_SPECTRUM)
+    {
+        if ((rv = specWrite (dSpec, pr->data)) != 0)
+            metAdd (&dMetrics.writeErrors, 1);
+        return rv;
+    }
+    if (pr->kind == STORE_CAPTURE)
+    {
+        if ((rv = capWrite (cbData[pr->sensor].cap, pr->data)) != 0)
+            metAdd (&dMetrics.writeErrors, 1);
+        return rv;
+    }
+
+    /* the storage time, all backends */
+    t0 = metClock ();
+    if ((rv = saveRecord (&cbData[pr->sensor].save, pr)) != 0)
+        metAdd (&dMetrics.writeErrors, 1);
+    metObserve (&dMetrics.write, metClock () - t0);
+    return rv;
 }
 
 
@@ -6,10 +6,18 @@
 /* supported magnetometer sensor devices */
 #define GMT_DEVICE_LSM303       0
 #define GMT_DEVICE_HMC5883      1
+#define GMT_DEVICE_SIM          2        /* simulated, random data */
+#define GMT_DEVICE_COUNT        3
 
 #define DEVICE_ADDRESS_LSM303   (0x3C >> 1)
 #define DEVICE_ADDRESS_HMC5883  (0x3C >> 1)
 
+/* status register, the same for both devices (SR_REG_M / SR);
+ * bit 0 is set when a new conversion is ready, and cleared by
+ * reading the data registers */
+#define DEVICE_REG_SR           0x09
+#define DEVICE_SR_DRDY          0x01
+
 /* supported/used output rates (per sensor) */
 /*     LSM303DLHC
  * Rate Hz)| 0.75 | 1.5 | 3.0 | 7.5 |  15 |  30 |  75 | 220
@@ -38,6 +46,9 @@
 #ifdef _GMT_DATA_
 const double         OD_rate_rtable[8] = {0.75,  1.5,  3.0,  7.5, 15.0, 30.0, 75.0, 220.0};
 const unsigned char  OD_rate_vtable[8] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07 };
+#else
+extern const double         OD_rate_rtable[8];
+extern const unsigned char  OD_rate_vtable[8];
 #endif
 
 /* supported/used fullscle values (per sensor) */
@@ -87,10 +98,45 @@ const unsigned char  FS_vtableHMC[8]    = {   0x00,   0x01,   0x02,   0x03,   0x
 /* number of consecutive samples, averaged to one value */
 #define GMT_AVG_COUNT            3
 
+/* acquisition modes;
+ * single: read GMT_AVG_COUNT values once a minute, in the main loop
+ * continuous: a sampler thread reads at the configured OD rate, and
+ * passes raw values through a ring buffer to the consumer, run by the
+ * main loop, which does the averaging and hands the records on */
+#define GMT_ACQ_SINGLE           0
+#define GMT_ACQ_CONTINUOUS       1
+
+/* raw sample ring size (records), a power of 2;
+ * 4096 records hold more than 18s of data at the max. OD rate */
+#define GMT_RING_SIZE            4096
+
+/* the consumer drains the rings once a second, this many ms after the
+ * second (plus two OD periods), when its samples are in */
+#define GMT_CONSUMER_DELAY_MS    20
+
+/* data-ready source; how the sampler learns of a new conversion
+ * none: wait one conversion period (at the OD rate)
+ * status: poll the DRDY bit of the status register
+ * gpio: wait for the edge of the sensor DRDY pin, on a gpio line */
+#define GMT_DRDY_NONE            0
+#define GMT_DRDY_STATUS          1
+#define GMT_DRDY_GPIO            2
+
+#define GMT_DRDY_POLL_DIV        8     /* status polls per OD period  */
+#define GMT_DRDY_EVENTS          16    /* gpio line event queue size  */
+
 #define GMT_PN_SIZE              64
+#define GMT_TARGET_SIZE          256   /* publish target list, chars */
+#define GMT_PATH_SIZE            256   /* config data path, chars    */
+#define GMT_NAME_SIZE            16    /* sensor name, file tag      */
+
+/* sensors per process, on any number of buses;
+ * with more than one sensor, acquisition is continuous, with one
+ * sampler thread per bus, all on the same clock tick */
+#define GMT_MAX_SENSORS          8
 
 /* internal data storage */
-#define MINS_PER_DAY             1400  /* 60 minutes * 24 hours */
+#define MINS_PER_DAY             1440  /* 60 minutes * 24 hours */
 #define GMT_AXES                 3
 #define DI_X                     0
 #define DI_Y                     1
@@ -98,6 +144,17 @@ const unsigned char  FS_vtableHMC[8]    = {   0x00,   0x01,   0x02,   0x03,   0x
 
 typedef unsigned char   uchar;
 
+
+/* one sensor of the config file SENSOR list
+ */
+typedef struct
+{
+    int     device;              /* GMT_DEVICE_*        */
+    int     bus;                 /* i2c bus number      */
+    int     addr;                /* i2c address, 0 = device default */
+    char    name[GMT_NAME_SIZE]; /* day file name tag   */
+}
+sensorConfig;
 /* sensor scan application config
  */
 typedef struct
@@ -105,9 +162,47 @@ typedef struct
     int     device;              /* sensor device type  */
     int     i2cBus;              /* i2c bus number      */
     int     sampleRate;          /* sampling rate       */
+    int     samplePeriod;        /* record period, s    */
+    int     dataType;            /* ELFD_DTYPE_*        */
+    int     decimMode;           /* GMT_DECIM_*         */
+    int     cicOrder;            /* CIC stages          */
+    int     cicFactor;           /* CIC decimation      */
     int     sampleAxes;          /* axes to sample      */
     double  fullScale;           /* fullscale value     */
     char    outputMode;          /* default output mode */
+    int     acqMode;             /* acquisition mode    */
+    int     storage;             /* storage backend(s)  */
+    int     writeBatch;          /* records per write   */
+    int     syncMode;            /* durability policy   */
+    int     syncValue;           /* records / seconds   */
+    int     backlog;             /* storage queue, max  */
+    int     overflow;            /* GMT_OVF_*           */
+    int     payload;             /* storage queue, MB of spectra / capture */
+    int     historyDays;         /* in-memory history   */
+    int     stationId;           /* station id          */
+    char    targets[GMT_TARGET_SIZE]; /* publish list   */
+    int     queryPort;           /* TCP query, 0 = off  */
+    char    metricsFile[GMT_PATH_SIZE];  /* "" = off    */
+    int     metricsPort;         /* HTTP, 0 = off       */
+    int     metricsInterval;     /* file rewrite, s     */
+    double  stormDbdt;           /* nT / min, 0 = off   */
+    double  stormDev;            /* nT, 0 = off         */
+    int     stormBaseline;       /* minutes             */
+    int     stormHyst;           /* percent             */
+    char    alerts[GMT_TARGET_SIZE];  /* alert targets  */
+    int     specSize;            /* FFT length, 0 = off */
+    int     specInterval;        /* s per spectrum      */
+    double  specFmax;            /* Hz, 0 = Nyquist     */
+    char    specPath[GMT_PATH_SIZE];  /* spectra files  */
+    char    capPath[GMT_PATH_SIZE];   /* "" = no capture */
+    int     capSize;             /* MB per capture file */
+    int     capRotate;           /* s per file, 0 = off */
+    char    dataPath[GMT_PATH_SIZE];  /* data directory */
+    int     drdyMode;            /* GMT_DRDY_*          */
+    char    drdyChip[GMT_PN_SIZE];    /* gpio chip      */
+    int     drdyLine;            /* gpio line offset    */
+    int     nSensors;            /* sensors in the list */
+    sensorConfig  sensor[GMT_MAX_SENSORS];
 }
 elfSenseConfig;
 
@@ -136,6 +231,199 @@ typedef struct
 }
 magnBuffer;
 
+/* sensor driver interface (gmtdrv.c);
+ * one driver per device type, chosen by the DEVICE / SENSOR name;
+ * a driver reads the data registers as one burst, the decode and
+ * scale kernels convert <n> bursts / samples in one loop
+ */
+#define GMT_BURST_MAX           6        /* data register bytes   */
+
+typedef struct gmtDriver  gmtDriver;
+typedef struct metSensor  metSensor;
+
+/* failed data reads are repeated this often, at once */
+#define GMT_I2C_RETRIES         2
+
+typedef struct
+{
+    const gmtDriver  *drv;       /* device driver               */
+    int               ifh;       /* i2c bus handle, or -1       */
+    unsigned char     addr;      /* i2c slave address           */
+    metSensor        *met;       /* its metrics, or NULL        */
+    int               failing;   /* last read failed, reported  */
+    double            odRate;    /* conversion rate, in Hz      */
+    double            scale;     /* raw value -> Gauss          */
+    struct timespec   t0;        /* simulation; start time      */
+    unsigned long     conv;      /* simulation; last conversion */
+    unsigned short    xsubi[3];  /* simulation; random state    */
+}
+gmtDevice;
+
+struct gmtDriver
+{
+    const char     *name;        /* config name                 */
+    int             device;      /* GMT_DEVICE_*                */
+    int             onBus;       /* needs an i2c bus            */
+    unsigned char   addr;        /* default i2c address         */
+    int             maxRate;     /* highest OD rate table index */
+    double          fullScale;   /* at the configured gain      */
+    int   (*probe)     (gmtDevice *pd);
+    int   (*configure) (gmtDevice *pd, int rate);
+    int   (*ready)     (gmtDevice *pd);
+    int   (*readBurst) (gmtDevice *pd, unsigned char *raw);
+    void  (*decode)    (const unsigned char *raw, int n, magnBuffer *pm);
+    void  (*scale)     (const magnBuffer *pm, int n, double scale, double *pv);
+};
+
+/* raw sensor record, as passed from the sampler thread to the consumer
+ */
+typedef struct
+{
+    struct timespec  ts;         /* acquisition time, realtime clock */
+    long long        mono;       /* the same, monotonic clock, ns    */
+    magnBuffer       mb;         /* raw sensor values                */
+}
+gmtRecord;
+
+/* single-producer / single-consumer lock-free ring (gmtring.c) */
+typedef struct gmtRing  gmtRing;
+
+/* in-memory sample history over several days (gmthist.c) */
+typedef struct gmtHistory  gmtHistory;
+
+/* aggregates over a time range of the history */
+typedef struct
+{
+    unsigned long  count;               /* samples in the range  */
+    double         mean[GMT_AXES];
+    double         min[GMT_AXES];
+    double         max[GMT_AXES];
+    double         stddev[GMT_AXES];
+}
+histStats;
+
+/* history length, in days */
+#define GMT_HISTORY_DAYS         7
+
+/* streaming decimation stage (gmtdecim.c), continuous mode;
+ * an optional CIC decimator (order N, factor R), followed by a boxcar
+ * over the record period, which gives mean, extremes, standard
+ * deviation and count per axis; nothing of the raw window is kept
+ * none: plain mean of the raw values (no statistics)
+ * boxcar: the boxcar over the raw values
+ * cic: CIC first, the boxcar over its output */
+#define GMT_DECIM_NONE           0
+#define GMT_DECIM_BOXCAR         1
+#define GMT_DECIM_CIC            2
+
+#define GMT_CIC_ORDER            3     /* default N                   */
+#define GMT_CIC_FACTOR           8     /* default R                   */
+#define GMT_CIC_MAX_ORDER        5
+#define GMT_CIC_MAX_BITS         40    /* 16 + N * log2 (R), at most, */
+                                       /* so period sums cannot overflow */
+
+typedef struct gmtDecim  gmtDecim;
+
+/* statistics of one record period; values in raw counts, and the
+ * same in integer units (GMT_INT_FRAC_BITS) for DATA_TYPE = INT
+ */
+typedef struct
+{
+    unsigned long  count;               /* filter outputs        */
+    double         mean[GMT_AXES];
+    double         min[GMT_AXES];
+    double         max[GMT_AXES];
+    double         stddev[GMT_AXES];
+    int            umean[GMT_AXES];     /* integer units         */
+    int            umin[GMT_AXES];
+    int            umax[GMT_AXES];
+}
+decimStats;
+
+/* online storm detector (gmtstorm.c), on the records of the first
+ * sensor; for X, Y, Z and the magnitude F: the rate of change dB/dt
+ * from the previous record, and the deviation from a rolling mean of
+ * the last STORM_BASELINE minutes (running sums over a ring of the
+ * records, O(1) each); an alarm is raised when one of them exceeds
+ * its threshold, and cleared when it is back below STORM_HYSTERESIS
+ * percent of it; a change of the alarms is sent right away, as a
+ * GMT_PCK_ALERT packet, with the record that caused it
+ */
+#define STORM_CHANNELS           4     /* X, Y, Z, F                  */
+#define STORM_F                  3
+#define STORM_BASELINE           60    /* default minutes             */
+#define STORM_HYSTERESIS         50    /* default percent             */
+#define STORM_MIN_FILL           10    /* baseline records, at least  */
+#define STORM_NT_PER_GA          1e5
+
+/* alarm bits; dB/dt of channel <c> is bit <c>, its deviation bit 8+<c> */
+#define STORM_BIT_DBDT(c)        (1u << (c))
+#define STORM_BIT_DEV(c)         (1u << (8 + (c)))
+
+typedef struct gmtStorm  gmtStorm;
+
+typedef struct
+{
+    time_t         time;         /* of the record                 */
+    unsigned int   active;       /* STORM_BIT_*, after the record */
+    unsigned int   changed;      /* raised or cleared by it       */
+    double         value[STORM_CHANNELS];  /* Ga                  */
+    double         dbdt[STORM_CHANNELS];   /* nT / min            */
+    double         dev[STORM_CHANNELS];    /* nT, from baseline   */
+}
+stormEvent;
+
+/* --- spectral analysis (gmtspec.c) ---
+ * a streaming Welch PSD of the raw samples of the first sensor, in
+ * continuous mode; blocks of SPEC_SIZE samples, overlapping by half,
+ * without their mean, and Hann-windowed, go through a real FFT (all
+ * axes at once, the plan is set up once); their one-sided power
+ * spectra are averaged over SPEC_INTERVAL seconds, and appended to the
+ * spectra file of the day, <SPEC_PATH>/YYYY_MM_DD[_tag].gsp;
+ * the file is a GSP_HEADER_SIZE header, followed by the records; the
+ * daemon writes a new header each time it opens the file, readers take
+ * the record size from the last header before a record
+ */
+#define GSP_HEADER_ID               "#GSP"
+#define GSP_RECORD_ID               "#GSR"
+#define GSP_VERSION                 1
+#define GSP_FILE_EXT                ".gsp"
+#define GSP_HEADER_SIZE             64
+#define GSP_MIN_SIZE                64     /* FFT length, samples     */
+#define GSP_MAX_SIZE                65536
+#define GSP_INTERVAL                60     /* default record, s       */
+#define GSP_OVERLAP                 50     /* percent                 */
+#define GSP_NT_PER_GA               1e5
+
+typedef struct gmtSpec  gmtSpec;
+
+typedef struct
+{
+    char            id[4];       /* GSP_HEADER_ID, no '\0'     */
+    unsigned char   version;     /* GSP_VERSION                */
+    unsigned char   axes;        /* spectra per record         */
+    unsigned short  hdrSize;     /* GSP_HEADER_SIZE            */
+    unsigned int    size;        /* FFT length, samples        */
+    unsigned int    bins;        /* per axis, from 0 Hz        */
+    unsigned int    interval;    /* seconds per record         */
+    unsigned int    overlap;     /* of the blocks, percent     */
+    double          rate;        /* sample rate, Hz            */
+    double          df;          /* bin width, Hz              */
+    char            window[8];   /* "HANN", '\0' padded        */
+    unsigned char   reserved[16];
+}
+gspHeader;
+
+/* one averaged spectrum; psd[axis * bins + bin], in nT^2 / Hz */
+typedef struct
+{
+    char            id[4];       /* GSP_RECORD_ID, no '\0'     */
+    unsigned int    blocks;      /* spectra averaged           */
+    long long       time;        /* interval start, epoch s    */
+    float           psd[];
+}
+gspRecord;
+
 typedef struct
 {
     unsigned int  days;
@@ -173,6 +461,183 @@ databuffer;
 #define ELFD_HEADER_ID              "#ESD"
 #define ELFD_DTYPE_FLOAT            'F'
 #define ELFD_DTYPE_INT              'I'
+#define ELFD_DTYPE_RAW              'R'    /* raw capture files   */
+
+/* integer data type; records are kept as raw counts, with
+ * GMT_INT_FRAC_BITS fraction bits for the sub-count part of averages;
+ * the physical value is (units * scale), the scale goes with the data
+ * (file header, packet), and is only applied for presentation */
+#define GMT_INT_FRAC_BITS           8
+#define GMT_INT_EMPTY               ((int) 0x80000000)  /* empty esd slot */
+
+/* --- binary day file (.esd) ---
+ * a fixed-size header, followed by one fixed-size slot per sample index;
+ * slot <n> holds the sample taken at second (n * period) of the day, so
+ * any time of the day is addressed directly, without parsing the file;
+ * the file is preallocated for the whole day, with all slots "empty"
+ * (all bits set, a float NaN; GMT_INT_EMPTY for integer files)
+ */
+#define ESD_VERSION                 1
+#define ESD_FILE_EXT                ".esd"
+#define ESD_HEADER_SIZE             64
+
+typedef struct
+{
+    char            id[4];       /* ELFD_HEADER_ID, no '\0'    */
+    unsigned char   version;     /* ESD_VERSION                */
+    unsigned char   dtype;       /* ELFD_DTYPE_FLOAT / _INT    */
+    unsigned char   axes;        /* values per slot, 1 or 3    */
+    unsigned char   mode;        /* GMT_AXIS_ALL / _SUM        */
+    unsigned short  year;        /* date of the day file       */
+    unsigned char   month;       /* 1..12                      */
+    unsigned char   mday;        /* 1..31                      */
+    unsigned int    period;      /* seconds per slot           */
+    unsigned int    slots;       /* number of slots            */
+    unsigned int    slotSize;    /* bytes per slot             */
+    unsigned int    hdrSize;     /* offset of slot 0           */
+    double          fullScale;   /* sensor fullscale, in Ga    */
+    double          scale;       /* integer files; Ga per unit */
+    unsigned char   reserved[16];
+}
+esdHeader;
+
+/* an open (memory-mapped) binary day file */
+typedef struct
+{
+    int             fd;          /* file handle                */
+    int             writable;    /* opened for writing         */
+    size_t          size;        /* mapped size                */
+    esdHeader      *hdr;         /* mapping, starts w/ header  */
+    unsigned char  *slots;       /* first slot                 */
+    size_t          dirtyLo;     /* bytes written since the    */
+    size_t          dirtyHi;     /* last esdSync, or 0 / 0     */
+}
+esdFile;
+
+/* --- raw capture files (.esr) ---
+ * every conversion of a sensor, as raw counts with its monotonic
+ * time, in continuous mode; the consumer fills blocks of RAW_BLOCK_SIZE
+ * bytes, the storage thread appends them to the capture file; each
+ * block is framed by ELFD_HEADER_ID, and starts on a RAW_BLOCK_SIZE
+ * boundary after the RAW_HEADER_SIZE header (its first 64 bytes used,
+ * as an esdHeader starts); files are preallocated to CAPTURE_SIZE, and
+ * a new one is started at that size, or every CAPTURE_ROTATE seconds
+ * of the wall clock; a file closed regularly is cut to its blocks, a
+ * reader stops at the first block without the frame id
+ * name: <CAPTURE_PATH>/YYYY_MM_DD_HHMMSS[_tag].esr, the first sample
+ */
+#define RAW_VERSION                 1
+#define RAW_FILE_EXT                ".esr"
+#define RAW_HEADER_SIZE             4096   /* one page, aligned blocks  */
+#define RAW_BLOCK_SIZE              65536  /* bytes per write           */
+#define RAW_FILE_SIZE               64     /* default MB per file       */
+#define RAW_ROTATE                  3600   /* default s per file        */
+
+typedef struct
+{
+    char            id[4];       /* ELFD_HEADER_ID, no '\0'    */
+    unsigned char   version;     /* RAW_VERSION                */
+    unsigned char   dtype;       /* ELFD_DTYPE_RAW             */
+    unsigned char   axes;        /* counts per sample          */
+    unsigned char   device;      /* GMT_DEVICE_*               */
+    unsigned int    hdrSize;     /* offset of block 0          */
+    unsigned int    blockSize;   /* RAW_BLOCK_SIZE             */
+    unsigned short  sampleSize;  /* bytes per rawSample        */
+    unsigned char   bus;         /* i2c bus, and address       */
+    unsigned char   addr;
+    unsigned int    sensor;      /* index in the sensor list   */
+    double          odRate;      /* nominal OD rate, Hz        */
+    double          fullScale;   /* sensor fullscale, in Ga    */
+    double          scale;       /* Ga per count               */
+    long long       real;        /* CLOCK_REALTIME, ns, at ... */
+    long long       mono;        /* ... this CLOCK_MONOTONIC   */
+}
+rawHeader;
+
+typedef struct
+{
+    long long       mono;        /* CLOCK_MONOTONIC, ns        */
+    short           v[GMT_AXES]; /* raw counts, X, Y, Z        */
+    unsigned short  flags;       /* 0                          */
+}
+rawSample;
+
+typedef struct
+{
+    char            id[4];       /* ELFD_HEADER_ID, no '\0'    */
+    unsigned int    seq;         /* block number, all files    */
+    unsigned int    count;       /* samples in the block       */
+    unsigned int    lost;        /* dropped before, ring full  */
+    long long       real;        /* CLOCK_REALTIME, ns, of the */
+    long long       mono;        /* first sample, both clocks  */
+    rawSample       s[];
+}
+rawBlock;
+
+#define RAW_BLOCK_SAMPLES           ((RAW_BLOCK_SIZE - sizeof (rawBlock)) / sizeof (rawSample))
+
+typedef struct gmtCapture  gmtCapture;
+
+/* --- compressed archive day file (.gmz) ---
+ * a text day file, lossless, as a bit stream (most significant bit
+ * first) after a GMZ_HEADER_SIZE header; each line is one operation,
+ * selected by a prefix code:
+ *   0      record, same time step as the previous record
+ *   10     record, <value> is the zigzag delta-of-delta of its time
+ *          (seconds of the day)
+ *          a record continues with one <value> per column, the zigzag
+ *          delta to the column's value in the previous record, in units
+ *          of its last digit
+ *   110    text line kept as is (comments, and records not written back
+ *          identically from numbers); <value> bytes
+ *   1110   record layout: <value> columns, 1 bit set if the time has
+ *          seconds, then 8 bits per column: the number of digits after
+ *          the decimal point, GMZ_FMT_INT for an integer
+ *   1111   end of the stream; 1 bit set if the last line has no newline
+ * a <value> is 0 for 0, or 10, 110, 1110, 11110 followed by 4, 8, 16,
+ * 32 bits, or 11111 followed by 64 bits
+ */
+#define GMZ_HEADER_ID               "#GMZ"
+#define GMZ_VERSION                 1
+#define GMZ_FILE_EXT                ".gmz"
+#define GMZ_HEADER_SIZE             16
+#define GMZ_MAX_COLS                32
+#define GMZ_MAX_DIGITS              9      /* after the decimal point */
+#define GMZ_LINE_MAX                (16 + GMZ_MAX_COLS * 24)  /* a record */
+#define GMZ_FMT_INT                 0xff
+#define GMZ_NEG_ZERO                (-0x7fffffffffffffffLL - 1)  /* "-0.0.." */
+
+#define GMZ_ITEM_RECORD             0      /* decoded items */
+#define GMZ_ITEM_TEXT               1
+
+/* streaming decoder state (gmtcodec.c) */
+typedef struct
+{
+    FILE           *fp;
+    unsigned int    bits;        /* current byte of the stream  */
+    int             avail;       /* of it, bits not yet read    */
+    int             cols;        /* current record layout       */
+    int             secs;        /* time as HH:MM:SS            */
+    unsigned char   fmt[GMZ_MAX_COLS];
+    long long       prev[GMZ_MAX_COLS];   /* previous values    */
+    long            tprev;       /* previous record time        */
+    long            dprev;       /* previous time delta         */
+    int             nonl;        /* last line without newline   */
+    char           *text;        /* text line buffer           */
+    size_t          tsize;
+}
+gmzReader;
+
+/* one decoded operation; a record, or a line of text */
+typedef struct
+{
+    int             kind;        /* GMZ_ITEM_RECORD / _TEXT     */
+    long            tod;         /* record: seconds of the day  */
+    int             cols;
+    double          v[GMZ_MAX_COLS];
+    const char     *text;        /* text: the line, w/o newline */
+}
+gmzItem;
 
 /* --- runtime-loaded config files ---
  */
@@ -180,22 +645,97 @@ databuffer;
 
 /* gmt config */
 #define CFG_STR_MAX                 256
+#define CFG_KEY_MAX                 32
+#define CFG_ITEMS_MAX               64
+
+/* the config file, loaded once into a key / value table (elfcfg.c) */
+typedef struct
+{
+    char   key[CFG_KEY_MAX];     /* upper case            */
+    char   value[CFG_STR_MAX];   /* as given, trimmed     */
+}
+cfgItem;
+
+typedef struct
+{
+    int      count;
+    cfgItem  item[CFG_ITEMS_MAX];
+}
+cfgTable;
 #define GMT_CFG_BUS                 "I2C_BUS"
 #define GMT_CFG_DEVICE              "DEVICE"
 #define GMT_CFG_AXES                "AXES"
+#define GMT_CFG_RATE                "SAMPLE_RATE"
+#define GMT_CFG_PERIOD              "SAMPLE_PERIOD"
+#define GMT_CFG_DTYPE               "DATA_TYPE"
+#define GMT_CFG_DECIM               "DECIMATION"
+#define GMT_CFG_CICORDER            "CIC_ORDER"
+#define GMT_CFG_CICFACTOR           "CIC_FACTOR"
+#define GMT_CFG_ACQMODE             "ACQ_MODE"
+#define GMT_CFG_SENSOR              "SENSOR"     /* repeated, one per sensor */
+#define GMT_CFG_DRDY                "DRDY_MODE"
+#define GMT_CFG_DRDYGPIO            "DRDY_GPIO"  /* "<chip> <line>" */
+#define GMT_DR_NONE                 "NONE"
+#define GMT_DR_STATUS               "STATUS"
+#define GMT_DR_GPIO                 "GPIO"
+#define GMT_DT_FLOAT                "FLOAT"
+#define GMT_DT_INT                  "INT"
+#define GMT_DC_NONE                 "NONE"
+#define GMT_DC_BOXCAR               "BOXCAR"
+#define GMT_DC_CIC                  "CIC"
 
 #define GMT_CFG_DEV_LSM303          "LSM303"
 #define GMT_CFG_DEV_HMC5883         "HMC5883"
+#define GMT_CFG_DEV_SIM             "SIM"
 #define GMT_AXIS_X                  'X'
 #define GMT_AXIS_Y                  'Y'
 #define GMT_AXIS_Z                  'Z'
 
 #define GMT_CFG_DATAPATH            "DATAFILE_PATH"
 #define GMT_CFG_MODE                "OUTPUT_MODE"
+#define GMT_CFG_STORAGE             "STORAGE"
+#define GMT_CFG_HISTORY             "HISTORY_DAYS"
+#define GMT_CFG_TARGETS             "PUBLISH_TARGETS"
+#define GMT_CFG_STATION             "STATION_ID"
+#define GMT_CFG_QRYPORT             "QUERY_PORT"
+#define GMT_CFG_METFILE             "METRICS_FILE"
+#define GMT_CFG_METPORT             "METRICS_PORT"
+#define GMT_CFG_METINTERVAL         "METRICS_INTERVAL"
+#define GMT_CFG_STORMDBDT           "STORM_DBDT"
+#define GMT_CFG_STORMDEV            "STORM_DEVIATION"
+#define GMT_CFG_STORMBASE           "STORM_BASELINE"
+#define GMT_CFG_STORMHYST           "STORM_HYSTERESIS"
+#define GMT_CFG_ALERTS              "ALERT_TARGETS"
+#define GMT_CFG_BATCH               "WRITE_BATCH"
+#define GMT_CFG_SYNCMODE            "SYNC_MODE"
+#define GMT_CFG_SYNCVALUE           "SYNC_VALUE"
+#define GMT_CFG_BACKLOG             "STORE_BACKLOG"
+#define GMT_CFG_OVERFLOW            "STORE_OVERFLOW"
+#define GMT_CFG_PAYLOAD             "STORE_PAYLOAD"
+#define GMT_CFG_SPECSIZE            "SPEC_SIZE"
+#define GMT_CFG_SPECINTERVAL        "SPEC_INTERVAL"
+#define GMT_CFG_SPECFMAX            "SPEC_FMAX"
+#define GMT_CFG_SPECPATH            "SPEC_PATH"
+#define GMT_CFG_CAPPATH             "CAPTURE_PATH"
+#define GMT_CFG_CAPSIZE             "CAPTURE_SIZE"
+#define GMT_CFG_CAPROTATE           "CAPTURE_ROTATE"
 #define GMT_MD_AXES                 "AXES"
 #define GMT_MD_SUM                  "SUM"
 #define GMT_AXIS_ALL                0      /* all axes separately */
 #define GMT_AXIS_SUM                1      /* vector sum only     */
+#define GMT_ACQ_MD_SINGLE           "SINGLE"
+#define GMT_ST_TEXT                 "TEXT"
+#define GMT_ST_BINARY               "BINARY"
+#define GMT_ST_BOTH                 "BOTH"
+#define GMT_SY_NONE                 "NONE"
+#define GMT_SY_RECORDS              "RECORDS"
+#define GMT_SY_SECONDS              "SECONDS"
+#define GMT_OV_DROP_OLDEST          "DROP_OLDEST"
+#define GMT_OV_DROP_NEWEST          "DROP_NEWEST"
+#define GMT_OV_BLOCK                "BLOCK"
+#define GMT_STORE_TEXT              0x01   /* .dat text day files */
+#define GMT_STORE_BINARY            0x02   /* .esd binary files   */
+#define GMT_ACQ_MD_CONTINUOUS       "CONTINUOUS"
 
 
 #define LB_SIZE                     2048
@@ -218,12 +758,466 @@ databuffer;
 
 #define MAX_MISSED_DATA_COUNT       3
 
+/* --- runtime metrics ---
+ * counters, gauges and latency histograms of the samplers and the
+ * writer (gmtmetric.c); updated with relaxed atomics from any thread,
+ * without locks; exported as Prometheus text, to a file replaced
+ * (renamed) every METRICS_INTERVAL seconds, and by HTTP on the
+ * loopback interface, "GET /metrics" on METRICS_PORT; histograms
+ * have log2 bins by upper bound in us, as the scheduler
+ */
+#define MET_BINS                    24     /* <=1us .. <=4.2s, and more */
+#define MET_INTERVAL                10     /* default file interval, s  */
+#define MET_REQUEST_MAX             1024   /* HTTP request head, bytes  */
+
+typedef struct
+{
+    _Atomic unsigned long long  bin[MET_BINS];
+    _Atomic unsigned long long  sum;       /* ns                      */
+}
+metHist;
+
+/* per sensor */
+struct metSensor
+{
+    _Atomic unsigned long long  samples;   /* raw samples read        */
+    _Atomic unsigned long long  i2cErrors; /* failed reads / timeouts */
+    _Atomic unsigned long long  i2cRetries;
+    _Atomic long long           overruns;  /* ring, samples dropped   */
+    _Atomic long long           queue;     /* ring fill, samples      */
+    _Atomic long long           lastSample;  /* realtime ns, 0 = none */
+    metHist                     i2c;       /* data read time          */
+};
+
+typedef struct
+{
+    int                         sensors;   /* in use                  */
+    time_t                      start;     /* of the process          */
+    metSensor                   sensor[GMT_MAX_SENSORS];
+    _Atomic unsigned long long  writeErrors;
+    _Atomic unsigned long long  bytes;     /* written to day files    */
+    _Atomic long long           backlog;   /* storage queue, records  */
+    _Atomic long long           backlogPeak;
+    _Atomic long long           backlogLimit;
+    _Atomic unsigned long long  dropped;   /* queue full, records     */
+    _Atomic long long           stormActive;  /* alarm bits       */
+    _Atomic unsigned long long  alerts;    /* alarm changes sent      */
+    metHist                     write;     /* saveRecord() time       */
+    metHist                     jitter;    /* scheduler wake-ups      */
+}
+gmtMetrics;
+
+/* metrics exporter, file and HTTP (gmtmetric.c) */
+typedef struct gmtMetricServer  gmtMetricServer;
+
+/* --- sample scheduler ---
+ * one record per sample period, taken at the absolute period boundaries;
+ * in single mode on the wall clock, in continuous mode the bus threads
+ * use it for the OD rate tick, and the main loop waits for its timerfd
+ * (schedTimer ()); a slot at most MAX_MISSED_DATA_COUNT
+ * periods late is still taken, later ones are skipped; the wake-up
+ * latency, and the deviation of each wake-up interval from the period
+ * (jitter) are counted in log2 histograms, in us
+ * sample periods are divisors of 60 seconds, or multiples of 60 seconds
+ * that divide an hour
+ */
+#define GMT_SAMPLE_PERIOD           60     /* default record period, s  */
+#define GMT_SCHED_BINS              24     /* <1us .. <4.2s, and more   */
+
+typedef struct
+{
+    clockid_t        clock;      /* CLOCK_REALTIME / _MONOTONIC   */
+    long long        period;     /* slot length, ns               */
+    struct timespec  base;       /* time of slot 0                */
+    long long        slot;       /* next slot                     */
+    long long        lastSlot;   /* slot of the last wake-up      */
+    struct timespec  lastWake;   /* time of the last wake-up      */
+    unsigned long    wakes;      /* slots taken                   */
+    unsigned long    late;       /* taken, but after the next one was due */
+    unsigned long    skipped;    /* slots not taken, too late     */
+    long long        latMax;     /* largest latency, ns           */
+    double           latSum;     /* sum of latencies, ns          */
+    unsigned long    lat[GMT_SCHED_BINS];  /* wake-up latency     */
+    unsigned long    jit[GMT_SCHED_BINS];  /* interval deviation  */
+    metHist         *jitter;     /* metrics, also; or NULL        */
+    int              tfd;        /* timerfd (schedTimer ()), or -1 */
+}
+gmtSched;
+
+/* --- event loop ---
+ * the main thread waits for all of its events in one epoll set
+ * (gmtloop.c); each source is a descriptor with a handler: the sample
+ * and consumer ticks are scheduler timerfds, SIGTERM, SIGINT and SIGHUP
+ * come through a signalfd; a handler returns non-zero to end the loop
+ */
+#define GMT_LOOP_SOURCES            16
+#define GMT_LOOP_EVENTS             8      /* per epoll_wait () */
+
+typedef int (*loopHandler) (void *arg, int fd, unsigned int events);
+
+typedef struct gmtLoop  gmtLoop;
+
+/* --- text day file writer ---
+ * the file of the current day is kept open, records are collected
+ * and written in batches; the sync mode sets when written data are
+ * forced to the storage medium (fdatasync); the binary day file of
+ * a sensor follows the same policy (msync of the written pages)
+ */
+#define GMT_SYNC_NONE               0      /* leave it to the kernel    */
+#define GMT_SYNC_RECORDS            1      /* every <n> records         */
+#define GMT_SYNC_SECONDS            2      /* every <n> seconds         */
+
+#define GMT_WRITE_BATCH             1      /* default records per write */
+#define GMT_WRITE_BUFSIZE           4096   /* initial buffer size       */
+
+typedef struct
+{
+    int       fd;                /* current day file, or -1       */
+    int       mday;              /* day of the open file          */
+    char      path[FILENAME_MAXSIZE];  /* data directory          */
+    char      tag[GMT_NAME_SIZE];      /* file name tag, or empty */
+    char     *buf;               /* pending record data           */
+    size_t    len;               /* bytes pending                 */
+    size_t    size;              /* buffer size                   */
+    int       batch;             /* records per write             */
+    int       pending;           /* records in the buffer         */
+    int       syncMode;          /* GMT_SYNC_*                    */
+    int       syncValue;         /* records or seconds per sync   */
+    int       unsynced;          /* records since the last sync   */
+    time_t    lastSync;          /* monotonic time of last sync   */
+    _Atomic unsigned long long  *written;  /* metrics, or NULL    */
+}
+gmtWriter;
+
+/* --- asynchronous storage ---
+ * the records go to storage through a FIFO (gmtstore.c), served by
+ * one thread that owns the writers, the binary, rollup, spectra and
+ * capture files; acquisition never waits for the medium; while it
+ * stalls, up to STORE_BACKLOG records are kept in memory (the queue
+ * grows as needed, and shrinks again once drained), and written in
+ * order when it recovers; beyond that, STORE_OVERFLOW drops the oldest
+ * or the newest sample record, or holds the producer back (it waits
+ * at most GMT_STORE_WAIT ms per tick, the samples stay in the rings,
+ * and its event loop keeps serving signals); spectra and
+ * capture blocks are held up to STORE_PAYLOAD MB, beyond that the new
+ * ones are dropped (the capture counts their samples as lost); a data
+ * path or write policy change is queued as well, to apply in order
+ * with the records
+ */
+#define GMT_STORE_BACKLOG           16384  /* default records, at most  */
+#define GMT_STORE_PAYLOAD           32     /* default MB held, at most  */
+#define GMT_STORE_CHUNK             256    /* initial queue size        */
+#define GMT_STORE_WAIT              200    /* BLOCK, ms per tick, most  */
+
+#define GMT_OVF_DROP_OLDEST         0
+#define GMT_OVF_DROP_NEWEST         1
+#define GMT_OVF_BLOCK               2
+
+#define STORE_SAMPLE                0
+#define STORE_CONFIG                1
+#define STORE_SPECTRUM              2
+#define STORE_CAPTURE               3
+
+typedef struct
+{
+    int            kind;         /* STORE_*                       */
+    int            sensor;       /* index in the sensor list      */
+    time_t         tstamp;       /* time of the sample            */
+    int            mode;         /* GMT_AXIS_*                    */
+    int            storage;      /* GMT_STORE_*                   */
+    int            envelope;     /* extremes and sdev are valid   */
+    unsigned long  nsmpl;        /* raw samples in the record     */
+    double         v[GMT_AXES];  /* _FLOAT: the values, in Ga     */
+    double         vmin[GMT_AXES];
+    double         vmax[GMT_AXES];
+    double         sd[GMT_AXES];
+    int            ival[GMT_AXES];  /* _INT: the values, in units */
+    int            imin[GMT_AXES];
+    int            imax[GMT_AXES];
+    char          *path;         /* CONFIG: data path, or NULL;   */
+                                 /* released after the sink       */
+    int            batch;        /* CONFIG: writer policy         */
+    int            syncMode;
+    int            syncValue;
+    void          *data;         /* SPECTRUM, CAPTURE: taken      */
+                                 /* over, released after the sink */
+    size_t         size;         /* bytes of <data>, for the limit */
+}
+storeRecord;
+
+/* called by the storage thread, for each record in order */
+typedef int  (*storeSink) (void *arg, storeRecord *pr);
+
+typedef struct gmtStore  gmtStore;
+
+/* --- data directory index ---
+ * a manifest of the day files in the data directory (IDX_FILE_NAME),
+ * with a sparse time / offset map per text file; whoever opens it
+ * indexes the files changed since (size, modification time) again,
+ * the daemon at each day change
+ */
+#define IDX_FILE_NAME               ".gmtindex"
+#define IDX_HEADER_ID               "#GIX"
+#define IDX_VERSION                 1
+#define IDX_HEADER_SIZE             16
+#define IDX_NAME_SIZE               40
+#define IDX_HOURS                   24
+
+#define IDX_KIND_DAT                0
+#define IDX_KIND_ESD                1
+#define IDX_KIND_GMZ                2
+
+typedef struct
+{
+    char            name[IDX_NAME_SIZE];  /* file name, no directory */
+    long long       size;        /* file size, bytes            */
+    long long       mtime;       /* modification time           */
+    unsigned short  year;        /* date of the day file        */
+    unsigned char   month;       /* 1..12                       */
+    unsigned char   mday;        /* 1..31                       */
+    unsigned char   kind;        /* IDX_KIND_*                  */
+    unsigned char   linear;      /* _DAT: times ascending, one scale;
+                                    the hour offsets can be used */
+    unsigned char   cols;        /* values per record, 1 or 3   */
+    unsigned char   reserved;
+    int             first;       /* first record, second of the day,
+                                    -1 if none                  */
+    int             last;        /* last record                 */
+    unsigned int    records;
+    double          scale;       /* _DAT: Ga per value unit     */
+    unsigned int    hour[IDX_HOURS];  /* _DAT: offset of the first
+                                    record at or after the hour */
+}
+idxEntry;
+
+/* receives the records of a day file (idxReadDay()); <t> in epoch
+ * seconds, <tod> the second of the day in the file, values in Ga;
+ * returns 0 to go on, or not 0 to stop reading */
+typedef int (*idxSink) (void *arg, time_t t, long tod, const double *pv, int cols);
+
+/* an index in memory, entries sorted by name (gmtidx.c) */
+typedef struct
+{
+    char            path[FILENAME_MAXSIZE];  /* data directory  */
+    int             count;
+    int             alloc;
+    idxEntry       *entry;
+}
+gmtIndex;
+
+/* gmtq binary output; one record per sample, native byte order */
+typedef struct
+{
+    long long       time;        /* epoch seconds               */
+    double          v[GMT_AXES]; /* Ga; NaN if not in the file  */
+}
+gmtqRecord;
+
+/* --- rollup pyramid (.gmr) ---
+ * count, min, max and sum per axis of all records, per minute, 10
+ * minutes, hour and day (UTC); one file per sensor, UTC year and
+ * period, "<data path>/rollup/YYYY_<period>[_<tag>].gmr", a header and
+ * one slot per period of the year, mapped like the binary day files;
+ * the daemon adds each record to all levels as it is written, and
+ * rebuilds the days not marked complete (built) from the day files,
+ * at the start and at each day change; a reader takes the coarsest
+ * level that still has a point per pixel
+ */
+#define GMR_HEADER_ID               "#GMR"
+#define GMR_VERSION                 1
+#define GMR_FILE_EXT                ".gmr"
+#define GMR_DIR                     "rollup"
+#define GMR_HEADER_SIZE             128
+#define GMR_LEVELS                  4
+#define GMR_PERIODS                 { 60, 600, 3600, 86400 }
+#define GMR_FANOUT                  { 1, 10, 6, 24 }   /* children per slot */
+#define GMR_DAYS                    366
+
+typedef struct
+{
+    char            id[4];       /* GMR_HEADER_ID, no '\0'      */
+    unsigned char   version;     /* GMR_VERSION                 */
+    unsigned char   axes;        /* values per record, 1 or 3   */
+    unsigned char   level;       /* 0 .. GMR_LEVELS-1           */
+    unsigned char   reserved1;
+    unsigned short  year;        /* UTC year                    */
+    unsigned short  days;        /* 365 or 366                  */
+    unsigned int    period;      /* seconds per slot            */
+    unsigned int    slots;       /* number of slots             */
+    unsigned int    slotSize;    /* bytes per slot              */
+    unsigned int    hdrSize;     /* offset of slot 0            */
+    unsigned char   built[(GMR_DAYS + 7) / 8];  /* level 0: UTC days
+                                    rebuilt from complete files */
+    unsigned char   reserved[54];
+}
+gmrHeader;
+
+typedef struct
+{
+    unsigned int    count;       /* records, 0 = empty          */
+    float           min[GMT_AXES];
+    float           max[GMT_AXES];
+    unsigned int    reserved;
+    double          sum[GMT_AXES];  /* mean = sum / count       */
+}
+gmrSlot;
+
+/* the rollup files of one sensor and year (gmtroll.c) */
+typedef struct
+{
+    char            path[FILENAME_MAXSIZE];  /* data directory  */
+    char            tag[GMT_NAME_SIZE];
+    int             year;        /* 0 if not open               */
+    int             axes;
+    int             writable;
+    time_t          start;       /* of the year, epoch seconds  */
+    int             fd[GMR_LEVELS];
+    size_t          size[GMR_LEVELS];
+    gmrHeader      *hdr[GMR_LEVELS];   /* mapping, or NULL      */
+    gmrSlot        *slot[GMR_LEVELS];
+}
+gmtRollup;
+
+/* one slot of a rollup query, see rollQuery(); returns 0 to go on */
+typedef struct
+{
+    time_t          time;        /* start of the slot           */
+    int             period;      /* its length, seconds         */
+    int             axes;
+    unsigned int    count;
+    double          mean[GMT_AXES];
+    double          min[GMT_AXES];
+    double          max[GMT_AXES];
+}
+gmrRow;
+
+typedef int (*gmrSink) (void *arg, const gmrRow *pr);
+
+/* -------- record averaging and storage --------
+ * (gmtsave.c) the averages of the raw values, and the record files of
+ * one sensor; shared by the daemon and the benchmarks
+ */
+
+/* running sum / extremes of raw sensor values over one interval */
+typedef struct
+{
+    long            n;           /* number of values            */
+    long long       sum[GMT_AXES];  /* exact, for any interval  */
+    short           min[GMT_AXES];
+    short           max[GMT_AXES];
+}
+rawAccum;
+
+/* the files of one sensor; text and binary day files, and the rollup;
+ * used by the storage thread only */
+typedef struct
+{
+    gmtWriter       writer;      /* text day files              */
+    esdFile         esd;         /* binary day file, if open    */
+    int             eday;        /* day of the binary file      */
+    int             eerr;        /* its error reported          */
+    int             eunsynced;   /* its records since last sync */
+    time_t          elastSync;   /* monotonic time of last sync */
+    char            epath[FILENAME_MAXSIZE];  /* its directory  */
+    int             iday;        /* day of the last rollup update */
+    gmtRollup       roll;        /* rollup files of the year    */
+    int             hdrFmt;      /* format of the last text header */
+    char            path[FILENAME_MAXSIZE];   /* data directory */
+    char            tag[GMT_NAME_SIZE];       /* file name tag  */
+    int             period;      /* record period, s            */
+    double          fullScale;   /* configured fullscale value  */
+    int             dtype;       /* ELFD_DTYPE_FLOAT / _INT     */
+    double          unit;        /* _INT: Ga per integer unit   */
+}
+gmtSaver;
+
 /* -------- UDP network settings --------
  */
 #define GMT_UDP_PORTBASE            10000
 #define GMT_UDP_PORTOFFSET_SEC      2
 #define GMT_UDP_PORTOFFSET_MH       3
+#define GMT_UDP_PORTOFFSET_ALERT    6
 #define GMT_UDP_DATA_SECONDS        (GMT_UDP_PORTBASE + GMT_UDP_PORTOFFSET_SEC)
 #define GMT_UDP_DATA_MIN_HOURS      (GMT_UDP_PORTBASE + GMT_UDP_PORTOFFSET_MH)
+#define GMT_UDP_ALERTS              (GMT_UDP_PORTBASE + GMT_UDP_PORTOFFSET_ALERT)
 
 #define GMT_DEFAULT_IP              "127.0.0.1"      /* default to local host */
+
+/* live data packets; one aggregate per packet, all integer fields in
+ * network byte order, floats as IEEE-754 bit patterns in network order;
+ * the values are floats, or integer units (ELFD_DTYPE_INT) to be
+ * multiplied by the packet scale;
+ * the sequence number counts per packet type, so a receiver can detect
+ * lost packets on each stream;
+ * seconds packets go to GMT_UDP_DATA_SECONDS, minute and hour packets
+ * to GMT_UDP_DATA_MIN_HOURS, relative to each target's port base;
+ * storm alerts (GMT_PCK_ALERT) go to GMT_UDP_ALERTS, with the time of
+ * the record, <count> the active alarm bits (STORM_BIT_*), reserved[0]
+ * set if alarms were raised, reserved[1] if cleared, mean / min the
+ * dB/dt (nT/min) and the baseline deviation (nT) of X, Y, Z, and max
+ * those of F, and F itself (Ga); all floats
+ */
+#define GMT_PCK_ID                  "GMTP"
+#define GMT_PCK_VERSION             2
+#define GMT_PCK_SECOND              1
+#define GMT_PCK_MINUTE              2
+#define GMT_PCK_HOUR                3
+#define GMT_PCK_ALERT               4
+#define GMT_PCK_TYPES               5
+
+#define GMT_UDP_MAX_TARGETS         32
+#define GMT_UDP_MAX_QUEUE           8      /* packets per send batch */
+
+typedef struct
+{
+    char            id[4];       /* GMT_PCK_ID, no '\0'         */
+    unsigned char   version;     /* GMT_PCK_VERSION             */
+    unsigned char   type;        /* GMT_PCK_SECOND / _MINUTE .. */
+    unsigned short  station;     /* sender station id           */
+    unsigned int    seq;         /* sequence number, per type   */
+    unsigned int    tsec;        /* interval start, epoch secs  */
+    unsigned short  tmsec;       /* interval start, millisecs   */
+    unsigned short  period;      /* interval length, seconds    */
+    unsigned int    count;       /* samples in the interval     */
+    unsigned char   dtype;       /* ELFD_DTYPE_FLOAT / _INT     */
+    unsigned char   reserved[3];
+    unsigned int    scale;       /* _INT: float bits, Ga / unit */
+    unsigned int    mean[GMT_AXES];  /* float bits / int, per axis */
+    unsigned int    min[GMT_AXES];
+    unsigned int    max[GMT_AXES];
+}
+gmtPacket;
+
+/* UDP live data publisher (gmtudp.c) */
+typedef struct gmtPublisher  gmtPublisher;
+
+/* -------- TCP query server --------
+ * line based requests, one at a time per connection:
+ *   RANGE <start> <end> [<step> [<axes>]]
+ *      aggregated (mean) values of [start, end), epoch seconds, one line
+ *      per <step> seconds (default 60), for the given axes ("XYZ");
+ *      answer "OK <lines>", followed by "<time>, <value>, ..." lines;
+ *      at most QRY_MAX_SPAN long, longer spans are read with ROLLUP;
+ *      before the history, the day files are averaged per minute, so
+ *      <step> must be whole minutes there, and <start> is taken from
+ *      the start of its minute
+ *   DAY <YYYY_MM_DD> [DAT | ESD | GMZ]
+ *      the stored day file as is; answer "OK <bytes>", followed by
+ *      the file content; GMZ is the archive form of a compacted day
+ *   ROLLUP <start> <end> <points>
+ *      the rollup slots of [start, end) at the level for a plot <points>
+ *      wide (see GMR_PERIODS); answer "OK <lines> <period>", followed by
+ *      "<time>, <count>, <mean>, <min>, <max>" lines, the last three
+ *      for each axis
+ * errors are answered with "ERR <reason>"
+ */
+#define GMT_TCP_PORTOFFSET_QRY      4
+#define GMT_TCP_QUERY               (GMT_UDP_PORTBASE + GMT_TCP_PORTOFFSET_QRY)
+
+#define QRY_MAX_CLIENTS             32
+#define QRY_LINE_MAX                256
+#define QRY_CACHE_DAYS              16     /* decoded day blocks (LRU) */
+#define QRY_MAX_LINES               (MINS_PER_DAY * 31)  /* per answer */
+#define QRY_MAX_SPAN                (24 * 3600 * 31)     /* s per RANGE */
+
+typedef struct gmtQueryServer  gmtQueryServer;
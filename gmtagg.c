@@ -0,0 +1,715 @@
+/***************************************************************************
+ *                           gmtagg.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the aggregator, collecting the live
+ *      data of many stations into per-station day files, and a sender
+ *      of simulated stations to try it with
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#define _GNU_SOURCE     /* recvmmsg() */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "gmt.h"
+
+#define AGG_PATH            "./aggData"
+#define AGG_SEC_TAG         "sec"      /* seconds stream file tag       */
+#define AGG_DELAY           5          /* s a record waits for others   */
+#define AGG_WINDOW          64         /* records held per stream       */
+#define AGG_BATCH           60         /* records per write             */
+#define AGG_FLUSH           10         /* s between writes, at most     */
+#define AGG_RX_BATCH        64         /* datagrams per receive call    */
+#define AGG_RCVBUF          (4 << 20)  /* socket receive buffer         */
+#define AGG_STATIONS        65536      /* station ids                   */
+#define AGG_SOCKETS         3          /* seconds, minutes, alerts      */
+
+#define AGG_STREAM_SEC      0          /* GMT_PCK_SECOND records        */
+#define AGG_STREAM_MIN      1          /* GMT_PCK_MINUTE records        */
+#define AGG_STREAMS         2
+
+/* one record, as received; <t> is aligned to its period
+ */
+typedef struct
+{
+    long long       t;             /* period start, epoch seconds */
+    time_t          arrived;       /* monotonic seconds           */
+    unsigned short  period;
+    unsigned char   dtype;         /* ELFD_DTYPE_FLOAT / _INT     */
+    float           scale;         /* _INT: Ga per unit           */
+    float           fval[GMT_AXES];
+    int             ival[GMT_AXES];
+}
+aggRecord;
+
+/*  The records of a stream wait in <pend>, sorted by time, until they
+ *  are AGG_DELAY seconds old, or the window is full; then they go to the
+ *  writer in order. A record of a time already pending, or not after the
+ *  last one written, is a duplicate, or too late, and dropped.
+ */
+typedef struct
+{
+    gmtWriter       writer;        /* day files of the stream     */
+    long long       last;          /* last time written, or 0     */
+    int             hdrPeriod;     /* format of the file header   */
+    int             hdrDtype;
+    float           hdrScale;
+    unsigned int    nextSeq;       /* expected sequence number    */
+    int             seqValid;
+    int             n;             /* records pending             */
+    aggRecord       pend[AGG_WINDOW];
+}
+aggStream;
+
+typedef struct
+{
+    unsigned short  station;
+    aggStream       s[AGG_STREAMS];
+    unsigned int    alertTime;     /* last alert, for duplicates  */
+    unsigned int    alertBits;
+}
+aggStation;
+
+/* --- prototypes ----
+ */
+extern int           writerInit  (gmtWriter *pw, const char *path, const char *tag, int batch,
+                                  int syncMode, int syncValue);
+extern int           writerDay   (gmtWriter *pw, struct tm *ptime);
+extern int           writerPut   (gmtWriter *pw, const char *text, int isRecord);
+extern int           writerFlush (gmtWriter *pw);
+extern void          writerClose (gmtWriter *pw);
+extern void          gmtMkDir    (const char *path);
+extern gmtPublisher *udpCreate   (const char *targets, int station);
+extern void          udpDestroy  (gmtPublisher *pp);
+extern void          udpQueue    (gmtPublisher *pp, int type, const struct timespec *ts, int period,
+                                  unsigned long count, const double *pmean, const double *pmin,
+                                  const double *pmax);
+extern void          udpQueueInt (gmtPublisher *pp, int type, const struct timespec *ts, int period,
+                                  unsigned long count, const int *pmean, const int *pmin,
+                                  const int *pmax, double scale);
+extern int           udpFlush    (gmtPublisher *pp);
+
+static int          aggSocket  (int port);
+static void         aggReceive (int sock, time_t now);
+static void         aggPacket  (const gmtPacket *pk, time_t now);
+static aggStation  *aggGet     (unsigned short station);
+static void         aggInsert  (aggStation *ps, int k, const aggRecord *pr);
+static void         aggRelease (aggStation *ps, int k, time_t now, int all);
+static void         aggWrite   (aggStation *ps, int k, const aggRecord *pr);
+static void         aggAlert   (aggStation *ps, const gmtPacket *pk);
+static float        floatValue (unsigned int bits);
+static int          aggSend    (const char *target, int stations, int seconds, int speed);
+static time_t       monoSeconds (void);
+static void         onSignal   (int sig);
+
+static volatile sig_atomic_t  aExit;
+static aggStation   *aStation[AGG_STATIONS];
+static unsigned short aList[AGG_STATIONS];  /* ids of the stations seen */
+static int           aCount;
+static const char   *aPath  = AGG_PATH;
+static int           aDelay = AGG_DELAY;
+static int           aBatch = AGG_BATCH;
+
+/* counters, for the summary */
+static unsigned long  aPackets, aInvalid, aWritten, aDups, aLate, aLost, aHours, aAlerts;
+
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* usage: gmtagg [-b <port base>] [-d <delay>] [-w <batch>] [-p <path>]
+ *        gmtagg -s <stations> [-n <seconds>] [-r <speed>] [-t <host[:portbase]>]
+ * receives the live data of any number of stations, seconds, minutes
+ * and alerts at the ports of <port base> (GMT_UDP_PORTBASE), and writes
+ * the seconds to <path>/<station>/YYYY_MM_DD_sec.dat, the minutes (or
+ * longer records) to <path>/<station>/YYYY_MM_DD.dat, text day files as
+ * the sampler writes them, so gmtq and gmtpack read them as well; the
+ * records are put in order and duplicates dropped, waiting <delay>
+ * seconds for late ones; <batch> records of a stream go with one write;
+ * hour packets are counted only, alerts are shown;
+ * with -s, sends the data of <stations> simulated stations instead, for
+ * the last <seconds> (one hour), <speed> times faster than real time,
+ * with a few duplicates and swapped packets, to the local aggregator
+ * or <host>
+ */
+int  main (int argc, char **argv)
+{
+    struct pollfd  pfd[AGG_SOCKETS];
+    const char    *target = GMT_DEFAULT_IP;
+    time_t         now, tick, flushed;
+    int            opt, i, k, stations = 0, seconds = 3600, speed = 1;
+    int            base = GMT_UDP_PORTBASE;
+
+    while ((opt = getopt (argc, argv, "b:d:n:p:r:s:t:w:")) != -1)
+    {
+        switch (opt)
+        {
+          case 'b':  base = atoi (optarg);      break;
+          case 'd':  aDelay = atoi (optarg);    break;
+          case 'n':  seconds = atoi (optarg);   break;
+          case 'p':  aPath = optarg;            break;
+          case 'r':  speed = atoi (optarg);     break;
+          case 's':  stations = atoi (optarg);  break;
+          case 't':  target = optarg;           break;
+          case 'w':  aBatch = atoi (optarg);    break;
+          default:   argc = 0;                  break;
+        }
+    }
+    if ((argc != optind) || (base <= 0) || (base > 65535 - GMT_UDP_PORTOFFSET_ALERT) ||
+        (aDelay < 0) || (aBatch <= 0) || (stations < 0) || (stations >= AGG_STATIONS) ||
+        (seconds <= 0) || (speed <= 0))
+    {
+        fprintf (stderr, "usage: %s [-b <port base>] [-d <delay>] [-w <batch>] [-p <path>]\n"
+                         "       %s -s <stations> [-n <seconds>] [-r <speed>] [-t <host[:portbase]>]\n",
+                         argv[0], argv[0]);
+        return 1;
+    }
+    if (stations)
+        return aggSend (target, stations, seconds, speed);
+
+    if (((pfd[0].fd = aggSocket (base + GMT_UDP_PORTOFFSET_SEC)) < 0) ||
+        ((pfd[1].fd = aggSocket (base + GMT_UDP_PORTOFFSET_MH)) < 0) ||
+        ((pfd[2].fd = aggSocket (base + GMT_UDP_PORTOFFSET_ALERT)) < 0))
+        return 2;
+    for (i=0; i<AGG_SOCKETS; i++)
+        pfd[i].events = POLLIN;
+
+    /* two day files open per station */
+    {
+        struct rlimit  rl;
+
+        if ((getrlimit (RLIMIT_NOFILE, &rl) == 0) && (rl.rlim_cur < rl.rlim_max))
+        {
+            rl.rlim_cur = rl.rlim_max;
+            setrlimit (RLIMIT_NOFILE, &rl);
+        }
+    }
+    gmtMkDir (aPath);
+    signal (SIGINT,  onSignal);
+    signal (SIGTERM, onSignal);
+
+    tick = flushed = monoSeconds ();
+    while (!aExit)
+    {
+        if ((poll (pfd, AGG_SOCKETS, 1000) < 0) && (errno != EINTR))
+        {
+            perror ("poll");
+            break;
+        }
+        now = monoSeconds ();
+        for (i=0; i<AGG_SOCKETS; i++)
+            if (pfd[i].revents & POLLIN)
+                aggReceive (pfd[i].fd, now);
+
+        /* the records due, once a second; the buffers now and then */
+        if (now == tick)
+            continue;
+        tick = now;
+        for (i=0; i<aCount; i++)
+            for (k=0; k<AGG_STREAMS; k++)
+                aggRelease (aStation[aList[i]], k, now, 0);
+        if (now - flushed >= AGG_FLUSH)
+        {
+            flushed = now;
+            for (i=0; i<aCount; i++)
+                for (k=0; k<AGG_STREAMS; k++)
+                    writerFlush (&aStation[aList[i]]->s[k].writer);
+        }
+    }
+
+    for (i=0; i<aCount; i++)
+    {
+        for (k=0; k<AGG_STREAMS; k++)
+        {
+            aggRelease (aStation[aList[i]], k, 0, 1);
+            writerClose (&aStation[aList[i]]->s[k].writer);
+        }
+        free (aStation[aList[i]]);
+    }
+    for (i=0; i<AGG_SOCKETS; i++)
+        close (pfd[i].fd);
+
+    printf ("%d stations, %lu packets, %lu records written, %lu duplicates, %lu late, %lu lost, "
+            "%lu hours, %lu alerts, %lu invalid\n", aCount, aPackets, aWritten, aDups, aLate, aLost,
+            aHours, aAlerts, aInvalid);
+    return 0;
+}
+
+
+
+/* open a UDP socket on <port>, any address, with a large receive buffer
+ * returns the socket, or -1 on error
+ */
+static int  aggSocket (int port)
+{
+    struct sockaddr_in  sa;
+    int                 sock, size = AGG_RCVBUF;
+
+    if ((sock = socket (AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
+    {
+        perror ("socket");
+        return -1;
+    }
+    setsockopt (sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof (size));
+
+    memset (&sa, 0, sizeof (sa));
+    sa.sin_family      = AF_INET;
+    sa.sin_addr.s_addr = htonl (INADDR_ANY);
+    sa.sin_port        = htons ((unsigned short) port);
+    if (bind (sock, (struct sockaddr *) &sa, sizeof (sa)) != 0)
+    {
+        fprintf (stderr, "port %d: %s\n", port, strerror (errno));
+        close (sock);
+        return -1;
+    }
+    return sock;
+}
+
+
+
+/* receive all datagrams waiting on <sock>, AGG_RX_BATCH per call
+ */
+static void  aggReceive (int sock, time_t now)
+{
+    struct mmsghdr  msgs[AGG_RX_BATCH];
+    struct iovec    iov[AGG_RX_BATCH];
+    gmtPacket       pks[AGG_RX_BATCH];
+    int             i, n;
+
+    for (i=0; i<AGG_RX_BATCH; i++)
+    {
+        iov[i].iov_base = &pks[i];
+        iov[i].iov_len  = sizeof (gmtPacket);
+    }
+
+    do
+    {
+        for (i=0; i<AGG_RX_BATCH; i++)
+        {
+            memset (&msgs[i], 0, sizeof (struct mmsghdr));
+            msgs[i].msg_hdr.msg_iov    = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        if ((n = recvmmsg (sock, msgs, AGG_RX_BATCH, MSG_DONTWAIT, NULL)) <= 0)
+            break;
+
+        for (i=0; i<n; i++)
+        {
+            aPackets++;
+            if ((msgs[i].msg_len != sizeof (gmtPacket)) || (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ||
+                memcmp (pks[i].id, GMT_PCK_ID, 4) || (pks[i].version != GMT_PCK_VERSION))
+                aInvalid++;
+            else
+                aggPacket (&pks[i], now);
+        }
+    } while (n == AGG_RX_BATCH);
+}
+
+
+
+/* take one packet; records go to the stream of their station
+ */
+static void  aggPacket (const gmtPacket *pk, time_t now)
+{
+    aggStation    *ps;
+    aggStream     *pst;
+    aggRecord      rec;
+    unsigned int   seq;
+    long long      ms;
+    int            i, k;
+
+    switch (pk->type)
+    {
+      case GMT_PCK_SECOND:  k = AGG_STREAM_SEC;  break;
+      case GMT_PCK_MINUTE:  k = AGG_STREAM_MIN;  break;
+      case GMT_PCK_HOUR:    aHours++;            return;
+      case GMT_PCK_ALERT:   k = -1;              break;
+      default:              aInvalid++;          return;
+    }
+    if (!(ps = aggGet (ntohs (pk->station))))
+        return;
+    if (k < 0)
+    {
+        aggAlert (ps, pk);
+        return;
+    }
+
+    /* gaps of the sequence are lost packets; a number far back is a
+     * restart of the station */
+    pst = &ps->s[k];
+    seq = ntohl (pk->seq);
+    if (pst->seqValid && (seq - pst->nextSeq < 0x80000000U))
+        aLost += seq - pst->nextSeq;
+    if (!pst->seqValid || (seq - pst->nextSeq < 0x80000000U) || (pst->nextSeq - seq > AGG_WINDOW))
+        pst->nextSeq = seq + 1;
+    pst->seqValid = 1;
+
+    memset (&rec, 0, sizeof (rec));
+    rec.period  = ntohs (pk->period);
+    rec.dtype   = pk->dtype;
+    rec.arrived = now;
+    if (rec.period == 0)
+    {
+        aInvalid++;
+        return;
+    }
+    /* the start of the period nearest to the packet time */
+    ms    = (long long) ntohl (pk->tsec) * 1000 + ntohs (pk->tmsec) + rec.period * 500LL;
+    rec.t = ms / (rec.period * 1000LL) * rec.period;
+    if (rec.dtype == ELFD_DTYPE_INT)
+    {
+        rec.scale = floatValue (pk->scale);
+        for (i=0; i<GMT_AXES; i++)
+            rec.ival[i] = (int) ntohl (pk->mean[i]);
+    }
+    else
+        for (i=0; i<GMT_AXES; i++)
+            rec.fval[i] = floatValue (pk->mean[i]);
+    aggInsert (ps, k, &rec);
+}
+
+
+
+/* the station of id <station>, set up when first seen
+ * returns NULL on memory shortage
+ */
+static aggStation  *aggGet (unsigned short station)
+{
+    aggStation  *ps;
+    char         dir[FILENAME_MAXSIZE];
+    int          k;
+
+    if ((ps = aStation[station]))
+        return ps;
+    if (!(ps = calloc (1, sizeof (aggStation))))
+        return NULL;
+
+    snprintf (dir, sizeof (dir), "%s/%u", aPath, station);
+    ps->station = station;
+    for (k=0; k<AGG_STREAMS; k++)
+    {
+        if (writerInit (&ps->s[k].writer, dir, (k == AGG_STREAM_SEC) ? AGG_SEC_TAG : NULL, aBatch,
+                        GMT_SYNC_NONE, 0) != 0)
+        {
+            while (k-- > 0)
+                writerClose (&ps->s[k].writer);
+            free (ps);
+            return NULL;
+        }
+        ps->s[k].hdrPeriod = -1;
+    }
+    aStation[station] = ps;
+    aList[aCount++]   = station;
+    printf ("station %u: first data\n", station);
+    fflush (stdout);
+    return ps;
+}
+
+
+
+/* put a record into the window of stream <k>, in time order; if the
+ * window is full, the oldest record is written first
+ */
+static void  aggInsert (aggStation *ps, int k, const aggRecord *pr)
+{
+    aggStream  *pst = &ps->s[k];
+    int         i;
+
+    if (pr->t <= pst->last)
+    {
+        aLate++;
+        return;
+    }
+
+    /* mostly in order, so looked for from the end */
+    for (i=pst->n; (i > 0) && (pst->pend[i-1].t >= pr->t); i--)
+        ;
+    if ((i < pst->n) && (pst->pend[i].t == pr->t))
+    {
+        aDups++;
+        return;
+    }
+
+    if (pst->n == AGG_WINDOW)
+    {
+        if (i == 0)
+        {
+            /* older than all the window, so it goes first */
+            aggWrite (ps, k, pr);
+            return;
+        }
+        aggWrite (ps, k, &pst->pend[0]);
+        memmove (&pst->pend[0], &pst->pend[1], (AGG_WINDOW - 1) * sizeof (aggRecord));
+        pst->n--;
+        i--;
+    }
+    memmove (&pst->pend[i+1], &pst->pend[i], (pst->n - i) * sizeof (aggRecord));
+    pst->pend[i] = *pr;
+    pst->n++;
+}
+
+
+
+/* write the records of stream <k> that waited long enough, oldest
+ * first, or <all> of them
+ */
+static void  aggRelease (aggStation *ps, int k, time_t now, int all)
+{
+    aggStream  *pst = &ps->s[k];
+    int         i;
+
+    for (i=0; (i < pst->n) && (all || (now - pst->pend[i].arrived >= aDelay)); i++)
+        aggWrite (ps, k, &pst->pend[i]);
+    if (i == 0)
+        return;
+    memmove (&pst->pend[0], &pst->pend[i], (pst->n - i) * sizeof (aggRecord));
+    pst->n -= i;
+}
+
+
+
+/* append one record to the day file of its stream, with a header for
+ * a new file, or when the format of the station changed
+ */
+static void  aggWrite (aggStation *ps, int k, const aggRecord *pr)
+{
+    aggStream   *pst = &ps->s[k];
+    char         fbuf[256];
+    struct tm    tm;
+    time_t       t;
+    int          rv, n, sec;
+
+    pst->last = pr->t;
+    t   = (time_t) pr->t;
+    sec = (pr->period < 60);
+    localtime_r (&t, &tm);
+    if ((rv = writerDay (&pst->writer, &tm)) < 0)
+        return;
+
+    if ((rv > 0) || (pst->hdrPeriod != pr->period) || (pst->hdrDtype != pr->dtype) ||
+        ((pr->dtype == ELFD_DTYPE_INT) && (pst->hdrScale != pr->scale)))
+    {
+        pst->hdrPeriod = pr->period;
+        pst->hdrDtype  = pr->dtype;
+        pst->hdrScale  = pr->scale;
+        if (pr->period == 60)
+            sprintf (fbuf, "# -- geomagnetism data, per minute --\n");
+        else
+            sprintf (fbuf, "# -- geomagnetism data, per %d seconds --\n", pr->period);
+        writerPut (&pst->writer, fbuf, 0);
+        sprintf (fbuf, "# station : %u\n", ps->station);
+        writerPut (&pst->writer, fbuf, 0);
+        sprintf (fbuf, "# start time : %02d.%02d.%4d, %02d:%02d\n", tm.tm_mon+1, tm.tm_mday,
+                 tm.tm_year + 1900, tm.tm_hour, tm.tm_min);
+        writerPut (&pst->writer, fbuf, 0);
+        sprintf (fbuf, "# format :\n# %s, X_data, Y_data, Z_data\n", sec ? "HH:MM:SS" : "HH:MM");
+        writerPut (&pst->writer, fbuf, 0);
+        if (pr->dtype == ELFD_DTYPE_INT)
+        {
+            sprintf (fbuf, "# scale value = %.9e Ga per unit\n", pr->scale);
+            writerPut (&pst->writer, fbuf, 0);
+        }
+    }
+
+    n = sprintf (fbuf, "%02d:%02d", tm.tm_hour, tm.tm_min);
+    if (sec)
+        n += sprintf (fbuf + n, ":%02d", tm.tm_sec);
+    if (pr->dtype == ELFD_DTYPE_INT)
+        sprintf (fbuf + n, ", %d, %d, %d\n", pr->ival[DI_X], pr->ival[DI_Y], pr->ival[DI_Z]);
+    else
+        sprintf (fbuf + n, ", %.6lf, %.6lf, %.6lf\n", pr->fval[DI_X], pr->fval[DI_Y], pr->fval[DI_Z]);
+    if (writerPut (&pst->writer, fbuf, 1) == 0)
+        aWritten++;
+}
+
+
+
+/* show a storm alert; the senders of several targets may deliver it
+ * more than once
+ */
+static void  aggAlert (aggStation *ps, const gmtPacket *pk)
+{
+    unsigned int  tsec = ntohl (pk->tsec), bits = ntohl (pk->count);
+    char          tbuf[32];
+    struct tm     tm;
+    time_t        t;
+
+    if ((tsec == ps->alertTime) && (bits == ps->alertBits))
+    {
+        aDups++;
+        return;
+    }
+    ps->alertTime = tsec;
+    ps->alertBits = bits;
+    aAlerts++;
+
+    t = (time_t) tsec;
+    localtime_r (&t, &tm);
+    strftime (tbuf, sizeof (tbuf), "%Y-%m-%d %H:%M:%S", &tm);
+    printf ("station %u: %s alarm %s, bits 0x%02x, dB/dt %.1lf nT/min, deviation %.1lf nT\n",
+            ps->station, tbuf, pk->reserved[0] ? "raised" : (pk->reserved[1] ? "cleared" : "changed"),
+            bits, floatValue (pk->max[0]), floatValue (pk->max[1]));
+    fflush (stdout);
+}
+
+
+
+/* the float of a bit pattern in network byte order
+ */
+static float  floatValue (unsigned int bits)
+{
+    unsigned int  u = ntohl (bits);
+    float         f;
+
+    memcpy (&f, &u, sizeof (f));
+    return f;
+}
+
+
+
+/* send the seconds and minutes of <stations> simulated stations (ids
+ * 1 to <stations>), for the last <seconds>, <speed> seconds of data
+ * per second; the odd stations send integer units; every 97th packet
+ * of a station goes twice, and every 61st one after its successor
+ * returns 0, or 2 if no sender could be set up
+ */
+static int  aggSend (const char *target, int stations, int seconds, int speed)
+{
+    gmtPublisher    **pub;
+    struct timespec   ts, t0, tn;
+    double            v[GMT_AXES];
+    int               iv[GMT_AXES];
+    long long         sent = 0, step;
+    time_t            start, t, tt;
+    int               s, i, k, n;
+
+    if (!(pub = calloc (stations, sizeof (gmtPublisher *))))
+        return 2;
+    for (s=0; s<stations; s++)
+        if (!(pub[s] = udpCreate (target, s + 1)))
+        {
+            fprintf (stderr, "no sender for %s\n", target);
+            return 2;
+        }
+
+    start = time (NULL) - seconds;
+    start -= start % 60;
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    for (step=0; (step < seconds) && !aExit; step++)
+    {
+        t = start + step;
+        for (s=0; s<stations; s++)
+        {
+            /* the times to send now; a swapped one is late by a second */
+            time_t  times[3];
+
+            n = 0;
+            if ((t + s) % 61 != 0)
+                times[n++] = t;
+            if ((step > 0) && ((t - 1 + s) % 61 == 0))
+                times[n++] = t - 1;
+            if ((t + s) % 97 == 0)
+                times[n++] = t;
+
+            for (i=0; i<n; i++)
+            {
+                tt = times[i];
+                ts.tv_sec  = tt;
+                ts.tv_nsec = 0;
+                for (k=0; k<GMT_AXES; k++)
+                {
+                    v[k]  = 0.2 * (k + 1) + 1e-4 * sin (2.0 * M_PI * tt / 600.0 + s + k);
+                    iv[k] = (int) lround (v[k] * 1e7);
+                }
+                if (s & 1)
+                    udpQueueInt (pub[s], GMT_PCK_SECOND, &ts, 1, 220, iv, NULL, NULL, 1e-7);
+                else
+                    udpQueue (pub[s], GMT_PCK_SECOND, &ts, 1, 220, v, NULL, NULL);
+                sent++;
+            }
+
+            /* minute complete; the values of its middle */
+            if ((t + 1) % 60 == 0)
+            {
+                ts.tv_sec = t - 59;
+                for (k=0; k<GMT_AXES; k++)
+                {
+                    v[k]  = 0.2 * (k + 1) + 1e-4 * sin (2.0 * M_PI * (t - 29) / 600.0 + s + k);
+                    iv[k] = (int) lround (v[k] * 1e7);
+                }
+                if (s & 1)
+                    udpQueueInt (pub[s], GMT_PCK_MINUTE, &ts, 60, 13200, iv, NULL, NULL, 1e-7);
+                else
+                    udpQueue (pub[s], GMT_PCK_MINUTE, &ts, 60, 13200, v, NULL, NULL);
+                sent++;
+            }
+            udpFlush (pub[s]);
+        }
+
+        /* paced by the start, so the rate does not drift */
+        tn = t0;
+        tn.tv_sec  += (step + 1) / speed;
+        tn.tv_nsec += (long) ((step + 1) % speed * 1000000000LL / speed);
+        if (tn.tv_nsec >= 1000000000L)
+        {
+            tn.tv_sec++;
+            tn.tv_nsec -= 1000000000L;
+        }
+        clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &tn, NULL);
+    }
+
+    for (s=0; s<stations; s++)
+        udpDestroy (pub[s]);
+    free (pub);
+    printf ("%d stations, %lld packets sent\n", stations, sent);
+    return 0;
+}
+
+
+
+/* seconds of the monotonic clock
+ */
+static time_t  monoSeconds (void)
+{
+    struct timespec  ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+
+
+/* SIGINT / SIGTERM: finish the records pending, and stop
+ */
+static void  onSignal (int sig)
+{
+    (void) sig;
+    aExit = 1;
+}
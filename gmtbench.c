@@ -0,0 +1,941 @@
+/***************************************************************************
+ *                           gmtbench.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the benchmarks, micro benchmarks
+ *      of the single pipeline stages, and an unthrottled end-to-end
+ *      run from a simulated sensor to the day files
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define _GMT_DATA_      /* declare const tables here */
+#include "gmt.h"
+
+/* minimal run time of one benchmark, and of the end-to-end run */
+#define BENCH_MIN_NS         200000000L
+#define BENCH_E2E_SAMPLES    2000000L
+#define BENCH_BURSTS         64        /* samples per decode call */
+
+/* one benchmark; <fn> does <n> operations
+ */
+typedef struct
+{
+    const char  *name;
+    void       (*fn) (long n);
+}
+benchItem;
+
+/* --- prototypes ----
+ */
+extern const gmtDriver *drvGet    (int device);
+extern int           devOpen      (gmtDevice *pd, const gmtDriver *drv, int ifh, int addr, int rate);
+extern int           devRead      (gmtDevice *pd, magnBuffer *pm);
+extern int           cfgLoad      (cfgTable *pct, const char *name);
+extern const char   *cfgGetStr    (cfgTable *pct, const char *key);
+extern int           cfgGetInt    (cfgTable *pct, const char *key, int *pvalue);
+extern int           saveInit     (gmtSaver *ps, const char *path, const char *tag, int period,
+                                   double fullScale, int dtype, double unit, int batch,
+                                   int syncMode, int syncValue);
+extern int           saveRecord   (gmtSaver *ps, const storeRecord *pr);
+extern void          saveClose    (gmtSaver *ps);
+extern void          accAdd       (rawAccum *pa, const magnBuffer *pm);
+extern void          accAddN      (rawAccum *pa, const magnBuffer *pm, int n);
+extern void          accResult    (rawAccum *pa, double scale, double *pmean, double *pmin,
+                                   double *pmax);
+extern void          accResultInt (rawAccum *pa, int *pmean, int *pmin, int *pmax);
+extern void          accMean      (const gmtDriver *pd, const magnBuffer *pm, int n, double scale,
+                                   double *pmean, double *pmin, double *pmax);
+extern gmtStore     *storeCreate  (unsigned long limit, int payload, int policy, storeSink fn,
+                                   void *arg, gmtMetrics *pm);
+extern void          storeDestroy (gmtStore *ps);
+extern int           storePut     (gmtStore *ps, const storeRecord *pr);
+extern int           rollUpdate   (gmtRollup *pr, const char *path, const char *tag, int axes, time_t t);
+extern int           rollAdd      (gmtRollup *pr, time_t t, const double *pv, int axes);
+extern void          rollClose    (gmtRollup *pr);
+extern gmtCapture   *capCreate    (const char *path, const char *tag, int sensor, int device, int bus,
+                                   int addr, double rate, double fullScale, double scale, int mb,
+                                   int rotate);
+extern void          capDestroy   (gmtCapture *pc);
+extern rawBlock     *capPut       (gmtCapture *pc, const gmtRecord *pr, unsigned long overruns);
+extern rawBlock     *capFlush     (gmtCapture *pc);
+extern int           capWrite     (gmtCapture *pc, const rawBlock *pb);
+extern gmtRing      *ringCreate   (unsigned long count, size_t esize);
+extern void          ringDestroy  (gmtRing *pr);
+extern int           ringPush     (gmtRing *pr, const void *pe);
+extern int           ringPop      (gmtRing *pr, void *pe);
+extern gmtHistory   *histCreate   (int days, int period);
+extern void          histDestroy  (gmtHistory *ph);
+extern int           histAppend   (gmtHistory *ph, time_t t, const double *pv);
+extern unsigned long histQuery    (gmtHistory *ph, time_t from, time_t to, histStats *ps);
+extern gmtDecim     *decimCreate  (int mode, int order, int factor);
+extern void          decimDestroy (gmtDecim *pd);
+extern int           decimPut     (gmtDecim *pd, const magnBuffer *pm);
+extern unsigned long decimResult  (gmtDecim *pd, decimStats *ps);
+extern gmtSpec      *specCreate   (int size, double rate, double scale, int interval, double fmax,
+                                   const char *path, const char *tag);
+extern void          specDestroy  (gmtSpec *ps);
+extern gspRecord    *specPut      (gmtSpec *ps, const struct timespec *pt, const magnBuffer *pm);
+extern int           gmzEncode    (FILE *pi, FILE *po);
+extern int           gmzOpen      (gmzReader *pr, const char *name);
+extern void          gmzClose     (gmzReader *pr);
+extern int           gmzNext      (gmzReader *pr, gmzItem *pi);
+
+static void    benchDecode    (long n);
+static void    benchSimRead   (long n);
+static void    benchAverage   (long n);
+static void    benchAvgInt    (long n);
+static void    benchBoxcar    (long n);
+static void    benchCic       (long n);
+static void    benchSpec      (long n);
+static void    benchConfig    (long n);
+static void    benchSave      (long n, int storage, int period, int dtype, int envelope, int batch);
+static void    benchText1     (long n);
+static void    benchText64    (long n);
+static void    benchTextInt   (long n);
+static void    benchTextEnv   (long n);
+static void    benchBinary    (long n);
+static void    benchRollup    (long n);
+static void    benchStore     (long n);
+static void    benchCapture   (long n);
+static void    benchRing      (long n);
+static void    benchHistory   (long n);
+static void    benchReadText  (long n);
+static void    benchReadGmz   (long n);
+static void    makeDayFiles   (char *ptext, char *pgmz);
+static void    runBench       (const benchItem *pb);
+static void    runEndToEnd    (long samples);
+static void   *e2eSampler     (void *arg);
+static void    makeRecord     (storeRecord *pr, time_t t, int storage, long i);
+static int     saveSink       (void *arg, storeRecord *pr);
+static void    report         (const char *name, long n, long ns, const char *unit);
+static long    nsElapsed      (const struct timespec *ps);
+static void    cleanDir       (void);
+static void    removeTree     (const char *path);
+
+static const benchItem  benches[] =
+{
+    { "decode_scale",  benchDecode  },
+    { "sim_read",      benchSimRead },
+    { "sample_avg",    benchAverage },
+    { "sample_avg_int", benchAvgInt },
+    { "decim_boxcar",  benchBoxcar  },
+    { "decim_cic",     benchCic     },
+    { "spec_welch",    benchSpec    },
+    { "config_load",   benchConfig  },
+    { "write_text",    benchText1   },
+    { "write_text_b64", benchText64 },
+    { "write_text_int", benchTextInt },
+    { "write_text_env", benchTextEnv },
+    { "write_esd",     benchBinary  },
+    { "roll_add",      benchRollup  },
+    { "store_put",     benchStore   },
+    { "cap_write",     benchCapture },
+    { "ring_push_pop", benchRing    },
+    { "hist_append",   benchHistory },
+    { "read_text",     benchReadText },
+    { "read_gmz",      benchReadGmz },
+    { NULL,            NULL         }
+};
+
+static char             benchDir[FILENAME_MAXSIZE];
+static const gmtDriver *simDrv;
+static gmtRing         *e2eRing;
+static atomic_int       e2eDone;
+static volatile double  sink;      /* keeps results alive */
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* usage: gmtbench [<name> ...]
+ * runs all benchmarks, or the named ones ("e2e" = end-to-end);
+ * the results go to stdout, one tab-separated line each:
+ * name, operations, ns per operation, operations per second, unit
+ */
+int  main (int argc, char **argv)
+{
+    const benchItem  *pb;
+    const char       *ptmp;
+    int               i, all;
+
+    if (!(ptmp = getenv ("TMPDIR")))
+        ptmp = "/tmp";
+    snprintf (benchDir, sizeof (benchDir), "%s/gmtbench.XXXXXX", ptmp);
+    if (!mkdtemp (benchDir))
+    {
+        perror (benchDir);
+        return 1;
+    }
+    simDrv = drvGet (GMT_DEVICE_SIM);
+
+    printf ("# name\tops\tns_per_op\tops_per_s\tunit\n");
+    all = (argc < 2);
+    for (pb=benches; pb->name; pb++)
+    {
+        for (i=1; !all && (i<argc); i++)
+            if (strcmp (argv[i], pb->name) == 0)
+                break;
+        if (all || (i < argc))
+            runBench (pb);
+    }
+
+    for (i=1; !all && (i<argc); i++)
+        if (strcmp (argv[i], "e2e") == 0)
+            break;
+    if (all || (i < argc))
+        runEndToEnd (BENCH_E2E_SAMPLES);
+
+    removeTree (benchDir);
+    return 0;
+}
+
+
+
+/* run one benchmark with growing counts, until it
+ * takes long enough to be measured, and print it
+ */
+static void  runBench (const benchItem *pb)
+{
+    struct timespec  t0;
+    long             n, ns;
+
+    for (n=1000; ; n*=4)
+    {
+        cleanDir ();
+        clock_gettime (CLOCK_MONOTONIC, &t0);
+        pb->fn (n);
+        ns = nsElapsed (&t0);
+        if ((ns >= BENCH_MIN_NS) || (n > 1000000000L / 4))
+            break;
+    }
+    report (pb->name, n, ns, "op");
+}
+
+
+
+/* raw register bursts to scaled values; the decode and scale kernels
+ * of the drivers, BENCH_BURSTS samples per call
+ */
+static void  benchDecode (long n)
+{
+    static uchar  raw[BENCH_BURSTS * GMT_BURST_MAX];
+    magnBuffer    mb[BENCH_BURSTS];
+    double        v[BENCH_BURSTS * GMT_AXES];
+    long          i;
+    int           k;
+
+    for (k=0; k<(int) sizeof (raw); k++)
+        raw[k] = (uchar) (k * 37);
+
+    for (i=0; i<n; i+=BENCH_BURSTS)
+    {
+        raw[0] = (uchar) i;
+        simDrv->decode (raw, BENCH_BURSTS, mb);
+        simDrv->scale (mb, BENCH_BURSTS, FS_VALUE_LSM303 / SHORT_MAX_DBL, v);
+        sink += v[0];
+    }
+}
+
+
+
+/* one read of the simulated sensor; register burst, and decode
+ */
+static void  benchSimRead (long n)
+{
+    gmtDevice   dev;
+    magnBuffer  mb;
+    long        i;
+
+    devOpen (&dev, simDrv, -1, 0, 7);
+    for (i=0; i<n; i++)
+    {
+        devRead (&dev, &mb);
+        sink += mb.mgnX;
+    }
+}
+
+
+
+/* the gmSample() work without waits; GMT_AVG_COUNT reads,
+ * scaled at once, with average and extremes
+ */
+static void  benchAverage (long n)
+{
+    gmtDevice   dev;
+    magnBuffer  raw[GMT_AVG_COUNT];
+    double      mean[GMT_AXES], dmin[GMT_AXES], dmax[GMT_AXES];
+    long        i;
+    int         j;
+
+    devOpen (&dev, simDrv, -1, 0, 7);
+    for (i=0; i<n; i++)
+    {
+        for (j=0; j<GMT_AVG_COUNT; j++)
+            devRead (&dev, &raw[j]);
+        accMean (simDrv, raw, GMT_AVG_COUNT, dev.scale, mean, dmin, dmax);
+        sink += mean[DI_X] + dmin[DI_Y] + dmax[DI_Z];
+    }
+}
+
+
+
+/* the gmSample() work of integer records (DATA_TYPE = INT); exact
+ * sums of the raw counts, without scaling
+ */
+static void  benchAvgInt (long n)
+{
+    gmtDevice   dev;
+    magnBuffer  raw[GMT_AVG_COUNT];
+    rawAccum    acc;
+    int         imean[GMT_AXES], imin[GMT_AXES], imax[GMT_AXES];
+    long        i;
+    int         j;
+
+    devOpen (&dev, simDrv, -1, 0, 7);
+    for (i=0; i<n; i++)
+    {
+        for (j=0; j<GMT_AVG_COUNT; j++)
+            devRead (&dev, &raw[j]);
+        acc.n = 0;
+        accAddN (&acc, raw, GMT_AVG_COUNT);
+        accResultInt (&acc, imean, imin, imax);
+        sink += imean[DI_X] + imin[DI_Y] + imax[DI_Z];
+    }
+}
+
+
+
+/* the decimation stage; one raw value in, one record
+ * per 4500 values (a minute at 75Hz)
+ */
+static void  benchDecim (long n, int mode)
+{
+    gmtDecim    *pd;
+    decimStats   ds;
+    magnBuffer   mb;
+    long         i;
+
+    if (!(pd = decimCreate (mode, GMT_CIC_ORDER, GMT_CIC_FACTOR)))
+        return;
+    memset (&mb, 0, sizeof (mb));
+    for (i=0; i<n; i++)
+    {
+        mb.mgnX = (short) (i & 0x7ff);
+        mb.mgnY = (short) -(i & 0x3ff);
+        mb.mgnZ = (short) (i * 7);
+        decimPut (pd, &mb);
+        if ((i % 4500) == 4499)
+            sink += decimResult (pd, &ds);
+    }
+    decimDestroy (pd);
+}
+
+
+
+/* Welch spectra of 2048 samples at 220Hz, per sample; the cost of a
+ * sample at that rate is this times 220 per second
+ */
+static void  benchSpec (long n)
+{
+    gmtSpec          *ps;
+    gspRecord        *pr;
+    magnBuffer        mb;
+    struct timespec   ts;
+    long              i;
+
+    if (!(ps = specCreate (2048, 220.0, 1.0 / 1100.0, 60, 0.0, benchDir, NULL)))
+        return;
+    memset (&mb, 0, sizeof (mb));
+    ts.tv_nsec = 0;
+    for (i=0; i<n; i++)
+    {
+        mb.mgnX = (short) (1000.0 * sin (i * 0.05));
+        mb.mgnY = (short) -(i & 0x3ff);
+        mb.mgnZ = (short) (i * 7);
+        ts.tv_sec = i / 220;
+        if ((pr = specPut (ps, &ts, &mb)))
+        {
+            sink += pr->psd[1];
+            free (pr);
+        }
+    }
+    specDestroy (ps);
+}
+
+
+
+/* boxcar statistics of the raw values
+ */
+static void  benchBoxcar (long n)
+{
+    benchDecim (n, GMT_DECIM_BOXCAR);
+}
+
+
+
+/* CIC decimation, and the boxcar of its output
+ */
+static void  benchCic (long n)
+{
+    benchDecim (n, GMT_DECIM_CIC);
+}
+
+
+
+/* load a config file like gmt.config, and look up its items
+ */
+static void  benchConfig (long n)
+{
+    static const char  *keys[] = { GMT_CFG_DEVICE, GMT_CFG_BUS, GMT_CFG_DATAPATH, GMT_CFG_MODE,
+                                   GMT_CFG_STORAGE, GMT_CFG_ACQMODE, GMT_CFG_RATE, GMT_CFG_BATCH,
+                                   GMT_CFG_SYNCMODE, GMT_CFG_SYNCVALUE, GMT_CFG_HISTORY,
+                                   GMT_CFG_TARGETS, GMT_CFG_STATION, GMT_CFG_QRYPORT,
+                                   GMT_CFG_DRDY, GMT_CFG_DRDYGPIO, NULL };
+    static cfgTable     cfg;
+    char                name[FILENAME_MAXSIZE + 32];
+    FILE               *pf;
+    long                i;
+    int                 k, v;
+
+    snprintf (name, sizeof (name), "%s/gmt.config", benchDir);
+    if (!(pf = fopen (name, "w")))
+        return;
+    fprintf (pf, "# -- config file for the gmt sampler --\n");
+    for (k=0; keys[k]; k++)
+        fprintf (pf, "# comment line, describing the item %s\n%s = %d\n", keys[k], keys[k], k + 1);
+    fclose (pf);
+
+    for (i=0; i<n; i++)
+    {
+        cfgLoad (&cfg, name);
+        for (k=0; keys[k]; k++)
+        {
+            cfgGetStr (&cfg, keys[k]);
+            cfgGetInt (&cfg, keys[k], &v);
+        }
+        sink += v;
+    }
+}
+
+
+
+/* records stored by the daemon's code, the day files and the
+ * rollup; one record per <period> seconds, so the day files change
+ * as in the daemon
+ */
+static void  benchSave (long n, int storage, int period, int dtype, int envelope, int batch)
+{
+    gmtSaver     sv;
+    storeRecord  sr;
+    time_t       t = 1760000000L;
+    long         i;
+
+    if (saveInit (&sv, benchDir, "bench", period, FS_VALUE_LSM303, dtype,
+                  FS_VALUE_LSM303 / SHORT_MAX_DBL / (1 << GMT_INT_FRAC_BITS), batch,
+                  GMT_SYNC_NONE, 1) != 0)
+        return;
+    for (i=0; i<n; i++, t+=period)
+    {
+        makeRecord (&sr, t, storage, i);
+        sr.envelope = envelope;
+        saveRecord (&sv, &sr);
+    }
+    saveClose (&sv);
+}
+
+
+
+/* text records, written one by one
+ */
+static void  benchText1 (long n)
+{
+    benchSave (n, GMT_STORE_TEXT, 60, ELFD_DTYPE_FLOAT, 0, 1);
+}
+
+
+
+/* text records, written in batches of 64
+ */
+static void  benchText64 (long n)
+{
+    benchSave (n, GMT_STORE_TEXT, 60, ELFD_DTYPE_FLOAT, 0, 64);
+}
+
+
+
+/* text day file records of integer units (DATA_TYPE = INT),
+ * without float formatting
+ */
+static void  benchTextInt (long n)
+{
+    benchSave (n, GMT_STORE_TEXT, 60, ELFD_DTYPE_INT, 0, 1);
+}
+
+
+
+/* text records of a second, HH:MM:SS, with the envelope columns
+ * of the decimation stage
+ */
+static void  benchTextEnv (long n)
+{
+    benchSave (n, GMT_STORE_TEXT, 1, ELFD_DTYPE_FLOAT, 1, 1);
+}
+
+
+
+/* binary day file records
+ */
+static void  benchBinary (long n)
+{
+    benchSave (n, GMT_STORE_BINARY, 60, ELFD_DTYPE_FLOAT, 0, 1);
+}
+
+
+
+/* rollup of minute records, without the day files
+ */
+static void  benchRollup (long n)
+{
+    gmtRollup  roll;
+    double     v[GMT_AXES] = { 0.1, -0.2, 0.3 };
+    time_t     t = 1760000000L;
+    long       i;
+
+    memset (&roll, 0, sizeof (roll));
+    if (rollUpdate (&roll, benchDir, "bench", GMT_AXES, t) != 0)
+        return;
+    for (i=0; i<n; i++, t+=60)
+    {
+        v[DI_X] += 1.0e-6;
+        rollAdd (&roll, t, v, GMT_AXES);
+    }
+    rollClose (&roll);
+}
+
+
+
+/* records through the storage queue, to the text day files; the
+ * storage thread writes them, all are written before the time ends
+ */
+static void  benchStore (long n)
+{
+    gmtSaver     sv;
+    gmtStore    *ps;
+    storeRecord  sr;
+    time_t       t = 1760000000L;
+    long         i;
+
+    if (saveInit (&sv, benchDir, "store", 60, FS_VALUE_LSM303, ELFD_DTYPE_FLOAT, 0.0,
+                  GMT_WRITE_BATCH, GMT_SYNC_NONE, 1) != 0)
+        return;
+    if (!(ps = storeCreate (GMT_STORE_BACKLOG, GMT_STORE_PAYLOAD, GMT_OVF_BLOCK, saveSink, &sv,
+                            NULL)))
+        return;
+    for (i=0; i<n; i++, t+=60)
+    {
+        makeRecord (&sr, t, GMT_STORE_TEXT, i);
+        storePut (ps, &sr);
+    }
+    storeDestroy (ps);
+    saveClose (&sv);
+}
+
+
+
+/* raw capture at 220Hz, per sample; full blocks are written at once,
+ * the files hold 16 MB
+ */
+static void  benchCapture (long n)
+{
+    gmtCapture  *pc;
+    rawBlock    *pb;
+    gmtRecord    rec;
+    long         i;
+
+    if (!(pc = capCreate (benchDir, "bench", 0, GMT_DEVICE_SIM, 0, 0, 220.0, FS_VALUE_LSM303,
+                          FS_VALUE_LSM303 / SHORT_MAX_DBL, 16, 0)))
+        return;
+    memset (&rec, 0, sizeof (rec));
+    for (i=0; i<n; i++)
+    {
+        rec.ts.tv_sec  = 1760000000L + i / 220;
+        rec.ts.tv_nsec = (i % 220) * (1000000000L / 220);
+        rec.mono       = i * (1000000000LL / 220);
+        rec.mb.mgnX    = (short) (i & 0x7ff);
+        rec.mb.mgnY    = (short) -(i & 0x3ff);
+        rec.mb.mgnZ    = (short) (i * 7);
+        if ((pb = capPut (pc, &rec, 0)))
+        {
+            capWrite (pc, pb);
+            free (pb);
+        }
+    }
+    if ((pb = capFlush (pc)))
+    {
+        capWrite (pc, pb);
+        free (pb);
+    }
+    capDestroy (pc);
+}
+
+
+
+/* raw sample records through the ring, one thread
+ */
+static void  benchRing (long n)
+{
+    gmtRing    *pr;
+    gmtRecord   rec;
+    long        i;
+
+    if (!(pr = ringCreate (GMT_RING_SIZE, sizeof (gmtRecord))))
+        return;
+    memset (&rec, 0, sizeof (rec));
+    for (i=0; i<n; i++)
+    {
+        rec.mb.mgnX = (short) i;
+        ringPush (pr, &rec);
+        ringPop (pr, &rec);
+    }
+    sink += rec.mb.mgnX;
+    ringDestroy (pr);
+}
+
+
+
+/* history append, and an hour query every 60 records
+ */
+static void  benchHistory (long n)
+{
+    gmtHistory  *ph;
+    histStats    hs;
+    double       v[GMT_AXES] = { 0.1, -0.2, 0.3 };
+    time_t       t = 1760000000L;
+    long         i;
+
+    if (!(ph = histCreate (GMT_HISTORY_DAYS, 60)))
+        return;
+    for (i=0; i<n; i++, t+=60)
+    {
+        v[DI_X] += 1.0e-6;
+        histAppend (ph, t, v);
+        if ((i % 60) == 59)
+            sink += histQuery (ph, t - 3540, t + 60, &hs);
+    }
+    histDestroy (ph);
+}
+
+
+
+/* records of a text day file, parsed as the query server does;
+ * the file is read again as often as needed
+ */
+static void  benchReadText (long n)
+{
+    char    text[FILENAME_MAXSIZE + 32], gmz[FILENAME_MAXSIZE + 32];
+    char    lbuf[256];
+    FILE   *fp;
+    double  a, b, c;
+    int     hh, mm;
+    long    i = 0;
+
+    makeDayFiles (text, gmz);
+    while ((i < n) && (fp = fopen (text, "r")))
+    {
+        while ((i < n) && fgets (lbuf, sizeof (lbuf), fp))
+        {
+            if ((lbuf[0] == '#') || (sscanf (lbuf, "%d:%d, %lf, %lf, %lf", &hh, &mm, &a, &b, &c) != 5))
+                continue;
+            sink += a + b + c;
+            i++;
+        }
+        fclose (fp);
+    }
+}
+
+
+
+/* records of the same day file, decoded from its archive form
+ */
+static void  benchReadGmz (long n)
+{
+    char       text[FILENAME_MAXSIZE + 32], gmz[FILENAME_MAXSIZE + 32];
+    gmzReader  gr;
+    gmzItem    gi;
+    long       i = 0;
+
+    makeDayFiles (text, gmz);
+    while ((i < n) && (gmzOpen (&gr, gmz) == 0))
+    {
+        while ((i < n) && (gmzNext (&gr, &gi) > 0))
+        {
+            if (gi.kind != GMZ_ITEM_RECORD)
+                continue;
+            sink += gi.v[0] + gi.v[1] + gi.v[2];
+            i++;
+        }
+        gmzClose (&gr);
+    }
+}
+
+
+
+/* a text day file of slowly varying values with a little noise, as
+ * writeData() formats them, and its archive form; the names are
+ * returned in <ptext> and <pgmz>
+ */
+static void  makeDayFiles (char *ptext, char *pgmz)
+{
+    FILE      *pi, *po;
+    unsigned   seed = 1;
+    double     v[GMT_AXES];
+    int        i, k;
+
+    sprintf (ptext, "%s/day.dat", benchDir);
+    sprintf (pgmz, "%s/day%s", benchDir, GMZ_FILE_EXT);
+    if (!(pi = fopen (ptext, "w+")))
+        return;
+    fprintf (pi, "# -- geomagnetism data, per minute --\n");
+    fprintf (pi, "# format :\n# HH:MM, X_data, Y_data, Z_data\n");
+    for (i=0; i<MINS_PER_DAY; i++)
+    {
+        for (k=0; k<GMT_AXES; k++)
+            v[k] = 0.2 * (k + 1) + 3.0e-4 * sin (i / (150.0 * (k + 1))) +
+                   ((int) (rand_r (&seed) % 9) - 4) * 1.0e-6;
+        fprintf (pi, "%02d:%02d, %.6lf, %.06lf, %06lf\n", i / 60, i % 60, v[DI_X], v[DI_Y], v[DI_Z]);
+    }
+
+    rewind (pi);
+    if ((po = fopen (pgmz, "w")))
+    {
+        gmzEncode (pi, po);
+        fclose (po);
+    }
+    fclose (pi);
+}
+
+
+
+/* end to end; a sampler thread reads the simulated sensor without
+ * waiting, and passes the raw values through the ring; this thread
+ * averages each 60 samples to a record like the continuous consumer,
+ * and hands it to the storage thread, for the text and binary day
+ * files and the rollup, and to the history
+ */
+static void  runEndToEnd (long samples)
+{
+    pthread_t        smpl;
+    struct timespec  t0;
+    gmtRecord        rec;
+    gmtSaver         sv;
+    gmtStore        *ps;
+    gmtHistory      *ph;
+    storeRecord      sr;
+    rawAccum         acc;
+    double           scale;
+    long             got, recs, ns;
+    time_t           t = 1760000000L;
+
+    cleanDir ();
+    if (!(e2eRing = ringCreate (GMT_RING_SIZE, sizeof (gmtRecord))) ||
+        !(ph = histCreate (GMT_HISTORY_DAYS, 60)))
+        return;
+    if (saveInit (&sv, benchDir, "e2e", 60, FS_VALUE_LSM303, ELFD_DTYPE_FLOAT, 0.0,
+                  GMT_WRITE_BATCH, GMT_SYNC_NONE, 1) != 0)
+        return;
+    if (!(ps = storeCreate (GMT_STORE_BACKLOG, GMT_STORE_PAYLOAD, GMT_OVF_BLOCK, saveSink, &sv,
+                            NULL)))
+        return;
+    scale = FS_VALUE_LSM303 / SHORT_MAX_DBL;
+    atomic_store (&e2eDone, 0);
+
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    if (pthread_create (&smpl, NULL, e2eSampler, &samples) != 0)
+        return;
+
+    got = recs = 0;
+    acc.n = 0;
+    memset (&sr, 0, sizeof (sr));
+    sr.kind    = STORE_SAMPLE;
+    sr.mode    = GMT_AXIS_ALL;
+    sr.storage = GMT_STORE_TEXT | GMT_STORE_BINARY;
+    while (1)
+    {
+        if (!ringPop (e2eRing, &rec))
+        {
+            if (atomic_load (&e2eDone) && !ringPop (e2eRing, &rec))
+                break;
+            sched_yield ();
+            continue;
+        }
+        got++;
+        accAdd (&acc, &rec.mb);
+        if (acc.n < 60)
+            continue;
+
+        accResult (&acc, scale, sr.v, sr.vmin, sr.vmax);
+        sr.tstamp = t;
+        sr.nsmpl  = acc.n;
+        storePut (ps, &sr);
+        histAppend (ph, t, sr.v);
+        acc.n = 0;
+        t    += 60;
+        recs++;
+    }
+    storeDestroy (ps);
+    saveClose (&sv);
+    ns = nsElapsed (&t0);
+    pthread_join (smpl, NULL);
+
+    report ("e2e_samples", got, ns, "sample");
+    report ("e2e_records", recs, ns, "record");
+
+    histDestroy (ph);
+    ringDestroy (e2eRing);
+}
+
+
+
+/* end-to-end sampler; a full ring is waited for, nothing is dropped
+ */
+static void  *e2eSampler (void *arg)
+{
+    long        n = *(long *) arg;
+    gmtDevice   dev;
+    gmtRecord   rec;
+    long        i;
+
+    devOpen (&dev, simDrv, -1, 0, 7);
+    for (i=0; i<n; i++)
+    {
+        devRead (&dev, &rec.mb);
+        clock_gettime (CLOCK_REALTIME, &rec.ts);
+        while (!ringPush (e2eRing, &rec))
+            sched_yield ();
+    }
+    atomic_store (&e2eDone, 1);
+    return NULL;
+}
+
+
+
+/* a sample record of all axes, for the <storage> backends, with
+ * slowly changing values, as putSample () fills it
+ */
+static void  makeRecord (storeRecord *pr, time_t t, int storage, long i)
+{
+    int  k;
+
+    memset (pr, 0, sizeof (storeRecord));
+    pr->kind    = STORE_SAMPLE;
+    pr->tstamp  = t;
+    pr->mode    = GMT_AXIS_ALL;
+    pr->storage = storage;
+    pr->nsmpl   = GMT_AVG_COUNT;
+    for (k=0; k<GMT_AXES; k++)
+    {
+        pr->v[k]    = 0.1 * (k + 1) + (i % 1000) * 1.0e-6;
+        pr->vmin[k] = pr->v[k] - 1.0e-4;
+        pr->vmax[k] = pr->v[k] + 1.0e-4;
+        pr->sd[k]   = 3.0e-5;
+        pr->ival[k] = (int) (i % 1000) + 1000 * (k + 1);
+        pr->imin[k] = pr->ival[k] - 16;
+        pr->imax[k] = pr->ival[k] + 16;
+    }
+}
+
+
+
+/* storage sink of the benchmarks; the record to the files of <arg>
+ * returns 0 if writing was ok, an error number otherwise
+ */
+static int  saveSink (void *arg, storeRecord *pr)
+{
+    return (saveRecord ((gmtSaver *) arg, pr));
+}
+
+
+
+/* print one result line
+ */
+static void  report (const char *name, long n, long ns, const char *unit)
+{
+    printf ("%s\t%ld\t%.2lf\t%.0lf\t%s\n", name, n, (double) ns / n,
+            (ns > 0) ? (n * 1.0e9 / ns) : 0.0, unit);
+    fflush (stdout);
+}
+
+
+
+/* nanoseconds since <ps>, monotonic clock
+ */
+static long  nsElapsed (const struct timespec *ps)
+{
+    struct timespec  ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ((ts.tv_sec - ps->tv_sec) * 1000000000L + (ts.tv_nsec - ps->tv_nsec));
+}
+
+
+
+/* remove the files of the last benchmark
+ */
+static void  cleanDir (void)
+{
+    removeTree (benchDir);
+    mkdir (benchDir, 0700);
+}
+
+
+
+/* remove a directory, with its files and subdirectories (the
+ * rollup and the index)
+ */
+static void  removeTree (const char *path)
+{
+    char            name[FILENAME_MAXSIZE + 300];
+    DIR            *pd;
+    struct dirent  *pe;
+
+    if (!(pd = opendir (path)))
+        return;
+    while ((pe = readdir (pd)))
+    {
+        if ((strcmp (pe->d_name, ".") == 0) || (strcmp (pe->d_name, "..") == 0))
+            continue;
+        snprintf (name, sizeof (name), "%s/%s", path, pe->d_name);
+        if (pe->d_type == DT_DIR)
+            removeTree (name);
+        else
+            unlink (name);
+    }
+    closedir (pd);
+    rmdir (path);
+}
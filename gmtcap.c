@@ -0,0 +1,282 @@
+/***************************************************************************
+ *                           gmtcap.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the raw capture recorder, every
+ *      conversion in preallocated, block-framed binary files
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "gmt.h"
+
+_Static_assert (sizeof (rawHeader) == 64, "rawHeader size");
+_Static_assert (sizeof (rawSample) == 16, "rawSample size");
+_Static_assert (sizeof (rawBlock) == 32, "rawBlock size");
+
+/*  The consumer fills one block at a time, and hands it over when it is
+ *  full; the storage thread only ever writes whole blocks, at block
+ *  boundaries of a file allocated in advance, so the medium sees one
+ *  large sequential write every RAW_BLOCK_SAMPLES conversions (some 18s
+ *  at 220Hz), and the file system no growth of the file.
+ */
+struct gmtCapture
+{
+    rawHeader      hdr;          /* of each file, times per file  */
+    rawBlock      *cur;          /* being filled, or NULL         */
+    unsigned int   seq;          /* next block number             */
+    unsigned long  overruns;     /* ring overruns, at last block  */
+    unsigned long  missed;       /* not saved, samples            */
+    int            fd;           /* capture file; storage thread  */
+    off_t          size;         /* its bytes written             */
+    off_t          limit;        /* its allocated size            */
+    int            rotate;       /* s per file, 0 = by size only  */
+    long long      slot;         /* wall clock / rotate, the file */
+    char           path[FILENAME_MAXSIZE];
+    char           tag[GMT_NAME_SIZE];
+};
+
+/* --- prototypes ----
+ */
+extern void  gmtMkDir   (const char *path);
+
+static int   capOpen    (gmtCapture *pc, const rawBlock *pb);
+static void  capClose   (gmtCapture *pc);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* create the capture of one sensor (<sensor> in the list, of type
+ * <device> at <bus> / <addr>), sampled at <rate> Hz, raw values times
+ * <scale> are Ga; the files go to the directory <path>, named with
+ * <tag> if not empty, with at most <mb> MB, and a new file every
+ * <rotate> seconds (0: none)
+ * returns NULL on memory shortage
+ */
+gmtCapture  *capCreate (const char *path, const char *tag, int sensor, int device, int bus,
+                        int addr, double rate, double fullScale, double scale, int mb, int rotate)
+{
+    gmtCapture  *pc;
+
+    if (!(pc = calloc (1, sizeof (gmtCapture))))
+        return NULL;
+    pc->fd     = -1;
+    pc->rotate = (rotate > 0) ? rotate : 0;
+    pc->limit  = (off_t) ((mb > 0) ? mb : RAW_FILE_SIZE) << 20;
+    if (pc->limit < RAW_HEADER_SIZE + RAW_BLOCK_SIZE)
+        pc->limit = RAW_HEADER_SIZE + RAW_BLOCK_SIZE;
+    strncpy (pc->path, path, FILENAME_MAXSIZE - 1);
+    if (tag)
+        strncpy (pc->tag, tag, GMT_NAME_SIZE - 1);
+
+    memcpy (pc->hdr.id, ELFD_HEADER_ID, 4);
+    pc->hdr.version    = RAW_VERSION;
+    pc->hdr.dtype      = ELFD_DTYPE_RAW;
+    pc->hdr.axes       = GMT_AXES;
+    pc->hdr.device     = (unsigned char) device;
+    pc->hdr.hdrSize    = RAW_HEADER_SIZE;
+    pc->hdr.blockSize  = RAW_BLOCK_SIZE;
+    pc->hdr.sampleSize = sizeof (rawSample);
+    pc->hdr.bus        = (unsigned char) bus;
+    pc->hdr.addr       = (unsigned char) addr;
+    pc->hdr.sensor     = (unsigned int) sensor;
+    pc->hdr.odRate     = rate;
+    pc->hdr.fullScale  = fullScale;
+    pc->hdr.scale      = scale;
+    return pc;
+}
+
+
+
+/* release a capture, after its last block was written; the file is
+ * cut to the blocks written; <pc> may be NULL
+ */
+void  capDestroy (gmtCapture *pc)
+{
+    if (!pc)
+        return;
+    capClose (pc);
+    free (pc->cur);
+    free (pc);
+}
+
+
+
+/* add one raw sample; <overruns> is the count of samples the ring
+ * dropped so far, the difference goes with the next block
+ * returns a full block (for capWrite (), to be freed), or NULL
+ */
+rawBlock  *capPut (gmtCapture *pc, const gmtRecord *pr, unsigned long overruns)
+{
+    rawBlock   *pb;
+    rawSample  *ps;
+
+    if (!(pb = pc->cur))
+    {
+        /* a whole block, so the part not used is zero */
+        if (!(pb = aligned_alloc (RAW_HEADER_SIZE, RAW_BLOCK_SIZE)))
+        {
+            pc->missed++;
+            return NULL;
+        }
+        memset (pb, 0, RAW_BLOCK_SIZE);
+        memcpy (pb->id, ELFD_HEADER_ID, 4);
+        pb->seq  = pc->seq++;
+        pb->lost = (unsigned int) (overruns - pc->overruns + pc->missed);
+        pb->real = pr->ts.tv_sec * 1000000000LL + pr->ts.tv_nsec;
+        pb->mono = pr->mono;
+        pc->overruns = overruns;
+        pc->missed   = 0;
+        pc->cur      = pb;
+    }
+
+    ps = &pb->s[pb->count++];
+    ps->mono    = pr->mono;
+    ps->v[DI_X] = pr->mb.mgnX;
+    ps->v[DI_Y] = pr->mb.mgnY;
+    ps->v[DI_Z] = pr->mb.mgnZ;
+    if (pb->count < RAW_BLOCK_SAMPLES)
+        return NULL;
+    pc->cur = NULL;
+    return pb;
+}
+
+
+
+/* the block being filled, even if not full
+ * returns the block (for capWrite (), to be freed), or NULL if there
+ * is none
+ */
+rawBlock  *capFlush (gmtCapture *pc)
+{
+    rawBlock  *pb = pc->cur;
+
+    pc->cur = NULL;
+    return pb;
+}
+
+
+
+/* <n> samples of a block returned were not saved (the block was
+ * dropped); they count as lost with the next block
+ */
+void  capLost (gmtCapture *pc, unsigned int n)
+{
+    pc->missed += n;
+}
+
+
+
+/* write a block to the capture file, at the next block boundary; a
+ * new file is started when the current one is full, or its time is
+ * over; called by the storage thread only
+ * returns 0 if ok, or an error number
+ */
+int  capWrite (gmtCapture *pc, const rawBlock *pb)
+{
+    long long  slot;
+
+    slot = pc->rotate ? (pb->real / 1000000000LL) / pc->rotate : 0;
+    if ((pc->fd >= 0) && ((pc->size + RAW_BLOCK_SIZE > pc->limit) || (slot != pc->slot)))
+        capClose (pc);
+    if ((pc->fd < 0) && (capOpen (pc, pb) != 0))
+        return 1;
+    pc->slot = slot;
+
+    if (pwrite (pc->fd, pb, RAW_BLOCK_SIZE, pc->size) != RAW_BLOCK_SIZE)
+    {
+        perror ("writing capture file");
+        capClose (pc);
+        return 2;
+    }
+    pc->size += RAW_BLOCK_SIZE;
+    return 0;
+}
+
+
+
+/* start a capture file, named by the first sample of block <pb>, and
+ * allocate all of it
+ * returns 0 if ok, or -1 on error
+ */
+static int  capOpen (gmtCapture *pc, const rawBlock *pb)
+{
+    unsigned char  hbuf[RAW_HEADER_SIZE];
+    char           name[FILENAME_MAXSIZE + GMT_NAME_SIZE + 64];
+    time_t         t;
+    struct tm      tm;
+    int            rv;
+
+    t = (time_t) (pb->real / 1000000000LL);
+    localtime_r (&t, &tm);
+    gmtMkDir (pc->path);
+    snprintf (name, sizeof (name), "%s/%4d_%02d_%02d_%02d%02d%02d%s%s%s", pc->path, tm.tm_year + 1900,
+              tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, pc->tag[0] ? "_" : "",
+              pc->tag, RAW_FILE_EXT);
+
+    /* a file of the same second is not overwritten */
+    if ((pc->fd = open (name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644)) < 0)
+    {
+        perror (name);
+        return -1;
+    }
+    pc->size = 0;
+    if ((rv = posix_fallocate (pc->fd, 0, pc->limit)) != 0)
+    {
+        errno = rv;
+        perror (name);
+        close (pc->fd);
+        unlink (name);
+        pc->fd = -1;
+        return -1;
+    }
+
+    pc->hdr.real = pb->real;
+    pc->hdr.mono = pb->mono;
+    memset (hbuf, 0, sizeof (hbuf));
+    memcpy (hbuf, &pc->hdr, sizeof (rawHeader));
+    if (pwrite (pc->fd, hbuf, RAW_HEADER_SIZE, 0) != RAW_HEADER_SIZE)
+    {
+        perror (name);
+        capClose (pc);
+        return -1;
+    }
+    pc->size = RAW_HEADER_SIZE;
+    return 0;
+}
+
+
+
+/* finish the capture file; cut to the blocks written, and close it
+ */
+static void  capClose (gmtCapture *pc)
+{
+    if (pc->fd < 0)
+        return;
+    if (ftruncate (pc->fd, pc->size) != 0)
+        perror ("capture file size");
+    close (pc->fd);
+    pc->fd = -1;
+}
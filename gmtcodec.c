@@ -0,0 +1,576 @@
+/***************************************************************************
+ *                           gmtcodec.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the archive codec, a lossless
+ *      compressed form of the text day files (.gmz), and its
+ *      streaming decoder
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "gmt.h"
+
+/*  The records are fixed-point decimal text, so each value is taken as
+ *  the integer of its digits; that is exact, where the double bits of
+ *  the value would not XOR to few bits. Times of regular records give
+ *  a delta-of-delta of 0 (1 bit), slowly varying values small deltas
+ *  (a few bits each). A line is only coded as a record if it is written
+ *  back byte for byte; anything else is kept as text.
+ */
+typedef struct
+{
+    int             cols;
+    int             secs;
+    unsigned char   fmt[GMZ_MAX_COLS];
+}
+gmzLayout;
+
+typedef struct
+{
+    FILE           *fp;
+    unsigned int    bits;        /* current byte, not yet written */
+    int             used;        /* of it, bits used              */
+}
+bitWriter;
+
+static const long long  decPow[GMZ_MAX_DIGITS + 1] =
+{
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL,
+    100000000LL, 1000000000LL
+};
+
+/* <value> code: payload bits after 0, 10, 110, .. 11111 */
+static const int  valBits[6] = { 0, 4, 8, 16, 32, 64 };
+
+/* --- prototypes ----
+ */
+static int   parseRecord  (const char *pl, gmzLayout *pf, long *ptod, long long *pv);
+static int   parseNumber  (const char **pp, long long *pv, unsigned char *pfmt);
+static int   formatRecord (char *pb, int secs, int cols, const unsigned char *fmt,
+                           long tod, const long long *pv);
+static void  putBits      (bitWriter *pw, unsigned long long v, int n);
+static void  putValue     (bitWriter *pw, unsigned long long v);
+static void  putZigzag    (bitWriter *pw, long long v);
+static int   getBits      (gmzReader *pr, int n, unsigned long long *pv);
+static int   getValue     (gmzReader *pr, unsigned long long *pv);
+static int   getPrefix    (gmzReader *pr, int max);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* compress the text day file <pi> into <po>, starting at the current
+ * positions;
+ * returns 0 on success, or -1 on a read / write error
+ */
+int  gmzEncode (FILE *pi, FILE *po)
+{
+    unsigned char  hdr[GMZ_HEADER_SIZE];
+    bitWriter      bw;
+    gmzLayout      cur, lay;
+    long long      prev[GMZ_MAX_COLS], v[GMZ_MAX_COLS];
+    char          *pl = NULL;
+    size_t         lsize = 0;
+    ssize_t        n, k;
+    long           tod, tprev = 0, dprev = 0;
+    int            i, nonl = 0;
+
+    memset (hdr, 0, sizeof (hdr));
+    memcpy (hdr, GMZ_HEADER_ID, 4);
+    hdr[4] = GMZ_VERSION;
+    fwrite (hdr, 1, sizeof (hdr), po);
+    memset (&cur, 0, sizeof (cur));
+    memset (&bw, 0, sizeof (bw));
+    bw.fp = po;
+
+    while ((n = getline (&pl, &lsize, pi)) > 0)
+    {
+        if (pl[n-1] == '\n')
+            pl[--n] = '\0';
+        else
+            nonl = 1;                  /* only the last line */
+
+        if ((pl[0] == '#') || (parseRecord (pl, &lay, &tod, v) != 0))
+        {
+            putBits (&bw, 0x6, 3);
+            putValue (&bw, (unsigned long long) n);
+            for (k=0; k<n; k++)
+                putBits (&bw, (unsigned char) pl[k], 8);
+            continue;
+        }
+
+        if ((lay.cols != cur.cols) || (lay.secs != cur.secs) ||
+            (memcmp (lay.fmt, cur.fmt, (size_t) lay.cols) != 0))
+        {
+            cur = lay;
+            putBits (&bw, 0xe, 4);
+            putValue (&bw, (unsigned long long) cur.cols);
+            putBits (&bw, (unsigned long long) cur.secs, 1);
+            for (i=0; i<cur.cols; i++)
+                putBits (&bw, cur.fmt[i], 8);
+            memset (prev, 0, sizeof (prev));
+        }
+
+        if (tod - tprev == dprev)
+            putBits (&bw, 0, 1);
+        else
+        {
+            putBits (&bw, 0x2, 2);
+            putZigzag (&bw, (long long) (tod - tprev) - dprev);
+        }
+        dprev = tod - tprev;
+        tprev = tod;
+        for (i=0; i<cur.cols; i++)
+        {
+            putZigzag (&bw, (long long) ((unsigned long long) v[i] - (unsigned long long) prev[i]));
+            prev[i] = v[i];
+        }
+    }
+    free (pl);
+
+    putBits (&bw, 0xf, 4);
+    putBits (&bw, (unsigned long long) nonl, 1);
+    if (bw.used > 0)
+        putBits (&bw, 0, 8 - bw.used);
+    return ((ferror (pi) || ferror (po)) ? -1 : 0);
+}
+
+
+
+/* open the archive day file <name> for decoding;
+ * returns 0 on success, or -1 on error (errno EINVAL if it is
+ * not an archive file)
+ */
+int  gmzOpen (gmzReader *pr, const char *name)
+{
+    unsigned char  hdr[GMZ_HEADER_SIZE];
+
+    memset (pr, 0, sizeof (gmzReader));
+    if (!(pr->fp = fopen (name, "r")))
+        return -1;
+
+    if ((fread (hdr, 1, sizeof (hdr), pr->fp) != sizeof (hdr)) ||
+        (memcmp (hdr, GMZ_HEADER_ID, 4) != 0) || (hdr[4] != GMZ_VERSION))
+    {
+        fclose (pr->fp);
+        pr->fp = NULL;
+        errno  = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+
+
+/* close an archive day file
+ */
+void  gmzClose (gmzReader *pr)
+{
+    if (pr->fp)
+        fclose (pr->fp);
+    free (pr->text);
+    memset (pr, 0, sizeof (gmzReader));
+}
+
+
+
+/* decode the next record or text line into <pi>; the line of a
+ * text item stays valid up to the next call;
+ * returns 1 for an item, 0 at the end of the stream, or -1 if
+ * the file is truncated or damaged
+ */
+int  gmzNext (gmzReader *pr, gmzItem *pi)
+{
+    unsigned long long  v;
+    size_t              k, len;
+    char               *pt;
+    int                 i, op;
+
+    while (1)
+    {
+        if ((op = getPrefix (pr, 4)) < 0)
+            return -1;
+
+        switch (op)
+        {
+          case 0:
+          case 1:
+            if (pr->cols == 0)
+                return -1;
+            if (op == 1)
+            {
+                if (getValue (pr, &v) != 0)
+                    return -1;
+                pr->dprev += (long) ((v >> 1) ^ -(v & 1));
+            }
+            pr->tprev += pr->dprev;
+            pi->kind   = GMZ_ITEM_RECORD;
+            pi->tod    = pr->tprev;
+            pi->cols   = pr->cols;
+            pi->text   = NULL;
+            for (i=0; i<pr->cols; i++)
+            {
+                if (getValue (pr, &v) != 0)
+                    return -1;
+                pr->prev[i] = (long long) ((unsigned long long) pr->prev[i] + ((v >> 1) ^ -(v & 1)));
+                /* an exact power of ten; the same double as the text gives */
+                if (pr->prev[i] == GMZ_NEG_ZERO)
+                    pi->v[i] = -0.0;
+                else
+                    pi->v[i] = (double) pr->prev[i] /
+                               (double) decPow[(pr->fmt[i] == GMZ_FMT_INT) ? 0 : pr->fmt[i]];
+            }
+            return 1;
+
+          case 2:
+            if (getValue (pr, &v) != 0)
+                return -1;
+            len = (size_t) v;
+            if (len + 1 > pr->tsize)
+            {
+                if ((v > (1ULL << 24)) || !(pt = realloc (pr->text, len + 256)))
+                    return -1;
+                pr->text  = pt;
+                pr->tsize = len + 256;
+            }
+            for (k=0; k<len; k++)
+            {
+                if (getBits (pr, 8, &v) != 0)
+                    return -1;
+                pr->text[k] = (char) v;
+            }
+            pr->text[len] = '\0';
+            pi->kind = GMZ_ITEM_TEXT;
+            pi->cols = 0;
+            pi->text = pr->text;
+            return 1;
+
+          case 3:
+            if ((getValue (pr, &v) != 0) || (v < 1) || (v > GMZ_MAX_COLS))
+                return -1;
+            pr->cols = (int) v;
+            if (getBits (pr, 1, &v) != 0)
+                return -1;
+            pr->secs = (int) v;
+            for (i=0; i<pr->cols; i++)
+            {
+                if (getBits (pr, 8, &v) != 0)
+                    return -1;
+                if ((v != GMZ_FMT_INT) && ((v < 1) || (v > GMZ_MAX_DIGITS)))
+                    return -1;
+                pr->fmt[i] = (unsigned char) v;
+            }
+            memset (pr->prev, 0, sizeof (pr->prev));
+            break;
+
+          default:
+            if (getBits (pr, 1, &v) != 0)
+                return -1;
+            pr->nonl = (int) v;
+            return 0;
+        }
+    }
+}
+
+
+
+/* write the text line of the record last returned by gmzNext()
+ * to <pb>, without newline; <pb> holds at least GMZ_LINE_MAX bytes;
+ * returns the length of the line
+ */
+int  gmzFormat (gmzReader *pr, char *pb)
+{
+    return formatRecord (pb, pr->secs, pr->cols, pr->fmt, pr->tprev, pr->prev);
+}
+
+
+
+/* decode an archive day file to its original text, into <po>;
+ * returns 0 on success, or -1 on error
+ */
+int  gmzUnpack (const char *name, FILE *po)
+{
+    gmzReader  gr;
+    gmzItem    gi;
+    char       lbuf[GMZ_LINE_MAX];
+    int        rv, nl = 0;
+
+    if (gmzOpen (&gr, name) != 0)
+        return -1;
+
+    /* the newline goes before the next line, so the last one
+     * can be left without */
+    while ((rv = gmzNext (&gr, &gi)) > 0)
+    {
+        if (nl)
+            putc_unlocked ('\n', po);
+        if (gi.kind == GMZ_ITEM_RECORD)
+            fwrite (lbuf, 1, (size_t) gmzFormat (&gr, lbuf), po);
+        else
+            fputs (gi.text, po);
+        nl = 1;
+    }
+    if (nl && (rv == 0) && !gr.nonl)
+        putc_unlocked ('\n', po);
+
+    gmzClose (&gr);
+    return (((rv < 0) || ferror (po)) ? -1 : 0);
+}
+
+
+
+/* parse a record line, "HH:MM[:SS], <value>[, <value> ...]", into
+ * seconds of the day and integer values, and its layout;
+ * returns 0 if the line is written back identically from them,
+ * or -1 if not
+ */
+static int  parseRecord (const char *pl, gmzLayout *pf, long *ptod, long long *pv)
+{
+    const char  *p = pl;
+    char         lbuf[GMZ_LINE_MAX];
+    long long    t[3];
+    int          i, n;
+
+    memset (pf, 0, sizeof (gmzLayout));
+    for (n=0; n<3; n++)
+    {
+        if ((*p < '0') || (*p > '9') || (p[1] < '0') || (p[1] > '9'))
+            break;
+        t[n] = (p[0] - '0') * 10 + (p[1] - '0');
+        p   += 2;
+        if (*p != ':')
+            break;
+        p++;
+    }
+    if ((n < 1) || (n > 2) || (*p != ','))
+        return -1;
+    pf->secs = (n == 2);
+    *ptod    = (long) (t[0] * 3600 + t[1] * 60 + (pf->secs ? t[2] : 0));
+
+    for (i=0; *p == ','; i++)
+    {
+        if ((i >= GMZ_MAX_COLS) || (p[1] != ' '))
+            return -1;
+        p += 2;
+        if (parseNumber (&p, &pv[i], &pf->fmt[i]) != 0)
+            return -1;
+    }
+    if (*p != '\0')
+        return -1;
+    pf->cols = i;
+
+    /* e.g. leading zeros, or "-0.000000" */
+    formatRecord (lbuf, pf->secs, pf->cols, pf->fmt, *ptod, pv);
+    return (strcmp (lbuf, pl) == 0) ? 0 : -1;
+}
+
+
+
+/* parse "[-]<digits>[.<digits>]" at *pp into the integer of all its
+ * digits, and the number of digits after the point;
+ * returns 0 on success, or -1 if it is no such number, or too long
+ */
+static int  parseNumber (const char **pp, long long *pv, unsigned char *pfmt)
+{
+    const char  *p = *pp;
+    long long    v = 0;
+    int          neg = 0, digits = 0, frac = -1;
+
+    if (*p == '-')
+    {
+        neg = 1;
+        p++;
+    }
+    for (; ((*p >= '0') && (*p <= '9')) || ((*p == '.') && (frac < 0)); p++)
+    {
+        if (*p == '.')
+        {
+            frac = 0;
+            continue;
+        }
+        if (++digits > 18)
+            return -1;
+        v = v * 10 + (*p - '0');
+        if (frac >= 0)
+            frac++;
+    }
+    if ((digits == 0) || (frac == 0) || (frac > GMZ_MAX_DIGITS))
+        return -1;
+
+    /* a sign of its own, the integer has none */
+    if (neg && (v == 0))
+        *pv = GMZ_NEG_ZERO;
+    else
+        *pv = neg ? -v : v;
+    *pfmt = (frac < 0) ? GMZ_FMT_INT : (unsigned char) frac;
+    *pp   = p;
+    return 0;
+}
+
+
+
+/* write a record line from its time, layout and integer values,
+ * without newline;
+ * returns the length of the line
+ */
+static int  formatRecord (char *pb, int secs, int cols, const unsigned char *fmt,
+                          long tod, const long long *pv)
+{
+    unsigned long long  u;
+    int                 i, n, k;
+
+    if (secs)
+        n = sprintf (pb, "%02ld:%02ld:%02ld", tod / 3600, (tod / 60) % 60, tod % 60);
+    else
+        n = sprintf (pb, "%02ld:%02ld", tod / 3600, (tod / 60) % 60);
+
+    for (i=0; i<cols; i++)
+    {
+        if (pv[i] == GMZ_NEG_ZERO)
+        {
+            n += sprintf (pb + n, ", -0");
+            if (fmt[i] != GMZ_FMT_INT)
+                n += sprintf (pb + n, ".%0*d", fmt[i], 0);
+            continue;
+        }
+        if (fmt[i] == GMZ_FMT_INT)
+        {
+            n += sprintf (pb + n, ", %lld", pv[i]);
+            continue;
+        }
+        k  = fmt[i];
+        u  = (pv[i] < 0) ? -(unsigned long long) pv[i] : (unsigned long long) pv[i];
+        n += sprintf (pb + n, ", %s%llu.%0*llu", (pv[i] < 0) ? "-" : "",
+                      u / (unsigned long long) decPow[k], k, u % (unsigned long long) decPow[k]);
+    }
+    return n;
+}
+
+
+
+/* append the low <n> bits of <v> to the stream, the highest first
+ */
+static void  putBits (bitWriter *pw, unsigned long long v, int n)
+{
+    int  k;
+
+    while (n > 0)
+    {
+        k         = (n < 8 - pw->used) ? n : 8 - pw->used;
+        n        -= k;
+        pw->bits  = (pw->bits << k) | (unsigned int) ((v >> n) & ((1U << k) - 1));
+        pw->used += k;
+        if (pw->used == 8)
+        {
+            putc_unlocked ((int) pw->bits, pw->fp);
+            pw->bits = 0;
+            pw->used = 0;
+        }
+    }
+}
+
+
+
+/* append a <value> code, the shortest one that holds <v>
+ */
+static void  putValue (bitWriter *pw, unsigned long long v)
+{
+    int  i;
+
+    for (i=0; (i < 5) && (v >> valBits[i]); i++)
+        ;
+    /* i ones, and a zero unless the longest */
+    putBits (pw, (i < 5) ? ((1ULL << (i + 1)) - 2) : 0x1f, (i < 5) ? i + 1 : 5);
+    putBits (pw, v, valBits[i]);
+}
+
+
+
+/* append a signed number as <value> code; zigzag, so small negative
+ * numbers are small codes, too
+ */
+static void  putZigzag (bitWriter *pw, long long v)
+{
+    putValue (pw, ((unsigned long long) v << 1) ^ (unsigned long long) (v >> 63));
+}
+
+
+
+/* read <n> bits of the stream into <pv>, the first as highest;
+ * returns 0 on success, or -1 at the end of the file
+ */
+static int  getBits (gmzReader *pr, int n, unsigned long long *pv)
+{
+    unsigned long long  v = 0;
+    int                 c, k;
+
+    while (n > 0)
+    {
+        if (pr->avail == 0)
+        {
+            if ((c = getc_unlocked (pr->fp)) == EOF)
+                return -1;
+            pr->bits  = (unsigned int) c;
+            pr->avail = 8;
+        }
+        k          = (n < pr->avail) ? n : pr->avail;
+        n         -= k;
+        pr->avail -= k;
+        v          = (v << k) | ((pr->bits >> pr->avail) & ((1U << k) - 1));
+    }
+    *pv = v;
+    return 0;
+}
+
+
+
+/* read a prefix of up to <max> one bits, ended by a zero bit
+ * unless <max> long;
+ * returns the number of one bits, or -1 at the end of the file
+ */
+static int  getPrefix (gmzReader *pr, int max)
+{
+    unsigned long long  b;
+    int                 i;
+
+    for (i=0; i<max; i++)
+    {
+        if (getBits (pr, 1, &b) != 0)
+            return -1;
+        if (b == 0)
+            break;
+    }
+    return i;
+}
+
+
+
+/* read a <value> code;
+ * returns 0 on success, or -1 at the end of the file
+ */
+static int  getValue (gmzReader *pr, unsigned long long *pv)
+{
+    int  i;
+
+    if ((i = getPrefix (pr, 5)) < 0)
+        return -1;
+    return getBits (pr, valBits[i], pv);
+}
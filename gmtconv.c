@@ -0,0 +1,139 @@
+/***************************************************************************
+ *                           gmtconv.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements a converter from the binary day
+ *      files (.esd) to the text day file layout (.dat)
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "gmt.h"
+
+/* --- prototypes ----
+ */
+extern int           esdOpen  (esdFile *pf, const char *name);
+extern void          esdClose (esdFile *pf);
+extern const void   *esdSlot  (esdFile *pf, unsigned int idx);
+extern int           esdGet   (esdFile *pf, unsigned int idx, double *pv);
+
+static int  convert (esdFile *pf, FILE *po);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* usage: gmtconv <day file.esd> [<output.dat>]
+ * without output file name, the text goes to stdout
+ */
+int  main (int argc, char **argv)
+{
+    esdFile  esd;
+    FILE    *po;
+    int      rv;
+
+    if (argc < 2)
+    {
+        fprintf (stderr, "usage: %s <file.esd> [<file.dat>]\n", argv[0]);
+        return 1;
+    }
+
+    if (esdOpen (&esd, argv[1]) != 0)
+    {
+        perror (argv[1]);
+        return 2;
+    }
+
+    po = stdout;
+    if ((argc > 2) && !(po = fopen (argv[2], "w")))
+    {
+        perror (argv[2]);
+        esdClose (&esd);
+        return 3;
+    }
+
+    rv = convert (&esd, po);
+
+    if (po != stdout)
+        fclose (po);
+    esdClose (&esd);
+    return rv;
+}
+
+
+
+/* write all used slots of the day file in the same layout as
+ * the text day files, i.e. usable by the gnuplot script; integer
+ * files are written as physical values, too;
+ * returns 0 on success
+ */
+static int  convert (esdFile *pf, FILE *po)
+{
+    esdHeader     *ph = pf->hdr;
+    double         pv[GMT_AXES];
+    unsigned int   i, first;
+    int            hh, mm, ss;
+    const char    *pfmt;
+
+    /* the header carries the time of the first sample */
+    for (first=0; first<ph->slots; first++)
+        if (esdSlot (pf, first))
+            break;
+    if (first >= ph->slots)
+        return 0;
+
+    /* records shorter than a minute carry the seconds */
+    pfmt = (ph->period < 60) ? "HH:MM:SS" : "HH:MM";
+    hh = (first * ph->period) / 3600;
+    mm = ((first * ph->period) / 60) % 60;
+    if (ph->period == 60)
+        fprintf (po, "# -- geomagnetism data, per minute --\n");
+    else
+        fprintf (po, "# -- geomagnetism data, per %u seconds --\n", ph->period);
+    fprintf (po, "# start time : %02d.%02d.%4d, %02d:%02d\n", ph->month, ph->mday,
+             ph->year, hh, mm);
+    if (ph->mode == GMT_AXIS_ALL)
+        fprintf (po, "# format :\n# %s, X_data, Y_data, Z_data\n", pfmt);
+    else
+        fprintf (po, "# format :\n# %s, XYZ_Vector_data\n", pfmt);
+    fprintf (po, "# fullscale value = %.5lf Ga\n", ph->fullScale);
+
+    for (i=first; i<ph->slots; i++)
+    {
+        if (!esdGet (pf, i, pv))
+            continue;
+
+        hh = (i * ph->period) / 3600;
+        mm = ((i * ph->period) / 60) % 60;
+        ss = (i * ph->period) % 60;
+        if (ph->period < 60)
+            fprintf (po, "%02d:%02d:%02d", hh, mm, ss);
+        else
+            fprintf (po, "%02d:%02d", hh, mm);
+        if (ph->axes == GMT_AXES)
+            fprintf (po, ", %.6lf, %.06lf, %06lf\n", pv[DI_X], pv[DI_Y], pv[DI_Z]);
+        else
+            fprintf (po, ", %.6lf\n", pv[0]);
+    }
+
+    return (ferror (po) ? 1 : 0);
+}
@@ -0,0 +1,217 @@
+/***************************************************************************
+ *                           gmtdecim.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the streaming decimation stage,
+ *      a CIC decimator followed by a boxcar with interval statistics
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gmt.h"
+
+/*  All three axes are processed at once, as lanes of one vector (the
+ *  fourth lane is unused); the compiler maps the vector operations to
+ *  the SIMD unit of the target, or to scalar code if there is none.
+ *  - CIC: N integrators at the input rate, N combs (delay 1) at the
+ *    output rate; the integrators wrap around, which is harmless in
+ *    two's complement as long as the output fits (GMT_CIC_MAX_BITS);
+ *    unsigned lanes make the wrap-around well defined; the gain is R^N
+ *  - boxcar: count, sums and extremes of the filter output over the
+ *    record period; the sums are kept relative to the first value of
+ *    the period, so the sum of squares does not lose the variance to
+ *    rounding
+ */
+typedef long long           v4ll  __attribute__ ((vector_size (32)));
+typedef unsigned long long  v4ull __attribute__ ((vector_size (32)));
+typedef double              v4df  __attribute__ ((vector_size (32)));
+
+struct gmtDecim
+{
+    v4ull          integ[GMT_CIC_MAX_ORDER];    /* integrator states     */
+    v4ull          comb[GMT_CIC_MAX_ORDER];     /* comb delay elements   */
+    v4ll           ref;          /* first value of the period     */
+    v4ll           sum;          /* sum of (value - ref)          */
+    v4df           sq;           /* sum of (value - ref)^2        */
+    v4ll           min;
+    v4ll           max;
+    unsigned long  n;            /* values in the period          */
+    int            order;        /* CIC stages, 0 = boxcar only   */
+    int            factor;       /* CIC decimation factor         */
+    int            phase;        /* inputs since the last output  */
+    int            warmup;       /* outputs still to be dropped   */
+    double         gain;         /* R^N                           */
+};
+
+/* --- prototypes ----
+ */
+static void  boxAdd    (gmtDecim *pd, const v4ll *px);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* create a decimation stage; <mode> GMT_DECIM_BOXCAR, or GMT_DECIM_CIC
+ * with <order> stages and decimation <factor>;
+ * returns NULL if the parameters are not valid, or on memory shortage
+ */
+gmtDecim  *decimCreate (int mode, int order, int factor)
+{
+    gmtDecim  *pd;
+    int        bits;
+
+    if (mode == GMT_DECIM_CIC)
+    {
+        for (bits=0; (1 << bits) < factor; bits++)
+            ;
+        if ((order < 1) || (order > GMT_CIC_MAX_ORDER) || (factor < 2) ||
+            (16 + order * bits > GMT_CIC_MAX_BITS))
+            return NULL;
+    }
+    else if (mode == GMT_DECIM_BOXCAR)
+        order = 0;
+    else
+        return NULL;
+
+    /* the vector members need their natural alignment */
+    if (posix_memalign ((void **) &pd, sizeof (v4ll), sizeof (gmtDecim)) != 0)
+        return NULL;
+    memset (pd, 0, sizeof (gmtDecim));
+    pd->order  = order;
+    pd->factor = (order > 0) ? factor : 1;
+    pd->gain   = pow (pd->factor, order);
+    pd->warmup = order;
+    return pd;
+}
+
+
+
+/* release a decimation stage
+ */
+void  decimDestroy (gmtDecim *pd)
+{
+    free (pd);
+}
+
+
+
+/* feed one raw sensor value;
+ * returns 1 if the filter gave an output, or 0 if not
+ */
+int  decimPut (gmtDecim *pd, const magnBuffer *pm)
+{
+    v4ll   x = { pm->mgnX, pm->mgnY, pm->mgnZ, 0 };
+    v4ull  v, t;
+    int    i;
+
+    if (pd->order == 0)
+    {
+        boxAdd (pd, &x);
+        return 1;
+    }
+
+    pd->integ[0] += (v4ull) x;
+    for (i=1; i<pd->order; i++)
+        pd->integ[i] += pd->integ[i-1];
+    if (++pd->phase < pd->factor)
+        return 0;
+    pd->phase = 0;
+
+    v = pd->integ[pd->order - 1];
+    for (i=0; i<pd->order; i++)
+    {
+        t           = v;
+        v          -= pd->comb[i];
+        pd->comb[i] = t;
+    }
+
+    /* the first outputs still hold the start-up transient */
+    if (pd->warmup > 0)
+    {
+        pd->warmup--;
+        return 0;
+    }
+    x = (v4ll) v;
+    boxAdd (pd, &x);
+    return 1;
+}
+
+
+
+/* statistics of the period so far, in raw counts, and restart the
+ * boxcar; the CIC keeps running across periods;
+ * returns the number of filter outputs in the period
+ */
+unsigned long  decimResult (gmtDecim *pd, decimStats *ps)
+{
+    double  s, var;
+    int     i;
+
+    memset (ps, 0, sizeof (decimStats));
+    if ((ps->count = pd->n) == 0)
+        return 0;
+
+    for (i=0; i<GMT_AXES; i++)
+    {
+        s   = (double) pd->sum[i];
+        var = (pd->sq[i] - s * s / pd->n) / pd->n;
+
+        ps->mean[i]   = (pd->ref[i] + s / pd->n) / pd->gain;
+        ps->min[i]    = pd->min[i] / pd->gain;
+        ps->max[i]    = pd->max[i] / pd->gain;
+        ps->stddev[i] = (var > 0.0) ? sqrt (var) / pd->gain : 0.0;
+        ps->umean[i]  = (int) lround (ps->mean[i] * (1 << GMT_INT_FRAC_BITS));
+        ps->umin[i]   = (int) lround (ps->min[i]  * (1 << GMT_INT_FRAC_BITS));
+        ps->umax[i]   = (int) lround (ps->max[i]  * (1 << GMT_INT_FRAC_BITS));
+    }
+    pd->n = 0;
+    return ps->count;
+}
+
+
+
+/* add one filter output to the boxcar; by reference, vectors
+ * as arguments would depend on the SIMD extensions enabled
+ */
+static void  boxAdd (gmtDecim *pd, const v4ll *px)
+{
+    v4ll  x = *px;
+    v4ll  d, m;
+    v4df  f;
+
+    if (pd->n == 0)
+    {
+        pd->ref = pd->min = pd->max = x;
+        pd->sum = (v4ll) { 0, 0, 0, 0 };
+        pd->sq  = (v4df) { 0.0, 0.0, 0.0, 0.0 };
+    }
+
+    d        = x - pd->ref;
+    f        = __builtin_convertvector (d, v4df);
+    pd->sum += d;
+    pd->sq  += f * f;
+
+    /* lane-wise select; a comparison gives all bits set where true */
+    m       = x < pd->min;
+    pd->min = (x & m) | (pd->min & ~m);
+    m       = x > pd->max;
+    pd->max = (x & m) | (pd->max & ~m);
+    pd->n++;
+}
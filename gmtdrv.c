@@ -0,0 +1,403 @@
+/***************************************************************************
+ *                           gmtdrv.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the sensor drivers (LSM303DLHC,
+ *      HMC5883L, and a simulated sensor) and the i2c access
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#define _GNU_SOURCE     /* strcasestr() */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+
+#include "gmt.h"
+
+/* data registers, 3 x 16 bit big endian, in the order X, Z, Y
+ * for both devices */
+#define DRV_REG_DATA            0x03
+#define DRV_REG_ID              0x0A     /* identification "H43" */
+
+/* --- prototypes ----
+ */
+extern void       metAdd     (_Atomic unsigned long long *pc, unsigned long long n);
+extern void       metObserve (metHist *ph, long long ns);
+extern long long  metClock   (void);
+
+static int   i2cWrite     (int ifh, uchar addr, uchar reg, uchar val);
+static int   i2cRead      (int ifh, uchar addr, uchar reg, uchar *buf, int len);
+
+static int   xzyProbe     (gmtDevice *pd);
+static int   lsmConfigure (gmtDevice *pd, int rate);
+static int   hmcConfigure (gmtDevice *pd, int rate);
+static int   xzyReady     (gmtDevice *pd);
+static int   xzyRead      (gmtDevice *pd, uchar *raw);
+static void  xzyDecode    (const uchar *raw, int n, magnBuffer *pm);
+static void  linScale     (const magnBuffer *pm, int n, double scale, double *pv);
+
+static int   simProbe     (gmtDevice *pd);
+static int   simConfigure (gmtDevice *pd, int rate);
+static int   simReady     (gmtDevice *pd);
+static int   simRead      (gmtDevice *pd, uchar *raw);
+
+/* register setup; CRA gets the OD rate bits added */
+static const deviceConfig  lsmRegs = { DEVICE_ADDRESS_LSM303,  0x00, 0x01, 0x02, 0x00, 0x20, 0x00 };
+static const deviceConfig  hmcRegs = { DEVICE_ADDRESS_HMC5883, 0x00, 0x01, 0x02, 0x00, 0x00, 0x00 };
+
+/* the drivers, by GMT_DEVICE_* index */
+static const gmtDriver  drivers[GMT_DEVICE_COUNT] =
+{
+    { GMT_CFG_DEV_LSM303,  GMT_DEVICE_LSM303,  1, DEVICE_ADDRESS_LSM303,  7, FS_VALUE_LSM303,
+      xzyProbe, lsmConfigure, xzyReady, xzyRead, xzyDecode, linScale },
+    { GMT_CFG_DEV_HMC5883, GMT_DEVICE_HMC5883, 1, DEVICE_ADDRESS_HMC5883, 6, FS_VALUE_HMC5883,
+      xzyProbe, hmcConfigure, xzyReady, xzyRead, xzyDecode, linScale },
+    { GMT_CFG_DEV_SIM,     GMT_DEVICE_SIM,     0, 0,                      7, FS_VALUE_LSM303,
+      simProbe, simConfigure, simReady, simRead, xzyDecode, linScale }
+};
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* the driver of a device type (GMT_DEVICE_*), or NULL
+ */
+const gmtDriver  *drvGet (int device)
+{
+    if ((device < 0) || (device >= GMT_DEVICE_COUNT))
+        return NULL;
+    return &drivers[device];
+}
+
+
+
+/* find the driver for a config device name, e.g. "LSM303DLHC";
+ * not case sensitive; returns NULL if there is none
+ */
+const gmtDriver  *drvFind (const char *name)
+{
+    int  i;
+
+    if (!name)
+        return NULL;
+    for (i=0; i<GMT_DEVICE_COUNT; i++)
+        if (strcasestr (name, drivers[i].name))
+            return &drivers[i];
+    return NULL;
+}
+
+
+
+/* set up a device; <addr> 0 is the driver default address,
+ * <rate> the OD rate table index, limited to the device maximum;
+ * the device is probed, configured and started;
+ * returns 0 if ok, 1 if the device does not answer, or
+ * 2 if it cannot be configured
+ */
+int  devOpen (gmtDevice *pd, const gmtDriver *drv, int ifh, int addr, int rate)
+{
+    memset (pd, 0, sizeof (gmtDevice));
+    pd->drv   = drv;
+    pd->ifh   = ifh;
+    pd->addr  = (uchar) (addr ? addr : drv->addr);
+    pd->scale = drv->fullScale / SHORT_MAX_DBL;
+
+    if (rate > drv->maxRate)
+        rate = drv->maxRate;
+    pd->odRate = OD_rate_rtable[rate];
+
+    if (drv->probe (pd) != 0)
+        return 1;
+    if (drv->configure (pd, rate) != 0)
+        return 2;
+    return 0;
+}
+
+
+
+/* read and decode one sample; a failed read is repeated up to
+ * GMT_I2C_RETRIES times; the time taken and the retries are counted
+ * in the device metrics, and the first failure of a series reported
+ * returns 0 if read was ok, or != 0 on error
+ */
+int  devRead (gmtDevice *pd, magnBuffer *pm)
+{
+    uchar      raw[GMT_BURST_MAX];
+    long long  t0;
+    int        i, rv;
+
+    t0 = metClock ();
+    for (i=0; ((rv = pd->drv->readBurst (pd, raw)) != 0) && (i < GMT_I2C_RETRIES); i++)
+        if (pd->met)
+            metAdd (&pd->met->i2cRetries, 1);
+    if (pd->met)
+        metObserve (&pd->met->i2c, metClock () - t0);
+
+    if (rv != 0)
+    {
+        if (!pd->failing)
+            perror ("i2c read");
+        pd->failing = 1;
+        return 1;
+    }
+    pd->failing = 0;
+    pd->drv->decode (raw, 1, pm);
+    return 0;
+}
+
+
+
+/* check for a new conversion;
+ * returns 1 if there is one, 0 if not, or -1 on error
+ */
+int  devReady (gmtDevice *pd)
+{
+    return (pd->drv->ready (pd));
+}
+
+
+
+/* ---- LSM303DLHC / HMC5883L ----
+ */
+
+/* check the identification registers
+ */
+static int  xzyProbe (gmtDevice *pd)
+{
+    uchar  id[3];
+
+    if (i2cRead (pd->ifh, pd->addr, DRV_REG_ID, id, 3) != 0)
+        return 1;
+    if ((id[0] != 'H') || (id[1] != '4') || (id[2] != '3'))
+    {
+        fprintf (stderr, "%s at 0x%02x: unexpected id %02x %02x %02x\n", pd->drv->name,
+                 pd->addr, id[0], id[1], id[2]);
+        return 1;
+    }
+    return 0;
+}
+
+
+
+/* OD rate in CRA bits 4..2, gain 1.3G, continuous conversion
+ */
+static int  lsmConfigure (gmtDevice *pd, int rate)
+{
+    if ((i2cWrite (pd->ifh, pd->addr, lsmRegs.adr_cra,
+                   lsmRegs.regm_cra | (OD_rate_vtable[rate] << OD_LSM303_SHIFT)) != 0) ||
+        (i2cWrite (pd->ifh, pd->addr, lsmRegs.adr_crb, lsmRegs.regm_crb) != 0) ||
+        (i2cWrite (pd->ifh, pd->addr, lsmRegs.adr_mr,  lsmRegs.regm_mr) != 0))
+        return 1;
+    return 0;
+}
+
+
+
+/* OD rate in CRA bits 4..2, gain 0.88G, continuous conversion
+ */
+static int  hmcConfigure (gmtDevice *pd, int rate)
+{
+    if ((i2cWrite (pd->ifh, pd->addr, hmcRegs.adr_cra,
+                   hmcRegs.regm_cra | (OD_rate_vtable[rate] << OD_HMC5883_SHIFT)) != 0) ||
+        (i2cWrite (pd->ifh, pd->addr, hmcRegs.adr_crb, hmcRegs.regm_crb) != 0) ||
+        (i2cWrite (pd->ifh, pd->addr, hmcRegs.adr_mr,  hmcRegs.regm_mr) != 0))
+        return 1;
+    return 0;
+}
+
+
+
+/* DRDY bit of the status register
+ */
+static int  xzyReady (gmtDevice *pd)
+{
+    uchar  sr;
+
+    if (i2cRead (pd->ifh, pd->addr, DEVICE_REG_SR, &sr, 1) != 0)
+        return -1;
+    return ((sr & DEVICE_SR_DRDY) ? 1 : 0);
+}
+
+
+
+/* all data registers, in one transfer
+ */
+static int  xzyRead (gmtDevice *pd, uchar *raw)
+{
+    return (i2cRead (pd->ifh, pd->addr, DRV_REG_DATA, raw, 6));
+}
+
+
+
+/* <n> bursts of X, Z, Y big endian register pairs into samples
+ */
+static void  xzyDecode (const uchar *raw, int n, magnBuffer *pm)
+{
+    int  i;
+
+    for (i=0; i<n; i++, raw+=6, pm++)
+    {
+        pm->mgnX = (short) ((raw[0] << 8) | raw[1]);
+        pm->mgnZ = (short) ((raw[2] << 8) | raw[3]);
+        pm->mgnY = (short) ((raw[4] << 8) | raw[5]);
+    }
+}
+
+
+
+/* <n> samples to physical values, X / Y / Z per sample;
+ * linear over the full scale range, the same for all axes
+ */
+static void  linScale (const magnBuffer *pm, int n, double scale, double *pv)
+{
+    int  i;
+
+    for (i=0; i<n; i++, pm++, pv+=GMT_AXES)
+    {
+        pv[DI_X] = pm->mgnX * scale;
+        pv[DI_Y] = pm->mgnY * scale;
+        pv[DI_Z] = pm->mgnZ * scale;
+    }
+}
+
+
+
+/* ---- simulated sensor ----
+ * random values, converted at the OD rate from the time it is set up,
+ * with the same register layout as the real devices
+ */
+
+static int  simProbe (gmtDevice *pd)
+{
+    static unsigned short  count = 0;    /* own values per sensor */
+
+    pd->xsubi[0] = 0x330e;
+    pd->xsubi[1] = (unsigned short) pd->addr;
+    pd->xsubi[2] = count++;
+    return 0;
+}
+
+
+
+static int  simConfigure (gmtDevice *pd, int rate)
+{
+    clock_gettime (CLOCK_MONOTONIC, &pd->t0);
+    pd->conv = 0;
+    return 0;
+}
+
+
+
+/* a new conversion is ready once per OD period
+ */
+static int  simReady (gmtDevice *pd)
+{
+    struct timespec  ts;
+    unsigned long    conv;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    conv = (unsigned long) (((ts.tv_sec - pd->t0.tv_sec) +
+                             (ts.tv_nsec - pd->t0.tv_nsec) * 1.0e-9) * pd->odRate);
+    return ((conv > pd->conv) ? 1 : 0);
+}
+
+
+
+static int  simRead (gmtDevice *pd, uchar *raw)
+{
+    struct timespec  ts;
+    short            v;
+    int              i;
+
+    for (i=0; i<GMT_AXES; i++)
+    {
+        v = (short) ((2.0 * erand48 (pd->xsubi) - 1.0) * 1000.0);
+        raw[2*i]   = (uchar) ((v >> 8) & 0xff);
+        raw[2*i+1] = (uchar) (v & 0xff);
+    }
+
+    /* the current conversion is read */
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    pd->conv = (unsigned long) (((ts.tv_sec - pd->t0.tv_sec) +
+                                 (ts.tv_nsec - pd->t0.tv_nsec) * 1.0e-9) * pd->odRate);
+    return 0;
+}
+
+
+
+/* ---- i2c access ----
+ */
+
+/* write to an i2c slave device's register
+ */
+static int  i2cWrite (int ifh, uchar addr, uchar reg, uchar val)
+{
+    uchar                       outbuf[2];
+    struct i2c_msg              msgs[1];
+    struct i2c_rdwr_ioctl_data  msgset[1];
+
+    outbuf[0] = reg;
+    outbuf[1] = val;
+
+    msgs[0].addr  = addr;
+    msgs[0].flags = 0;
+    msgs[0].len   = 2;
+    msgs[0].buf   = outbuf;
+
+    msgset[0].msgs  = msgs;
+    msgset[0].nmsgs = 1;
+
+    if (ioctl (ifh, I2C_RDWR, &msgset) < 0)
+    {
+        perror ("i2c write");
+        return 1;
+    }
+    return 0;
+}
+
+
+
+/* read <len> registers of an i2c slave device, starting at <reg>
+ */
+static int  i2cRead (int ifh, uchar addr, uchar reg, uchar *buf, int len)
+{
+    struct i2c_msg              msgs[2];
+    struct i2c_rdwr_ioctl_data  msgset[1];
+
+    msgs[0].addr  = addr;
+    msgs[0].flags = 0;
+    msgs[0].len   = 1;
+    msgs[0].buf   = &reg;
+
+    msgs[1].addr  = addr;
+    msgs[1].flags = I2C_M_RD | I2C_M_NOSTART;
+    msgs[1].len   = (unsigned short) len;
+    msgs[1].buf   = buf;
+
+    msgset[0].msgs  = msgs;
+    msgset[0].nmsgs = 2;
+
+    if (ioctl (ifh, I2C_RDWR, &msgset) < 0)
+        return 1;
+    return 0;
+}
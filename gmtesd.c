@@ -0,0 +1,297 @@
+/***************************************************************************
+ *                           gmtesd.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the binary, memory-mapped day files
+ *      with one fixed-size slot per sample index
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "gmt.h"
+
+_Static_assert (sizeof (esdHeader) == ESD_HEADER_SIZE, "esdHeader size");
+
+/* --- prototypes ----
+ */
+void        esdClose (esdFile *pf);
+static int  esdMap   (esdFile *pf, int prot);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* open the binary day file <name> for writing, create and preallocate
+ * it if it does not exist yet; an existing file is reused only if the
+ * layout matches, otherwise opening fails; values are floats, or
+ * integer units of <scale> Ga for <dtype> ELFD_DTYPE_INT;
+ * returns 0 on success, 2 if the file exists with another layout,
+ * or another error number
+ */
+int  esdCreate (esdFile *pf, const char *name, struct tm *ptime, int period, int axes,
+                int mode, double fullScale, int dtype, double scale)
+{
+    esdHeader    h;
+    struct stat  st;
+    size_t       size, i;
+
+    memset (pf, 0, sizeof (esdFile));
+    memset (&h, 0, sizeof (h));
+    memcpy (h.id, ELFD_HEADER_ID, 4);
+    h.version   = ESD_VERSION;
+    h.dtype     = (unsigned char) ((dtype == ELFD_DTYPE_INT) ? ELFD_DTYPE_INT : ELFD_DTYPE_FLOAT);
+    h.axes      = (unsigned char) axes;
+    h.mode      = (unsigned char) mode;
+    h.year      = (unsigned short) (ptime->tm_year + 1900);
+    h.month     = (unsigned char) (ptime->tm_mon + 1);
+    h.mday      = (unsigned char) ptime->tm_mday;
+    h.period    = (unsigned int) period;
+    h.slots     = (unsigned int) ((24 * 3600) / period);
+    h.slotSize  = (unsigned int) (axes * sizeof (float));
+    h.hdrSize   = ESD_HEADER_SIZE;
+    h.fullScale = fullScale;
+    h.scale     = (h.dtype == ELFD_DTYPE_INT) ? scale : 0.0;
+    size        = h.hdrSize + (size_t) h.slots * h.slotSize;
+
+    if ((pf->fd = open (name, O_RDWR | O_CREAT, 0664)) < 0)
+        return 1;
+
+    if (fstat (pf->fd, &st) < 0)
+        goto err;
+
+    /* new file; allocate all blocks now, so the day never runs
+     * out of space, and mark all slots empty */
+    if (st.st_size == 0)
+    {
+        if (posix_fallocate (pf->fd, 0, size) != 0)
+            goto err;
+        pf->size     = size;
+        pf->writable = 1;
+        if (esdMap (pf, PROT_READ | PROT_WRITE))
+            goto err;
+        if (h.dtype == ELFD_DTYPE_INT)
+        {
+            for (i=0; i<(size - h.hdrSize) / sizeof (int); i++)
+                ((int *) pf->slots)[i] = GMT_INT_EMPTY;
+        }
+        else
+            memset (pf->slots, 0xFF, size - h.hdrSize);
+        memcpy (pf->hdr, &h, sizeof (h));
+        return 0;
+    }
+
+    /* existing file (restart during the day); must be identical */
+    if ((size_t) st.st_size != size)
+    {
+        close (pf->fd);
+        pf->fd = -1;
+        errno  = EINVAL;
+        return 2;
+    }
+    pf->size     = size;
+    pf->writable = 1;
+    if (esdMap (pf, PROT_READ | PROT_WRITE))
+        goto err;
+    if ((memcmp (pf->hdr->id, ELFD_HEADER_ID, 4) != 0) ||
+        (pf->hdr->period != h.period) || (pf->hdr->axes != h.axes) ||
+        (pf->hdr->dtype != h.dtype))
+    {
+        esdClose (pf);
+        errno = EINVAL;
+        return 2;
+    }
+    return 0;
+
+err:
+    close (pf->fd);
+    pf->fd = -1;
+    return 1;
+}
+
+
+
+/* open an existing binary day file for reading;
+ * returns 0 on success, or an error number
+ */
+int  esdOpen (esdFile *pf, const char *name)
+{
+    struct stat  st;
+
+    memset (pf, 0, sizeof (esdFile));
+    if ((pf->fd = open (name, O_RDONLY)) < 0)
+        return 1;
+
+    if ((fstat (pf->fd, &st) < 0) || (st.st_size < ESD_HEADER_SIZE))
+    {
+        close (pf->fd);
+        pf->fd = -1;
+        errno  = EINVAL;
+        return 2;
+    }
+
+    pf->size = (size_t) st.st_size;
+    if (esdMap (pf, PROT_READ))
+    {
+        close (pf->fd);
+        pf->fd = -1;
+        return 3;
+    }
+
+    if ((memcmp (pf->hdr->id, ELFD_HEADER_ID, 4) != 0) ||
+        (pf->hdr->version != ESD_VERSION) || (pf->hdr->slotSize == 0) ||
+        (pf->hdr->hdrSize + (size_t) pf->hdr->slots * pf->hdr->slotSize > pf->size))
+    {
+        esdClose (pf);
+        errno = EINVAL;
+        return 4;
+    }
+    return 0;
+}
+
+
+
+/* unmap and close the day file
+ */
+void  esdClose (esdFile *pf)
+{
+    if (pf->hdr)
+        munmap (pf->hdr, pf->size);
+    if (pf->fd >= 0)
+        close (pf->fd);
+    pf->hdr   = NULL;
+    pf->slots = NULL;
+    pf->fd    = -1;
+}
+
+
+
+/* store one sample in slot <idx>; floats, or integer units,
+ * as given by the file data type;
+ * returns 0 if stored, or 1 if the index is out of range
+ */
+int  esdPut (esdFile *pf, unsigned int idx, const void *pv)
+{
+    size_t  off;
+
+    if ((!pf->writable) || (idx >= pf->hdr->slots))
+        return 1;
+
+    off = ESD_HEADER_SIZE + (size_t) idx * pf->hdr->slotSize;
+    memcpy ((unsigned char *) pf->hdr + off, pv, pf->hdr->slotSize);
+
+    /* the range to force to the medium with the next esdSync */
+    if ((pf->dirtyHi == 0) || (off < pf->dirtyLo))
+        pf->dirtyLo = off;
+    if (off + pf->hdr->slotSize > pf->dirtyHi)
+        pf->dirtyHi = off + pf->hdr->slotSize;
+    return 0;
+}
+
+
+
+/* force the slots written since the last call to the storage
+ * medium; only the pages of that range are synced
+ * returns 0 on success, or 1 if syncing failed
+ */
+int  esdSync (esdFile *pf)
+{
+    size_t  page, lo;
+
+    if ((!pf->writable) || (pf->dirtyHi == 0))
+        return 0;
+
+    page = (size_t) sysconf (_SC_PAGESIZE);
+    lo   = pf->dirtyLo - (pf->dirtyLo % page);
+    if (msync ((unsigned char *) pf->hdr + lo, pf->dirtyHi - lo, MS_SYNC) != 0)
+    {
+        perror ("syncing binary data file");
+        return 1;
+    }
+    pf->dirtyLo = 0;
+    pf->dirtyHi = 0;
+    return 0;
+}
+
+
+
+/* return a pointer to the values of slot <idx>, floats or integer
+ * units as given by the file data type;
+ * returns NULL if the slot is empty or out of range
+ */
+const void  *esdSlot (esdFile *pf, unsigned int idx)
+{
+    const void  *pv;
+
+    if (idx >= pf->hdr->slots)
+        return NULL;
+
+    pv = pf->slots + (size_t) idx * pf->hdr->slotSize;
+    if (pf->hdr->dtype == ELFD_DTYPE_INT)
+        return ((*(const int *) pv == GMT_INT_EMPTY) ? NULL : pv);
+    return (isnan (*(const float *) pv) ? NULL : pv);
+}
+
+
+
+/* physical values of slot <idx>, into <pv> (one per axis of the file);
+ * integer units are scaled here;
+ * returns 1 if the slot has a sample, or 0 if it is empty
+ */
+int  esdGet (esdFile *pf, unsigned int idx, double *pv)
+{
+    const void  *ps;
+    unsigned int i;
+
+    if (!(ps = esdSlot (pf, idx)))
+        return 0;
+    for (i=0; i<pf->hdr->axes; i++)
+    {
+        if (pf->hdr->dtype == ELFD_DTYPE_INT)
+            pv[i] = ((const int *) ps)[i] * pf->hdr->scale;
+        else
+            pv[i] = ((const float *) ps)[i];
+    }
+    return 1;
+}
+
+
+
+/* map the file, and set the header / slot pointers;
+ * returns 0 on success
+ */
+static int  esdMap (esdFile *pf, int prot)
+{
+    void  *pm;
+
+    pm = mmap (NULL, pf->size, prot, MAP_SHARED, pf->fd, 0);
+    if (pm == MAP_FAILED)
+        return 1;
+
+    pf->hdr   = (esdHeader *) pm;
+    pf->slots = (unsigned char *) pm + ESD_HEADER_SIZE;
+    return 0;
+}
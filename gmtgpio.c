@@ -0,0 +1,116 @@
+/***************************************************************************
+ *                           gmtgpio.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the sensor data-ready (DRDY) line,
+ *      through the Linux gpio character device
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include "gmt.h"
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* request line <line> of gpio chip <chip> (e.g. "/dev/gpiochip0", or
+ * just "gpiochip0") as input, with events on the rising edge;
+ * returns the line event handle, or -1 on error
+ */
+int  gpioOpen (const char *chip, int line)
+{
+    struct gpio_v2_line_request  req;
+    char                         name[GMT_PN_SIZE + 8];
+    int                          cfd;
+
+    if (strchr (chip, '/'))
+        snprintf (name, sizeof (name), "%s", chip);
+    else
+        snprintf (name, sizeof (name), "/dev/%s", chip);
+
+    if ((cfd = open (name, O_RDONLY | O_CLOEXEC)) < 0)
+    {
+        perror (name);
+        return -1;
+    }
+
+    memset (&req, 0, sizeof (req));
+    req.offsets[0]        = (unsigned int) line;
+    req.num_lines         = 1;
+    req.config.flags      = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING;
+    req.event_buffer_size = GMT_DRDY_EVENTS;
+    strncpy (req.consumer, "gmt-drdy", sizeof (req.consumer) - 1);
+
+    if (ioctl (cfd, GPIO_V2_GET_LINE_IOCTL, &req) < 0)
+    {
+        perror ("requesting DRDY line");
+        close (cfd);
+        return -1;
+    }
+
+    /* the line handle stays valid without the chip handle */
+    close (cfd);
+    return req.fd;
+}
+
+
+
+/* wait for the next rising edge on the line, at most <ms> milliseconds;
+ * events queued meanwhile are consumed, so each edge is seen once;
+ * returns 1 on an edge, 0 on timeout, or -1 on error
+ */
+int  gpioWait (int fd, int ms)
+{
+    struct gpio_v2_line_event  ev[GMT_DRDY_EVENTS];
+    struct pollfd              pfd;
+    ssize_t                    n;
+    int                        rv;
+
+    pfd.fd     = fd;
+    pfd.events = POLLIN;
+
+    while ((rv = poll (&pfd, 1, ms)) < 0)
+    {
+        if (errno != EINTR)
+            return -1;
+    }
+    if (rv == 0)
+        return 0;
+
+    if ((n = read (fd, ev, sizeof (ev))) < (ssize_t) sizeof (ev[0]))
+        return -1;
+    return 1;
+}
+
+
+
+/* release the line
+ */
+void  gpioClose (int fd)
+{
+    if (fd >= 0)
+        close (fd);
+}
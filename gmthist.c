@@ -0,0 +1,444 @@
+/***************************************************************************
+ *                           gmthist.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the in-memory sample history, a ring
+ *      over several days with fast range aggregates
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "gmt.h"
+
+/*  Every slot holds the full-precision values of one sample period.
+ *  Slots are addressed by their absolute index (time / period), the
+ *  ring position is (index % ring). The ring has one slot more than
+ *  the retained history, so the prefix sum just before the oldest
+ *  retained slot is always still available.
+ *  - mean / stddev : running prefix sums of count, value and value^2;
+ *    the sums over a range are the difference of two prefix entries,
+ *    i.e. constant time; the prefix sums are rebased once per ring
+ *    cycle to keep their magnitude (and rounding error) small
+ *  - min / max : one segment tree per statistic over the ring positions;
+ *    update and range query in logarithmic time
+ */
+struct gmtHistory
+{
+    pthread_mutex_t  lock;
+    int              period;     /* seconds per slot              */
+    long             ring;       /* ring positions (slots + 1)    */
+    long             tsize;      /* segment tree leaves, 2^n      */
+    long             first;      /* oldest valid absolute index   */
+    long             last;       /* newest absolute index, or -1  */
+    double          *val;        /* [ring][GMT_AXES], NaN = empty */
+    double          *psum;       /* [ring][GMT_AXES] prefix sums  */
+    double          *psq;        /* [ring][GMT_AXES] prefix sq.   */
+    double          *pcnt;       /* [ring] prefix counts          */
+    double          *tmin;       /* [2*tsize][GMT_AXES]           */
+    double          *tmax;       /* [2*tsize][GMT_AXES]           */
+};
+
+/* --- prototypes ----
+ */
+void         histDestroy  (gmtHistory *ph);
+static void  histPutSlot  (gmtHistory *ph, long idx, const double *pv);
+static void  histRebase   (gmtHistory *ph);
+static void  treeUpdate   (gmtHistory *ph, long pos, const double *pv);
+static void  treeQuery    (gmtHistory *ph, long lo, long hi, double *pmin, double *pmax);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* create a history over <days> days, with one slot per <period> seconds;
+ * returns NULL if memory allocation failed
+ */
+gmtHistory  *histCreate (int days, int period)
+{
+    gmtHistory  *ph;
+    long         i, n;
+
+    if ((days < 1) || (period < 1))
+        return NULL;
+    if (!(ph = calloc (1, sizeof (gmtHistory))))
+        return NULL;
+
+    ph->period = period;
+    ph->ring   = ((long) days * 24 * 3600) / period + 1;
+    for (ph->tsize=1; ph->tsize<ph->ring; ph->tsize <<= 1)
+        ;
+    ph->first  = 0;
+    ph->last   = -1;
+
+    n = ph->ring * GMT_AXES;
+    ph->val  = malloc (n * sizeof (double));
+    ph->psum = calloc (n, sizeof (double));
+    ph->psq  = calloc (n, sizeof (double));
+    ph->pcnt = calloc (ph->ring, sizeof (double));
+    ph->tmin = malloc (2 * ph->tsize * GMT_AXES * sizeof (double));
+    ph->tmax = malloc (2 * ph->tsize * GMT_AXES * sizeof (double));
+    if (!ph->val || !ph->psum || !ph->psq || !ph->pcnt || !ph->tmin || !ph->tmax)
+    {
+        histDestroy (ph);
+        return NULL;
+    }
+
+    for (i=0; i<n; i++)
+        ph->val[i] = NAN;
+    for (i=0; i<2*ph->tsize*GMT_AXES; i++)
+    {
+        ph->tmin[i] = INFINITY;
+        ph->tmax[i] = -INFINITY;
+    }
+
+    pthread_mutex_init (&ph->lock, NULL);
+    return ph;
+}
+
+
+
+/* release all history memory
+ */
+void  histDestroy (gmtHistory *ph)
+{
+    if (!ph)
+        return;
+    free (ph->val);
+    free (ph->psum);
+    free (ph->psq);
+    free (ph->pcnt);
+    free (ph->tmin);
+    free (ph->tmax);
+    free (ph);
+}
+
+
+
+/* add the sample <pv> (GMT_AXES values) taken at time <t>;
+ * slots skipped since the last sample are marked empty, a second
+ * sample in the newest slot replaces it, older samples are ignored;
+ * returns 0 if stored, or 1 if ignored
+ */
+int  histAppend (gmtHistory *ph, time_t t, const double *pv)
+{
+    long  idx, k;
+
+    idx = (long) (t / ph->period);
+
+    pthread_mutex_lock (&ph->lock);
+
+    if ((ph->last >= 0) && (idx < ph->last))
+    {
+        pthread_mutex_unlock (&ph->lock);
+        return 1;
+    }
+
+    /* first sample, or a gap longer than the history; start over */
+    if ((ph->last < 0) || (idx - ph->last >= ph->ring))
+    {
+        for (k=0; k<ph->ring * GMT_AXES; k++)
+            ph->val[k] = NAN;
+        for (k=0; k<2*ph->tsize*GMT_AXES; k++)
+        {
+            ph->tmin[k] = INFINITY;
+            ph->tmax[k] = -INFINITY;
+        }
+        ph->first = idx;
+        ph->last  = idx - 1;
+
+        /* the prefix entry before the first slot is the zero base */
+        k = ((idx - 1) % ph->ring + ph->ring) % ph->ring;
+        ph->pcnt[k] = 0.0;
+        memset (ph->psum + k * GMT_AXES, 0, GMT_AXES * sizeof (double));
+        memset (ph->psq  + k * GMT_AXES, 0, GMT_AXES * sizeof (double));
+    }
+
+    /* fill the gap with empty slots */
+    for (k=ph->last+1; k<idx; k++)
+        histPutSlot (ph, k, NULL);
+
+    histPutSlot (ph, idx, pv);
+    ph->last = idx;
+    if (ph->first < ph->last - ph->ring + 2)
+        ph->first = ph->last - ph->ring + 2;
+
+    pthread_mutex_unlock (&ph->lock);
+    return 0;
+}
+
+
+
+/* aggregate all samples in the time range [from, to);
+ * the range is clipped to the retained history;
+ * returns the number of samples in the range (0: no data)
+ */
+unsigned long  histQuery (gmtHistory *ph, time_t from, time_t to, histStats *ps)
+{
+    long    a, b, pa, pb;
+    double  n, s, q, m, v;
+    int     i;
+
+    memset (ps, 0, sizeof (histStats));
+
+    pthread_mutex_lock (&ph->lock);
+
+    a = (long) (from / ph->period);
+    b = (long) ((to - 1) / ph->period);
+    if (a < ph->first)
+        a = ph->first;
+    if (b > ph->last)
+        b = ph->last;
+    if ((ph->last < 0) || (a > b))
+    {
+        pthread_mutex_unlock (&ph->lock);
+        return 0;
+    }
+
+    /* sums: difference of the prefix entries at <b> and before <a>;
+     * the ring has one spare position, so the one before <a> is valid */
+    pb = b % ph->ring;
+    pa = ((a - 1) % ph->ring + ph->ring) % ph->ring;
+    n  = ph->pcnt[pb] - ph->pcnt[pa];
+    ps->count = (unsigned long) (n + 0.5);
+
+    if (ps->count > 0)
+    {
+        for (i=0; i<GMT_AXES; i++)
+        {
+            s = ph->psum[pb * GMT_AXES + i] - ph->psum[pa * GMT_AXES + i];
+            q = ph->psq [pb * GMT_AXES + i] - ph->psq [pa * GMT_AXES + i];
+            m = s / n;
+            v = q / n - m * m;
+            ps->mean[i]   = m;
+            ps->stddev[i] = (v > 0.0) ? sqrt (v) : 0.0;
+        }
+
+        /* extremes; the range may wrap around the end of the ring */
+        pa = a % ph->ring;
+        if (pa <= pb)
+            treeQuery (ph, pa, pb, ps->min, ps->max);
+        else
+        {
+            double  mn[GMT_AXES], mx[GMT_AXES];
+
+            treeQuery (ph, pa, ph->ring - 1, ps->min, ps->max);
+            treeQuery (ph, 0, pb, mn, mx);
+            for (i=0; i<GMT_AXES; i++)
+            {
+                ps->min[i] = fmin (ps->min[i], mn[i]);
+                ps->max[i] = fmax (ps->max[i], mx[i]);
+            }
+        }
+    }
+
+    pthread_mutex_unlock (&ph->lock);
+    return ps->count;
+}
+
+
+
+/* copy the values of the slot holding time <t>;
+ * returns 1 if the slot has a sample, or 0 if empty / not retained
+ */
+int  histGet (gmtHistory *ph, time_t t, double *pv)
+{
+    long  idx;
+    int   rv = 0;
+
+    pthread_mutex_lock (&ph->lock);
+    idx = (long) (t / ph->period);
+    if ((ph->last >= 0) && (idx >= ph->first) && (idx <= ph->last))
+    {
+        memcpy (pv, ph->val + (idx % ph->ring) * GMT_AXES, GMT_AXES * sizeof (double));
+        rv = !isnan (pv[0]);
+    }
+    pthread_mutex_unlock (&ph->lock);
+    return rv;
+}
+
+
+
+/* time range currently held; returns 0 if the history is empty
+ */
+int  histSpan (gmtHistory *ph, time_t *pfrom, time_t *pto)
+{
+    int  rv = 0;
+
+    pthread_mutex_lock (&ph->lock);
+    if (ph->last >= 0)
+    {
+        *pfrom = (time_t) ph->first * ph->period;
+        *pto   = (time_t) (ph->last + 1) * ph->period;
+        rv     = 1;
+    }
+    pthread_mutex_unlock (&ph->lock);
+    return rv;
+}
+
+
+
+/* seconds per slot
+ */
+int  histPeriod (gmtHistory *ph)
+{
+    return ph->period;
+}
+
+
+
+/* write slot <idx> (values, or empty for NULL), and continue
+ * the prefix sums from the previous slot
+ */
+static void  histPutSlot (gmtHistory *ph, long idx, const double *pv)
+{
+    long     pos, prev;
+    double  *pval;
+    double   empty[GMT_AXES] = { NAN, NAN, NAN };
+    int      i;
+
+    pos  = idx % ph->ring;
+    prev = (pos > 0) ? pos - 1 : ph->ring - 1;
+
+    /* start of a new ring cycle; keep the prefix sums small */
+    if (pos == 0)
+        histRebase (ph);
+
+    pval = ph->val + pos * GMT_AXES;
+    if (!pv)
+        pv = empty;
+    memcpy (pval, pv, GMT_AXES * sizeof (double));
+
+    ph->pcnt[pos] = ph->pcnt[prev] + (isnan (pv[0]) ? 0.0 : 1.0);
+    for (i=0; i<GMT_AXES; i++)
+    {
+        ph->psum[pos * GMT_AXES + i] = ph->psum[prev * GMT_AXES + i];
+        ph->psq [pos * GMT_AXES + i] = ph->psq [prev * GMT_AXES + i];
+        if (!isnan (pv[0]))
+        {
+            ph->psum[pos * GMT_AXES + i] += pv[i];
+            ph->psq [pos * GMT_AXES + i] += pv[i] * pv[i];
+        }
+    }
+
+    treeUpdate (ph, pos, pv);
+}
+
+
+
+/* subtract the prefix entry just before the oldest needed slot
+ * from all prefix entries; called once per ring cycle, so the cost
+ * is constant per sample; stale entries are shifted as well, which
+ * does no harm
+ */
+static void  histRebase (gmtHistory *ph)
+{
+    long    k, pos, b;
+    double  bc, bs[GMT_AXES], bq[GMT_AXES];
+    int     i;
+
+    /* the new slot at position 0 drops the oldest slot, so the new
+     * base is the slot that is dropped next, i.e. position 1 */
+    b  = (ph->ring > 1) ? 1 : 0;
+    bc = ph->pcnt[b];
+    for (i=0; i<GMT_AXES; i++)
+    {
+        bs[i] = ph->psum[b * GMT_AXES + i];
+        bq[i] = ph->psq [b * GMT_AXES + i];
+    }
+
+    for (pos=0; pos<ph->ring; pos++)
+    {
+        ph->pcnt[pos] -= bc;
+        for (i=0; i<GMT_AXES; i++)
+        {
+            k = pos * GMT_AXES + i;
+            ph->psum[k] -= bs[i];
+            ph->psq [k] -= bq[i];
+        }
+    }
+}
+
+
+
+/* set the tree leaf of ring position <pos>, and update its parents
+ */
+static void  treeUpdate (gmtHistory *ph, long pos, const double *pv)
+{
+    long  n, l, r;
+    int   i;
+
+    n = ph->tsize + pos;
+    for (i=0; i<GMT_AXES; i++)
+    {
+        ph->tmin[n * GMT_AXES + i] = isnan (pv[0]) ? INFINITY  : pv[i];
+        ph->tmax[n * GMT_AXES + i] = isnan (pv[0]) ? -INFINITY : pv[i];
+    }
+
+    for (n >>= 1; n>0; n >>= 1)
+    {
+        l = 2 * n;
+        r = l + 1;
+        for (i=0; i<GMT_AXES; i++)
+        {
+            ph->tmin[n * GMT_AXES + i] = fmin (ph->tmin[l * GMT_AXES + i], ph->tmin[r * GMT_AXES + i]);
+            ph->tmax[n * GMT_AXES + i] = fmax (ph->tmax[l * GMT_AXES + i], ph->tmax[r * GMT_AXES + i]);
+        }
+    }
+}
+
+
+
+/* min / max over the ring positions [lo, hi]
+ */
+static void  treeQuery (gmtHistory *ph, long lo, long hi, double *pmin, double *pmax)
+{
+    long  l, r;
+    int   i;
+
+    for (i=0; i<GMT_AXES; i++)
+    {
+        pmin[i] = INFINITY;
+        pmax[i] = -INFINITY;
+    }
+
+    for (l = lo + ph->tsize, r = hi + ph->tsize + 1; l < r; l >>= 1, r >>= 1)
+    {
+        if (l & 1)
+        {
+            for (i=0; i<GMT_AXES; i++)
+            {
+                pmin[i] = fmin (pmin[i], ph->tmin[l * GMT_AXES + i]);
+                pmax[i] = fmax (pmax[i], ph->tmax[l * GMT_AXES + i]);
+            }
+            l++;
+        }
+        if (r & 1)
+        {
+            r--;
+            for (i=0; i<GMT_AXES; i++)
+            {
+                pmin[i] = fmin (pmin[i], ph->tmin[r * GMT_AXES + i]);
+                pmax[i] = fmax (pmax[i], ph->tmax[r * GMT_AXES + i]);
+            }
+        }
+    }
+}
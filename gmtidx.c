@@ -0,0 +1,721 @@
+/***************************************************************************
+ *                           gmtidx.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the data directory index, a
+ *      manifest of the day files with a time / offset map each
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "gmt.h"
+
+/*  The manifest is a header and the entries as they are in memory; it
+ *  is only read and written by this host. It is replaced as a whole,
+ *  by rename(), so the daemon and the tools can update it at any time.
+ */
+
+/* a day file being read, see idxReadDay() */
+typedef struct
+{
+    const idxEntry  *pe;
+    time_t           from;       /* range, epoch seconds          */
+    time_t           to;
+    time_t           hbase[IDX_HOURS];  /* epoch of each hour     */
+    idxSink          fn;
+    void            *arg;
+    int              n;          /* records passed on             */
+}
+idxDay;
+
+/* exact powers of ten; with up to 15 digits, a decimal number is
+ * (digits / 10^frac) with a single rounding, as strtod() gives it */
+static const double  decPow[16] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+};
+
+/* --- prototypes ----
+ */
+extern int          esdOpen   (esdFile *pf, const char *name);
+extern void         esdClose  (esdFile *pf);
+extern const void  *esdSlot   (esdFile *pf, unsigned int idx);
+extern int          esdGet    (esdFile *pf, unsigned int idx, double *pv);
+extern int          gmzOpen   (gmzReader *pr, const char *name);
+extern void         gmzClose  (gmzReader *pr);
+extern int          gmzNext   (gmzReader *pr, gmzItem *pi);
+
+void           idxClose  (gmtIndex *pi);
+static int     idxLoad   (gmtIndex *pi);
+static int     idxSave   (gmtIndex *pi);
+static int     dayName   (const char *name, idxEntry *pe);
+static int     scanFile  (const char *name, idxEntry *pe);
+static int     scanText  (FILE *fp, idxEntry *pe);
+static int     scanEsd   (const char *name, idxEntry *pe);
+static int     scanGmz   (const char *name, idxEntry *pe);
+static int     cmpEntry  (const void *pa, const void *pb);
+static int     readText  (idxDay *pd, const char *name);
+static int     readEsd   (idxDay *pd, const char *name);
+static int     readGmz   (idxDay *pd, const char *name);
+static int     putRecord (idxDay *pd, long tod, const double *pv, int cols, double scale);
+static int     parseLine (const char *p, long *ptod, double *pv);
+static const char *parseDouble (const char *p, double *pv);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* open the index of the data directory <path>; files changed since
+ * it was saved are indexed again, and the manifest is saved if any
+ * entry changed (not if the directory is read-only);
+ * returns 0 on success, or -1 if the directory cannot be read
+ */
+int  idxOpen (gmtIndex *pi, const char *path)
+{
+    char            name[FILENAME_MAXSIZE + 300];
+    DIR            *pd;
+    struct dirent  *pe;
+    struct stat     st;
+    idxEntry        key, *pold, *pnew = NULL, *pt;
+    int             nold, n = 0, alloc = 0, changed = 0;
+
+    memset (pi, 0, sizeof (gmtIndex));
+    strncpy (pi->path, path, FILENAME_MAXSIZE);
+    pi->path[FILENAME_MAXSIZE-1] = '\0';
+    if (!(pd = opendir (path)))
+        return -1;
+    idxLoad (pi);
+    pold = pi->entry;
+    nold = pi->count;
+
+    while ((pe = readdir (pd)) != NULL)
+    {
+        memset (&key, 0, sizeof (key));
+        if (dayName (pe->d_name, &key) != 0)
+            continue;
+        snprintf (name, sizeof (name), "%s/%s", path, pe->d_name);
+        if (stat (name, &st) != 0)
+            continue;
+
+        if (n >= alloc)
+        {
+            alloc = alloc ? alloc * 2 : 256;
+            if (!(pt = realloc (pnew, alloc * sizeof (idxEntry))))
+                break;
+            pnew = pt;
+        }
+
+        /* unchanged files keep their entries */
+        pt = nold ? bsearch (&key, pold, nold, sizeof (idxEntry), cmpEntry) : NULL;
+        if (pt && (pt->size == st.st_size) && (pt->mtime == st.st_mtime))
+        {
+            pnew[n++] = *pt;
+            continue;
+        }
+        key.size  = st.st_size;
+        key.mtime = st.st_mtime;
+        if (scanFile (name, &key) != 0)
+            continue;
+        pnew[n++] = key;
+        changed   = 1;
+    }
+    closedir (pd);
+
+    if (n != nold)
+        changed = 1;
+    if (n > 1)
+        qsort (pnew, n, sizeof (idxEntry), cmpEntry);
+    free (pold);
+    pi->entry = pnew;
+    pi->count = n;
+    pi->alloc = alloc;
+
+    if (changed)
+        idxSave (pi);
+    return 0;
+}
+
+
+
+/* release an index
+ */
+void  idxClose (gmtIndex *pi)
+{
+    free (pi->entry);
+    pi->entry = NULL;
+    pi->count = pi->alloc = 0;
+}
+
+
+
+/* bring the manifest of <path> up to date, e.g. at a day change;
+ * returns 0 on success, or -1 if the directory cannot be read
+ */
+int  idxUpdate (const char *path)
+{
+    gmtIndex  gi;
+
+    if (idxOpen (&gi, path) != 0)
+        return -1;
+    idxClose (&gi);
+    return 0;
+}
+
+
+
+/* the file to read for a day; binary, text, or archive file, in
+ * this order, as the query server does; <tag> names the sensor,
+ * NULL or empty for the first one;
+ * returns its entry, or NULL if there is no file for that day
+ */
+const idxEntry  *idxFind (gmtIndex *pi, int year, int mon, int mday, const char *tag)
+{
+    static const char  *ext[3] = { ESD_FILE_EXT, ".dat", GMZ_FILE_EXT };
+    idxEntry            key;
+    const idxEntry     *pe;
+    int                 i;
+
+    for (i=0; i<3; i++)
+    {
+        if ((tag && tag[0]))
+            snprintf (key.name, sizeof (key.name), "%04d_%02d_%02d_%s%s", year, mon, mday, tag, ext[i]);
+        else
+            snprintf (key.name, sizeof (key.name), "%04d_%02d_%02d%s", year, mon, mday, ext[i]);
+        if (pi->count && (pe = bsearch (&key, pi->entry, pi->count, sizeof (idxEntry), cmpEntry)))
+            return pe;
+    }
+    return NULL;
+}
+
+
+
+/* read the records of the day file <pe> in <path> with a time in
+ * [from, to), epoch seconds; each one is passed to <fn>, with <arg>,
+ * its time, the second of the day in the file, and its values in Ga;
+ * reading ends early if <fn> does not return 0;
+ * returns the number of records passed, or -1 if the file cannot
+ * be read
+ */
+int  idxReadDay (const char *path, const idxEntry *pe, time_t from, time_t to,
+                 idxSink fn, void *arg)
+{
+    char       name[FILENAME_MAXSIZE + 64];
+    idxDay     day;
+    struct tm  tm;
+    int        i, rv;
+
+    memset (&day, 0, sizeof (day));
+    day.pe   = pe;
+    day.from = from;
+    day.to   = to;
+    day.fn   = fn;
+    day.arg  = arg;
+
+    /* the file is named by local time; each hour on its own, for
+     * the days of a DST change */
+    for (i=0; i<IDX_HOURS; i++)
+    {
+        memset (&tm, 0, sizeof (tm));
+        tm.tm_year  = pe->year - 1900;
+        tm.tm_mon   = pe->month - 1;
+        tm.tm_mday  = pe->mday;
+        tm.tm_hour  = i;
+        tm.tm_isdst = -1;
+        day.hbase[i] = mktime (&tm);
+    }
+    if ((day.hbase[0] >= to) || (day.hbase[IDX_HOURS-1] + 3600 <= from))
+        return 0;
+
+    snprintf (name, sizeof (name), "%s/%s", path, pe->name);
+    if (pe->kind == IDX_KIND_ESD)
+        rv = readEsd (&day, name);
+    else if (pe->kind == IDX_KIND_GMZ)
+        rv = readGmz (&day, name);
+    else
+        rv = readText (&day, name);
+    return (rv < 0) ? -1 : day.n;
+}
+
+
+
+/* read the manifest, if there is a valid one;
+ * returns 0 on success, or -1 if not
+ */
+static int  idxLoad (gmtIndex *pi)
+{
+    char           name[FILENAME_MAXSIZE + 32];
+    unsigned char  hdr[IDX_HEADER_SIZE];
+    unsigned int   count, esize;
+    FILE          *fp;
+
+    snprintf (name, sizeof (name), "%s/%s", pi->path, IDX_FILE_NAME);
+    if (!(fp = fopen (name, "r")))
+        return -1;
+
+    if ((fread (hdr, 1, sizeof (hdr), fp) != sizeof (hdr)) ||
+        (memcmp (hdr, IDX_HEADER_ID, 4) != 0) || (hdr[4] != IDX_VERSION))
+    {
+        fclose (fp);
+        return -1;
+    }
+    memcpy (&count, hdr + 8, sizeof (count));
+    memcpy (&esize, hdr + 12, sizeof (esize));
+    if ((esize != sizeof (idxEntry)) || (count > (1U << 20)) ||
+        (count && !(pi->entry = malloc (count * sizeof (idxEntry)))))
+    {
+        fclose (fp);
+        return -1;
+    }
+    if (fread (pi->entry, sizeof (idxEntry), count, fp) != count)
+    {
+        free (pi->entry);
+        pi->entry = NULL;
+        fclose (fp);
+        return -1;
+    }
+    fclose (fp);
+    pi->count = pi->alloc = (int) count;
+    return 0;
+}
+
+
+
+/* write the manifest; to a temporary file first, which then
+ * replaces the old one;
+ * returns 0 on success, or -1 on error
+ */
+static int  idxSave (gmtIndex *pi)
+{
+    char           name[FILENAME_MAXSIZE + 32], tmp[FILENAME_MAXSIZE + 64];
+    unsigned char  hdr[IDX_HEADER_SIZE];
+    unsigned int   count = (unsigned int) pi->count, esize = sizeof (idxEntry);
+    FILE          *fp;
+    int            rv;
+
+    snprintf (name, sizeof (name), "%s/%s", pi->path, IDX_FILE_NAME);
+    snprintf (tmp, sizeof (tmp), "%s.%d", name, (int) getpid ());
+    if (!(fp = fopen (tmp, "w")))
+        return -1;
+
+    memset (hdr, 0, sizeof (hdr));
+    memcpy (hdr, IDX_HEADER_ID, 4);
+    hdr[4] = IDX_VERSION;
+    memcpy (hdr + 8, &count, sizeof (count));
+    memcpy (hdr + 12, &esize, sizeof (esize));
+    fwrite (hdr, 1, sizeof (hdr), fp);
+    fwrite (pi->entry, sizeof (idxEntry), count, fp);
+
+    rv = ferror (fp) ? -1 : 0;
+    if ((fclose (fp) != 0) || (rv != 0) || (rename (tmp, name) != 0))
+    {
+        unlink (tmp);
+        return -1;
+    }
+    return 0;
+}
+
+
+
+/* check a file name for "YYYY_MM_DD[_<tag>].<ext>", a day file,
+ * and fill in name, date and kind of <pe>;
+ * returns 0 if it is one, or -1 if not
+ */
+static int  dayName (const char *name, idxEntry *pe)
+{
+    const char  *pext;
+    int          y, m, d;
+
+    if ((strlen (name) >= IDX_NAME_SIZE) || !(pext = strrchr (name, '.')) ||
+        (sscanf (name, "%4d_%2d_%2d", &y, &m, &d) != 3) ||
+        (name[10] != '.' && name[10] != '_'))
+        return -1;
+
+    if (strcmp (pext, ".dat") == 0)
+        pe->kind = IDX_KIND_DAT;
+    else if (strcmp (pext, ESD_FILE_EXT) == 0)
+        pe->kind = IDX_KIND_ESD;
+    else if (strcmp (pext, GMZ_FILE_EXT) == 0)
+        pe->kind = IDX_KIND_GMZ;
+    else
+        return -1;
+
+    strcpy (pe->name, name);
+    pe->year  = (unsigned short) y;
+    pe->month = (unsigned char) m;
+    pe->mday  = (unsigned char) d;
+    return 0;
+}
+
+
+
+/* index the day file <name>, of the kind given in <pe>;
+ * returns 0 on success, or -1 if it cannot be read
+ */
+static int  scanFile (const char *name, idxEntry *pe)
+{
+    FILE  *fp;
+    int    rv;
+
+    pe->first  = pe->last = -1;
+    pe->scale  = 1.0;
+    pe->linear = 1;
+    if (pe->kind == IDX_KIND_ESD)
+        return scanEsd (name, pe);
+    if (pe->kind == IDX_KIND_GMZ)
+        return scanGmz (name, pe);
+
+    if (!(fp = fopen (name, "r")))
+        return -1;
+    rv = scanText (fp, pe);
+    fclose (fp);
+    return rv;
+}
+
+
+
+/* index a text day file; the offset of the first record of each
+ * hour, hours without records point to the next one;
+ * returns 0 on success, or -1 on a read error
+ */
+static int  scanText (FILE *fp, idxEntry *pe)
+{
+    char    lbuf[GMZ_LINE_MAX];
+    long    off = 0, tod;
+    double  scale = 1.0, a, v[GMT_AXES];
+    int     h, n;
+
+    for (h=0; h<IDX_HOURS; h++)
+        pe->hour[h] = (unsigned int) -1;
+
+    for (; fgets (lbuf, sizeof (lbuf), fp); off += (long) strlen (lbuf))
+    {
+        if (lbuf[0] == '#')
+        {
+            if (sscanf (lbuf, "# scale value = %lf", &a) == 1)
+                scale = a;
+            else if (strncmp (lbuf, "# -- ", 5) == 0)
+                scale = 1.0;
+            continue;
+        }
+        if ((n = parseLine (lbuf, &tod, v)) < 1)
+            continue;
+
+        if (pe->records == 0)
+        {
+            pe->first = (int) tod;
+            pe->scale = scale;
+            pe->cols  = (unsigned char) n;
+        }
+        else if ((tod < pe->last) || (scale != pe->scale))
+            pe->linear = 0;
+        h = (int) (tod / 3600);
+        if (pe->hour[h] == (unsigned int) -1)
+            pe->hour[h] = (unsigned int) off;
+        pe->last = (int) tod;
+        pe->records++;
+    }
+
+    for (h=IDX_HOURS-1; h>=0; h--)
+        if (pe->hour[h] == (unsigned int) -1)
+            pe->hour[h] = (h < IDX_HOURS - 1) ? pe->hour[h+1] : (unsigned int) off;
+    return (ferror (fp) ? -1 : 0);
+}
+
+
+
+/* index a binary day file; used slots, first and last
+ * returns 0 on success, or -1 if it cannot be read
+ */
+static int  scanEsd (const char *name, idxEntry *pe)
+{
+    esdFile       esd;
+    unsigned int  i;
+
+    if (esdOpen (&esd, name) != 0)
+        return -1;
+    pe->cols = esd.hdr->axes;
+    for (i=0; i<esd.hdr->slots; i++)
+    {
+        if (!esdSlot (&esd, i))
+            continue;
+        if (pe->records++ == 0)
+            pe->first = (int) (i * esd.hdr->period);
+        pe->last = (int) (i * esd.hdr->period);
+    }
+    esdClose (&esd);
+    return 0;
+}
+
+
+
+/* index an archive day file; it is decoded as a whole anyway,
+ * so only first and last record
+ * returns 0 on success, or -1 if it cannot be read
+ */
+static int  scanGmz (const char *name, idxEntry *pe)
+{
+    gmzReader  gr;
+    gmzItem    gi;
+    int        rv;
+
+    if (gmzOpen (&gr, name) != 0)
+        return -1;
+    while ((rv = gmzNext (&gr, &gi)) > 0)
+    {
+        if (gi.kind != GMZ_ITEM_RECORD)
+            continue;
+        if (pe->records++ == 0)
+        {
+            pe->first = (int) gi.tod;
+            pe->cols  = (unsigned char) ((gi.cols > GMT_AXES) ? GMT_AXES : gi.cols);
+        }
+        pe->last = (int) gi.tod;
+    }
+    gmzClose (&gr);
+    return (rv < 0) ? -1 : 0;
+}
+
+
+
+/* records of a text day file; from the offset of the first hour
+ * needed, up to the end of the range, if the index allows; the part
+ * is read at once, and parsed in memory
+ * returns 0 on success, or -1 if the file cannot be read
+ */
+static int  readText (idxDay *pd, const char *name)
+{
+    const idxEntry  *pe = pd->pe;
+    double           v[GMT_AXES], scale = 1.0, a;
+    FILE            *fp;
+    char            *pb, *pl, *pn;
+    long             off = 0, size, tod;
+    int              h, n;
+
+    if (!(fp = fopen (name, "r")))
+        return -1;
+
+    /* the first hour with data in the range */
+    if (pe->linear)
+    {
+        scale = pe->scale;
+        for (h=IDX_HOURS-1; (h > 0) && (pd->hbase[h] > pd->from); h--)
+            ;
+        off = (long) pe->hour[h];
+    }
+    if ((fseek (fp, 0, SEEK_END) != 0) || ((size = ftell (fp) - off) < 0) ||
+        (fseek (fp, off, SEEK_SET) != 0) || !(pb = malloc ((size_t) size + 1)))
+    {
+        fclose (fp);
+        return -1;
+    }
+    size     = (long) fread (pb, 1, (size_t) size, fp);
+    pb[size] = '\0';
+    fclose (fp);
+
+    for (pl=pb; pl < pb + size; pl=pn)
+    {
+        if ((pn = strchr (pl, '\n')))
+            *pn++ = '\0';
+        else
+            pn = pb + size;
+
+        if (pl[0] == '#')
+        {
+            if (sscanf (pl, "# scale value = %lf", &a) == 1)
+                scale = a;
+            else if (strncmp (pl, "# -- ", 5) == 0)
+                scale = 1.0;
+            continue;
+        }
+        if ((n = parseLine (pl, &tod, v)) < 1)
+            continue;
+        if (pe->linear && (pd->hbase[tod / 3600] + tod % 3600 >= pd->to))
+            break;
+        if (putRecord (pd, tod, v, n, scale) != 0)
+            break;
+    }
+    free (pb);
+    return 0;
+}
+
+
+
+/* records of a binary day file
+ * returns 0 on success, or -1 if the file cannot be read
+ */
+static int  readEsd (idxDay *pd, const char *name)
+{
+    esdFile       esd;
+    double        v[GMT_AXES];
+    unsigned int  i;
+
+    if (esdOpen (&esd, name) != 0)
+        return -1;
+    for (i=0; i<esd.hdr->slots; i++)
+        if (esdGet (&esd, i, v) && (putRecord (pd, (long) (i * esd.hdr->period), v, esd.hdr->axes, 1.0) != 0))
+            break;
+    esdClose (&esd);
+    return 0;
+}
+
+
+
+/* records of an archive day file
+ * returns 0 on success, or -1 if the file cannot be read
+ */
+static int  readGmz (idxDay *pd, const char *name)
+{
+    gmzReader  gr;
+    gmzItem    gi;
+    double     scale = 1.0, a;
+
+    if (gmzOpen (&gr, name) != 0)
+        return -1;
+    while (gmzNext (&gr, &gi) > 0)
+    {
+        if (gi.kind == GMZ_ITEM_TEXT)
+        {
+            if (sscanf (gi.text, "# scale value = %lf", &a) == 1)
+                scale = a;
+            else if (strncmp (gi.text, "# -- ", 5) == 0)
+                scale = 1.0;
+            continue;
+        }
+        if (putRecord (pd, gi.tod, gi.v, (gi.cols > GMT_AXES) ? GMT_AXES : gi.cols, scale) != 0)
+            break;
+    }
+    gmzClose (&gr);
+    return 0;
+}
+
+
+
+/* pass one record on, at second <tod> of the day, if in the range
+ * returns the result of the sink, or 0 if not passed
+ */
+static int  putRecord (idxDay *pd, long tod, const double *pv, int cols, double scale)
+{
+    double  v[GMT_AXES];
+    time_t  t;
+    int     i;
+
+    if ((tod < 0) || (tod >= IDX_HOURS * 3600))
+        return 0;
+    t = pd->hbase[tod / 3600] + tod % 3600;
+    if ((t < pd->from) || (t >= pd->to))
+        return 0;
+
+    for (i=0; i<cols; i++)
+        v[i] = pv[i] * scale;
+    pd->n++;
+    return pd->fn (pd->arg, t, tod, v, cols);
+}
+
+
+
+/* parse a record line "HH:MM[:SS], <value>[, <value> ...]"; the time
+ * into seconds of the day, up to GMT_AXES values into <pv>;
+ * returns the number of values, or -1 if it is no record
+ */
+static int  parseLine (const char *p, long *ptod, double *pv)
+{
+    long  t[3] = { 0, 0, 0 };
+    int   i, n;
+
+    for (n=0; n<3; n++)
+    {
+        if ((*p < '0') || (*p > '9'))
+            return -1;
+        for (; (*p >= '0') && (*p <= '9'); p++)
+            t[n] = t[n] * 10 + (*p - '0');
+        if (*p != ':')
+            break;
+        p++;
+    }
+    if ((n < 1) || (n > 2) || (t[0] >= IDX_HOURS) || (t[1] > 59) || (t[2] > 59))
+        return -1;
+    *ptod = (t[0] * 60 + t[1]) * 60 + t[2];
+
+    for (i=0; (i < GMT_AXES) && (*p == ','); i++)
+    {
+        for (p++; *p == ' '; p++)
+            ;
+        if (!(p = parseDouble (p, &pv[i])))
+            return -1;
+    }
+    return (i > 0) ? i : -1;
+}
+
+
+
+/* parse a decimal number; "[-]<digits>[.<digits>]" directly, anything
+ * else (exponents, more digits) with strtod();
+ * returns the end of the number, or NULL if there is none
+ */
+static const char  *parseDouble (const char *p, double *pv)
+{
+    const char  *ps = p;
+    char        *pe;
+    long long    m = 0;
+    int          neg = 0, digits = 0, frac = -1;
+
+    if (*p == '-')
+    {
+        neg = 1;
+        p++;
+    }
+    for (; ((*p >= '0') && (*p <= '9')) || ((*p == '.') && (frac < 0)); p++)
+    {
+        if (*p == '.')
+        {
+            frac = 0;
+            continue;
+        }
+        m = m * 10 + (*p - '0');
+        if (frac >= 0)
+            frac++;
+        if (++digits > 15)
+            break;
+    }
+    if ((digits == 0) || (digits > 15) || (*p == 'e') || (*p == 'E'))
+    {
+        *pv = strtod (ps, &pe);
+        return (pe != ps) ? pe : NULL;
+    }
+
+    *pv = (double) m / decPow[(frac > 0) ? frac : 0];
+    if (neg)
+        *pv = -*pv;
+    return p;
+}
+
+
+
+/* order of entries, by file name
+ */
+static int  cmpEntry (const void *pa, const void *pb)
+{
+    return strcmp (((const idxEntry *) pa)->name, ((const idxEntry *) pb)->name);
+}
@@ -0,0 +1,191 @@
+/***************************************************************************
+ *                           gmtloop.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the event loop of the main thread,
+ *      one epoll set for timers, signals and sockets
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+
+#include "gmt.h"
+
+typedef struct
+{
+    int           fd;            /* -1 if the entry is free       */
+    loopHandler   fn;
+    void         *arg;
+}
+loopSource;
+
+struct gmtLoop
+{
+    int           efd;           /* epoll handle                  */
+    int           sfd;           /* signalfd, or -1               */
+    loopSource    src[GMT_LOOP_SOURCES];
+};
+
+/* --- prototypes ----
+ */
+int   loopAdd (gmtLoop *pl, int fd, unsigned int events, loopHandler fn, void *arg);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* create an event loop, without sources
+ * returns NULL on error
+ */
+gmtLoop  *loopCreate (void)
+{
+    gmtLoop  *pl;
+    int       i;
+
+    if (!(pl = calloc (1, sizeof (gmtLoop))))
+        return NULL;
+    if ((pl->efd = epoll_create1 (EPOLL_CLOEXEC)) < 0)
+    {
+        free (pl);
+        return NULL;
+    }
+    pl->sfd = -1;
+    for (i=0; i<GMT_LOOP_SOURCES; i++)
+        pl->src[i].fd = -1;
+    return pl;
+}
+
+
+
+/* release an event loop, and its signalfd; the other descriptors
+ * belong to those who added them; <pl> may be NULL
+ */
+void  loopDestroy (gmtLoop *pl)
+{
+    if (!pl)
+        return;
+    if (pl->sfd >= 0)
+        close (pl->sfd);
+    close (pl->efd);
+    free (pl);
+}
+
+
+
+/* add the descriptor <fd>, for the epoll <events>; <fn> is called with
+ * <arg> when one of them occurs
+ * returns 0, or -1 if the loop is full, or on error
+ */
+int  loopAdd (gmtLoop *pl, int fd, unsigned int events, loopHandler fn, void *arg)
+{
+    struct epoll_event  ev;
+    int                 i;
+
+    for (i=0; (i < GMT_LOOP_SOURCES) && (pl->src[i].fd >= 0); i++)
+        ;
+    if (i == GMT_LOOP_SOURCES)
+    {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    memset (&ev, 0, sizeof (ev));
+    ev.events   = events;
+    ev.data.u32 = (unsigned int) i;
+    if (epoll_ctl (pl->efd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        return -1;
+    pl->src[i].fd  = fd;
+    pl->src[i].fn  = fn;
+    pl->src[i].arg = arg;
+    return 0;
+}
+
+
+
+/* remove the descriptor <fd> from the loop; it is not closed
+ */
+void  loopDel (gmtLoop *pl, int fd)
+{
+    int  i;
+
+    if (!pl || (fd < 0))
+        return;
+    for (i=0; i<GMT_LOOP_SOURCES; i++)
+    {
+        if (pl->src[i].fd != fd)
+            continue;
+        epoll_ctl (pl->efd, EPOLL_CTL_DEL, fd, NULL);
+        pl->src[i].fd = -1;
+    }
+}
+
+
+
+/* take the signals of <pset> as events; they must be blocked in all
+ * threads (before any thread is started), <fn> reads their
+ * signalfd_siginfo from the descriptor it is given
+ * returns 0, or -1 on error
+ */
+int  loopSignals (gmtLoop *pl, const sigset_t *pset, loopHandler fn, void *arg)
+{
+    if ((pl->sfd = signalfd (-1, pset, SFD_NONBLOCK | SFD_CLOEXEC)) < 0)
+        return -1;
+    if (loopAdd (pl, pl->sfd, EPOLLIN, fn, arg) != 0)
+    {
+        close (pl->sfd);
+        pl->sfd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+
+
+/* wait for events, and call their handlers, until one of them returns
+ * non-zero; the thread sleeps in between
+ * returns 0 if a handler ended the loop, or -1 on error
+ */
+int  loopRun (gmtLoop *pl)
+{
+    struct epoll_event  ev[GMT_LOOP_EVENTS];
+    loopSource         *ps;
+    int                 i, n, done = 0;
+
+    while (!done)
+    {
+        if ((n = epoll_wait (pl->efd, ev, GMT_LOOP_EVENTS, -1)) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror ("event loop");
+            return -1;
+        }
+        for (i=0; i<n; i++)
+        {
+            ps = &pl->src[ev[i].data.u32];
+            if ((ps->fd >= 0) && (ps->fn (ps->arg, ps->fd, ev[i].events) != 0))
+                done = 1;
+        }
+    }
+    return 0;
+}
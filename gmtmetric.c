@@ -0,0 +1,463 @@
+/***************************************************************************
+ *                           gmtmetric.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the runtime metrics, their lock-free
+ *      updates, and the export as Prometheus text, by file and HTTP
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#define _GNU_SOURCE     /* accept4() */
+#include <unistd.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+
+#include "gmt.h"
+
+/*  The hot path only ever does relaxed atomic adds and stores; the
+ *  exporter reads each value on its own, so a scrape may see a sample
+ *  counted, and its histogram entry not yet. That is fine for metrics.
+ */
+struct gmtMetricServer
+{
+    gmtMetrics     *pm;
+    int             lfd;         /* HTTP socket, or -1             */
+    int             wfd;         /* eventfd, stop request          */
+    int             interval;    /* file rewrite, s                */
+    pthread_t       thread;
+    char            file[FILENAME_MAXSIZE];  /* "" = no file       */
+};
+
+/* --- prototypes ----
+ */
+void           metDestroy  (gmtMetricServer *ps);
+static void   *metThread   (void *arg);
+static void    metAnswer   (gmtMetricServer *ps);
+static int     metFile     (gmtMetricServer *ps);
+static void    metText     (gmtMetrics *pm, FILE *fp);
+static void    putCounter  (FILE *fp, const char *name, const char *help, gmtMetrics *pm, size_t off);
+static void    putHist     (FILE *fp, const char *name, const char *label, const metHist *ph);
+static unsigned long long  getU (const _Atomic unsigned long long *pc);
+static long long           getS (const _Atomic long long *pg);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* count <n> more
+ */
+void  metAdd (_Atomic unsigned long long *pc, unsigned long long n)
+{
+    atomic_fetch_add_explicit (pc, n, memory_order_relaxed);
+}
+
+
+
+/* set a gauge
+ */
+void  metSet (_Atomic long long *pg, long long v)
+{
+    atomic_store_explicit (pg, v, memory_order_relaxed);
+}
+
+
+
+/* count a duration of <ns> in histogram <ph>
+ */
+void  metObserve (metHist *ph, long long ns)
+{
+    unsigned long long  us;
+    int                 i;
+
+    if (ns < 0)
+        ns = 0;
+    /* bin i holds (2^(i-1), 2^i] us, as the le labels of putHist;
+     * the bit length of the rounded up us, less one */
+    us = ((unsigned long long) ns + 999) / 1000;
+    i  = (us > 1) ? 64 - __builtin_clzll (us - 1) : 0;
+    if (i > MET_BINS - 1)
+        i = MET_BINS - 1;
+    atomic_fetch_add_explicit (&ph->bin[i], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit (&ph->sum, (unsigned long long) ns, memory_order_relaxed);
+}
+
+
+
+/* monotonic time, to measure durations with
+ * returns nanoseconds
+ */
+long long  metClock (void)
+{
+    struct timespec  ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+
+/* start the exporter of <pm>; the text goes to <file> every <interval>
+ * seconds (none if empty), and is served on 127.0.0.1:<port> (none
+ * if 0);
+ * returns NULL on error
+ */
+gmtMetricServer  *metCreate (gmtMetrics *pm, const char *file, int port, int interval)
+{
+    gmtMetricServer     *ps;
+    struct sockaddr_in   sa;
+    int                  on = 1;
+
+    if (!(ps = calloc (1, sizeof (gmtMetricServer))))
+        return NULL;
+    ps->pm       = pm;
+    ps->lfd      = ps->wfd = -1;
+    ps->interval = (interval > 0) ? interval : MET_INTERVAL;
+    if (file)
+        strncpy (ps->file, file, FILENAME_MAXSIZE - 1);
+
+    /* loopback only; the numbers are for the local collector */
+    if (port > 0)
+    {
+        memset (&sa, 0, sizeof (sa));
+        sa.sin_family      = AF_INET;
+        sa.sin_port        = htons ((unsigned short) port);
+        sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+        if (((ps->lfd = socket (AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) ||
+            (setsockopt (ps->lfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on)) < 0) ||
+            (bind (ps->lfd, (struct sockaddr *) &sa, sizeof (sa)) < 0) ||
+            (listen (ps->lfd, 4) < 0))
+        {
+            perror ("metrics socket");
+            metDestroy (ps);
+            return NULL;
+        }
+    }
+
+    if (((ps->wfd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) ||
+        (pthread_create (&ps->thread, NULL, metThread, ps) != 0))
+    {
+        perror ("metrics thread");
+        metDestroy (ps);
+        return NULL;
+    }
+    return ps;
+}
+
+
+
+/* stop the exporter thread, and release it; the file is written
+ * a last time
+ */
+void  metDestroy (gmtMetricServer *ps)
+{
+    uint64_t  one = 1;
+
+    if (!ps)
+        return;
+
+    if (ps->thread)
+    {
+        if (write (ps->wfd, &one, sizeof (one)) < 0)
+            perror ("metrics stop");
+        pthread_join (ps->thread, NULL);
+        metFile (ps);
+    }
+    if (ps->lfd >= 0)  close (ps->lfd);
+    if (ps->wfd >= 0)  close (ps->wfd);
+    free (ps);
+}
+
+
+
+/* exporter thread; rewrites the file on time, and answers
+ * HTTP requests in between, one at a time
+ */
+static void  *metThread (void *arg)
+{
+    gmtMetricServer  *ps = (gmtMetricServer *) arg;
+    struct pollfd     pfd[2];
+    long long         next, now;
+    int               n, ms;
+
+    pfd[0].fd     = ps->wfd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd     = ps->lfd;
+    pfd[1].events = POLLIN;
+    next = metClock ();
+
+    while (1)
+    {
+        now = metClock ();
+        if (ps->file[0] && (now >= next))
+        {
+            if (metFile (ps) != 0)
+                perror (ps->file);
+            next = now + ps->interval * 1000000000LL;
+        }
+        ms = ps->file[0] ? (int) ((next - now) / 1000000) + 1 : -1;
+
+        if ((n = poll (pfd, (ps->lfd >= 0) ? 2 : 1, ms)) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror ("metrics wait");
+            break;
+        }
+        if (pfd[0].revents)
+            break;
+        if ((n > 0) && (ps->lfd >= 0) && pfd[1].revents)
+            metAnswer (ps);
+    }
+    return NULL;
+}
+
+
+
+/* accept one connection, and answer its request; the metrics for
+ * "GET /metrics" (or "/"), 404 for anything else
+ */
+static void  metAnswer (gmtMetricServer *ps)
+{
+    struct timeval  tv;
+    char            req[MET_REQUEST_MAX + 1];
+    char           *body = NULL;
+    size_t          len = 0, done;
+    ssize_t         n;
+    FILE           *fp;
+    int             fd, ok;
+
+    if ((fd = accept4 (ps->lfd, NULL, NULL, SOCK_CLOEXEC)) < 0)
+        return;
+
+    /* a slow client must not hold the exporter */
+    tv.tv_sec  = 1;
+    tv.tv_usec = 0;
+    setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+    setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof (tv));
+
+    req[0] = '\0';
+    for (done=0; done < MET_REQUEST_MAX; )
+    {
+        if ((n = read (fd, req + done, MET_REQUEST_MAX - done)) <= 0)
+            break;
+        done     += (size_t) n;
+        req[done] = '\0';
+        if (strstr (req, "\r\n\r\n") || strstr (req, "\n\n"))
+            break;
+    }
+    ok = (strncmp (req, "GET /metrics ", 13) == 0) || (strncmp (req, "GET / ", 6) == 0);
+
+    if (ok && (fp = open_memstream (&body, &len)))
+    {
+        metText (ps->pm, fp);
+        fclose (fp);
+        dprintf (fd, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                 "Content-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long) len);
+        for (done=0; done < len; done+=(size_t) n)
+            if ((n = write (fd, body + done, len - done)) <= 0)
+                break;
+        free (body);
+    }
+    else
+        dprintf (fd, "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    close (fd);
+}
+
+
+
+/* write the metrics file; to a temporary file, renamed when complete,
+ * so a reader never sees a part of it
+ * returns 0 on success, or -1 on error
+ */
+static int  metFile (gmtMetricServer *ps)
+{
+    char   tmp[FILENAME_MAXSIZE + 8];
+    FILE  *fp;
+
+    if (!ps->file[0])
+        return 0;
+    snprintf (tmp, sizeof (tmp), "%s.tmp", ps->file);
+    if (!(fp = fopen (tmp, "w")))
+        return -1;
+    metText (ps->pm, fp);
+    if ((fclose (fp) != 0) || (rename (tmp, ps->file) != 0))
+    {
+        unlink (tmp);
+        return -1;
+    }
+    return 0;
+}
+
+
+
+/* all metrics, in the Prometheus text format
+ */
+static void  metText (gmtMetrics *pm, FILE *fp)
+{
+    struct timespec  ts;
+    char             label[32];
+    long long        last, now;
+    int              k;
+
+    putCounter (fp, "gmt_samples_total", "Raw samples read from the sensor.",
+                pm, offsetof (metSensor, samples));
+    putCounter (fp, "gmt_i2c_errors_total", "Sensor reads failed after retries, or timed out.",
+                pm, offsetof (metSensor, i2cErrors));
+    putCounter (fp, "gmt_i2c_retries_total", "Sensor reads repeated.",
+                pm, offsetof (metSensor, i2cRetries));
+
+    fprintf (fp, "# HELP gmt_ring_overruns_total Samples dropped, the consumer was behind.\n"
+                 "# TYPE gmt_ring_overruns_total counter\n");
+    for (k=0; k<pm->sensors; k++)
+        fprintf (fp, "gmt_ring_overruns_total{sensor=\"%d\"} %lld\n", k,
+                 atomic_load_explicit (&pm->sensor[k].overruns, memory_order_relaxed));
+    fprintf (fp, "# HELP gmt_queue_depth Samples waiting for the consumer.\n"
+                 "# TYPE gmt_queue_depth gauge\n");
+    for (k=0; k<pm->sensors; k++)
+        fprintf (fp, "gmt_queue_depth{sensor=\"%d\"} %lld\n", k,
+                 atomic_load_explicit (&pm->sensor[k].queue, memory_order_relaxed));
+
+    /* the age from the realtime stamp of the last sample */
+    clock_gettime (CLOCK_REALTIME, &ts);
+    now = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    fprintf (fp, "# HELP gmt_last_sample_age_seconds Time since the last sample was read.\n"
+                 "# TYPE gmt_last_sample_age_seconds gauge\n");
+    for (k=0; k<pm->sensors; k++)
+    {
+        last = atomic_load_explicit (&pm->sensor[k].lastSample, memory_order_relaxed);
+        if (last > 0)
+            fprintf (fp, "gmt_last_sample_age_seconds{sensor=\"%d\"} %.3lf\n", k, (now - last) / 1e9);
+    }
+
+    fprintf (fp, "# HELP gmt_i2c_seconds Time of a sensor data read, with retries.\n"
+                 "# TYPE gmt_i2c_seconds histogram\n");
+    for (k=0; k<pm->sensors; k++)
+    {
+        snprintf (label, sizeof (label), "sensor=\"%d\"", k);
+        putHist (fp, "gmt_i2c_seconds", label, &pm->sensor[k].i2c);
+    }
+
+    fprintf (fp, "# HELP gmt_write_errors_total Records not stored.\n"
+                 "# TYPE gmt_write_errors_total counter\n"
+                 "gmt_write_errors_total %llu\n", getU (&pm->writeErrors));
+    fprintf (fp, "# HELP gmt_written_bytes_total Bytes written to the day files.\n"
+                 "# TYPE gmt_written_bytes_total counter\n"
+                 "gmt_written_bytes_total %llu\n", getU (&pm->bytes));
+    fprintf (fp, "# HELP gmt_store_backlog Records queued for storage, not written yet.\n"
+                 "# TYPE gmt_store_backlog gauge\n"
+                 "gmt_store_backlog %lld\n", getS (&pm->backlog));
+    fprintf (fp, "# HELP gmt_store_backlog_peak Most records queued for storage.\n"
+                 "# TYPE gmt_store_backlog_peak gauge\n"
+                 "gmt_store_backlog_peak %lld\n", getS (&pm->backlogPeak));
+    fprintf (fp, "# HELP gmt_store_backlog_limit Records queued for storage, at most.\n"
+                 "# TYPE gmt_store_backlog_limit gauge\n"
+                 "gmt_store_backlog_limit %lld\n", getS (&pm->backlogLimit));
+    fprintf (fp, "# HELP gmt_store_dropped_total Records lost, the storage backlog was full.\n"
+                 "# TYPE gmt_store_dropped_total counter\n"
+                 "gmt_store_dropped_total %llu\n", getU (&pm->dropped));
+    fprintf (fp, "# HELP gmt_storm_alarms Active storm alarm bits; dB/dt of X, Y, Z, F in bits 0-3, "
+                 "their baseline deviation in bits 8-11.\n"
+                 "# TYPE gmt_storm_alarms gauge\n"
+                 "gmt_storm_alarms %lld\n", getS (&pm->stormActive));
+    fprintf (fp, "# HELP gmt_storm_alerts_total Storm alarm changes sent.\n"
+                 "# TYPE gmt_storm_alerts_total counter\n"
+                 "gmt_storm_alerts_total %llu\n", getU (&pm->alerts));
+    fprintf (fp, "# HELP gmt_write_seconds Time to store one record.\n"
+                 "# TYPE gmt_write_seconds histogram\n");
+    putHist (fp, "gmt_write_seconds", NULL, &pm->write);
+    fprintf (fp, "# HELP gmt_sched_jitter_seconds Deviation of the sample tick intervals.\n"
+                 "# TYPE gmt_sched_jitter_seconds histogram\n");
+    putHist (fp, "gmt_sched_jitter_seconds", NULL, &pm->jitter);
+
+    fprintf (fp, "# HELP gmt_start_time_seconds Start of the process, epoch seconds.\n"
+                 "# TYPE gmt_start_time_seconds gauge\n"
+                 "gmt_start_time_seconds %lld\n", (long long) pm->start);
+}
+
+
+
+/* a per-sensor counter, at offset <off> of metSensor
+ */
+static void  putCounter (FILE *fp, const char *name, const char *help, gmtMetrics *pm, size_t off)
+{
+    int  k;
+
+    fprintf (fp, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+    for (k=0; k<pm->sensors; k++)
+        fprintf (fp, "%s{sensor=\"%d\"} %llu\n", name, k,
+                 getU ((const _Atomic unsigned long long *) ((const char *) &pm->sensor[k] + off)));
+}
+
+
+
+/* a histogram; cumulative buckets, in seconds, with an optional
+ * <label> ("name=\"value\""); the count is that of all buckets
+ */
+static void  putHist (FILE *fp, const char *name, const char *label, const metHist *ph)
+{
+    unsigned long long  cum = 0;
+    int                 i;
+
+    for (i=0; i<MET_BINS-1; i++)
+    {
+        cum += getU (&ph->bin[i]);
+        fprintf (fp, "%s_bucket{%s%sle=\"%.6lf\"} %llu\n", name, label ? label : "",
+                 label ? "," : "", (1UL << i) / 1e6, cum);
+    }
+    cum += getU (&ph->bin[MET_BINS-1]);
+    fprintf (fp, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, label ? label : "", label ? "," : "", cum);
+    if (label)
+    {
+        fprintf (fp, "%s_sum{%s} %.9lf\n", name, label, getU (&ph->sum) / 1e9);
+        fprintf (fp, "%s_count{%s} %llu\n", name, label, cum);
+    }
+    else
+    {
+        fprintf (fp, "%s_sum %.9lf\n", name, getU (&ph->sum) / 1e9);
+        fprintf (fp, "%s_count %llu\n", name, cum);
+    }
+}
+
+
+
+/* read a counter
+ */
+static unsigned long long  getU (const _Atomic unsigned long long *pc)
+{
+    return atomic_load_explicit ((_Atomic unsigned long long *) pc, memory_order_relaxed);
+}
+
+
+
+/* read a gauge
+ */
+static long long  getS (const _Atomic long long *pg)
+{
+    return atomic_load_explicit ((_Atomic long long *) pg, memory_order_relaxed);
+}
@@ -0,0 +1,268 @@
+/***************************************************************************
+ *                           gmtpack.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the archive compaction tool,
+ *      converting the text day files of finished days to the
+ *      compressed archive form (.gmz), and back
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "gmt.h"
+
+/* --- prototypes ----
+ */
+extern int          cfgLoad   (cfgTable *pct, const char *name);
+extern const char  *cfgGetStr (cfgTable *pct, const char *key);
+extern int          gmzEncode (FILE *pi, FILE *po);
+extern int          gmzUnpack (const char *name, FILE *po);
+extern int          idxUpdate (const char *path);
+
+static int  packDir   (const char *path, int keep);
+static int  packFile  (const char *src, const char *dst, long *pin, long *pout);
+static int  sameFile  (FILE *pa, FILE *pb);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* usage: gmtpack [-k] [<data path>]
+ *        gmtpack -d <file.gmz> [<file.dat>]
+ * the first form compacts all text day files of finished days, in the
+ * given directory or the DATAFILE_PATH of the config file; each one
+ * is checked by decoding it again before the text file is removed
+ * (kept with -k); the second form decodes an archive file to text,
+ * to stdout without output file name
+ */
+int  main (int argc, char **argv)
+{
+    cfgTable     cfg;
+    const char  *path = NULL;
+    FILE        *po;
+    int          i, rv, keep = 0;
+
+    if ((argc > 2) && (strcmp (argv[1], "-d") == 0))
+    {
+        po = stdout;
+        if ((argc > 3) && !(po = fopen (argv[3], "w")))
+        {
+            perror (argv[3]);
+            return 3;
+        }
+        if ((rv = gmzUnpack (argv[2], po)) != 0)
+            fprintf (stderr, "%s: %s\n", argv[2], (errno == EINVAL) ? "not an archive file" : "damaged");
+        if (po != stdout)
+            fclose (po);
+        return (rv ? 2 : 0);
+    }
+
+    for (i=1; i<argc; i++)
+    {
+        if (strcmp (argv[i], "-k") == 0)
+            keep = 1;
+        else if (argv[i][0] == '-')
+        {
+            fprintf (stderr, "usage: %s [-k] [<data path>]\n"
+                             "       %s -d <file%s> [<file.dat>]\n", argv[0], argv[0], GMZ_FILE_EXT);
+            return 1;
+        }
+        else
+            path = argv[i];
+    }
+
+    if (!path)
+    {
+        if (cfgLoad (&cfg, GMT_CFG) < 0)
+        {
+            perror (GMT_CFG);
+            return 2;
+        }
+        if (!(path = cfgGetStr (&cfg, GMT_CFG_DATAPATH)))
+        {
+            fprintf (stderr, "no %s in %s\n", GMT_CFG_DATAPATH, GMT_CFG);
+            return 2;
+        }
+    }
+    return packDir (path, keep);
+}
+
+
+
+/* compact the text day files of the days before today in <path>,
+ * i.e. "YYYY_MM_DD[_<tag>].dat", with no archive file yet;
+ * returns 0 on success, or the number of failed files
+ */
+static int  packDir (const char *path, int keep)
+{
+    char            src[FILENAME_MAXSIZE + 280], dst[FILENAME_MAXSIZE + 280];
+    char            today[16];
+    DIR            *pd;
+    struct dirent  *pe;
+    struct stat     st;
+    time_t          t;
+    size_t          len;
+    long            in, out, tin = 0, tout = 0;
+    int             y, m, d, files = 0, fails = 0;
+
+    /* the day files are named by local time */
+    t = time (NULL);
+    strftime (today, sizeof (today), "%Y_%m_%d", localtime (&t));
+
+    if (!(pd = opendir (path)))
+    {
+        perror (path);
+        return 1;
+    }
+
+    while ((pe = readdir (pd)) != NULL)
+    {
+        len = strlen (pe->d_name);
+        if ((len < 14) || (strcmp (pe->d_name + len - 4, ".dat") != 0) ||
+            (sscanf (pe->d_name, "%4d_%2d_%2d", &y, &m, &d) != 3) ||
+            (strncmp (pe->d_name, today, 10) >= 0))
+            continue;
+
+        snprintf (src, sizeof (src), "%s/%s", path, pe->d_name);
+        snprintf (dst, sizeof (dst), "%s/%.*s%s", path, (int) len - 4, pe->d_name, GMZ_FILE_EXT);
+        if (stat (dst, &st) == 0)
+        {
+            printf ("%s: %s exists, skipped\n", pe->d_name, GMZ_FILE_EXT);
+            continue;
+        }
+
+        if (packFile (src, dst, &in, &out) != 0)
+        {
+            fails++;
+            continue;
+        }
+        if (!keep && (unlink (src) != 0))
+            perror (src);
+
+        printf ("%s: %ld -> %ld bytes, %.1lf : 1\n", pe->d_name, in, out,
+                (out > 0) ? (double) in / out : 0.0);
+        files++;
+        tin  += in;
+        tout += out;
+    }
+    closedir (pd);
+
+    if (files > 0)
+    {
+        idxUpdate (path);
+        printf ("%d files, %ld -> %ld bytes, %.1lf : 1\n", files, tin, tout,
+                (tout > 0) ? (double) tin / tout : 0.0);
+    }
+    if (fails > 0)
+        printf ("%d files failed\n", fails);
+    return fails;
+}
+
+
+
+/* compress the text file <src> to the archive file <dst>; it is
+ * written to a temporary file first, which is decoded and compared
+ * to the source, and renamed when complete and equal;
+ * <pin> / <pout> get the file sizes;
+ * returns 0 on success, or -1 on error
+ */
+static int  packFile (const char *src, const char *dst, long *pin, long *pout)
+{
+    char   tmp[FILENAME_MAXSIZE + 300];
+    FILE  *pi, *po, *pc;
+    int    rv = -1;
+
+    snprintf (tmp, sizeof (tmp), "%s.tmp", dst);
+    if (!(pi = fopen (src, "r")))
+    {
+        perror (src);
+        return -1;
+    }
+    if (!(po = fopen (tmp, "w")))
+    {
+        perror (tmp);
+        fclose (pi);
+        return -1;
+    }
+
+    if ((gmzEncode (pi, po) != 0) || (fflush (po) != 0) || (fsync (fileno (po)) != 0))
+        perror (tmp);
+    else
+    {
+        *pin  = ftell (pi);
+        *pout = ftell (po);
+
+        /* decode into a temporary stream, and compare */
+        rewind (pi);
+        if (!(pc = tmpfile ()))
+            perror ("tmpfile");
+        else
+        {
+            if ((gmzUnpack (tmp, pc) != 0) || (fflush (pc) != 0))
+                fprintf (stderr, "%s: decoding failed\n", tmp);
+            else
+            {
+                rewind (pc);
+                if (!sameFile (pi, pc))
+                    fprintf (stderr, "%s: decoded file differs\n", tmp);
+                else
+                    rv = 0;
+            }
+            fclose (pc);
+        }
+    }
+    fclose (pi);
+    if (fclose (po) != 0)
+        rv = -1;
+
+    if ((rv == 0) && (rename (tmp, dst) != 0))
+    {
+        perror (dst);
+        rv = -1;
+    }
+    if (rv != 0)
+        unlink (tmp);
+    return rv;
+}
+
+
+
+/* compare two streams to their ends;
+ * returns 1 if equal, or 0 if not
+ */
+static int  sameFile (FILE *pa, FILE *pb)
+{
+    char    ba[8192], bb[8192];
+    size_t  na, nb;
+
+    do
+    {
+        na = fread (ba, 1, sizeof (ba), pa);
+        nb = fread (bb, 1, sizeof (bb), pb);
+        if ((na != nb) || (memcmp (ba, bb, na) != 0))
+            return 0;
+    }
+    while (na > 0);
+    return 1;
+}
@@ -0,0 +1,557 @@
+/***************************************************************************
+ *                           gmtq.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the range query tool, reading the
+ *      samples of any time range from the data directory, through its
+ *      index, with the days decoded in parallel
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "gmt.h"
+
+#define GMTQ_MAX_THREADS    64
+#define GMTQ_WINDOW         4          /* decoded days ahead, per thread */
+
+/* one day of the range; decoded by a worker into <buf>, written
+ * out in order by the main thread
+ */
+typedef struct
+{
+    int              year;
+    int              mon;
+    int              mday;
+    const idxEntry  *pe;           /* its file, or NULL           */
+    FILE            *po;           /* output, to <buf>            */
+    char            *buf;
+    size_t           len;
+    unsigned long    records;      /* in <buf>                    */
+    int              done;
+}
+qryJob;
+
+/* --- prototypes ----
+ */
+extern int          cfgLoad   (cfgTable *pct, const char *name);
+extern const char  *cfgGetStr (cfgTable *pct, const char *key);
+extern int          idxOpen   (gmtIndex *pi, const char *path);
+extern void         idxClose  (gmtIndex *pi);
+extern const idxEntry *idxFind (gmtIndex *pi, int year, int mon, int mday, const char *tag);
+extern int          idxReadDay (const char *path, const idxEntry *pe, time_t from, time_t to,
+                                idxSink fn, void *arg);
+extern int          rollOpen  (gmtRollup *pr, const char *path, const char *tag, int year, int axes,
+                               int writable);
+extern void         rollClose (gmtRollup *pr);
+extern int          rollRebuild (gmtRollup *pr, gmtIndex *pi, time_t from, time_t to, time_t now,
+                                 int force);
+extern int          rollQuery (const char *path, const char *tag, time_t from, time_t to, int points,
+                               gmrSink fn, void *arg);
+
+static int     parseTime  (const char *ps, time_t *pt);
+static void   *worker     (void *arg);
+static void    readDay    (qryJob *pj);
+static int     putSample  (void *arg, time_t t, long tod, const double *pv, int cols);
+static int     putRow     (void *arg, const gmrRow *pr);
+static int     putScript  (const char *name, const char *data);
+static void    listIndex  (gmtIndex *pi);
+static int     rebuild    (const char *tag);
+
+static gmtIndex         qIndex;
+static qryJob          *qJobs;
+static int              qCount;        /* jobs                        */
+static int              qNext;         /* next job to decode          */
+static int              qWritten;      /* jobs written out            */
+static int              qWindow;       /* jobs decoded ahead, at most */
+static pthread_mutex_t  qLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   qCond = PTHREAD_COND_INITIALIZER;
+static time_t           qFrom, qTo;
+static int              qBinary;
+static int              qDate;         /* CSV times as date and time  */
+static int              qRollup;       /* rollup rows, for <n> points */
+static int              qAxes;         /* of the rollup rows          */
+static unsigned long    qRecords;      /* written                     */
+
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* usage: gmtq [-b | -d] [-j <threads>] [-p <data path>] [-t <tag>]
+ *             [-o <file> [-g <script>]] <start> <end>
+ *        gmtq -r <points> [-d] [-p <data path>] [-t <tag>]
+ *             [-o <file> [-g <script>]] <start> <end>
+ *        gmtq -R [-p <data path>] [-t <tag>] <start> <end>
+ *        gmtq -i [-p <data path>]
+ * writes the samples of [start, end) to stdout or <file>, as CSV lines
+ * "<time>,<x>,<y>,<z>" (epoch seconds, or local "YYYY-MM-DD HH:MM:SS"
+ * with -d; values in Ga), or as gmtqRecord with -b, which gnuplot reads
+ * as binary records; -g writes a gnuplot script to plot the output;
+ * with -r, the rollup level for a plot <points> wide instead, as lines
+ * "<time>,<count>,<mean>,<min>,<max>", the last three for each axis;
+ * -R rebuilds the rollup of the days in the range from the day files,
+ * e.g. after an import (the daemon does so for the current year);
+ * the arguments are epoch seconds, or local "YYYY-MM-DD[THH:MM[:SS]]";
+ * <tag> selects a sensor other than the first; -i updates and lists
+ * the index only
+ */
+int  main (int argc, char **argv)
+{
+    cfgTable     cfg;
+    pthread_t    thr[GMTQ_MAX_THREADS];
+    const char  *path = NULL, *tag = NULL, *out = NULL, *script = NULL;
+    struct tm    tm, te;
+    qryJob      *pj;
+    time_t       t;
+    int          i, n, opt, list = 0, build = 0, threads = 0;
+
+    while ((opt = getopt (argc, argv, "bdg:ij:o:p:r:Rt:")) != -1)
+    {
+        switch (opt)
+        {
+          case 'b':  qBinary = 1;              break;
+          case 'd':  qDate = 1;                break;
+          case 'g':  script = optarg;          break;
+          case 'i':  list = 1;                 break;
+          case 'o':  out = optarg;             break;
+          case 'j':  threads = atoi (optarg);  break;
+          case 'p':  path = optarg;            break;
+          case 'r':  qRollup = atoi (optarg);  break;
+          case 'R':  build = 1;                break;
+          case 't':  tag = optarg;             break;
+          default:   argc = 0;                 break;
+        }
+    }
+    if (!list && ((argc - optind != 2) || (parseTime (argv[optind], &qFrom) != 0) ||
+                  (parseTime (argv[optind+1], &qTo) != 0) || (qTo <= qFrom) ||
+                  (qBinary && qDate) || (script && !out) || (qRollup < 0) || (qRollup && qBinary)))
+    {
+        fprintf (stderr, "usage: %s [-b | -d] [-j <threads>] [-p <data path>] [-t <tag>]\n"
+                         "           [-o <file> [-g <script>]] <start> <end>\n"
+                         "       %s -r <points> [-d] [-p <data path>] [-t <tag>]\n"
+                         "           [-o <file> [-g <script>]] <start> <end>\n"
+                         "       %s -R [-p <data path>] [-t <tag>] <start> <end>\n"
+                         "       %s -i [-p <data path>]\n"
+                         "times as epoch seconds, or YYYY-MM-DD[THH:MM[:SS]]\n", argv[0], argv[0], argv[0],
+                         argv[0]);
+        return 1;
+    }
+
+    if (!path)
+    {
+        if (cfgLoad (&cfg, GMT_CFG) < 0)
+        {
+            perror (GMT_CFG);
+            return 2;
+        }
+        if (!(path = cfgGetStr (&cfg, GMT_CFG_DATAPATH)))
+        {
+            fprintf (stderr, "no %s in %s\n", GMT_CFG_DATAPATH, GMT_CFG);
+            return 2;
+        }
+    }
+    if (idxOpen (&qIndex, path) != 0)
+    {
+        perror (path);
+        return 2;
+    }
+    if (list)
+    {
+        listIndex (&qIndex);
+        idxClose (&qIndex);
+        return 0;
+    }
+    if (build)
+    {
+        n = rebuild (tag);
+        idxClose (&qIndex);
+        return (n < 0) ? 2 : 0;
+    }
+    if (out && !freopen (out, "w", stdout))
+    {
+        perror (out);
+        return 2;
+    }
+
+    /* the rollup files have the levels ready, no day file is read */
+    if (qRollup)
+    {
+        idxClose (&qIndex);
+        if (rollQuery (path, tag, qFrom, qTo, qRollup, putRow, NULL) < 0)
+        {
+            fprintf (stderr, "no rollup files in %s/%s\n", path, GMR_DIR);
+            return 2;
+        }
+        goto done;
+    }
+
+    /* the days of the range, local time, as the day files */
+    localtime_r (&qFrom, &tm);
+    t = qTo - 1;
+    localtime_r (&t, &te);
+    while (1)
+    {
+        if (!(qJobs = realloc (qJobs, (qCount + 1) * sizeof (qryJob))))
+            return 3;
+        pj = &qJobs[qCount++];
+        memset (pj, 0, sizeof (qryJob));
+        pj->year = tm.tm_year + 1900;
+        pj->mon  = tm.tm_mon + 1;
+        pj->mday = tm.tm_mday;
+        pj->pe   = idxFind (&qIndex, pj->year, pj->mon, pj->mday, tag);
+
+        if ((tm.tm_year == te.tm_year) && (tm.tm_yday == te.tm_yday))
+            break;
+        /* next day; noon is clear of any DST change */
+        tm.tm_mday++;
+        tm.tm_hour  = 12;
+        tm.tm_isdst = -1;
+        mktime (&tm);
+    }
+
+    if ((threads <= 0) && ((threads = (int) sysconf (_SC_NPROCESSORS_ONLN)) <= 0))
+        threads = 1;
+    if (threads > GMTQ_MAX_THREADS)
+        threads = GMTQ_MAX_THREADS;
+    if (threads > qCount)
+        threads = qCount;
+    qWindow = threads * GMTQ_WINDOW;
+
+    for (n=0; n<threads; n++)
+        if (pthread_create (&thr[n], NULL, worker, NULL) != 0)
+            break;
+    if (n == 0)
+    {
+        perror ("thread");
+        return 3;
+    }
+
+    /* in order of the days, as soon as each one is done */
+    for (i=0; i<qCount; i++)
+    {
+        pthread_mutex_lock (&qLock);
+        while (!qJobs[i].done)
+            pthread_cond_wait (&qCond, &qLock);
+        pthread_mutex_unlock (&qLock);
+
+        if (qJobs[i].len > 0)
+            fwrite (qJobs[i].buf, 1, qJobs[i].len, stdout);
+        qRecords += qJobs[i].records;
+        free (qJobs[i].buf);
+        qJobs[i].buf = NULL;
+
+        pthread_mutex_lock (&qLock);
+        qWritten++;
+        pthread_cond_broadcast (&qCond);
+        pthread_mutex_unlock (&qLock);
+    }
+
+    while (n-- > 0)
+        pthread_join (thr[n], NULL);
+    free (qJobs);
+    idxClose (&qIndex);
+
+done:
+    if ((fflush (stdout) != 0) || ferror (stdout))
+        return 4;
+    if (out)
+        fprintf (stderr, "%lu records to %s\n", qRecords, out);
+    if (script && (putScript (script, out) != 0))
+    {
+        perror (script);
+        return 4;
+    }
+    return 0;
+}
+
+
+
+/* parse a time argument; epoch seconds, or local date and time
+ * "YYYY-MM-DD[THH:MM[:SS]]" ('T' or a blank);
+ * returns 0 on success, or -1 if not valid
+ */
+static int  parseTime (const char *ps, time_t *pt)
+{
+    struct tm  tm;
+    char      *pe;
+    long long  v;
+    int        n;
+
+    v = strtoll (ps, &pe, 10);
+    if ((*pe == '\0') && (pe != ps))
+    {
+        *pt = (time_t) v;
+        return 0;
+    }
+
+    memset (&tm, 0, sizeof (tm));
+    n = sscanf (ps, "%d-%d-%d%*1[T ]%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+    if ((n != 3) && (n < 5))
+        return -1;
+    tm.tm_year -= 1900;
+    tm.tm_mon  -= 1;
+    tm.tm_isdst = -1;
+    if ((*pt = mktime (&tm)) == (time_t) -1)
+        return -1;
+    return 0;
+}
+
+
+
+/* decoding thread; takes the next day, as long as it is not too far
+ * ahead of the output
+ */
+static void  *worker (void *arg)
+{
+    int  i;
+
+    (void) arg;
+    while (1)
+    {
+        pthread_mutex_lock (&qLock);
+        while ((qNext < qCount) && (qNext >= qWritten + qWindow))
+            pthread_cond_wait (&qCond, &qLock);
+        if (qNext >= qCount)
+        {
+            pthread_mutex_unlock (&qLock);
+            return NULL;
+        }
+        i = qNext++;
+        pthread_mutex_unlock (&qLock);
+
+        readDay (&qJobs[i]);
+
+        pthread_mutex_lock (&qLock);
+        qJobs[i].done = 1;
+        pthread_cond_broadcast (&qCond);
+        pthread_mutex_unlock (&qLock);
+    }
+}
+
+
+
+/* decode the samples of one day in the range, to the job's buffer
+ */
+static void  readDay (qryJob *pj)
+{
+    if (!pj->pe || (pj->pe->records == 0) || !(pj->po = open_memstream (&pj->buf, &pj->len)))
+        return;
+    idxReadDay (qIndex.path, pj->pe, qFrom, qTo, putSample, pj);
+    fclose (pj->po);
+}
+
+
+
+/* write one sample of a day; <tod> is its second of the day
+ * returns 0, to go on
+ */
+static int  putSample (void *arg, time_t t, long tod, const double *pv, int cols)
+{
+    qryJob      *pj = (qryJob *) arg;
+    gmtqRecord   r;
+    int          i;
+
+    r.time = (long long) t;
+    for (i=0; i<GMT_AXES; i++)
+        r.v[i] = (i < cols) ? pv[i] : NAN;
+    pj->records++;
+    if (qBinary)
+    {
+        fwrite (&r, sizeof (r), 1, pj->po);
+        return 0;
+    }
+
+    /* the wall clock time of the file, as is */
+    if (qDate)
+        fprintf (pj->po, "%04d-%02d-%02d %02ld:%02ld:%02ld", pj->year, pj->mon, pj->mday,
+                 tod / 3600, (tod / 60) % 60, tod % 60);
+    else
+        fprintf (pj->po, "%lld", r.time);
+    if (cols >= GMT_AXES)
+        fprintf (pj->po, ",%.9lg,%.9lg,%.9lg\n", r.v[0], r.v[1], r.v[2]);
+    else
+        fprintf (pj->po, ",%.9lg\n", r.v[0]);
+    return 0;
+}
+
+
+
+/* write one rollup row; its time in the file as the samples
+ * returns 0, to go on
+ */
+static int  putRow (void *arg, const gmrRow *pr)
+{
+    struct tm  tm;
+    int        i;
+
+    (void) arg;
+    if (qDate)
+    {
+        localtime_r (&pr->time, &tm);
+        printf ("%04d-%02d-%02d %02d:%02d:%02d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                tm.tm_hour, tm.tm_min, tm.tm_sec);
+    }
+    else
+        printf ("%lld", (long long) pr->time);
+    printf (",%u", pr->count);
+    for (i=0; i<pr->axes; i++)
+        printf (",%.9lg,%.9lg,%.9lg", pr->mean[i], pr->min[i], pr->max[i]);
+    printf ("\n");
+    qAxes = pr->axes;
+    qRecords++;
+    return 0;
+}
+
+
+
+/* write a gnuplot script, plotting the exported file <data>
+ * returns 0 on success, or -1 on error
+ */
+static int  putScript (const char *name, const char *data)
+{
+    static const char  *title[GMT_AXES] = { "X", "Y", "Z" };
+    char                from[32], to[32];
+    struct tm           tm;
+    FILE               *fp;
+    int                 i;
+
+    if (!(fp = fopen (name, "w")))
+        return -1;
+    strftime (from, sizeof (from), "%Y-%m-%d %H:%M:%S", localtime_r (&qFrom, &tm));
+    strftime (to, sizeof (to), "%Y-%m-%d %H:%M:%S", localtime_r (&qTo, &tm));
+
+    fprintf (fp, "# geomagnetism data, %s - %s, %lu records\n", from, to, qRecords);
+    fprintf (fp, "# written by gmtq; gnuplot -p %s\n", name);
+    fprintf (fp, "set xdata time\n");
+    if (qBinary)
+        fprintf (fp, "# epoch seconds, shown as UTC\n");
+    else if (qDate)
+    {
+        fprintf (fp, "set datafile separator \",\"\n");
+        fprintf (fp, "set timefmt '%%Y-%%m-%%d %%H:%%M:%%S'\n");
+    }
+    else
+    {
+        fprintf (fp, "# epoch seconds, shown as UTC\n");
+        fprintf (fp, "set datafile separator \",\"\n");
+        fprintf (fp, "set timefmt '%%s'\n");
+    }
+    /* a day or more: the date, too */
+    if (qTo - qFrom > 86400)
+        fprintf (fp, "set format x \"%%d.%%m.%%y\\n%%H:%%M\"\n");
+    else
+        fprintf (fp, "set format x \"%%H:%%M\"\n");
+    fprintf (fp, "set ylabel \"Ga\"\nset grid x\nset grid y\n");
+
+    /* rollup: the min / max band of each axis, and the mean */
+    if (qRollup)
+    {
+        fprintf (fp, "set style fill transparent solid 0.25 noborder\n");
+        fprintf (fp, "plot ");
+        for (i=0; i<(qAxes ? qAxes : GMT_AXES); i++)
+            fprintf (fp, "%s'%s' using 1:%d:%d with filledcurves notitle lc %d, \\\n"
+                     "     '' using 1:%d with lines title '%s' lc %d", (i > 0) ? ", \\\n     " : "",
+                     data, 4 + 3 * i, 5 + 3 * i, i + 1, 3 + 3 * i, (qAxes == 1) ? "XYZ" : title[i], i + 1);
+        fprintf (fp, "\n");
+        return ((fclose (fp) != 0) ? -1 : 0);
+    }
+
+    fprintf (fp, "plot ");
+    for (i=0; i<GMT_AXES; i++)
+    {
+        fprintf (fp, "%s'%s'", (i > 0) ? ", \\\n     " : "", (i > 0) ? "" : data);
+        if (qBinary)
+            fprintf (fp, " binary format='%%int64%%3double'");
+        fprintf (fp, " using 1:%d with lines title '%s'", i + 2, title[i]);
+    }
+    fprintf (fp, "\n");
+
+    if (fclose (fp) != 0)
+        return -1;
+    return 0;
+}
+
+
+
+/* rebuild the rollup of [qFrom, qTo), all days, for each UTC year;
+ * the axes are those of the day files
+ * returns the number of days, or -1 on error
+ */
+static int  rebuild (const char *tag)
+{
+    gmtRollup   gr;
+    struct tm   tm;
+    time_t      t;
+    int         i, year, y1, axes = 0, n = 0;
+
+    for (i=0; (i<qIndex.count) && !axes; i++)
+        if (qIndex.entry[i].records > 0)
+            axes = qIndex.entry[i].cols;
+    if (!axes)
+    {
+        fprintf (stderr, "no data in %s\n", qIndex.path);
+        return -1;
+    }
+
+    gmtime_r (&qFrom, &tm);
+    year = tm.tm_year + 1900;
+    t    = qTo - 1;
+    gmtime_r (&t, &tm);
+    y1   = tm.tm_year + 1900;
+    for (; year<=y1; year++)
+    {
+        if (rollOpen (&gr, qIndex.path, tag, year, axes, 1) != 0)
+        {
+            perror (GMR_DIR);
+            return -1;
+        }
+        n += rollRebuild (&gr, &qIndex, qFrom, qTo, time (NULL), 1);
+        rollClose (&gr);
+    }
+    fprintf (stderr, "%d days rebuilt\n", n);
+    return n;
+}
+
+
+
+/* print the index, one file per line
+ */
+static void  listIndex (gmtIndex *pi)
+{
+    static const char  *kind[3] = { "dat", "esd", "gmz" };
+    const idxEntry     *pe;
+    int                 i;
+
+    printf ("# %d files in %s\n", pi->count, pi->path);
+    for (i=0; i<pi->count; i++)
+    {
+        pe = &pi->entry[i];
+        printf ("%-32s %s %10lld bytes %6u records", pe->name, kind[pe->kind % 3], pe->size, pe->records);
+        if (pe->records > 0)
+            printf (", %02d:%02d:%02d - %02d:%02d:%02d", pe->first / 3600, (pe->first / 60) % 60,
+                    pe->first % 60, pe->last / 3600, (pe->last / 60) % 60, pe->last % 60);
+        printf ("\n");
+    }
+}
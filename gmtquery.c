@@ -0,0 +1,958 @@
+/***************************************************************************
+ *                           gmtquery.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the TCP query server, answering
+ *      time range requests from memory or from the stored day files
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#define _GNU_SOURCE     /* accept4() */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "gmt.h"
+
+/* one client connection; while an answer is pending (buffer or file),
+ * further requests stay in the input buffer, so answers keep their order
+ */
+typedef struct
+{
+    int      fd;                 /* socket, or -1 if unused       */
+    int      closing;            /* peer closed, finish output    */
+    char     in[QRY_LINE_MAX];   /* partial request line(s)       */
+    size_t   inlen;
+    char    *out;                /* answer text                   */
+    size_t   outlen;
+    size_t   outpos;
+    size_t   outsize;
+    int      sfd;                /* file to send, or -1           */
+    off_t    soff;
+    size_t   sleft;
+}
+qryClient;
+
+/* one decoded day file, minute slots of the local day; records shorter
+ * than a minute are summed up in the slot of their minute */
+typedef struct
+{
+    int            used;
+    int            nodata;       /* no file for that day          */
+    int            year, mon, mday;
+    time_t         mtime;        /* file time when decoded        */
+    unsigned long  stamp;        /* last use, for LRU replacement */
+    unsigned long  checked;      /* request of the last file check */
+    double         v[MINS_PER_DAY][GMT_AXES];   /* sum, NaN = axis not stored */
+    unsigned short n[MINS_PER_DAY];             /* records, 0 = no data */
+}
+qryDay;
+
+struct gmtQueryServer
+{
+    int             lfd;         /* listening socket              */
+    int             efd;         /* epoll handle                  */
+    int             wfd;         /* eventfd, stop request         */
+    pthread_t       thread;
+    gmtHistory     *hist;        /* recent data, may be NULL      */
+    char            path[FILENAME_MAXSIZE];
+    char            npath[FILENAME_MAXSIZE];  /* set by qrySetPath  */
+    pthread_mutex_t plock;       /* protects npath                */
+    qryClient       client[QRY_MAX_CLIENTS];
+    qryDay          cache[QRY_CACHE_DAYS];
+    unsigned long   clock;       /* LRU use counter               */
+    unsigned long   reqno;       /* request counter               */
+};
+
+/* --- prototypes ----
+ */
+extern unsigned long  histQuery (gmtHistory *ph, time_t from, time_t to, histStats *ps);
+extern int            histSpan  (gmtHistory *ph, time_t *pfrom, time_t *pto);
+extern int            esdOpen   (esdFile *pf, const char *name);
+extern void           esdClose  (esdFile *pf);
+extern int            esdGet    (esdFile *pf, unsigned int idx, double *pv);
+extern int            gmzOpen   (gmzReader *pr, const char *name);
+extern void           gmzClose  (gmzReader *pr);
+extern int            gmzNext   (gmzReader *pr, gmzItem *pi);
+extern int            rollLevel (time_t from, time_t to, int points);
+extern int            rollQuery (const char *path, const char *tag, time_t from, time_t to,
+                                 int points, gmrSink fn, void *arg);
+
+void                  qryDestroy   (gmtQueryServer *pq);
+static void           qryPath      (gmtQueryServer *pq);
+static void          *qryThread    (void *arg);
+static void           qryAccept    (gmtQueryServer *pq);
+static void           qryRead      (gmtQueryServer *pq, qryClient *pc);
+static void           qryRequests  (gmtQueryServer *pq, qryClient *pc);
+static int            qryFlush     (gmtQueryServer *pq, qryClient *pc);
+static void           qryClose     (gmtQueryServer *pq, qryClient *pc);
+static void           qryRange     (gmtQueryServer *pq, qryClient *pc, char *args);
+static void           qryDayFile   (gmtQueryServer *pq, qryClient *pc, char *args);
+static void           qryRollup    (gmtQueryServer *pq, qryClient *pc, char *args);
+static int            qryRow       (void *arg, const gmrRow *pr);
+static void           qryPrintf    (qryClient *pc, const char *fmt, ...);
+static int            qryArchive   (gmtQueryServer *pq, time_t from, time_t to, double *sum);
+static qryDay         *qryCache     (gmtQueryServer *pq, struct tm *ptm);
+static int            qryLoadDay   (gmtQueryServer *pq, qryDay *pd, struct tm *ptm);
+static void           qryAdd       (qryDay *pd, int k, const double *pv, int axes);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* create the server, listening on all interfaces at <port>,
+ * and start its thread; <hist> is the in-memory history (or NULL),
+ * <path> the data directory;
+ * returns NULL on error
+ */
+gmtQueryServer  *qryCreate (int port, gmtHistory *hist, const char *path)
+{
+    gmtQueryServer      *pq;
+    struct sockaddr_in   sa;
+    struct epoll_event   ev;
+    int                  i, on = 1;
+
+    if (!(pq = calloc (1, sizeof (gmtQueryServer))))
+        return NULL;
+    pq->lfd  = pq->efd = pq->wfd = -1;
+    pq->hist = hist;
+    strncpy (pq->path, path, FILENAME_MAXSIZE);
+    pq->path[FILENAME_MAXSIZE-1] = '\0';
+    pthread_mutex_init (&pq->plock, NULL);
+    for (i=0; i<QRY_MAX_CLIENTS; i++)
+    {
+        pq->client[i].fd  = -1;
+        pq->client[i].sfd = -1;
+    }
+
+    memset (&sa, 0, sizeof (sa));
+    sa.sin_family      = AF_INET;
+    sa.sin_port        = htons ((unsigned short) port);
+    sa.sin_addr.s_addr = htonl (INADDR_ANY);
+
+    if (((pq->lfd = socket (AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) ||
+        (setsockopt (pq->lfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on)) < 0) ||
+        (bind (pq->lfd, (struct sockaddr *) &sa, sizeof (sa)) < 0) ||
+        (listen (pq->lfd, 16) < 0))
+    {
+        perror ("query server socket");
+        qryDestroy (pq);
+        return NULL;
+    }
+
+    if (((pq->efd = epoll_create1 (EPOLL_CLOEXEC)) < 0) ||
+        ((pq->wfd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0))
+    {
+        perror ("query server epoll");
+        qryDestroy (pq);
+        return NULL;
+    }
+
+    /* listening socket and stop event; tagged with NULL / the server */
+    ev.events   = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl (pq->efd, EPOLL_CTL_ADD, pq->lfd, &ev);
+    ev.data.ptr = pq;
+    epoll_ctl (pq->efd, EPOLL_CTL_ADD, pq->wfd, &ev);
+
+    if (pthread_create (&pq->thread, NULL, qryThread, pq) != 0)
+    {
+        perror ("query server thread");
+        qryDestroy (pq);
+        return NULL;
+    }
+    return pq;
+}
+
+
+
+/* stop the server thread, close all connections, and release it
+ */
+void  qryDestroy (gmtQueryServer *pq)
+{
+    uint64_t  one = 1;
+    int       i;
+
+    if (!pq)
+        return;
+
+    if (pq->thread)
+    {
+        if (write (pq->wfd, &one, sizeof (one)) < 0)
+            perror ("query server stop");
+        pthread_join (pq->thread, NULL);
+    }
+
+    for (i=0; i<QRY_MAX_CLIENTS; i++)
+        if (pq->client[i].fd >= 0)
+            qryClose (pq, &pq->client[i]);
+
+    if (pq->lfd >= 0)  close (pq->lfd);
+    if (pq->efd >= 0)  close (pq->efd);
+    if (pq->wfd >= 0)  close (pq->wfd);
+    pthread_mutex_destroy (&pq->plock);
+    free (pq);
+}
+
+
+
+/* change the data directory, e.g. after a configuration reload;
+ * the server thread takes it over with the next request
+ */
+void  qrySetPath (gmtQueryServer *pq, const char *path)
+{
+    if (!pq)
+        return;
+    pthread_mutex_lock (&pq->plock);
+    strncpy (pq->npath, path, FILENAME_MAXSIZE);
+    pq->npath[FILENAME_MAXSIZE-1] = '\0';
+    pthread_mutex_unlock (&pq->plock);
+}
+
+
+
+/* server thread; waits for socket events only, no polling
+ */
+static void  *qryThread (void *arg)
+{
+    gmtQueryServer      *pq = (gmtQueryServer *) arg;
+    struct epoll_event   ev[16];
+    qryClient           *pc;
+    int                  i, n, r;
+
+    while (1)
+    {
+        if ((n = epoll_wait (pq->efd, ev, 16, -1)) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror ("query server wait");
+            break;
+        }
+
+        for (i=0; i<n; i++)
+        {
+            if (ev[i].data.ptr == pq)           /* stop request   */
+                return NULL;
+            if (ev[i].data.ptr == NULL)         /* new connection */
+            {
+                qryAccept (pq);
+                continue;
+            }
+
+            pc = (qryClient *) ev[i].data.ptr;
+            if (ev[i].events & (EPOLLERR | EPOLLHUP))
+                pc->closing = 1;
+            if (ev[i].events & (EPOLLIN | EPOLLRDHUP))
+                qryRead (pq, pc);
+            if (pc->fd < 0)
+                continue;
+
+            /* answer request lines one by one, as far as the socket takes it;
+             * a full buffer without a line end is answered, too, as nothing
+             * more is read then, and the socket would stay readable */
+            while (((r = qryFlush (pq, pc)) == 0) &&
+                   (strchr (pc->in, '\n') || (pc->inlen >= QRY_LINE_MAX - 1)))
+                qryRequests (pq, pc);
+            if ((r == 0) && pc->closing)
+                qryClose (pq, pc);
+        }
+    }
+    return NULL;
+}
+
+
+
+/* accept all pending connections;
+ * connections beyond QRY_MAX_CLIENTS are closed right away
+ */
+static void  qryAccept (gmtQueryServer *pq)
+{
+    struct epoll_event  ev;
+    int                 fd, i, on = 1;
+
+    while ((fd = accept4 (pq->lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        for (i=0; i<QRY_MAX_CLIENTS; i++)
+            if (pq->client[i].fd < 0)
+                break;
+        if (i >= QRY_MAX_CLIENTS)
+        {
+            close (fd);
+            continue;
+        }
+
+        setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof (on));
+        memset (&pq->client[i], 0, sizeof (qryClient));
+        pq->client[i].fd  = fd;
+        pq->client[i].sfd = -1;
+
+        ev.events   = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = &pq->client[i];
+        epoll_ctl (pq->efd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+
+
+/* read all available request data
+ */
+static void  qryRead (gmtQueryServer *pq, qryClient *pc)
+{
+    ssize_t  n;
+
+    while (pc->inlen < QRY_LINE_MAX - 1)
+    {
+        n = read (pc->fd, pc->in + pc->inlen, QRY_LINE_MAX - 1 - pc->inlen);
+        if (n > 0)
+        {
+            pc->inlen += (size_t) n;
+            continue;
+        }
+        if ((n == 0) || ((errno != EAGAIN) && (errno != EINTR)))
+            pc->closing = 1;
+        if ((n < 0) && (errno == EINTR))
+            continue;
+        break;
+    }
+    pc->in[pc->inlen] = '\0';
+}
+
+
+
+/* take over a changed data directory; the cached days
+ * belong to the old one, and are dropped
+ */
+static void  qryPath (gmtQueryServer *pq)
+{
+    int  i;
+
+    pthread_mutex_lock (&pq->plock);
+    if (pq->npath[0])
+    {
+        strcpy (pq->path, pq->npath);
+        pq->npath[0] = '\0';
+        for (i=0; i<QRY_CACHE_DAYS; i++)
+            pq->cache[i].used = 0;
+    }
+    pthread_mutex_unlock (&pq->plock);
+}
+
+
+
+/* handle complete request lines, as long as no answer is pending
+ */
+static void  qryRequests (gmtQueryServer *pq, qryClient *pc)
+{
+    char   *pl, *pe;
+    size_t  used;
+
+    qryPath (pq);
+    while ((pc->outlen == 0) && (pc->sfd < 0) && (pe = strchr (pc->in, '\n')))
+    {
+        *pe = '\0';
+        if ((pe > pc->in) && (pe[-1] == '\r'))
+            pe[-1] = '\0';
+        pl = pc->in;
+
+        if (strncasecmp (pl, "RANGE ", 6) == 0)
+            qryRange (pq, pc, pl + 6);
+        else if (strncasecmp (pl, "DAY ", 4) == 0)
+            qryDayFile (pq, pc, pl + 4);
+        else if (strncasecmp (pl, "ROLLUP ", 7) == 0)
+            qryRollup (pq, pc, pl + 7);
+        else if (*pl)
+            qryPrintf (pc, "ERR unknown request\n");
+
+        used = (size_t) (pe - pc->in) + 1;
+        memmove (pc->in, pc->in + used, pc->inlen - used + 1);
+        pc->inlen -= used;
+    }
+
+    /* a line longer than the buffer can never complete */
+    if ((pc->inlen >= QRY_LINE_MAX - 1) && !strchr (pc->in, '\n'))
+    {
+        qryPrintf (pc, "ERR request too long\n");
+        pc->inlen   = 0;
+        pc->closing = 1;
+    }
+}
+
+
+
+/* send pending answer data, without blocking; watches for
+ * EPOLLOUT instead of EPOLLIN while data are left;
+ * returns 0 if all is sent, 1 if data are pending, or -1 if closed
+ */
+static int  qryFlush (gmtQueryServer *pq, qryClient *pc)
+{
+    struct epoll_event  ev;
+    ssize_t             n;
+
+    while (pc->outpos < pc->outlen)
+    {
+        n = write (pc->fd, pc->out + pc->outpos, pc->outlen - pc->outpos);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                goto pending;
+            qryClose (pq, pc);
+            return -1;
+        }
+        pc->outpos += (size_t) n;
+    }
+    pc->outlen = pc->outpos = 0;
+
+    /* file data go straight from the page cache to the socket */
+    while (pc->sleft > 0)
+    {
+        n = sendfile (pc->fd, pc->sfd, &pc->soff, pc->sleft);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                goto pending;
+            qryClose (pq, pc);
+            return -1;
+        }
+        if (n == 0)             /* file shrunk, should not happen */
+            break;
+        pc->sleft -= (size_t) n;
+    }
+    if (pc->sfd >= 0)
+    {
+        close (pc->sfd);
+        pc->sfd = -1;
+    }
+
+    ev.events   = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = pc;
+    epoll_ctl (pq->efd, EPOLL_CTL_MOD, pc->fd, &ev);
+    return 0;
+
+pending:
+    ev.events   = EPOLLOUT;
+    ev.data.ptr = pc;
+    epoll_ctl (pq->efd, EPOLL_CTL_MOD, pc->fd, &ev);
+    return 1;
+}
+
+
+
+/* close a connection, and free its resources
+ */
+static void  qryClose (gmtQueryServer *pq, qryClient *pc)
+{
+    epoll_ctl (pq->efd, EPOLL_CTL_DEL, pc->fd, NULL);
+    close (pc->fd);
+    if (pc->sfd >= 0)
+        close (pc->sfd);
+    free (pc->out);
+    memset (pc, 0, sizeof (qryClient));
+    pc->fd  = -1;
+    pc->sfd = -1;
+}
+
+
+
+/* RANGE <start> <end> [<step> [<axes>]];
+ * every step interval that lies within the in-memory history is taken
+ * from there, older ones from the (cached) day files
+ */
+static void  qryRange (gmtQueryServer *pq, qryClient *pc, char *args)
+{
+    long            start, end, step, t, lines;
+    char            axes[8] = "XYZ";
+    int             use[GMT_AXES], i, n;
+    time_t          hfrom, hto;   /* history span, data after <hto> do not exist yet */
+    int             hok;
+    histStats       hs;
+    double          sum[GMT_AXES], mean[GMT_AXES];
+    size_t          hdr;
+
+    step = 60;
+    n = sscanf (args, "%ld %ld %ld %7s", &start, &end, &step, axes);
+    if ((n < 2) || (end <= start) || (step < 1))
+    {
+        qryPrintf (pc, "ERR usage: RANGE <start> <end> [<step> [<axes>]]\n");
+        return;
+    }
+    if ((end - start) / step > QRY_MAX_LINES)
+    {
+        qryPrintf (pc, "ERR more than %d lines\n", QRY_MAX_LINES);
+        return;
+    }
+    /* bounds the day file work of a request, whatever the step */
+    if (end - start > QRY_MAX_SPAN)
+    {
+        qryPrintf (pc, "ERR longer than %d days, use ROLLUP\n", QRY_MAX_SPAN / (24 * 3600));
+        return;
+    }
+
+    for (i=0; i<GMT_AXES; i++)
+        use[i] = (strchr (axes, 'X' + i) || strchr (axes, 'x' + i)) ? 1 : 0;
+
+    hok = (pq->hist && histSpan (pq->hist, &hfrom, &hto));
+
+    /* the day files are read per minute; a start within a minute is
+     * taken from the start of that minute, a step must be whole ones */
+    if (!hok || (start < hfrom))
+    {
+        if (step % 60)
+        {
+            if (hok)
+                qryPrintf (pc, "ERR step must be whole minutes before %ld\n", (long) hfrom);
+            else
+                qryPrintf (pc, "ERR step must be whole minutes\n");
+            return;
+        }
+        start -= ((start % 60) + 60) % 60;
+    }
+    pq->reqno++;
+    lines = 0;
+
+    for (t=start; t<end; t+=step)
+    {
+        if (hok && (t >= hfrom))
+        {
+            if (histQuery (pq->hist, t, t + step, &hs) == 0)
+                continue;
+            memcpy (mean, hs.mean, sizeof (mean));
+        }
+        else
+        {
+            if ((n = qryArchive (pq, (time_t) t, (time_t) (t + step), sum)) == 0)
+                continue;
+            for (i=0; i<GMT_AXES; i++)
+                mean[i] = sum[i] / n;
+        }
+
+        qryPrintf (pc, "%ld", t);
+        for (i=0; i<GMT_AXES; i++)
+            if (use[i])
+                qryPrintf (pc, ", %.6lf", mean[i]);
+        qryPrintf (pc, "\n");
+        lines++;
+    }
+
+    /* the header goes in front, once the line count is known */
+    hdr = pc->outlen;
+    qryPrintf (pc, "OK %ld\n", lines);
+    if (pc->out)
+    {
+        char  hbuf[32];
+        size_t  hlen = pc->outlen - hdr;
+
+        memcpy (hbuf, pc->out + hdr, hlen);
+        memmove (pc->out + hlen, pc->out, hdr);
+        memcpy (pc->out, hbuf, hlen);
+    }
+}
+
+
+
+/* DAY <YYYY_MM_DD> [DAT | ESD | GMZ];
+ * the day file is sent unchanged, with sendfile()
+ */
+static void  qryDayFile (gmtQueryServer *pq, qryClient *pc, char *args)
+{
+    char         name[FILENAME_MAXSIZE + 32];
+    char         day[16], fmt[8] = "DAT";
+    const char  *ext = ".dat";
+    struct stat  st;
+    int          y, m, d;
+
+    if ((sscanf (args, "%15s %7s", day, fmt) < 1) ||
+        (sscanf (day, "%4d_%2d_%2d", &y, &m, &d) != 3))
+    {
+        qryPrintf (pc, "ERR usage: DAY <YYYY_MM_DD> [DAT | ESD | GMZ]\n");
+        return;
+    }
+
+    if (strcasecmp (fmt, "ESD") == 0)
+        ext = ESD_FILE_EXT;
+    else if (strcasecmp (fmt, "GMZ") == 0)
+        ext = GMZ_FILE_EXT;
+    snprintf (name, sizeof (name), "%s/%04d_%02d_%02d%s", pq->path, y, m, d, ext);
+    if (((pc->sfd = open (name, O_RDONLY | O_CLOEXEC)) < 0) || (fstat (pc->sfd, &st) < 0))
+    {
+        if (pc->sfd >= 0)
+            close (pc->sfd);
+        pc->sfd = -1;
+        qryPrintf (pc, "ERR no such day\n");
+        return;
+    }
+
+    pc->soff  = 0;
+    pc->sleft = (size_t) st.st_size;
+    qryPrintf (pc, "OK %lu\n", (unsigned long) st.st_size);
+}
+
+
+
+/* ROLLUP <start> <end> <points>;
+ * the slots of the rollup level for a plot <points> wide, from the
+ * rollup files of the first sensor
+ */
+static void  qryRollup (gmtQueryServer *pq, qryClient *pc, char *args)
+{
+    long    start, end;
+    int     points, n;
+    size_t  hdr;
+
+    if ((sscanf (args, "%ld %ld %d", &start, &end, &points) != 3) || (end <= start) || (points < 1))
+    {
+        qryPrintf (pc, "ERR usage: ROLLUP <start> <end> <points>\n");
+        return;
+    }
+    if ((end - start) / rollLevel (start, end, points) > QRY_MAX_LINES)
+    {
+        qryPrintf (pc, "ERR more than %d lines\n", QRY_MAX_LINES);
+        return;
+    }
+    if ((n = rollQuery (pq->path, NULL, (time_t) start, (time_t) end, points, qryRow, pc)) < 0)
+    {
+        qryPrintf (pc, "ERR no rollup\n");
+        return;
+    }
+
+    /* the header goes in front, as for RANGE */
+    hdr = pc->outlen;
+    qryPrintf (pc, "OK %d %d\n", n, rollLevel (start, end, points));
+    if (pc->out)
+    {
+        char    hbuf[32];
+        size_t  hlen = pc->outlen - hdr;
+
+        memcpy (hbuf, pc->out + hdr, hlen);
+        memmove (pc->out + hlen, pc->out, hdr);
+        memcpy (pc->out, hbuf, hlen);
+    }
+}
+
+
+
+/* one line of a ROLLUP answer
+ * returns 0, to go on
+ */
+static int  qryRow (void *arg, const gmrRow *pr)
+{
+    qryClient  *pc = (qryClient *) arg;
+    int         i;
+
+    qryPrintf (pc, "%ld, %u", (long) pr->time, pr->count);
+    for (i=0; i<pr->axes; i++)
+        qryPrintf (pc, ", %.6lf, %.6lf, %.6lf", pr->mean[i], pr->min[i], pr->max[i]);
+    qryPrintf (pc, "\n");
+    return 0;
+}
+
+
+
+/* append formatted text to the answer buffer
+ */
+static void  qryPrintf (qryClient *pc, const char *fmt, ...)
+{
+    va_list  ap;
+    char    *pb;
+    int      n;
+
+    while (1)
+    {
+        va_start (ap, fmt);
+        n = vsnprintf (pc->out ? pc->out + pc->outlen : NULL,
+                       pc->out ? pc->outsize - pc->outlen : 0, fmt, ap);
+        va_end (ap);
+        if (n < 0)
+            return;
+        if (pc->out && (pc->outlen + (size_t) n < pc->outsize))
+            break;
+
+        if (!(pb = realloc (pc->out, pc->outsize + (size_t) n + 4096)))
+            return;
+        pc->out      = pb;
+        pc->outsize += (size_t) n + 4096;
+    }
+    pc->outlen += (size_t) n;
+}
+
+
+
+/* sum of the records of the minutes that start within [from, to), from
+ * the stored day files; the minutes of each day are summed as a slice
+ * of its cached array, so the work does not depend on the step;
+ * returns the number of records
+ */
+static int  qryArchive (gmtQueryServer *pq, time_t from, time_t to, double *sum)
+{
+    struct tm     tm, tn;
+    const qryDay *pd;
+    time_t        t, next, e;
+    int           i, slot, last, n;
+
+    for (i=0; i<GMT_AXES; i++)
+        sum[i] = 0.0;
+    n = 0;
+
+    for (t=from + (60 - from % 60) % 60; t<to; t=next)
+    {
+        localtime_r (&t, &tm);
+        slot = tm.tm_hour * 60 + tm.tm_min;
+
+        /* the next local midnight; at DST changes a day has 23 or 25 hours */
+        tn = tm;
+        tn.tm_mday++;
+        tn.tm_hour  = 0;
+        tn.tm_min   = 0;
+        tn.tm_sec   = 0;
+        tn.tm_isdst = -1;
+        next = mktime (&tn);
+
+        /* up to the minute that starts at or after <to>, in local time */
+        last = MINS_PER_DAY;
+        e    = to + (60 - to % 60) % 60;
+        if (e < next)
+        {
+            localtime_r (&e, &tn);
+            last = tn.tm_hour * 60 + tn.tm_min;
+        }
+
+        if (!(pd = qryCache (pq, &tm)))
+            continue;
+        for (; slot<last; slot++)
+        {
+            if (pd->n[slot] == 0)
+                continue;
+            for (i=0; i<GMT_AXES; i++)
+                sum[i] += pd->v[slot][i];
+            n += pd->n[slot];
+        }
+    }
+    return n;
+}
+
+
+
+/* the cache entry of the day of <ptm>; decoded days are kept in an
+ * LRU cache, an entry is decoded again if its file has changed since;
+ * returns NULL if there is no file for that day
+ */
+static qryDay  *qryCache (gmtQueryServer *pq, struct tm *ptm)
+{
+    qryDay    *pd, *plru;
+    int        i;
+
+    plru = &pq->cache[0];
+    pd   = NULL;
+    for (i=0; i<QRY_CACHE_DAYS; i++)
+    {
+        if (pq->cache[i].used && (pq->cache[i].year == ptm->tm_year + 1900) &&
+            (pq->cache[i].mon == ptm->tm_mon + 1) && (pq->cache[i].mday == ptm->tm_mday))
+        {
+            pd = &pq->cache[i];
+            break;
+        }
+        if (!pq->cache[i].used || (pq->cache[i].stamp < plru->stamp))
+            plru = &pq->cache[i];
+    }
+
+    if (!pd)
+    {
+        pd = plru;
+        pd->used = 0;
+    }
+    pd->stamp = ++pq->clock;
+    if (qryLoadDay (pq, pd, ptm) != 0)
+        return NULL;
+    return pd;
+}
+
+
+
+/* (re)load the day of <ptm> into cache entry <pd>, if needed; the file
+ * is checked for changes only once per request;
+ * the binary day file is used if present, the text file otherwise,
+ * or its archive form, once compacted;
+ * returns 0 if the entry holds the data of that day,
+ * or -1 if there is no file for that day
+ */
+static int  qryLoadDay (gmtQueryServer *pq, qryDay *pd, struct tm *ptm)
+{
+    char          name[FILENAME_MAXSIZE + 32];
+    char          lbuf[256];
+    struct stat   st;
+    esdFile       esd;
+    gmzReader     gr;
+    gmzItem       gi;
+    double        v[GMT_AXES];
+    FILE         *fp;
+    double        a, b, c, scale;
+    int           i, k, hh, mm, n, year, mon;
+
+    year = ptm->tm_year + 1900;
+    mon  = ptm->tm_mon + 1;
+    if (pd->used && (pd->checked == pq->reqno))
+        return (pd->nodata ? -1 : 0);
+
+    pd->used    = 1;
+    pd->year    = year;
+    pd->mon     = mon;
+    pd->mday    = ptm->tm_mday;
+    pd->checked = pq->reqno;
+
+    snprintf (name, sizeof (name), "%s/%04d_%02d_%02d%s", pq->path, year, mon, ptm->tm_mday, ESD_FILE_EXT);
+    if (stat (name, &st) != 0)
+    {
+        snprintf (name, sizeof (name), "%s/%04d_%02d_%02d.dat", pq->path, year, mon, ptm->tm_mday);
+        if (stat (name, &st) != 0)
+        {
+            snprintf (name, sizeof (name), "%s/%04d_%02d_%02d%s", pq->path, year, mon, ptm->tm_mday, GMZ_FILE_EXT);
+            if (stat (name, &st) != 0)
+            {
+                pd->nodata = 1;
+                return -1;
+            }
+        }
+    }
+    if (!pd->nodata && (pd->mtime == st.st_mtime) && (pd->mtime != 0))
+        return 0;
+
+    pd->nodata = 1;
+    pd->mtime  = 0;
+
+    memset (pd->v, 0, sizeof (pd->v));
+    memset (pd->n, 0, sizeof (pd->n));
+
+    if (strstr (name, ESD_FILE_EXT))
+    {
+        if (esdOpen (&esd, name) != 0)
+            return -1;
+        for (i=0; i<(int) esd.hdr->slots; i++)
+        {
+            if (!esdGet (&esd, i, v))
+                continue;
+            k = (int) ((i * esd.hdr->period) / 60);
+            if (k >= MINS_PER_DAY)
+                break;
+            qryAdd (pd, k, v, esd.hdr->axes);
+        }
+        esdClose (&esd);
+    }
+    else if (strstr (name, GMZ_FILE_EXT))
+    {
+        /* the same as the text file, without parsing it */
+        if (gmzOpen (&gr, name) != 0)
+            return -1;
+        scale = 1.0;
+        while (gmzNext (&gr, &gi) > 0)
+        {
+            if (gi.kind == GMZ_ITEM_TEXT)
+            {
+                if (sscanf (gi.text, "# scale value = %lf", &a) == 1)
+                    scale = a;
+                else if (strncmp (gi.text, "# -- ", 5) == 0)
+                    scale = 1.0;
+                continue;
+            }
+            if ((gi.tod < 0) || (gi.tod >= MINS_PER_DAY * 60))
+                continue;
+            for (i=0; i<GMT_AXES; i++)
+                v[i] = gi.v[i] * scale;
+            qryAdd (pd, (int) (gi.tod / 60), v, (gi.cols >= GMT_AXES) ? GMT_AXES : 1);
+        }
+        gmzClose (&gr);
+    }
+    else
+    {
+        if (!(fp = fopen (name, "r")))
+            return -1;
+        /* integer units, if a scale is given; it may change
+         * within the file, after a restart */
+        scale = 1.0;
+        while (fgets (lbuf, sizeof (lbuf), fp))
+        {
+            if (lbuf[0] == '#')
+            {
+                if (sscanf (lbuf, "# scale value = %lf", &a) == 1)
+                    scale = a;
+                else if (strncmp (lbuf, "# -- ", 5) == 0)
+                    scale = 1.0;
+                continue;
+            }
+            /* records shorter than a minute carry the seconds */
+            if ((n = sscanf (lbuf, "%d:%d:%*d, %lf, %lf, %lf", &hh, &mm, &a, &b, &c)) < 3)
+                n = sscanf (lbuf, "%d:%d, %lf, %lf, %lf", &hh, &mm, &a, &b, &c);
+            if ((n < 3) || (hh < 0) || (hh > 23) || (mm < 0) || (mm > 59))
+                continue;
+            v[0] = a * scale;
+            if (n == 5)
+            {
+                v[1] = b * scale;
+                v[2] = c * scale;
+            }
+            qryAdd (pd, hh * 60 + mm, v, (n == 5) ? GMT_AXES : 1);
+        }
+        fclose (fp);
+    }
+
+    pd->nodata = 0;
+    pd->mtime  = st.st_mtime;
+    return 0;
+}
+
+
+
+/* add a record of <axes> values to minute <k> of a cache entry; a
+ * single value (the magnitude) leaves the other axes without data
+ */
+static void  qryAdd (qryDay *pd, int k, const double *pv, int axes)
+{
+    if ((k < 0) || (k >= MINS_PER_DAY) || (pd->n[k] == USHRT_MAX))
+        return;
+
+    pd->v[k][0] += pv[0];
+    if (axes == GMT_AXES)
+    {
+        pd->v[k][1] += pv[1];
+        pd->v[k][2] += pv[2];
+    }
+    else
+    {
+        pd->v[k][1] = NAN;
+        pd->v[k][2] = NAN;
+    }
+    pd->n[k]++;
+}
@@ -0,0 +1,175 @@
+/***************************************************************************
+ *                           gmtring.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements a bounded, lock-free ring buffer
+ *      for exactly one producer and one consumer thread
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "gmt.h"
+
+/* the producer only ever writes <head>, the consumer only ever writes <tail>;
+ * both are free-running counters, the buffer index is (counter & mask);
+ * keeping them in separate cache lines avoids false sharing between the
+ * sampler and the consumer core
+ */
+#define RING_CACHELINE      64
+
+struct gmtRing
+{
+    _Atomic unsigned long  head;                    /* next slot to write */
+    char                   pad0[RING_CACHELINE - sizeof (unsigned long)];
+    _Atomic unsigned long  tail;                    /* next slot to read  */
+    char                   pad1[RING_CACHELINE - sizeof (unsigned long)];
+    _Atomic unsigned long  overruns;                /* dropped on full    */
+    unsigned long          mask;                    /* slot count - 1     */
+    size_t                 esize;                   /* element size       */
+    unsigned char         *buf;                     /* element storage    */
+};
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* create a ring for <count> elements of <esize> bytes each;
+ * <count> is rounded up to the next power of 2;
+ * returns NULL if memory allocation failed
+ */
+gmtRing  *ringCreate (unsigned long count, size_t esize)
+{
+    gmtRing        *pr;
+    unsigned long   n;
+
+    n = 2;
+    while (n < count)
+        n <<= 1;
+
+    if (!(pr = aligned_alloc (RING_CACHELINE, sizeof (gmtRing))))
+        return NULL;
+    memset (pr, 0, sizeof (gmtRing));
+
+    if (!(pr->buf = malloc (n * esize)))
+    {
+        free (pr);
+        return NULL;
+    }
+
+    pr->mask  = n - 1;
+    pr->esize = esize;
+    atomic_init (&pr->head, 0);
+    atomic_init (&pr->tail, 0);
+    atomic_init (&pr->overruns, 0);
+    return pr;
+}
+
+
+
+/* release the ring memory;
+ * both threads must have stopped using it
+ */
+void  ringDestroy (gmtRing *pr)
+{
+    if (!pr)
+        return;
+    free (pr->buf);
+    free (pr);
+}
+
+
+
+/* producer side; copy one element into the ring;
+ * returns 1 if stored, or 0 if the ring was full - the element is dropped
+ * and counted then, the producer never waits for the consumer
+ */
+int  ringPush (gmtRing *pr, const void *pe)
+{
+    unsigned long  h, t;
+
+    h = atomic_load_explicit (&pr->head, memory_order_relaxed);
+    t = atomic_load_explicit (&pr->tail, memory_order_acquire);
+    if ((h - t) > pr->mask)
+    {
+        atomic_fetch_add_explicit (&pr->overruns, 1, memory_order_relaxed);
+        return 0;
+    }
+
+    memcpy (pr->buf + (h & pr->mask) * pr->esize, pe, pr->esize);
+    atomic_store_explicit (&pr->head, h + 1, memory_order_release);
+    return 1;
+}
+
+
+
+/* consumer side; copy the oldest element out of the ring;
+ * returns 1 if an element was read, or 0 if the ring was empty
+ */
+int  ringPop (gmtRing *pr, void *pe)
+{
+    unsigned long  h, t;
+
+    t = atomic_load_explicit (&pr->tail, memory_order_relaxed);
+    h = atomic_load_explicit (&pr->head, memory_order_acquire);
+    if (h == t)
+        return 0;
+
+    memcpy (pe, pr->buf + (t & pr->mask) * pr->esize, pr->esize);
+    atomic_store_explicit (&pr->tail, t + 1, memory_order_release);
+    return 1;
+}
+
+
+
+/* consumer side; copy the oldest element, but leave it in the ring;
+ * returns 1 if an element was read, or 0 if the ring was empty
+ */
+int  ringPeek (gmtRing *pr, void *pe)
+{
+    unsigned long  h, t;
+
+    t = atomic_load_explicit (&pr->tail, memory_order_relaxed);
+    h = atomic_load_explicit (&pr->head, memory_order_acquire);
+    if (h == t)
+        return 0;
+
+    memcpy (pe, pr->buf + (t & pr->mask) * pr->esize, pr->esize);
+    return 1;
+}
+
+
+
+/* number of elements currently queued;
+ * only a snapshot if called while the other side is active
+ */
+unsigned long  ringCount (gmtRing *pr)
+{
+    return (atomic_load_explicit (&pr->head, memory_order_acquire) -
+            atomic_load_explicit (&pr->tail, memory_order_acquire));
+}
+
+
+
+/* number of elements dropped because the ring was full
+ */
+unsigned long  ringOverruns (gmtRing *pr)
+{
+    return (atomic_load_explicit (&pr->overruns, memory_order_relaxed));
+}
@@ -0,0 +1,540 @@
+/***************************************************************************
+ *                           gmtroll.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the rollup pyramid, the min / max /
+ *      mean of the records per minute, 10 minutes, hour and day
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "gmt.h"
+
+_Static_assert (sizeof (gmrHeader) == GMR_HEADER_SIZE, "gmrHeader size");
+_Static_assert (sizeof (gmrSlot) == 56, "gmrSlot size");
+
+/*  All levels are kept alike, so a level is read without the others;
+ *  a slot of a level is the sum of its GMR_FANOUT children one level
+ *  below, and the days of the year line up with the slots of all of
+ *  them. The files are sparse, only the slots with data take space.
+ */
+static const int  rPeriod[GMR_LEVELS] = GMR_PERIODS;
+static const int  rFanout[GMR_LEVELS] = GMR_FANOUT;
+
+/* --- prototypes ----
+ */
+extern int             idxOpen    (gmtIndex *pi, const char *path);
+extern void            idxClose   (gmtIndex *pi);
+extern const idxEntry *idxFind    (gmtIndex *pi, int year, int mon, int mday, const char *tag);
+extern int             idxReadDay (const char *path, const idxEntry *pe, time_t from, time_t to,
+                                   idxSink fn, void *arg);
+
+void           rollClose  (gmtRollup *pr);
+static int     rollMap    (gmtRollup *pr, int level, int axes);
+static int     rollDay    (gmtRollup *pr, gmtIndex *pi, int day);
+static int     addMinute  (void *arg, time_t t, long tod, const double *pv, int cols);
+static void    slotAdd    (gmrSlot *ps, const double *pv, int axes);
+static void    slotMerge  (gmrSlot *ps, const gmrSlot *pc, int n, int axes);
+static int     yearDays   (int year);
+static time_t  yearStart  (int year);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* open the rollup files of sensor <tag> (NULL or empty for the first
+ * one) in data directory <path>, for UTC <year>; writable ones are
+ * created if they do not exist, and cleared if they hold another
+ * number of <axes>; read-only, the axes are those of the files;
+ * returns 0 on success, or -1 on error
+ */
+int  rollOpen (gmtRollup *pr, const char *path, const char *tag, int year, int axes, int writable)
+{
+    char  dir[FILENAME_MAXSIZE + 16];
+    int   l;
+
+    memset (pr, 0, sizeof (gmtRollup));
+    strncpy (pr->path, path, FILENAME_MAXSIZE - 1);
+    if (tag)
+        strncpy (pr->tag, tag, GMT_NAME_SIZE - 1);
+    pr->year     = year;
+    pr->axes     = axes;
+    pr->writable = writable;
+    pr->start    = yearStart (year);
+    for (l=0; l<GMR_LEVELS; l++)
+        pr->fd[l] = -1;
+
+    if (writable)
+    {
+        snprintf (dir, sizeof (dir), "%s/%s", path, GMR_DIR);
+        if ((mkdir (dir, 0775) != 0) && (errno != EEXIST))
+        {
+            pr->year = 0;
+            return -1;
+        }
+    }
+    for (l=0; l<GMR_LEVELS; l++)
+    {
+        if (rollMap (pr, l, axes) != 0)
+        {
+            rollClose (pr);
+            return -1;
+        }
+        axes = pr->axes;
+    }
+    return 0;
+}
+
+
+
+/* unmap and close the rollup files; path and tag are kept
+ */
+void  rollClose (gmtRollup *pr)
+{
+    int  l;
+
+    for (l=0; l<GMR_LEVELS; l++)
+    {
+        if (pr->hdr[l])
+        {
+            munmap (pr->hdr[l], pr->size[l]);
+            close (pr->fd[l]);
+        }
+        pr->hdr[l]  = NULL;
+        pr->slot[l] = NULL;
+        pr->fd[l]   = -1;
+    }
+    pr->year = 0;
+}
+
+
+
+/* add one record at time <t> to all levels; at the turn of the
+ * year, the files of the new year are opened
+ * returns 0 if added, or 1 if not
+ */
+int  rollAdd (gmtRollup *pr, time_t t, const double *pv, int axes)
+{
+    char       path[FILENAME_MAXSIZE], tag[GMT_NAME_SIZE];
+    struct tm  tm;
+    long       sec;
+    int        l;
+
+    if (!pr->year || !pr->writable)
+        return 1;
+    sec = (long) (t - pr->start);
+    if ((sec < 0) || (sec >= (long) pr->hdr[0]->days * 86400))
+    {
+        strcpy (path, pr->path);
+        strcpy (tag, pr->tag);
+        rollClose (pr);
+        gmtime_r (&t, &tm);
+        if (rollOpen (pr, path, tag, tm.tm_year + 1900, axes, 1) != 0)
+            return 1;
+        sec = (long) (t - pr->start);
+    }
+    if (axes != pr->axes)
+        return 1;
+
+    for (l=0; l<GMR_LEVELS; l++)
+        slotAdd (&pr->slot[l][sec / rPeriod[l]], pv, axes);
+    return 0;
+}
+
+
+
+/* rebuild the UTC days of the open year that overlap [from, to) from
+ * the day files of index <pi>; only those not built yet, or all of
+ * them with <force>; days that end before <now> are marked built,
+ * later ones are left out
+ * returns the number of days rebuilt
+ */
+int  rollRebuild (gmtRollup *pr, gmtIndex *pi, time_t from, time_t to, time_t now, int force)
+{
+    gmrHeader  *ph = pr->hdr[0];
+    long        d0, d1, d;
+    int         n = 0;
+
+    if (!pr->year || !pr->writable)
+        return 0;
+    d0 = (from > pr->start) ? (long) (from - pr->start) / 86400 : 0;
+    d1 = (to > pr->start) ? (long) (to - pr->start + 86399) / 86400 : 0;
+    if (d1 > ph->days)
+        d1 = ph->days;
+
+    for (d=d0; d<d1; d++)
+    {
+        if (!force && (ph->built[d / 8] & (1 << (d % 8))))
+            continue;
+        if (pr->start + d * 86400 > now)
+            break;
+        rollDay (pr, pi, (int) d);
+        if (pr->start + (d + 1) * 86400 <= now)
+            ph->built[d / 8] |= (unsigned char) (1 << (d % 8));
+        n++;
+    }
+    return n;
+}
+
+
+
+/* bring the rollup of a sensor up to date at time <t>, the daemon
+ * does it at the start and at each day change; updates the index of
+ * the data directory, (re)opens the files of the year for <path>,
+ * <tag> and <axes>, and rebuilds the days not built yet; the year
+ * before, too, while the directory holds files of it
+ * returns 0 on success, or -1 on error
+ */
+int  rollUpdate (gmtRollup *pr, const char *path, const char *tag, int axes, time_t t)
+{
+    gmtRollup  prev;
+    gmtIndex   gi;
+    struct tm  tm;
+    int        year;
+
+    if (idxOpen (&gi, path) != 0)
+        return -1;
+    gmtime_r (&t, &tm);
+    year = tm.tm_year + 1900;
+
+    if ((gi.count > 0) && (gi.entry[0].year < year) &&
+        (rollOpen (&prev, path, tag, year - 1, axes, 1) == 0))
+    {
+        rollRebuild (&prev, &gi, prev.start, yearStart (year), t, 0);
+        rollClose (&prev);
+    }
+
+    if ((pr->year != year) || (pr->axes != axes) || strcmp (pr->path, path) ||
+        strcmp (pr->tag, tag ? tag : ""))
+    {
+        rollClose (pr);
+        if (rollOpen (pr, path, tag, year, axes, 1) != 0)
+        {
+            idxClose (&gi);
+            return -1;
+        }
+    }
+    rollRebuild (pr, &gi, pr->start, t + 1, t, 0);
+    idxClose (&gi);
+    return 0;
+}
+
+
+
+/* the level to read for [from, to) on <points> pixels; the coarsest
+ * one with at least one slot per pixel, or the finest
+ * returns its period, seconds
+ */
+int  rollLevel (time_t from, time_t to, int points)
+{
+    int  l;
+
+    for (l=GMR_LEVELS-1; l>0; l--)
+        if ((to - from) / rPeriod[l] >= points)
+            break;
+    return rPeriod[l];
+}
+
+
+
+/* read the rollup of sensor <tag> in <path> for [from, to), at the
+ * level for <points> pixels (rollLevel()); each slot with data that
+ * starts in the range, or contains its start, is passed to <fn>
+ * returns the number of slots passed, or -1 if there is no rollup
+ * file for the range
+ */
+int  rollQuery (const char *path, const char *tag, time_t from, time_t to, int points,
+                gmrSink fn, void *arg)
+{
+    gmtRollup       gr;
+    gmrRow          row;
+    const gmrSlot  *ps;
+    struct tm       tm;
+    time_t          t;
+    long            i, i1;
+    int             l, a, year, y1, files = 0, n = 0;
+
+    for (l=0; rPeriod[l] != rollLevel (from, to, points); l++)
+        ;
+    gmtime_r (&from, &tm);
+    year = tm.tm_year + 1900;
+    t    = to - 1;
+    gmtime_r (&t, &tm);
+    y1   = tm.tm_year + 1900;
+
+    for (; year<=y1; year++)
+    {
+        memset (&gr, 0, sizeof (gr));
+        strncpy (gr.path, path, FILENAME_MAXSIZE - 1);
+        if (tag)
+            strncpy (gr.tag, tag, GMT_NAME_SIZE - 1);
+        gr.year  = year;
+        gr.start = yearStart (year);
+        gr.fd[l] = -1;
+        if (rollMap (&gr, l, 0) != 0)
+            continue;
+        files++;
+
+        i  = (from > gr.start) ? (long) (from - gr.start) / rPeriod[l] : 0;
+        i1 = (long) (to - gr.start + rPeriod[l] - 1) / rPeriod[l];
+        if (i1 > (long) gr.hdr[l]->slots)
+            i1 = (long) gr.hdr[l]->slots;
+        for (; i<i1; i++)
+        {
+            ps = &gr.slot[l][i];
+            if (ps->count == 0)
+                continue;
+            row.time   = gr.start + (time_t) i * rPeriod[l];
+            row.period = rPeriod[l];
+            row.axes   = gr.axes;
+            row.count  = ps->count;
+            for (a=0; a<GMT_AXES; a++)
+            {
+                row.mean[a] = (a < gr.axes) ? ps->sum[a] / ps->count : 0.0;
+                row.min[a]  = ps->min[a];
+                row.max[a]  = ps->max[a];
+            }
+            n++;
+            if (fn (arg, &row) != 0)
+                break;
+        }
+        munmap (gr.hdr[l], gr.size[l]);
+        close (gr.fd[l]);
+        if (i < i1)
+            break;
+    }
+    return (files ? n : -1);
+}
+
+
+
+/* open and map the file of <level>; a new (writable) file is sized
+ * to the whole year, and its header written; <axes> 0 takes those
+ * of an existing file
+ * returns 0 on success, or -1 on error
+ */
+static int  rollMap (gmtRollup *pr, int level, int axes)
+{
+    char         name[FILENAME_MAXSIZE + GMT_NAME_SIZE + 48];
+    gmrHeader    h, fh;
+    struct stat  st;
+    void        *pm;
+    int          fd;
+
+    memset (&h, 0, sizeof (h));
+    memcpy (h.id, GMR_HEADER_ID, 4);
+    h.version  = GMR_VERSION;
+    h.axes     = (unsigned char) axes;
+    h.level    = (unsigned char) level;
+    h.year     = (unsigned short) pr->year;
+    h.days     = (unsigned short) yearDays (pr->year);
+    h.period   = (unsigned int) rPeriod[level];
+    h.slots    = (unsigned int) (h.days * (86400 / rPeriod[level]));
+    h.slotSize = sizeof (gmrSlot);
+    h.hdrSize  = GMR_HEADER_SIZE;
+
+    snprintf (name, sizeof (name), "%s/%s/%04d_%d%s%s%s", pr->path, GMR_DIR, pr->year,
+              rPeriod[level], pr->tag[0] ? "_" : "", pr->tag, GMR_FILE_EXT);
+    if ((fd = open (name, pr->writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0664)) < 0)
+        return -1;
+    if (fstat (fd, &st) < 0)
+        goto err;
+
+    if ((st.st_size == 0) && pr->writable)
+    {
+        /* sparse; the slots are empty (zero) until written */
+        if ((ftruncate (fd, (off_t) (h.hdrSize + (size_t) h.slots * h.slotSize)) != 0) ||
+            (pwrite (fd, &h, sizeof (h), 0) != sizeof (h)))
+            goto err;
+    }
+    else
+    {
+        if ((pread (fd, &fh, sizeof (fh), 0) != sizeof (fh)) ||
+            (memcmp (fh.id, GMR_HEADER_ID, 4) != 0) || (fh.version != GMR_VERSION) ||
+            (fh.year != h.year) || (fh.period != h.period) || (fh.slots != h.slots) ||
+            (fh.slotSize != h.slotSize) || (fh.hdrSize != h.hdrSize) ||
+            (st.st_size != (off_t) (h.hdrSize + (size_t) h.slots * h.slotSize)))
+        {
+            errno = EINVAL;
+            goto err;
+        }
+        /* another number of axes (mode changed); start over, the
+         * rebuild fills it from the day files again */
+        if (axes && (fh.axes != axes))
+        {
+            if (!pr->writable || (ftruncate (fd, 0) != 0) ||
+                (ftruncate (fd, (off_t) (h.hdrSize + (size_t) h.slots * h.slotSize)) != 0) ||
+                (pwrite (fd, &h, sizeof (h), 0) != sizeof (h)))
+                goto err;
+        }
+        else
+            pr->axes = fh.axes;
+    }
+
+    pr->size[level] = (size_t) (h.hdrSize + (size_t) h.slots * h.slotSize);
+    pm = mmap (NULL, pr->size[level], pr->writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+               MAP_SHARED, fd, 0);
+    if (pm == MAP_FAILED)
+        goto err;
+    pr->fd[level]   = fd;
+    pr->hdr[level]  = (gmrHeader *) pm;
+    pr->slot[level] = (gmrSlot *) ((unsigned char *) pm + GMR_HEADER_SIZE);
+    return 0;
+
+err:
+    close (fd);
+    return -1;
+}
+
+
+
+/* rebuild UTC day <day> of the year; the minutes from the day files,
+ * at most two local days, and the levels above from the minutes;
+ * empty slots are not written, so they take no space
+ * returns 0
+ */
+static int  rollDay (gmtRollup *pr, gmtIndex *pi, int day)
+{
+    const idxEntry  *pe;
+    gmrSlot         *ps, sum;
+    struct tm        tm;
+    time_t           s, e, t;
+    int              l, i, n, pday = 0;
+
+    s  = pr->start + (time_t) day * 86400;
+    e  = s + 86400;
+    n  = 86400 / rPeriod[0];
+    ps = pr->slot[0] + (size_t) day * n;
+    for (i=0; i<n; i++)
+        if (ps[i].count)
+            memset (&ps[i], 0, sizeof (gmrSlot));
+
+    for (t=s; t<e; t+=86399)
+    {
+        localtime_r (&t, &tm);
+        if (tm.tm_mday == pday)
+            continue;
+        pday = tm.tm_mday;
+        if ((pe = idxFind (pi, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, pr->tag)) &&
+            (pe->records > 0))
+            idxReadDay (pi->path, pe, s, e, addMinute, pr);
+    }
+
+    for (l=1; l<GMR_LEVELS; l++)
+    {
+        n  = 86400 / rPeriod[l];
+        ps = pr->slot[l] + (size_t) day * n;
+        for (i=0; i<n; i++)
+        {
+            memset (&sum, 0, sizeof (sum));
+            slotMerge (&sum, pr->slot[l-1] + ((size_t) day * n + i) * rFanout[l], rFanout[l], pr->axes);
+            if (sum.count || ps[i].count)
+                ps[i] = sum;
+        }
+    }
+    return 0;
+}
+
+
+
+/* sink of idxReadDay(); one record into its minute slot
+ */
+static int  addMinute (void *arg, time_t t, long tod, const double *pv, int cols)
+{
+    gmtRollup  *pr = (gmtRollup *) arg;
+
+    (void) tod;
+    if (cols == pr->axes)
+        slotAdd (&pr->slot[0][(t - pr->start) / rPeriod[0]], pv, cols);
+    return 0;
+}
+
+
+
+/* add a record to a slot
+ */
+static void  slotAdd (gmrSlot *ps, const double *pv, int axes)
+{
+    int  a;
+
+    for (a=0; a<axes; a++)
+    {
+        if ((ps->count == 0) || (pv[a] < ps->min[a]))
+            ps->min[a] = (float) pv[a];
+        if ((ps->count == 0) || (pv[a] > ps->max[a]))
+            ps->max[a] = (float) pv[a];
+        ps->sum[a] += pv[a];
+    }
+    ps->count++;
+}
+
+
+
+/* merge <n> child slots at <pc> into the slot at <ps>, which is
+ * empty at first
+ */
+static void  slotMerge (gmrSlot *ps, const gmrSlot *pc, int n, int axes)
+{
+    int  i, a;
+
+    for (i=0; i<n; i++, pc++)
+    {
+        if (pc->count == 0)
+            continue;
+        for (a=0; a<axes; a++)
+        {
+            if ((ps->count == 0) || (pc->min[a] < ps->min[a]))
+                ps->min[a] = pc->min[a];
+            if ((ps->count == 0) || (pc->max[a] > ps->max[a]))
+                ps->max[a] = pc->max[a];
+            ps->sum[a] += pc->sum[a];
+        }
+        ps->count += pc->count;
+    }
+}
+
+
+
+/* days of a year
+ */
+static int  yearDays (int year)
+{
+    return (((year % 4 == 0) && (year % 100 != 0)) || (year % 400 == 0)) ? 366 : 365;
+}
+
+
+
+/* start of a UTC year, epoch seconds
+ */
+static time_t  yearStart (int year)
+{
+    struct tm  tm;
+
+    memset (&tm, 0, sizeof (tm));
+    tm.tm_year = year - 1900;
+    tm.tm_mday = 1;
+    return timegm (&tm);
+}
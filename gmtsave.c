@@ -0,0 +1,594 @@
+/***************************************************************************
+ *                           gmtsave.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the averaging of the raw values,
+ *      and the record files of a sensor, text and binary day files
+ *      and the rollup; the daemon and the benchmarks share it
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "gmt.h"
+
+/* --- prototypes ----
+ */
+extern int     esdCreate    (esdFile *pf, const char *name, struct tm *ptime, int period,
+                             int axes, int mode, double fullScale, int dtype, double scale);
+extern void    esdClose     (esdFile *pf);
+extern int     esdPut       (esdFile *pf, unsigned int idx, const void *pv);
+extern int     esdSync      (esdFile *pf);
+extern time_t  monoSeconds  (void);
+extern int     writerInit   (gmtWriter *pw, const char *path, const char *tag, int batch,
+                             int syncMode, int syncValue);
+extern int     writerDay    (gmtWriter *pw, struct tm *ptime);
+extern int     writerPut    (gmtWriter *pw, const char *text, int isRecord);
+extern int     writerFlush  (gmtWriter *pw);
+extern void    writerClose  (gmtWriter *pw);
+extern void    writerSetPath (gmtWriter *pw, const char *path);
+extern void    gmtMkDir     (const char *path);
+extern int     rollUpdate   (gmtRollup *pr, const char *path, const char *tag, int axes, time_t t);
+extern int     rollAdd      (gmtRollup *pr, time_t t, const double *pv, int axes);
+extern void    rollClose    (gmtRollup *pr);
+
+int            intMagnitude (const int *pv);
+static int     saveBinary   (gmtSaver *ps, const storeRecord *pr, struct tm *ptime);
+static int     saveSync     (gmtSaver *ps, int force);
+
+#ifdef __SIMULATION__
+  #define localtime   sim_localtime
+  static struct tm   *sim_localtime (const time_t *timep);
+#endif
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* add one raw sensor value to an interval accumulator;
+ * the first value after a reset (n = 0) restarts the sums
+ */
+void  accAdd (rawAccum *pa, const magnBuffer *pm)
+{
+    short  v[GMT_AXES];
+    int    i;
+
+    v[DI_X] = pm->mgnX;
+    v[DI_Y] = pm->mgnY;
+    v[DI_Z] = pm->mgnZ;
+
+    if (pa->n == 0)
+    {
+        for (i=0; i<GMT_AXES; i++)
+        {
+            pa->sum[i] = v[i];
+            pa->min[i] = pa->max[i] = v[i];
+        }
+        pa->n = 1;
+        return;
+    }
+
+    for (i=0; i<GMT_AXES; i++)
+    {
+        pa->sum[i] += v[i];
+        if (v[i] < pa->min[i])
+            pa->min[i] = v[i];
+        if (v[i] > pa->max[i])
+            pa->max[i] = v[i];
+    }
+    pa->n++;
+}
+
+
+
+/* add <n> raw sensor values to an interval accumulator, like accAdd ();
+ * plain counted loops over local sums and extremes, which the
+ * compiler can vectorize
+ */
+void  accAddN (rawAccum *pa, const magnBuffer *pm, int n)
+{
+    long long  sx, sy, sz;
+    short      nx, ny, nz, xx, xy, xz;
+    int        i;
+
+    if (n <= 0)
+        return;
+    if (pa->n == 0)
+    {
+        pa->sum[DI_X] = pa->sum[DI_Y] = pa->sum[DI_Z] = 0;
+        pa->min[DI_X] = pa->max[DI_X] = pm[0].mgnX;
+        pa->min[DI_Y] = pa->max[DI_Y] = pm[0].mgnY;
+        pa->min[DI_Z] = pa->max[DI_Z] = pm[0].mgnZ;
+    }
+
+    sx = sy = sz = 0;
+    nx = pa->min[DI_X];
+    ny = pa->min[DI_Y];
+    nz = pa->min[DI_Z];
+    xx = pa->max[DI_X];
+    xy = pa->max[DI_Y];
+    xz = pa->max[DI_Z];
+    for (i=0; i<n; i++)
+    {
+        sx += pm[i].mgnX;
+        sy += pm[i].mgnY;
+        sz += pm[i].mgnZ;
+        nx  = (pm[i].mgnX < nx) ? pm[i].mgnX : nx;
+        ny  = (pm[i].mgnY < ny) ? pm[i].mgnY : ny;
+        nz  = (pm[i].mgnZ < nz) ? pm[i].mgnZ : nz;
+        xx  = (pm[i].mgnX > xx) ? pm[i].mgnX : xx;
+        xy  = (pm[i].mgnY > xy) ? pm[i].mgnY : xy;
+        xz  = (pm[i].mgnZ > xz) ? pm[i].mgnZ : xz;
+    }
+
+    pa->sum[DI_X] += sx;
+    pa->sum[DI_Y] += sy;
+    pa->sum[DI_Z] += sz;
+    pa->min[DI_X] = nx;
+    pa->min[DI_Y] = ny;
+    pa->min[DI_Z] = nz;
+    pa->max[DI_X] = xx;
+    pa->max[DI_Y] = xy;
+    pa->max[DI_Z] = xz;
+    pa->n += n;
+}
+
+
+
+/* scaled mean and extremes of an interval accumulator (n > 0)
+ */
+void  accResult (rawAccum *pa, double scale, double *pmean, double *pmin, double *pmax)
+{
+    int  i;
+
+    for (i=0; i<GMT_AXES; i++)
+    {
+        pmean[i] = ((double) pa->sum[i] / pa->n) * scale;
+        pmin[i]  = pa->min[i] * scale;
+        pmax[i]  = pa->max[i] * scale;
+    }
+}
+
+
+
+/* mean and extremes of an interval accumulator (n > 0), in integer
+ * units with GMT_INT_FRAC_BITS fraction bits; the mean is rounded
+ * to the nearest unit, everything else is exact
+ */
+void  accResultInt (rawAccum *pa, int *pmean, int *pmin, int *pmax)
+{
+    long long  s;
+    int        i;
+
+    for (i=0; i<GMT_AXES; i++)
+    {
+        s        = pa->sum[i] * (1 << GMT_INT_FRAC_BITS);
+        s       += (s < 0) ? -(pa->n / 2) : (pa->n / 2);
+        pmean[i] = (int) (s / pa->n);
+        pmin[i]  = pa->min[i] * (1 << GMT_INT_FRAC_BITS);
+        pmax[i]  = pa->max[i] * (1 << GMT_INT_FRAC_BITS);
+    }
+}
+
+
+
+/* the single mode sample; scale <n> raw values with the driver <pd>
+ * all at once, and average them; without values, the mean is 0, and
+ * the extremes are left as they are
+ */
+void  accMean (const gmtDriver *pd, const magnBuffer *pm, int n, double scale, double *pmean,
+               double *pmin, double *pmax)
+{
+    double  v[GMT_AVG_COUNT][GMT_AXES];
+    int     i, k;
+
+    if (n > GMT_AVG_COUNT)
+        n = GMT_AVG_COUNT;
+    pd->scale (pm, n, scale, &v[0][0]);
+    pmean[DI_X] = pmean[DI_Y] = pmean[DI_Z] = 0.0;
+    for (i=0; i<n; i++)
+    {
+        for (k=0; k<GMT_AXES; k++)
+        {
+            if ((i == 0) || (v[i][k] < pmin[k]))  pmin[k] = v[i][k];
+            if ((i == 0) || (v[i][k] > pmax[k]))  pmax[k] = v[i][k];
+            pmean[k] += v[i][k];
+        }
+    }
+
+    if (n > 0)
+    {
+        for (k=0; k<GMT_AXES; k++)
+            pmean[k] /= n;
+    }
+}
+
+
+
+/* vector sum of integer units, rounded to a unit
+ */
+int  intMagnitude (const int *pv)
+{
+    double  d;
+
+    d = (double) pv[DI_X] * pv[DI_X] + (double) pv[DI_Y] * pv[DI_Y] + (double) pv[DI_Z] * pv[DI_Z];
+    return ((int) lround (sqrt (d)));
+}
+
+
+
+/* initialize the files of a sensor; to the directory <path>, named
+ * with <tag> if not empty, records of <period> seconds, of the type
+ * <dtype> (<unit> Ga per integer unit), with <fullScale> Ga in the
+ * headers; <batch>, <syncMode> and <syncValue> are the text writer
+ * policy; no file is opened yet
+ * returns 0 on success, or 1 if no buffer memory is available
+ */
+int  saveInit (gmtSaver *ps, const char *path, const char *tag, int period, double fullScale,
+               int dtype, double unit, int batch, int syncMode, int syncValue)
+{
+    memset (ps, 0, sizeof (gmtSaver));
+    ps->esd.fd    = -1;
+    ps->elastSync = monoSeconds ();
+    ps->hdrFmt    = -1;
+    ps->period    = period;
+    ps->fullScale = fullScale;
+    ps->dtype     = dtype;
+    ps->unit      = unit;
+    strncpy (ps->path, path, FILENAME_MAXSIZE);
+    ps->path[FILENAME_MAXSIZE-1] = '\0';
+    if (tag)
+    {
+        strncpy (ps->tag, tag, GMT_NAME_SIZE);
+        ps->tag[GMT_NAME_SIZE-1] = '\0';
+    }
+    return (writerInit (&ps->writer, ps->path, ps->tag, batch, syncMode, syncValue));
+}
+
+
+
+/* change the data directory; the files are reopened there with
+ * the next record
+ */
+void  saveSetPath (gmtSaver *ps, const char *path)
+{
+    strncpy (ps->path, path, FILENAME_MAXSIZE);
+    ps->path[FILENAME_MAXSIZE-1] = '\0';
+    writerSetPath (&ps->writer, ps->path);
+}
+
+
+
+/* finish and close all files of a sensor
+ */
+void  saveClose (gmtSaver *ps)
+{
+    writerClose (&ps->writer);
+    if (ps->esd.fd >= 0)
+    {
+        saveSync (ps, 1);
+        esdClose (&ps->esd);
+    }
+    rollClose (&ps->roll);
+}
+
+
+
+/* save one record to file; called by the storage thread only,
+ * which owns the writers, the binary and the rollup files
+ * return 0 if writing was ok
+ * an error number otherwise
+ */
+int  saveRecord (gmtSaver *ps, const storeRecord *pr)
+{
+    char         fbuf[256];
+    double       v[GMT_AXES];
+    time_t       t;
+    struct tm   *ptime;
+    int          rv, n, axes, fmt;
+
+    /* use the sample time */
+    t     = pr->tstamp;
+    ptime = localtime (&t);
+
+    /* the values as the day files have them, for the rollup */
+    axes = (pr->mode == GMT_AXIS_ALL) ? GMT_AXES : 1;
+    if (ps->dtype == ELFD_DTYPE_INT)
+    {
+        for (n=0; n<GMT_AXES; n++)
+            v[n] = pr->ival[n] * ps->unit;
+        if (axes == 1)
+            v[0] = intMagnitude (pr->ival) * ps->unit;
+    }
+    else
+    {
+        for (n=0; n<GMT_AXES; n++)
+            v[n] = pr->v[n];
+        if (axes == 1)
+            v[0] = sqrt (pr->v[DI_X] * pr->v[DI_X] + pr->v[DI_Y] * pr->v[DI_Y] + pr->v[DI_Z] * pr->v[DI_Z]);
+    }
+
+    /* the day files of the data directory are indexed again once
+     * a day, and at the start, when the previous day is complete;
+     * the rollup days not complete yet are rebuilt from them */
+    if ((ps->iday != ptime->tm_mday) || strcmp (ps->roll.path, ps->path) || (ps->roll.axes != axes))
+    {
+        ps->iday = ptime->tm_mday;
+        writerFlush (&ps->writer);
+        gmtMkDir (ps->path);
+        if (rollUpdate (&ps->roll, ps->path, ps->tag, axes, t) != 0)
+            perror ("accessing rollup files");
+        ptime = localtime (&t);
+    }
+    rollAdd (&ps->roll, t, v, axes);
+
+    /* binary day file, optionally instead of the text file */
+    if (pr->storage & GMT_STORE_BINARY)
+        saveBinary (ps, pr, ptime);
+    if (!(pr->storage & GMT_STORE_TEXT))
+        return 0;
+
+    /* the writer keeps the file of the current day open,
+     * and only opens a new one when the day changes */
+    if ((rv = writerDay (&ps->writer, ptime)) < 0)
+        return 1;
+
+    /* write header to (each) output file once, and again
+     * when the output format was changed by a reload */
+    fmt = pr->mode | (pr->storage << 4) | (pr->envelope << 8);
+    if (ps->hdrFmt < 0)
+        ps->hdrFmt = fmt;
+    if ((rv > 0) || (ps->hdrFmt != fmt))
+    {
+        ps->hdrFmt = fmt;
+        if (ps->period == 60)
+            sprintf (fbuf, "# -- geomagnetism data, per minute --\n");
+        else
+            sprintf (fbuf, "# -- geomagnetism data, per %d seconds --\n", ps->period);
+        writerPut (&ps->writer, fbuf, 0);
+        sprintf (fbuf, "# start time : %02d.%02d.%4d, %02d:%02d\n", ptime->tm_mon+1, ptime->tm_mday,
+             ptime->tm_year + 1900, ptime->tm_hour, ptime->tm_min);
+        writerPut (&ps->writer, fbuf, 0);
+        if ((pr->mode == GMT_AXIS_ALL) && pr->envelope)
+            sprintf (fbuf, "# format :\n# %s, X_data, Y_data, Z_data, count, X_min, X_max, X_sdev, "
+                     "Y_min, Y_max, Y_sdev, Z_min, Z_max, Z_sdev\n", (ps->period < 60) ? "HH:MM:SS" : "HH:MM");
+        else if (pr->mode == GMT_AXIS_ALL)
+            sprintf (fbuf, "# format :\n# %s, X_data, Y_data, Z_data\n", (ps->period < 60) ? "HH:MM:SS" : "HH:MM");
+        else
+            sprintf (fbuf, "# format :\n# %s, XYZ_Vector_data\n", (ps->period < 60) ? "HH:MM:SS" : "HH:MM");
+        writerPut (&ps->writer, fbuf, 0);
+        sprintf (fbuf, "# fullscale value = %.5lf Ga\n", ps->fullScale);
+        writerPut (&ps->writer, fbuf, 0);
+        if (ps->dtype == ELFD_DTYPE_INT)
+        {
+            sprintf (fbuf, "# scale value = %.9e Ga per unit\n", ps->unit);
+            writerPut (&ps->writer, fbuf, 0);
+        }
+    }
+
+    /* write data; the seconds only for records shorter than a minute */
+    n = sprintf (fbuf, "%02d:%02d", ptime->tm_hour, ptime->tm_min);
+    if (ps->period < 60)
+        n += sprintf (fbuf + n, ":%02d", ptime->tm_sec);
+    if (ps->dtype == ELFD_DTYPE_INT)
+    {
+        if (pr->mode == GMT_AXIS_ALL)
+            n += sprintf (fbuf + n, ", %d, %d, %d", pr->ival[DI_X], pr->ival[DI_Y], pr->ival[DI_Z]);
+        else
+            n += sprintf (fbuf + n, ", %d", intMagnitude (pr->ival));
+    }
+    else if (pr->mode == GMT_AXIS_ALL)
+        n += sprintf (fbuf + n, ", %.6lf, %.06lf, %06lf", pr->v[DI_X], pr->v[DI_Y], pr->v[DI_Z]);
+    else
+        n += sprintf (fbuf + n, ", %.6lf", v[0]);
+
+    /* the envelope of the decimation stage, per axis */
+    if ((pr->mode == GMT_AXIS_ALL) && pr->envelope)
+    {
+        int  i;
+
+        n += sprintf (fbuf + n, ", %lu", pr->nsmpl);
+        for (i=0; i<GMT_AXES; i++)
+        {
+            if (ps->dtype == ELFD_DTYPE_INT)
+                n += sprintf (fbuf + n, ", %d, %d, %ld", pr->imin[i], pr->imax[i],
+                              lround (pr->sd[i] / ps->unit));
+            else
+                n += sprintf (fbuf + n, ", %.6lf, %.6lf, %.6lf", pr->vmin[i], pr->vmax[i],
+                              pr->sd[i]);
+        }
+    }
+    strcpy (fbuf + n, "\n");
+    return (writerPut (&ps->writer, fbuf, 1));
+}
+
+
+
+/* save current data to the binary day file;
+ * the file of the current day is kept open and mapped, and only
+ * replaced when the day changes; the sample goes into the slot of
+ * its sample period of the day
+ * return 0 if writing was ok
+ * an error number otherwise
+ */
+static int  saveBinary (gmtSaver *ps, const storeRecord *pr, struct tm *ptime)
+{
+    esdFile        *pe = &ps->esd;
+    char            fbuf[FILENAME_MAXSIZE + GMT_NAME_SIZE + 64];
+    float           v[GMT_AXES];
+    int             iv[GMT_AXES];
+    unsigned int    idx;
+    int             axes, rv;
+    const void     *pv;
+
+    axes = (pr->mode == GMT_AXIS_ALL) ? GMT_AXES : 1;
+
+    /* a reload may have changed the data path, or the mode */
+    if ((pe->fd < 0) || (ps->eday != ptime->tm_mday) || strcmp (ps->epath, ps->path) ||
+        (pe->hdr->axes != axes) || (pe->hdr->dtype != ps->dtype))
+    {
+        if (pe->fd >= 0)
+        {
+            saveSync (ps, 1);
+            esdClose (pe);
+        }
+
+        strcpy (ps->epath, ps->path);
+        gmtMkDir (ps->epath);
+        sprintf (fbuf, "%s/%4d_%02d_%02d%s%s%s", ps->epath, ptime->tm_year + 1900,
+                 ptime->tm_mon+1, ptime->tm_mday, ps->tag[0] ? "_" : "", ps->tag, ESD_FILE_EXT);
+        rv = esdCreate (pe, fbuf, ptime, ps->period, axes, pr->mode, ps->fullScale,
+                        ps->dtype, ps->unit);
+
+        /* the day file has another layout (a reload of the mode, or a
+         * restart with another period or data type); it is moved aside
+         * to the first free <name>.<n>, and the day goes on in a new
+         * file under the usual name, the one all readers look for */
+        if (rv == 2)
+        {
+            char  abuf[sizeof (fbuf) + 16];
+            int   n = 1;
+
+            do
+                sprintf (abuf, "%s.%d", fbuf, n++);
+            while ((access (abuf, F_OK) == 0) && (n < 1000));
+            if (rename (fbuf, abuf) == 0)
+            {
+                printf ("binary day file of another layout moved to <%s>\n", abuf);
+                rv = esdCreate (pe, fbuf, ptime, ps->period, axes, pr->mode, ps->fullScale,
+                                ps->dtype, ps->unit);
+            }
+        }
+        /* reported once, not for every record */
+        if (rv != 0)
+        {
+            if (!ps->eerr)
+                perror ("accessing binary data file");
+            ps->eerr = 1;
+            return 1;
+        }
+        ps->eerr = 0;
+        ps->eday = ptime->tm_mday;
+    }
+
+    idx = (unsigned int) ((ptime->tm_hour * 3600 + ptime->tm_min * 60 + ptime->tm_sec) / ps->period);
+
+    /* integer units as they are */
+    if (ps->dtype == ELFD_DTYPE_INT)
+    {
+        if (axes == GMT_AXES)
+            memcpy (iv, pr->ival, sizeof (iv));
+        else
+            iv[0] = intMagnitude (pr->ival);
+        pv = iv;
+    }
+    else
+    {
+        if (axes == GMT_AXES)
+        {
+            v[DI_X] = (float) pr->v[DI_X];
+            v[DI_Y] = (float) pr->v[DI_Y];
+            v[DI_Z] = (float) pr->v[DI_Z];
+        }
+        else
+            v[0] = (float) sqrt (pr->v[DI_X] * pr->v[DI_X] + pr->v[DI_Y] * pr->v[DI_Y] + pr->v[DI_Z] * pr->v[DI_Z]);
+        pv = v;
+    }
+
+    if ((rv = esdPut (pe, idx, pv)) != 0)
+        return rv;
+    ps->eunsynced++;
+    return (saveSync (ps, 0));
+}
+
+
+
+/* force the binary day file to the storage medium by the sync policy
+ * of the text writer, or when <force> is set and a policy is given;
+ * returns 0 if ok, or 1 if syncing failed
+ */
+static int  saveSync (gmtSaver *ps, int force)
+{
+    gmtWriter  *pw = &ps->writer;
+
+    if (pw->syncMode == GMT_SYNC_NONE)
+        return 0;
+    if (force || ((pw->syncMode == GMT_SYNC_RECORDS) && (ps->eunsynced >= pw->syncValue)) ||
+        ((pw->syncMode == GMT_SYNC_SECONDS) && (monoSeconds () - ps->elastSync >= pw->syncValue)))
+    {
+        ps->eunsynced = 0;
+        ps->elastSync = monoSeconds ();
+        return (esdSync (&ps->esd));
+    }
+    return 0;
+}
+
+
+
+#ifdef __SIMULATION__
+/* a debug function to "speed up" simulated runs
+ * does <not> try to emulate fully compatible behavior !
+ */
+static struct tm  *sim_localtime (const time_t *timep)
+{
+    static struct tm  lstime;
+    static int        ccount = 0;
+
+    /*  on first call, get the actual time, and keep a copy */
+    if (ccount == 0)
+    {
+        lstime.tm_sec  = 0;
+        lstime.tm_min  = 1;
+        lstime.tm_hour = 13;
+        lstime.tm_mday = 4;
+        lstime.tm_mon  = 4;
+        lstime.tm_year = 125;
+        ccount++;
+        return (&lstime);
+    }
+
+    /* on subsequent calls, just modify the local copy
+     * and advance the minute */
+    else
+    {
+        lstime.tm_sec = 0;
+        lstime.tm_min++;
+        if (lstime.tm_min >= 60)
+        {
+            lstime.tm_min = 0;
+            lstime.tm_hour++;
+        }
+        if (lstime.tm_hour >= 23)
+        {
+            lstime.tm_hour = 0;
+            lstime.tm_mday++;
+        }
+        if (lstime.tm_mday >= 31)
+        {
+            lstime.tm_mday = 1;
+            lstime.tm_mon++;
+        }
+        if (lstime.tm_mon >= 12)
+            lstime.tm_year++;
+    }
+    return (&lstime);
+}
+#endif
@@ -0,0 +1,296 @@
+/***************************************************************************
+ *                           gmtsched.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the sample scheduler, waking at
+ *      absolute period boundaries, with wake-up latency and jitter
+ *      statistics
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+
+#include "gmt.h"
+
+#define NS_PER_SEC     1000000000LL
+
+/*  Slot <n> is due at (base + n * period). The wake-up time is never
+ *  derived from the previous wake-up, so neither the sleep latency nor
+ *  the sampling work adds up over time; a late slot only delays itself.
+ */
+
+/* --- prototypes ----
+ */
+extern void       metObserve (metHist *ph, long long ns);
+
+void              schedClose (gmtSched *ps);
+
+static void       schedTake  (gmtSched *ps, const struct timespec *pnow, struct timespec *pslot);
+static int        schedArm   (gmtSched *ps);
+static long long  tsToNs     (const struct timespec *ps);
+static void       nsToTs     (long long ns, struct timespec *ps);
+static int        histBin    (long long ns);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* set up the scheduler for slots of <period> ns on clock <clock>;
+ * slot 0 is at <pbase>, or at the clock epoch if NULL, so realtime
+ * periods that divide a day fall on the wall clock boundaries;
+ * the first slot is the first one after the current time
+ */
+void  schedInit (gmtSched *ps, clockid_t clock, long long period, const struct timespec *pbase)
+{
+    struct timespec  now;
+
+    memset (ps, 0, sizeof (gmtSched));
+    ps->tfd      = -1;
+    ps->clock    = clock;
+    ps->period   = (period > 0) ? period : NS_PER_SEC;
+    ps->lastSlot = -1;
+    if (pbase)
+        ps->base = *pbase;
+
+    clock_gettime (clock, &now);
+    ps->slot = (tsToNs (&now) - tsToNs (&ps->base)) / ps->period + 1;
+}
+
+
+
+/* wait for the next slot; the time it was due is returned in <pslot>;
+ * a slot already past is returned at once, if it is at most
+ * MAX_MISSED_DATA_COUNT periods late; if later, the slots in between
+ * are skipped, and the latest one due is returned;
+ * returns 0 when the slot is due, or -1 if a signal cut the wait
+ * short (call again to go on waiting for the same slot)
+ */
+int  schedWait (gmtSched *ps, struct timespec *pslot)
+{
+    struct timespec  due, now;
+
+    nsToTs (tsToNs (&ps->base) + ps->slot * ps->period, &due);
+    if (clock_nanosleep (ps->clock, TIMER_ABSTIME, &due, NULL) != 0)
+        return -1;
+    clock_gettime (ps->clock, &now);
+    schedTake (ps, &now, pslot);
+    return 0;
+}
+
+
+
+/* a timerfd for the scheduler, armed for the next slot; instead of
+ * schedWait (), the owner waits for it to become readable, and takes
+ * the slot with schedExpired (); a realtime timer notices when the
+ * clock is set
+ * returns the descriptor (closed by schedClose ()), or -1 on error
+ */
+int  schedTimer (gmtSched *ps)
+{
+    if ((ps->tfd < 0) &&
+        ((ps->tfd = timerfd_create (ps->clock, TFD_NONBLOCK | TFD_CLOEXEC)) < 0))
+        return -1;
+    if (schedArm (ps) != 0)
+    {
+        schedClose (ps);
+        return -1;
+    }
+    return ps->tfd;
+}
+
+
+
+/* the timer of the scheduler is readable; the slot due is taken as
+ * with schedWait (), and the timer armed for the next one; after the
+ * realtime clock was set, the slots start over from the current time
+ * returns 0 when the slot is due, or -1 if there is none
+ */
+int  schedExpired (gmtSched *ps, struct timespec *pslot)
+{
+    struct timespec  now;
+    uint64_t         n;
+    ssize_t          rv;
+
+    rv = read (ps->tfd, &n, sizeof (n));
+    clock_gettime (ps->clock, &now);
+    if (rv != sizeof (n))
+    {
+        if ((rv < 0) && (errno == ECANCELED))
+        {
+            ps->slot     = (tsToNs (&now) - tsToNs (&ps->base)) / ps->period + 1;
+            ps->lastSlot = -1;
+            schedArm (ps);
+        }
+        return -1;
+    }
+
+    schedTake (ps, &now, pslot);
+    schedArm (ps);
+    return 0;
+}
+
+
+
+/* close the timer of the scheduler, if there is one
+ */
+void  schedClose (gmtSched *ps)
+{
+    if (ps->tfd >= 0)
+        close (ps->tfd);
+    ps->tfd = -1;
+}
+
+
+
+/* print the statistics of a scheduler, labeled <name>;
+ * the histograms list the non-empty bins, by upper bound in us
+ */
+void  schedReport (gmtSched *ps, const char *name)
+{
+    const char     *title[2] = { "latency", "jitter" };
+    unsigned long  *bins[2];
+    int             i, k;
+
+    if (ps->wakes == 0)
+        return;
+    bins[0] = ps->lat;
+    bins[1] = ps->jit;
+
+    printf ("\n%s: %lu wakes, %lu late, %lu skipped, latency mean %.1lfus max %.1lfus",
+            name, ps->wakes, ps->late, ps->skipped, ps->latSum / ps->wakes / 1000.0,
+            ps->latMax / 1000.0);
+    for (k=0; k<2; k++)
+    {
+        printf ("\n  %-7s", title[k]);
+        for (i=0; i<GMT_SCHED_BINS; i++)
+        {
+            if (bins[k][i] == 0)
+                continue;
+            if (i < GMT_SCHED_BINS - 1)
+                printf (" <%luus:%lu", 1UL << i, bins[k][i]);
+            else
+                printf (" more:%lu", bins[k][i]);
+        }
+    }
+    printf ("\n");
+}
+
+
+
+/* take the current slot, woken at <now>; its due time goes to <pslot>,
+ * if not NULL; missed slots are caught up with, or skipped, and the
+ * latency and jitter counted
+ */
+static void  schedTake (gmtSched *ps, const struct timespec *pnow, struct timespec *pslot)
+{
+    struct timespec  due;
+    long long        tdue, lat, behind, jit;
+
+    tdue = tsToNs (&ps->base) + ps->slot * ps->period;
+    nsToTs (tdue, &due);
+
+    /* missed deadlines; catch up, or resynchronize */
+    lat    = tsToNs (pnow) - tdue;
+    behind = lat / ps->period;
+    if (behind > MAX_MISSED_DATA_COUNT)
+    {
+        ps->skipped += (unsigned long) behind;
+        ps->slot    += behind;
+        tdue        += behind * ps->period;
+        lat         -= behind * ps->period;
+        nsToTs (tdue, &due);
+    }
+    else if (behind > 0)
+        ps->late++;
+
+    /* statistics; jitter only between consecutive slots */
+    ps->wakes++;
+    ps->latSum += (double) lat;
+    if (lat > ps->latMax)
+        ps->latMax = lat;
+    ps->lat[histBin (lat)]++;
+    if (ps->lastSlot == ps->slot - 1)
+    {
+        jit = tsToNs (pnow) - tsToNs (&ps->lastWake) - ps->period;
+        ps->jit[histBin ((jit < 0) ? -jit : jit)]++;
+        if (ps->jitter)
+            metObserve (ps->jitter, (jit < 0) ? -jit : jit);
+    }
+    ps->lastWake = *pnow;
+    ps->lastSlot = ps->slot;
+
+    ps->slot++;
+    if (pslot)
+        *pslot = due;
+}
+
+
+
+/* arm the timer for the absolute time of the next slot, once
+ * returns 0, or -1 on error
+ */
+static int  schedArm (gmtSched *ps)
+{
+    struct itimerspec  its;
+    int                flags = TFD_TIMER_ABSTIME;
+
+    memset (&its, 0, sizeof (its));
+    nsToTs (tsToNs (&ps->base) + ps->slot * ps->period, &its.it_value);
+    if (ps->clock == CLOCK_REALTIME)
+        flags |= TFD_TIMER_CANCEL_ON_SET;
+    return timerfd_settime (ps->tfd, flags, &its, NULL);
+}
+
+
+
+/* nanoseconds of a timespec
+ */
+static long long  tsToNs (const struct timespec *ps)
+{
+    return ((long long) ps->tv_sec * NS_PER_SEC + ps->tv_nsec);
+}
+
+
+
+/* timespec of nanoseconds (not negative)
+ */
+static void  nsToTs (long long ns, struct timespec *ps)
+{
+    ps->tv_sec  = (time_t) (ns / NS_PER_SEC);
+    ps->tv_nsec = (long) (ns % NS_PER_SEC);
+}
+
+
+
+/* histogram bin of a duration; bin <i> counts values below 2^i us,
+ * the last bin all larger ones
+ */
+static int  histBin (long long ns)
+{
+    long long  us = ns / 1000;
+    int        i;
+
+    for (i=0; (i < GMT_SCHED_BINS - 1) && (us >= (1LL << i)); i++)
+        ;
+    return i;
+}
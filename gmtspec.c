@@ -0,0 +1,412 @@
+/***************************************************************************
+ *                           gmtspec.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the streaming spectral analysis, a
+ *      Welch PSD of the raw samples, and its spectra files
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "gmt.h"
+
+_Static_assert (sizeof (gspHeader) == GSP_HEADER_SIZE, "gspHeader size");
+
+/*  As in the decimation stage, the three axes are the lanes of one
+ *  vector, so each butterfly does all axes at once.
+ *  - real FFT: the N real samples are taken as N/2 complex ones (even
+ *    samples the real, odd ones the imaginary parts), transformed by
+ *    an iterative radix-2 FFT, and the N/2+1 bins of the real input
+ *    are split off from that; half the work of a complex FFT of N
+ *  - plan: window, bit reversal and twiddle factors are computed once,
+ *    by specCreate (), and used for all blocks
+ *  - Welch: a block every N/2 samples; the one-sided power is summed
+ *    per bin, and scaled to nT^2 / Hz when the record is made
+ */
+typedef double  v4df  __attribute__ ((vector_size (32)));
+
+struct gmtSpec
+{
+    int            size;         /* FFT length N                  */
+    int            half;         /* N / 2, the complex FFT        */
+    int            bins;         /* written, from 0 Hz            */
+    int            interval;     /* s per record                  */
+    double         norm;         /* power to nT^2 / Hz            */
+    double        *window;       /* Hann, N                       */
+    double        *twr;          /* e^(-2 pi i j / (N/2)), N/4    */
+    double        *twi;
+    double        *spr;          /* e^(-2 pi i k / N), N/2 + 1    */
+    double        *spi;
+    unsigned int  *rev;          /* bit reversal, N/2             */
+    v4df          *in;           /* samples of the block, N       */
+    v4df          *re;           /* FFT work, N/2 each            */
+    v4df          *im;
+    v4df          *acc;          /* summed power, per bin         */
+    int            fill;         /* samples in <in>               */
+    unsigned int   blocks;       /* spectra in <acc>              */
+    time_t         slot;         /* time / interval of <acc>      */
+    gspHeader      hdr;
+    int            fd;           /* spectra file; storage thread  */
+    int            mday;         /* its day                       */
+    char           path[FILENAME_MAXSIZE];
+    char           tag[GMT_NAME_SIZE];
+};
+
+/* --- prototypes ----
+ */
+extern void        gmtMkDir    (const char *path);
+
+void               specDestroy (gmtSpec *ps);
+static void        specBlock   (gmtSpec *ps);
+static gspRecord  *specResult  (gmtSpec *ps);
+size_t             specSize    (const gmtSpec *ps);
+static void       *specAlloc   (size_t n, size_t size);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* create a spectral stage; FFT length <size> (a power of 2) at the
+ * sample <rate> in Hz, raw values times <scale> are Ga; a record every
+ * <interval> s, with the bins up to <fmax> Hz (0: all); the files go
+ * to the directory <path>, named with <tag> if not empty
+ * returns NULL if the parameters are not valid, or on memory shortage
+ */
+gmtSpec  *specCreate (int size, double rate, double scale, int interval, double fmax,
+                      const char *path, const char *tag)
+{
+    gmtSpec  *ps;
+    double    u, nt;
+    int       i, m, bits;
+
+    if ((size < GSP_MIN_SIZE) || (size > GSP_MAX_SIZE) || (size & (size - 1)) || (rate <= 0.0))
+        return NULL;
+    if (!(ps = calloc (1, sizeof (gmtSpec))))
+        return NULL;
+    ps->size     = size;
+    ps->half     = m = size / 2;
+    ps->interval = (interval > 0) ? interval : GSP_INTERVAL;
+    ps->bins     = m + 1;
+    if ((fmax > 0.0) && ((int) (fmax * size / rate) + 1 < ps->bins))
+        ps->bins = (int) (fmax * size / rate) + 1;
+    ps->slot     = -1;
+    ps->fd       = -1;
+    strncpy (ps->path, path, FILENAME_MAXSIZE - 1);
+    if (tag)
+        strncpy (ps->tag, tag, GMT_NAME_SIZE - 1);
+
+    if (!(ps->window = specAlloc (size, sizeof (double))) ||
+        !(ps->twr    = specAlloc (m / 2, sizeof (double))) ||
+        !(ps->twi    = specAlloc (m / 2, sizeof (double))) ||
+        !(ps->spr    = specAlloc (m + 1, sizeof (double))) ||
+        !(ps->spi    = specAlloc (m + 1, sizeof (double))) ||
+        !(ps->rev    = specAlloc (m, sizeof (unsigned int))) ||
+        !(ps->in     = specAlloc (size, sizeof (v4df))) ||
+        !(ps->re     = specAlloc (m, sizeof (v4df))) ||
+        !(ps->im     = specAlloc (m, sizeof (v4df))) ||
+        !(ps->acc    = specAlloc (ps->bins, sizeof (v4df))))
+    {
+        specDestroy (ps);
+        return NULL;
+    }
+
+    /* periodic Hann window, and its power */
+    for (u=0.0, i=0; i<size; i++)
+    {
+        ps->window[i] = 0.5 * (1.0 - cos (2.0 * M_PI * i / size));
+        u += ps->window[i] * ps->window[i];
+    }
+    for (i=0; i<m/2; i++)
+    {
+        ps->twr[i] = cos (2.0 * M_PI * i / m);
+        ps->twi[i] = -sin (2.0 * M_PI * i / m);
+    }
+    for (i=0; i<=m; i++)
+    {
+        ps->spr[i] = cos (2.0 * M_PI * i / size);
+        ps->spi[i] = -sin (2.0 * M_PI * i / size);
+    }
+    for (bits=0; (1 << bits) < m; bits++)
+        ;
+    for (i=0; i<m; i++)
+    {
+        unsigned int  r = 0, v = (unsigned int) i;
+        int           b;
+
+        for (b=0; b<bits; b++, v>>=1)
+            r = (r << 1) | (v & 1);
+        ps->rev[i] = r;
+    }
+
+    /* one-sided density; the factor 2 of the inner bins is applied
+     * by specResult () */
+    nt       = scale * GSP_NT_PER_GA;
+    ps->norm = nt * nt / (rate * u);
+
+    memcpy (ps->hdr.id, GSP_HEADER_ID, 4);
+    ps->hdr.version  = GSP_VERSION;
+    ps->hdr.axes     = GMT_AXES;
+    ps->hdr.hdrSize  = GSP_HEADER_SIZE;
+    ps->hdr.size     = (unsigned int) size;
+    ps->hdr.bins     = (unsigned int) ps->bins;
+    ps->hdr.interval = (unsigned int) ps->interval;
+    ps->hdr.overlap  = GSP_OVERLAP;
+    ps->hdr.rate     = rate;
+    ps->hdr.df       = rate / size;
+    strcpy (ps->hdr.window, "HANN");
+    return ps;
+}
+
+
+
+/* release a spectral stage, and close its file; <ps> may be NULL
+ */
+void  specDestroy (gmtSpec *ps)
+{
+    if (!ps)
+        return;
+    if (ps->fd >= 0)
+        close (ps->fd);
+    free (ps->window);
+    free (ps->twr);
+    free (ps->twi);
+    free (ps->spr);
+    free (ps->spi);
+    free (ps->rev);
+    free (ps->in);
+    free (ps->re);
+    free (ps->im);
+    free (ps->acc);
+    free (ps);
+}
+
+
+
+/* add one raw sample, taken at <pt>; a block is transformed when
+ * complete, the average of an interval handed out when the next one
+ * starts
+ * returns the record of the last interval (to be freed by the
+ * caller), or NULL
+ */
+gspRecord  *specPut (gmtSpec *ps, const struct timespec *pt, const magnBuffer *pm)
+{
+    gspRecord  *pr = NULL;
+    time_t      slot;
+
+    slot = pt->tv_sec / ps->interval;
+    if ((slot != ps->slot) && (ps->blocks > 0))
+        pr = specResult (ps);
+    ps->slot = slot;
+
+    ps->in[ps->fill++] = (v4df) { pm->mgnX, pm->mgnY, pm->mgnZ, 0.0 };
+    if (ps->fill == ps->size)
+    {
+        specBlock (ps);
+        /* the second half starts the next block */
+        memcpy (ps->in, ps->in + ps->half, ps->half * sizeof (v4df));
+        ps->fill = ps->half;
+    }
+    return pr;
+}
+
+
+
+/* the average of the current interval, even if not complete
+ * returns the record (to be freed by the caller), or NULL if there
+ * is none
+ */
+gspRecord  *specFlush (gmtSpec *ps)
+{
+    return ((ps->blocks > 0) ? specResult (ps) : NULL);
+}
+
+
+
+/* the size of the records
+ * returns the bytes of one gspRecord, with its psd[]
+ */
+size_t  specSize (const gmtSpec *ps)
+{
+    return (sizeof (gspRecord) + (size_t) GMT_AXES * ps->bins * sizeof (float));
+}
+
+
+
+/* append a record to the spectra file of its day; the file is kept
+ * open, and a header written each time it is opened; called by the
+ * storage thread only
+ * returns 0 if ok, or an error number
+ */
+int  specWrite (gmtSpec *ps, const gspRecord *pr)
+{
+    char       name[FILENAME_MAXSIZE + GMT_NAME_SIZE + 32];
+    time_t     t = (time_t) pr->time;
+    struct tm  tm;
+    size_t     len;
+
+    localtime_r (&t, &tm);
+    if ((ps->fd < 0) || (ps->mday != tm.tm_mday))
+    {
+        if (ps->fd >= 0)
+            close (ps->fd);
+        gmtMkDir (ps->path);
+        snprintf (name, sizeof (name), "%s/%4d_%02d_%02d%s%s%s", ps->path, tm.tm_year + 1900,
+                  tm.tm_mon + 1, tm.tm_mday, ps->tag[0] ? "_" : "", ps->tag, GSP_FILE_EXT);
+        if ((ps->fd = open (name, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) < 0)
+        {
+            perror (name);
+            return 1;
+        }
+        ps->mday = tm.tm_mday;
+        if (write (ps->fd, &ps->hdr, sizeof (gspHeader)) != sizeof (gspHeader))
+            goto fail;
+    }
+
+    /* a short write leaves a part; readers find the next id */
+    len = sizeof (gspRecord) + (size_t) ps->hdr.axes * ps->bins * sizeof (float);
+    if (write (ps->fd, pr, len) != (ssize_t) len)
+        goto fail;
+    return 0;
+
+fail:
+    perror ("writing spectra file");
+    close (ps->fd);
+    ps->fd = -1;
+    return 2;
+}
+
+
+
+/* transform the block in <in>, and add its power to the sums
+ */
+static void  specBlock (gmtSpec *ps)
+{
+    v4df    *re = ps->re, *im = ps->im;
+    v4df     mean, tr, ti, er, ei, or, oi, xr, xi;
+    double   c, s;
+    int      m = ps->half;
+    int      n, len, half, step, i, j, a, b, k;
+
+    /* the mean would leak into the lowest bins */
+    mean = (v4df) { 0.0, 0.0, 0.0, 0.0 };
+    for (n=0; n<ps->size; n++)
+        mean += ps->in[n];
+    mean *= 1.0 / ps->size;
+
+    /* pairs of samples as complex values, in bit-reversed order */
+    for (n=0; n<m; n++)
+    {
+        re[ps->rev[n]] = (ps->in[2 * n] - mean) * ps->window[2 * n];
+        im[ps->rev[n]] = (ps->in[2 * n + 1] - mean) * ps->window[2 * n + 1];
+    }
+
+    /* radix-2 butterflies, decimation in time */
+    for (len=2; len<=m; len<<=1)
+    {
+        half = len >> 1;
+        step = m / len;
+        for (i=0; i<m; i+=len)
+        {
+            for (j=0; j<half; j++)
+            {
+                c  = ps->twr[j * step];
+                s  = ps->twi[j * step];
+                a  = i + j;
+                b  = a + half;
+                tr = re[b] * c - im[b] * s;
+                ti = re[b] * s + im[b] * c;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+
+    /* bins of the real input; even and odd samples' parts of
+     * Z[k] and Z[N/2 - k], the odd ones shifted by e^(-2 pi i k / N) */
+    for (k=0; k<ps->bins; k++)
+    {
+        a  = (k < m) ? k : 0;
+        b  = (k > 0) ? m - k : 0;
+        er = (re[a] + re[b]) * 0.5;
+        ei = (im[a] - im[b]) * 0.5;
+        or = (im[a] + im[b]) * 0.5;
+        oi = (re[b] - re[a]) * 0.5;
+        xr = er + or * ps->spr[k] - oi * ps->spi[k];
+        xi = ei + oi * ps->spr[k] + or * ps->spi[k];
+        ps->acc[k] += xr * xr + xi * xi;
+    }
+    ps->blocks++;
+}
+
+
+
+/* the averaged density of the blocks summed so far, as a record;
+ * the sums start again
+ * returns the record, or NULL on memory shortage
+ */
+static gspRecord  *specResult (gmtSpec *ps)
+{
+    gspRecord  *pr;
+    double      f;
+    int         c, k;
+
+    pr = malloc (specSize (ps));
+    if (pr)
+    {
+        memcpy (pr->id, GSP_RECORD_ID, 4);
+        pr->blocks = ps->blocks;
+        pr->time   = (long long) ps->slot * ps->interval;
+        for (k=0; k<ps->bins; k++)
+        {
+            /* 0 Hz and Nyquist are not mirrored */
+            f = ps->norm / ps->blocks;
+            if ((k > 0) && (k < ps->half))
+                f *= 2.0;
+            for (c=0; c<GMT_AXES; c++)
+                pr->psd[c * ps->bins + k] = (float) (ps->acc[k][c] * f);
+        }
+    }
+    memset (ps->acc, 0, ps->bins * sizeof (v4df));
+    ps->blocks = 0;
+    return pr;
+}
+
+
+
+/* zeroed memory for <n> items of <size>, aligned for the vectors
+ * returns NULL on memory shortage
+ */
+static void  *specAlloc (size_t n, size_t size)
+{
+    void    *p;
+    size_t   len;
+
+    /* aligned_alloc () wants a multiple of the alignment */
+    len = (n * size + sizeof (v4df) - 1) & ~(sizeof (v4df) - 1);
+    if (!(p = aligned_alloc (sizeof (v4df), len ? len : sizeof (v4df))))
+        return NULL;
+    memset (p, 0, len);
+    return p;
+}
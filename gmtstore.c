@@ -0,0 +1,384 @@
+/***************************************************************************
+ *                           gmtstore.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the asynchronous storage stage, a
+ *      bounded FIFO of records drained in order by a storage thread
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "gmt.h"
+
+/* the records are kept in a circular buffer, <head> is the oldest;
+ * it only grows while the sink is behind, up to <limit> records
+ * (more for config records, which are never dropped); the data of
+ * spectrum and capture records count against <payload> instead
+ */
+struct gmtStore
+{
+    storeRecord     *buf;
+    unsigned long    size;       /* records in <buf>              */
+    unsigned long    head;       /* oldest record                 */
+    unsigned long    count;      /* records queued                */
+    unsigned long    limit;      /* samples queued, at most       */
+    size_t           bytes;      /* record data queued            */
+    size_t           payload;    /* record data queued, at most   */
+    int              policy;     /* GMT_OVF_*                     */
+    int              stop;       /* drain, and end the thread     */
+    int              busy;       /* the sink has a record         */
+    unsigned long    lost;       /* dropped, current series       */
+    pthread_mutex_t  lock;
+    pthread_cond_t   more;       /* record queued, or stop        */
+    pthread_cond_t   space;      /* record taken                  */
+    pthread_t        thread;
+    storeSink        fn;
+    void            *arg;
+    gmtMetrics      *pm;         /* backlog and drops, or NULL    */
+};
+
+/* --- prototypes ----
+ */
+extern void    metAdd       (_Atomic unsigned long long *pc, unsigned long long n);
+extern void    metSet       (_Atomic long long *pg, long long v);
+
+void           storeDestroy (gmtStore *ps);
+static void   *storeThread  (void *arg);
+static int     storeResize  (gmtStore *ps, unsigned long size);
+static void    storeLevel   (gmtStore *ps);
+static int     storeFull    (gmtStore *ps, int ms);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* create the storage stage, and start its thread; <fn> is called
+ * with each record, in order; at most <limit> sample records are
+ * queued, <policy> (GMT_OVF_*) decides what happens beyond that;
+ * record data (spectra, capture blocks) up to <payload> MB;
+ * <pm> gets the backlog and the drops, it may be NULL
+ * returns the store, or NULL on error
+ */
+gmtStore  *storeCreate (unsigned long limit, int payload, int policy, storeSink fn, void *arg,
+                        gmtMetrics *pm)
+{
+    gmtStore            *ps;
+    pthread_condattr_t   ca;
+
+    if (!(ps = calloc (1, sizeof (gmtStore))))
+        return NULL;
+    ps->limit   = (limit > 0) ? limit : GMT_STORE_BACKLOG;
+    ps->payload = (size_t) ((payload > 0) ? payload : GMT_STORE_PAYLOAD) << 20;
+    ps->policy  = policy;
+    ps->fn      = fn;
+    ps->arg     = arg;
+    ps->pm      = pm;
+    if (storeResize (ps, GMT_STORE_CHUNK) != 0)
+    {
+        free (ps);
+        return NULL;
+    }
+    pthread_mutex_init (&ps->lock, NULL);
+    pthread_cond_init (&ps->more, NULL);
+    /* timed waits for space; not affected by clock changes */
+    pthread_condattr_init (&ca);
+    pthread_condattr_setclock (&ca, CLOCK_MONOTONIC);
+    pthread_cond_init (&ps->space, &ca);
+    pthread_condattr_destroy (&ca);
+    if (pm)
+        metSet (&pm->backlogLimit, (long long) ps->limit);
+
+    if (pthread_create (&ps->thread, NULL, storeThread, ps) != 0)
+    {
+        pthread_cond_destroy (&ps->space);
+        pthread_cond_destroy (&ps->more);
+        pthread_mutex_destroy (&ps->lock);
+        free (ps->buf);
+        free (ps);
+        return NULL;
+    }
+    return ps;
+}
+
+
+
+/* write all queued records, end the thread, and release the store;
+ * <ps> may be NULL
+ */
+void  storeDestroy (gmtStore *ps)
+{
+    if (!ps)
+        return;
+    pthread_mutex_lock (&ps->lock);
+    ps->stop = 1;
+    pthread_cond_broadcast (&ps->more);
+    pthread_cond_broadcast (&ps->space);
+    pthread_mutex_unlock (&ps->lock);
+    pthread_join (ps->thread, NULL);
+
+    pthread_cond_destroy (&ps->space);
+    pthread_cond_destroy (&ps->more);
+    pthread_mutex_destroy (&ps->lock);
+    free (ps->buf);
+    free (ps);
+}
+
+
+
+/* queue one record, a copy of <pr>; never waits for the sink; if
+ * the queue is full and the policy is GMT_OVF_BLOCK, a sample record
+ * is not queued, the producer is to wait with storeWait (), and try
+ * again;
+ * config records are always queued; the data of spectrum and capture
+ * records are taken over, and the record is dropped (and its data
+ * released) if they would exceed the payload limit
+ * returns 0 if queued, 1 if a record was dropped (for a spectrum
+ * or capture record: this one), or 2 if the queue is full (BLOCK)
+ */
+int  storePut (gmtStore *ps, const storeRecord *pr)
+{
+    storeRecord  *pd;
+    int           rv = 0;
+
+    pthread_mutex_lock (&ps->lock);
+    if (pr->data && (ps->bytes + pr->size > ps->payload))
+    {
+        if (ps->lost++ == 0)
+            printf ("storage stalled, %zu MB of spectra / capture held; dropping the newest\n",
+                    ps->payload >> 20);
+        goto nomem;
+    }
+    if ((pr->kind == STORE_SAMPLE) && (ps->count >= ps->limit))
+    {
+        if (ps->policy == GMT_OVF_BLOCK)
+        {
+            pthread_mutex_unlock (&ps->lock);
+            return 2;
+        }
+        /* the oldest one; unless it is not a sample record */
+        if ((ps->policy == GMT_OVF_DROP_OLDEST) && (ps->buf[ps->head].kind == STORE_SAMPLE))
+        {
+            ps->head = (ps->head + 1) % ps->size;
+            ps->count--;
+            rv = 1;
+        }
+        else
+            rv = 2;
+
+        if (rv && (ps->lost++ == 0))
+            printf ("storage stalled, backlog of %lu records full; dropping the %s ones\n", ps->limit,
+                    (rv == 1) ? "oldest" : "newest");
+        if (rv && ps->pm)
+            metAdd (&ps->pm->dropped, 1);
+        if (rv == 2)
+        {
+            pthread_mutex_unlock (&ps->lock);
+            return 1;
+        }
+    }
+
+    /* no memory; as if the queue was full */
+    if ((ps->count >= ps->size) && (storeResize (ps, ps->size * 2) != 0))
+        goto nomem;
+    pd  = &ps->buf[(ps->head + ps->count) % ps->size];
+    *pd = *pr;
+    if (pr->path && !(pd->path = strdup (pr->path)))
+        goto nomem;
+    ps->count++;
+    ps->bytes += pr->data ? pr->size : 0;
+    storeLevel (ps);
+    pthread_cond_signal (&ps->more);
+    pthread_mutex_unlock (&ps->lock);
+    return (rv ? 1 : 0);
+
+nomem:
+    free (pr->data);
+    if (ps->pm)
+        metAdd (&ps->pm->dropped, 1);
+    pthread_mutex_unlock (&ps->lock);
+    return 1;
+}
+
+
+
+/* with the GMT_OVF_BLOCK policy, wait at most <ms> ms while the
+ * sample records fill the queue; the producer does not go on with
+ * more records then, but serves its other events, and tries again
+ * returns 0 if there is space (or another policy), or 1 if full
+ */
+int  storeWait (gmtStore *ps, int ms)
+{
+    int  rv = 0;
+
+    pthread_mutex_lock (&ps->lock);
+    if (ps->policy == GMT_OVF_BLOCK)
+        rv = storeFull (ps, ms);
+    pthread_mutex_unlock (&ps->lock);
+    return rv;
+}
+
+
+
+/* count a sample record the producer gave up on, while a blocking
+ * queue stayed full; it joins the current series of dropped records
+ */
+void  storeSkip (gmtStore *ps)
+{
+    pthread_mutex_lock (&ps->lock);
+    if (ps->lost++ == 0)
+        printf ("storage stalled, backlog of %lu records full; skipping samples\n", ps->limit);
+    if (ps->pm)
+        metAdd (&ps->pm->dropped, 1);
+    pthread_mutex_unlock (&ps->lock);
+}
+
+
+
+/* change the limits and the overflow policy; records already queued
+ * beyond a lower limit are kept
+ */
+void  storeSetLimit (gmtStore *ps, unsigned long limit, int payload, int policy)
+{
+    pthread_mutex_lock (&ps->lock);
+    ps->limit   = (limit > 0) ? limit : GMT_STORE_BACKLOG;
+    ps->payload = (size_t) ((payload > 0) ? payload : GMT_STORE_PAYLOAD) << 20;
+    ps->policy  = policy;
+    if (ps->pm)
+        metSet (&ps->pm->backlogLimit, (long long) ps->limit);
+    pthread_cond_broadcast (&ps->space);
+    pthread_mutex_unlock (&ps->lock);
+}
+
+
+
+/* storage thread; takes the records in order, and hands each one to
+ * the sink without the lock held, so the producer is never kept
+ * waiting by the medium; on a stop, the queue is drained first
+ */
+static void  *storeThread (void *arg)
+{
+    gmtStore     *ps = (gmtStore *) arg;
+    storeRecord   r;
+
+    pthread_mutex_lock (&ps->lock);
+    while (1)
+    {
+        while (!ps->stop && (ps->count == 0))
+            pthread_cond_wait (&ps->more, &ps->lock);
+        if (ps->count == 0)
+            break;
+
+        r = ps->buf[ps->head];
+        ps->head = (ps->head + 1) % ps->size;
+        ps->count--;
+        ps->busy   = 1;
+        ps->bytes -= r.data ? r.size : 0;
+        pthread_cond_signal (&ps->space);
+        pthread_mutex_unlock (&ps->lock);
+
+        ps->fn (ps->arg, &r);
+        free (r.path);
+        free (r.data);
+
+        pthread_mutex_lock (&ps->lock);
+        ps->busy = 0;
+        storeLevel (ps);
+
+        /* caught up; give the memory of a stall back */
+        if (ps->count == 0)
+        {
+            if (ps->lost > 0)
+                printf ("storage recovered, %lu records dropped\n", ps->lost);
+            ps->lost = 0;
+            if (ps->size > GMT_STORE_CHUNK)
+                storeResize (ps, GMT_STORE_CHUNK);
+        }
+    }
+    pthread_mutex_unlock (&ps->lock);
+    return NULL;
+}
+
+
+
+/* change the size of the buffer, with the queued records in order at
+ * the start of the new one; called with the lock held
+ * returns 0 on success, or -1 if no memory is available
+ */
+static int  storeResize (gmtStore *ps, unsigned long size)
+{
+    storeRecord    *pb;
+    unsigned long   i;
+
+    if (size < ps->count)
+        return -1;
+    if (!(pb = malloc (size * sizeof (storeRecord))))
+        return -1;
+    for (i=0; i<ps->count; i++)
+        pb[i] = ps->buf[(ps->head + i) % ps->size];
+    free (ps->buf);
+    ps->buf  = pb;
+    ps->size = size;
+    ps->head = 0;
+    return 0;
+}
+
+
+
+/* the backlog to the metrics; called with the lock held
+ */
+static void  storeLevel (gmtStore *ps)
+{
+    long long  n;
+
+    if (!ps->pm)
+        return;
+    n = (long long) (ps->count + (unsigned long) ps->busy);
+    metSet (&ps->pm->backlog, n);
+    if (n > atomic_load_explicit (&ps->pm->backlogPeak, memory_order_relaxed))
+        metSet (&ps->pm->backlogPeak, n);
+}
+
+
+
+/* wait at most <ms> ms for space for a sample record; called with
+ * the lock held
+ * returns 0 if there is space, or 1 if the queue is still full
+ */
+static int  storeFull (gmtStore *ps, int ms)
+{
+    struct timespec  tend;
+
+    clock_gettime (CLOCK_MONOTONIC, &tend);
+    tend.tv_sec  += ms / 1000;
+    tend.tv_nsec += (ms % 1000) * 1000000L;
+    if (tend.tv_nsec >= 1000000000L)
+    {
+        tend.tv_sec++;
+        tend.tv_nsec -= 1000000000L;
+    }
+    while (!ps->stop && (ps->count >= ps->limit))
+    {
+        if (pthread_cond_timedwait (&ps->space, &ps->lock, &tend) != 0)
+            break;
+    }
+    return ((ps->count >= ps->limit) ? 1 : 0);
+}
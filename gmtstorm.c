@@ -0,0 +1,184 @@
+/***************************************************************************
+ *                           gmtstorm.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the online storm detector, with
+ *      rate of change and baseline deviation alarms per record
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gmt.h"
+
+/* the baseline is the mean of the records in the ring; the running
+ * sums are computed again from the ring once per turn, so rounding
+ * errors cannot pile up
+ */
+struct gmtStorm
+{
+    double        *ring;         /* size * STORM_CHANNELS values  */
+    int            size;         /* records of the baseline       */
+    int            count;        /* records in the ring           */
+    int            pos;          /* next one to replace           */
+    double         sum[STORM_CHANNELS];
+    int            have;         /* a previous record             */
+    time_t         tprev;
+    double         vprev[STORM_CHANNELS];
+    double         dbdt;         /* thresholds, nT / min, nT      */
+    double         dev;
+    double         hyst;         /* clear level, fraction         */
+    unsigned int   active;       /* STORM_BIT_*                   */
+};
+
+/* --- prototypes ----
+ */
+static unsigned int  stormCheck (gmtStorm *ps, unsigned int bit, double v, double limit);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* create a storm detector for records every <period> seconds, with
+ * a baseline of <baseline> minutes; the thresholds are set by
+ * stormSetLimits ()
+ * returns NULL on memory shortage
+ */
+gmtStorm  *stormCreate (int period, int baseline)
+{
+    gmtStorm  *ps;
+
+    if (!(ps = calloc (1, sizeof (gmtStorm))))
+        return NULL;
+    ps->size = (baseline * 60) / ((period > 0) ? period : 1);
+    if (ps->size < STORM_MIN_FILL)
+        ps->size = STORM_MIN_FILL;
+    if (!(ps->ring = malloc (ps->size * STORM_CHANNELS * sizeof (double))))
+    {
+        free (ps);
+        return NULL;
+    }
+    ps->hyst = STORM_HYSTERESIS / 100.0;
+    return ps;
+}
+
+
+
+/* release a storm detector; <ps> may be NULL
+ */
+void  stormDestroy (gmtStorm *ps)
+{
+    if (!ps)
+        return;
+    free (ps->ring);
+    free (ps);
+}
+
+
+
+/* set the thresholds; dB/dt in nT / min, the deviation in nT, 0 for
+ * none; alarms clear below <hyst> percent of them
+ */
+void  stormSetLimits (gmtStorm *ps, double dbdt, double dev, int hyst)
+{
+    ps->dbdt = dbdt;
+    ps->dev  = dev;
+    ps->hyst = ((hyst > 0) && (hyst <= 100)) ? hyst / 100.0 : STORM_HYSTERESIS / 100.0;
+}
+
+
+
+/* add one record at <t>, the values <pv> of X, Y, Z in Ga;
+ * <pe> gets the rates, deviations and alarms of the record
+ * returns 1 if an alarm was raised or cleared, 0 if not
+ */
+int  stormAdd (gmtStorm *ps, time_t t, const double *pv, stormEvent *pe)
+{
+    double        *pr;
+    double         dt;
+    unsigned int   prev;
+    int            c, i;
+
+    memset (pe, 0, sizeof (stormEvent));
+    pe->time = t;
+    for (c=0; c<GMT_AXES; c++)
+        pe->value[c] = pv[c];
+    pe->value[STORM_F] = sqrt (pv[DI_X] * pv[DI_X] + pv[DI_Y] * pv[DI_Y] + pv[DI_Z] * pv[DI_Z]);
+
+    /* rate from the previous record, per minute */
+    dt = ps->have ? (double) (t - ps->tprev) / 60.0 : 0.0;
+    for (c=0; c<STORM_CHANNELS; c++)
+    {
+        if (dt > 0.0)
+            pe->dbdt[c] = (pe->value[c] - ps->vprev[c]) * STORM_NT_PER_GA / dt;
+        if (ps->count >= STORM_MIN_FILL)
+            pe->dev[c] = (pe->value[c] - ps->sum[c] / ps->count) * STORM_NT_PER_GA;
+        ps->vprev[c] = pe->value[c];
+    }
+    ps->tprev = t;
+    ps->have  = 1;
+
+    /* the record into the baseline, replacing the oldest one */
+    pr = &ps->ring[ps->pos * STORM_CHANNELS];
+    for (c=0; c<STORM_CHANNELS; c++)
+    {
+        if (ps->count == ps->size)
+            ps->sum[c] -= pr[c];
+        pr[c]       = pe->value[c];
+        ps->sum[c] += pr[c];
+    }
+    if (ps->count < ps->size)
+        ps->count++;
+    if (++ps->pos == ps->size)
+    {
+        ps->pos = 0;
+        for (c=0; c<STORM_CHANNELS; c++)
+            for (ps->sum[c]=0.0, i=0; i<ps->count; i++)
+                ps->sum[c] += ps->ring[i * STORM_CHANNELS + c];
+    }
+
+    prev = ps->active;
+    for (c=0; c<STORM_CHANNELS; c++)
+    {
+        if (dt > 0.0)
+            stormCheck (ps, STORM_BIT_DBDT (c), pe->dbdt[c], ps->dbdt);
+        if (ps->count > STORM_MIN_FILL)
+            stormCheck (ps, STORM_BIT_DEV (c), pe->dev[c], ps->dev);
+    }
+    pe->active  = ps->active;
+    pe->changed = ps->active ^ prev;
+    return (pe->changed ? 1 : 0);
+}
+
+
+
+/* the alarm <bit> for the value <v>; raised when |v| reaches <limit>,
+ * cleared when below the hysteresis level; a <limit> of 0 clears it
+ * returns the alarm bits
+ */
+static unsigned int  stormCheck (gmtStorm *ps, unsigned int bit, double v, double limit)
+{
+    if (limit <= 0.0)
+        ps->active &= ~bit;
+    else if (!(ps->active & bit) && (fabs (v) >= limit))
+        ps->active |= bit;
+    else if ((ps->active & bit) && (fabs (v) < limit * ps->hyst))
+        ps->active &= ~bit;
+    return ps->active;
+}
@@ -0,0 +1,302 @@
+/***************************************************************************
+ *                           gmtudp.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the UDP live data publisher, sending
+ *      second / minute / hour aggregates to a list of targets
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#define _GNU_SOURCE     /* sendmmsg() */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "gmt.h"
+
+struct gmtPublisher
+{
+    int                 sock;                           /* UDP socket        */
+    int                 ntargets;                       /* used targets      */
+    struct sockaddr_in  target[GMT_UDP_MAX_TARGETS];    /* target addresses  */
+    unsigned short      portbase[GMT_UDP_MAX_TARGETS];  /* per target        */
+    unsigned short      station;                        /* station id        */
+    unsigned int        seq[GMT_PCK_TYPES];             /* per packet type   */
+    int                 nqueued;                        /* packets queued    */
+    gmtPacket           queue[GMT_UDP_MAX_QUEUE];
+    unsigned long       sent;                           /* datagrams sent    */
+    unsigned long       errors;                         /* send errors       */
+};
+
+/* --- prototypes ----
+ */
+int                  udpFlush  (gmtPublisher *pp);
+static gmtPacket    *udpSlot   (gmtPublisher *pp, int type, const struct timespec *ts, int period,
+                                unsigned long count);
+static unsigned int  floatBits (double v);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* create the publisher for a comma-separated list of targets,
+ * each given as "host" or "host:portbase";
+ * returns NULL if no target could be resolved, or on error
+ */
+gmtPublisher  *udpCreate (const char *targets, int station)
+{
+    gmtPublisher     *pp;
+    struct addrinfo   hints, *pai;
+    char              list[GMT_TARGET_SIZE];
+    char             *ptok, *psave, *pport;
+    int               base;
+
+    if (!targets || !*targets)
+        return NULL;
+    if (!(pp = calloc (1, sizeof (gmtPublisher))))
+        return NULL;
+    pp->station = (unsigned short) station;
+
+    strncpy (list, targets, sizeof (list));
+    list[sizeof (list) - 1] = '\0';
+
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    for (ptok = strtok_r (list, ", \t", &psave); ptok && (pp->ntargets < GMT_UDP_MAX_TARGETS);
+         ptok = strtok_r (NULL, ", \t", &psave))
+    {
+        base = GMT_UDP_PORTBASE;
+        if ((pport = strchr (ptok, ':')))
+        {
+            *pport++ = '\0';
+            base     = atoi (pport);
+        }
+
+        if (getaddrinfo (ptok, NULL, &hints, &pai) != 0)
+        {
+            fprintf (stderr, "publish target <%s> not resolved\n", ptok);
+            continue;
+        }
+        memcpy (&pp->target[pp->ntargets], pai->ai_addr, sizeof (struct sockaddr_in));
+        pp->portbase[pp->ntargets] = (unsigned short) base;
+        pp->ntargets++;
+        freeaddrinfo (pai);
+    }
+
+    if ((pp->ntargets == 0) || ((pp->sock = socket (AF_INET, SOCK_DGRAM, 0)) < 0))
+    {
+        free (pp);
+        return NULL;
+    }
+    return pp;
+}
+
+
+
+/* close the socket, and release the publisher
+ */
+void  udpDestroy (gmtPublisher *pp)
+{
+    if (!pp)
+        return;
+    close (pp->sock);
+    free (pp);
+}
+
+
+
+/* queue one aggregate packet of type <type>;
+ * the interval starts at <ts>, and lasts <period> seconds;
+ * <pmin> / <pmax> may be NULL if not known, the mean is sent then;
+ * a full queue is sent right away
+ */
+void  udpQueue (gmtPublisher *pp, int type, const struct timespec *ts, int period,
+                unsigned long count, const double *pmean, const double *pmin, const double *pmax)
+{
+    gmtPacket  *pk;
+    int         i;
+
+    if (!(pk = udpSlot (pp, type, ts, period, count)))
+        return;
+    pk->dtype = ELFD_DTYPE_FLOAT;
+    for (i=0; i<GMT_AXES; i++)
+    {
+        pk->mean[i] = floatBits (pmean[i]);
+        pk->min[i]  = floatBits (pmin ? pmin[i] : pmean[i]);
+        pk->max[i]  = floatBits (pmax ? pmax[i] : pmean[i]);
+    }
+}
+
+
+
+/* queue one aggregate packet of integer units, like udpQueue ();
+ * the values are sent as they are, with <scale> (Ga per unit)
+ */
+void  udpQueueInt (gmtPublisher *pp, int type, const struct timespec *ts, int period,
+                   unsigned long count, const int *pmean, const int *pmin, const int *pmax,
+                   double scale)
+{
+    gmtPacket  *pk;
+    int         i;
+
+    if (!(pk = udpSlot (pp, type, ts, period, count)))
+        return;
+    pk->dtype = ELFD_DTYPE_INT;
+    pk->scale = floatBits (scale);
+    for (i=0; i<GMT_AXES; i++)
+    {
+        pk->mean[i] = htonl ((unsigned int) pmean[i]);
+        pk->min[i]  = htonl ((unsigned int) (pmin ? pmin[i] : pmean[i]));
+        pk->max[i]  = htonl ((unsigned int) (pmax ? pmax[i] : pmean[i]));
+    }
+}
+
+
+
+/* queue one storm alert packet; the alarms after the record, and its
+ * rates and deviations (see GMT_PCK_ALERT)
+ */
+void  udpQueueAlert (gmtPublisher *pp, const stormEvent *pe, int period)
+{
+    struct timespec  ts;
+    gmtPacket       *pk;
+    int              i;
+
+    ts.tv_sec  = pe->time;
+    ts.tv_nsec = 0;
+    if (!(pk = udpSlot (pp, GMT_PCK_ALERT, &ts, period, pe->active)))
+        return;
+    pk->dtype       = ELFD_DTYPE_FLOAT;
+    pk->reserved[0] = (pe->changed & pe->active) ? 1 : 0;
+    pk->reserved[1] = (pe->changed & ~pe->active) ? 1 : 0;
+    for (i=0; i<GMT_AXES; i++)
+    {
+        pk->mean[i] = floatBits (pe->dbdt[i]);
+        pk->min[i]  = floatBits (pe->dev[i]);
+    }
+    pk->max[0] = floatBits (pe->dbdt[STORM_F]);
+    pk->max[1] = floatBits (pe->dev[STORM_F]);
+    pk->max[2] = floatBits (pe->value[STORM_F]);
+}
+
+
+
+/* send all queued packets to all targets, with one system call;
+ * returns the number of datagrams sent
+ */
+int  udpFlush (gmtPublisher *pp)
+{
+    struct mmsghdr      msgs[GMT_UDP_MAX_TARGETS * GMT_UDP_MAX_QUEUE];
+    struct iovec        iov[GMT_UDP_MAX_QUEUE];
+    struct sockaddr_in  dest[GMT_UDP_MAX_TARGETS * GMT_UDP_MAX_QUEUE];
+    int                 i, k, n, port, rv;
+
+    if (!pp || (pp->nqueued == 0))
+        return 0;
+
+    n = 0;
+    for (i=0; i<pp->nqueued; i++)
+    {
+        iov[i].iov_base = &pp->queue[i];
+        iov[i].iov_len  = sizeof (gmtPacket);
+        port = (pp->queue[i].type == GMT_PCK_SECOND) ? GMT_UDP_PORTOFFSET_SEC : GMT_UDP_PORTOFFSET_MH;
+        if (pp->queue[i].type == GMT_PCK_ALERT)
+            port = GMT_UDP_PORTOFFSET_ALERT;
+
+        for (k=0; k<pp->ntargets; k++, n++)
+        {
+            dest[n]          = pp->target[k];
+            dest[n].sin_port = htons ((unsigned short) (pp->portbase[k] + port));
+            memset (&msgs[n], 0, sizeof (struct mmsghdr));
+            msgs[n].msg_hdr.msg_name    = &dest[n];
+            msgs[n].msg_hdr.msg_namelen = sizeof (struct sockaddr_in);
+            msgs[n].msg_hdr.msg_iov     = &iov[i];
+            msgs[n].msg_hdr.msg_iovlen  = 1;
+        }
+    }
+    pp->nqueued = 0;
+
+    /* a datagram that fails is skipped, the rest is still sent */
+    for (i=0; i<n; i+=rv)
+    {
+        if ((rv = sendmmsg (pp->sock, msgs + i, n - i, MSG_DONTWAIT)) <= 0)
+        {
+            if ((rv < 0) && (errno == EINTR))
+            {
+                rv = 0;
+                continue;
+            }
+            pp->errors++;
+            rv = 1;
+            continue;
+        }
+        pp->sent += rv;
+    }
+    return n;
+}
+
+
+
+/* next free queue entry, with the common fields set;
+ * a full queue is sent first;
+ * returns NULL if the packet type is not valid
+ */
+static gmtPacket  *udpSlot (gmtPublisher *pp, int type, const struct timespec *ts, int period,
+                            unsigned long count)
+{
+    gmtPacket  *pk;
+
+    if (!pp || (type <= 0) || (type >= GMT_PCK_TYPES))
+        return NULL;
+    if (pp->nqueued >= GMT_UDP_MAX_QUEUE)
+        udpFlush (pp);
+
+    pk = &pp->queue[pp->nqueued++];
+    memset (pk, 0, sizeof (gmtPacket));
+    memcpy (pk->id, GMT_PCK_ID, 4);
+    pk->version = GMT_PCK_VERSION;
+    pk->type    = (unsigned char) type;
+    pk->station = htons (pp->station);
+    pk->seq     = htonl (pp->seq[type]++);
+    pk->tsec    = htonl ((unsigned int) ts->tv_sec);
+    pk->tmsec   = htons ((unsigned short) (ts->tv_nsec / 1000000L));
+    pk->period  = htons ((unsigned short) period);
+    pk->count   = htonl ((unsigned int) count);
+    return pk;
+}
+
+
+
+/* float bit pattern of a value, in network byte order
+ */
+static unsigned int  floatBits (double v)
+{
+    float         f = (float) v;
+    unsigned int  u;
+
+    memcpy (&u, &f, sizeof (u));
+    return htonl (u);
+}
@@ -0,0 +1,300 @@
+/***************************************************************************
+ *                           gmtwriter.c
+ *                       -------------------
+ *  begin                : Fri Oct 16 2026
+ *  copyright            : (C) 2026 by fm
+ *  email                : frank.meyer@cablelink.at
+ *
+ *      POSIX implementation of a geomagnetic field tracking tool;
+ *      this source file implements the day file writer, which keeps
+ *      the current file open, batches records, and syncs by policy
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "gmt.h"
+
+/* --- prototypes ----
+ */
+extern void    metAdd      (_Atomic unsigned long long *pc, unsigned long long n);
+
+int            writerFlush (gmtWriter *pw);
+void           gmtMkDir    (const char *path);
+static int     writerSync  (gmtWriter *pw);
+time_t         monoSeconds (void);
+
+
+/* --------------------------------
+ * ------------  code  ------------
+ */
+
+/* initialize the writer;
+ * <path> is the data directory, created when the first file is opened;
+ * <tag> (may be NULL) is appended to the file names, to tell the files
+ * of several sensors apart;
+ * returns 0 on success, or 1 if no buffer memory is available
+ */
+int  writerInit (gmtWriter *pw, const char *path, const char *tag, int batch, int syncMode, int syncValue)
+{
+    memset (pw, 0, sizeof (gmtWriter));
+    pw->fd        = -1;
+    pw->batch     = (batch > 0) ? batch : GMT_WRITE_BATCH;
+    pw->syncMode  = syncMode;
+    pw->syncValue = (syncValue > 0) ? syncValue : 1;
+    pw->lastSync  = monoSeconds ();
+    strncpy (pw->path, path, FILENAME_MAXSIZE);
+    pw->path[FILENAME_MAXSIZE-1] = '\0';
+    if (tag)
+    {
+        strncpy (pw->tag, tag, GMT_NAME_SIZE);
+        pw->tag[GMT_NAME_SIZE-1] = '\0';
+    }
+
+    pw->size = GMT_WRITE_BUFSIZE;
+    if (!(pw->buf = malloc (pw->size)))
+        return 1;
+    return 0;
+}
+
+
+
+/* make sure the file for the day in <ptime> is open;
+ * the file stays open until the day changes, only then the data
+ * directory is checked, and the next file is opened;
+ * returns 1 if a new, empty file was opened (header needed),
+ * 0 if the file is open and already has data, or -1 on error
+ */
+int  writerDay (gmtWriter *pw, struct tm *ptime)
+{
+    char         fname[FILENAME_MAXSIZE + GMT_NAME_SIZE + 32];
+    struct stat  st = { 0 };
+
+    if ((pw->fd >= 0) && (pw->mday == ptime->tm_mday))
+        return 0;
+
+    /* day rolled over; finish the old file completely */
+    if (pw->fd >= 0)
+    {
+        writerFlush (pw);
+        if (pw->syncMode != GMT_SYNC_NONE)
+            writerSync (pw);
+        close (pw->fd);
+        pw->fd = -1;
+    }
+
+    gmtMkDir (pw->path);
+
+    /* using the current date as name automatically creates a new file each day */
+    snprintf (fname, sizeof (fname), "%s/%4d_%02d_%02d%s%s.dat", pw->path,
+              ptime->tm_year + 1900, ptime->tm_mon+1, ptime->tm_mday,
+              pw->tag[0] ? "_" : "", pw->tag);
+    if ((pw->fd = open (fname, O_WRONLY | O_APPEND | O_CREAT, 0664)) < 0)
+    {
+        perror ("accessing data file");
+        return -1;
+    }
+    pw->mday = ptime->tm_mday;
+
+    if (fstat (pw->fd, &st) < 0)
+        return -1;
+    return ((st.st_size == 0) ? 1 : 0);
+}
+
+
+
+/* add one record (or header) text to the write buffer;
+ * only counted records trigger the batch write and the sync policy;
+ * returns 0 on success, or an error number
+ */
+int  writerPut (gmtWriter *pw, const char *text, int isRecord)
+{
+    size_t  n;
+    char   *pb;
+    int     rv;
+
+    n = strlen (text);
+    if (pw->len + n > pw->size)
+    {
+        if (!(pb = realloc (pw->buf, pw->len + n + GMT_WRITE_BUFSIZE)))
+            return 1;
+        pw->buf  = pb;
+        pw->size = pw->len + n + GMT_WRITE_BUFSIZE;
+    }
+    memcpy (pw->buf + pw->len, text, n);
+    pw->len += n;
+
+    if (!isRecord)
+        return 0;
+
+    pw->pending++;
+    pw->unsynced++;
+
+    rv = 0;
+    if (pw->pending >= pw->batch)
+        rv = writerFlush (pw);
+
+    /* a due sync includes the records still in the buffer */
+    if (((pw->syncMode == GMT_SYNC_RECORDS) && (pw->unsynced >= pw->syncValue)) ||
+        ((pw->syncMode == GMT_SYNC_SECONDS) && (monoSeconds () - pw->lastSync >= pw->syncValue)))
+    {
+        if (pw->len)
+            rv = writerFlush (pw);
+        if (rv == 0)
+            rv = writerSync (pw);
+    }
+    return rv;
+}
+
+
+
+/* write all buffered data to the open file, with one write call
+ * if possible; returns 0 on success, or an error number
+ */
+int  writerFlush (gmtWriter *pw)
+{
+    size_t   done;
+    ssize_t  n;
+
+    if (pw->len == 0)
+        return 0;
+    if (pw->fd < 0)
+        return 1;
+
+    done = 0;
+    while (done < pw->len)
+    {
+        n = write (pw->fd, pw->buf + done, pw->len - done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror ("writing data file");
+
+            /* keep the rest for the next attempt */
+            memmove (pw->buf, pw->buf + done, pw->len - done);
+            pw->len -= done;
+            return 2;
+        }
+        done += (size_t) n;
+        if (pw->written)
+            metAdd (pw->written, (unsigned long long) n);
+    }
+
+    pw->len     = 0;
+    pw->pending = 0;
+    return 0;
+}
+
+
+
+/* change the data directory; the open file is finished and closed,
+ * the next record opens the file of its day in the new directory
+ */
+void  writerSetPath (gmtWriter *pw, const char *path)
+{
+    if (pw->fd >= 0)
+    {
+        writerFlush (pw);
+        if (pw->syncMode != GMT_SYNC_NONE)
+            writerSync (pw);
+        close (pw->fd);
+        pw->fd = -1;
+    }
+    strncpy (pw->path, path, FILENAME_MAXSIZE);
+    pw->path[FILENAME_MAXSIZE-1] = '\0';
+}
+
+
+
+/* change the batch size and the sync policy;
+ * buffered records are kept, and written by the new rules
+ */
+void  writerSetPolicy (gmtWriter *pw, int batch, int syncMode, int syncValue)
+{
+    pw->batch     = (batch > 0) ? batch : GMT_WRITE_BATCH;
+    pw->syncMode  = syncMode;
+    pw->syncValue = (syncValue > 0) ? syncValue : 1;
+}
+
+
+
+/* write pending data, sync and close the file, and release the buffer
+ */
+void  writerClose (gmtWriter *pw)
+{
+    if (pw->fd >= 0)
+    {
+        writerFlush (pw);
+        if (pw->syncMode != GMT_SYNC_NONE)
+            writerSync (pw);
+        close (pw->fd);
+    }
+    pw->fd = -1;
+
+    free (pw->buf);
+    pw->buf  = NULL;
+    pw->size = pw->len = 0;
+}
+
+
+
+/* create data files in a sub-directory; might need to create the directory first...
+ * have to set "executable" rights, or else creating files fails
+ */
+void  gmtMkDir (const char *path)
+{
+    struct stat  st = { 0 };
+
+    if (stat (path, &st) == -1)
+    {
+        if (mkdir (path, S_IRUSR | S_IWUSR | S_IXUSR | S_IRGRP | S_IWGRP | S_IXGRP) != 0)
+            perror ("creating data directory");
+    }
+}
+
+
+
+/* force written data to the medium, and restart the sync counters
+ */
+static int  writerSync (gmtWriter *pw)
+{
+    pw->unsynced = 0;
+    pw->lastSync = monoSeconds ();
+
+    if ((pw->fd >= 0) && (fdatasync (pw->fd) != 0))
+    {
+        perror ("syncing data file");
+        return 3;
+    }
+    return 0;
+}
+
+
+
+/* seconds of the monotonic clock;
+ * not affected by setting the system time
+ */
+time_t  monoSeconds (void)
+{
+    struct timespec  ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}